@@ -3,7 +3,8 @@
 namespace algo {
 
     AlgoBase::AlgoBase(const std::string& name, pm::FloorBase::ChannelType& channel)
-    : m_name(name), m_channel(channel), m_should_run(false) {
+    : m_name(name), m_channel(channel), m_should_run(false), m_event_ns(0),
+      m_algo_pi_lat(utils::LatencyStats::HopAlgoPI) {
     }
 
     AlgoBase::~AlgoBase() {
@@ -119,6 +120,13 @@ namespace algo {
 
         msgreq.copyData((const char*)&pi, sizeof(pm::FloorBase::PositionInstruction));
         msgresp.copyString("");
+        if (!utils::TimeUtil::is_mocked()) {
+            auto* pip = (pm::FloorBase::PositionInstruction*)msgreq.buf;
+            pip->sent_ns = utils::LatencyStats::now_ns();
+            if (m_event_ns) {
+                m_algo_pi_lat.hist(pi.symbol)->record(pip->sent_ns - m_event_ns);
+            }
+        }
         if (!m_channel->requestAndCheckAck(msgreq, msgresp, 1, pm::FloorBase::SetPositionAck)) {
             logError("%s failed to set position: %s", m_name.c_str(), msgresp.buf);
             return false;
@@ -180,19 +188,138 @@ namespace algo {
         m_symbols.clear();
     }
 
+    void AlgoBase::subscribeEvents(int symid, int event_mask) {
+        auto& sinfo (m_symbols[symid]);
+        if ((event_mask & (EventBook|EventTrade)) && (!sinfo->_event_reader)) {
+            sinfo->_event_reader = sinfo->_bq->newReader();
+        }
+        if (event_mask & EventBar) {
+            md::BarPrice bar;
+            sinfo->_bar_reader->read(bar);
+            sinfo->_last_bar_time = bar.bar_time;
+        }
+        sinfo->_event_mask = event_mask;
+        logInfo("%s subscribed events %d on %s", m_name.c_str(), event_mask, sinfo->toString().c_str());
+    }
+
+    int AlgoBase::dispatchBookEvents() {
+        // bound the updates drained from a queue in one call
+        static const int MaxDrain = 1024;
+        int cnt = 0;
+        for (int symid = 0; symid < (int) m_symbols.size(); ++symid) {
+            auto& sinfo (*m_symbols[symid]);
+            if (!(sinfo._event_mask & (EventBook|EventTrade))) {
+                continue;
+            }
+            // drain and keep the latest quote and trade, reading into
+            // the spare slot and swapping, without copying the books
+            int updates = 0, book_cnt = 0, trade_cnt = 0;
+            md::BookDepot *next = &sinfo._event_buf[0], *book = &sinfo._event_buf[1], *trade = &sinfo._event_buf[2];
+            while ((updates < MaxDrain) && sinfo._event_reader->getNextUpdate(*next)) {
+                ++updates;
+                if (next->update_type == 2) {
+                    std::swap(next, trade);
+                    ++trade_cnt;
+                } else {
+                    std::swap(next, book);
+                    ++book_cnt;
+                }
+            }
+            if (!updates || !m_should_run) {
+                continue;
+            }
+            const bool has_book = book_cnt && (sinfo._event_mask & EventBook);
+            const bool has_trade = trade_cnt && (sinfo._event_mask & EventTrade);
+            sinfo._event_latency._coalesced += (has_book? book_cnt-1:0) + (has_trade? trade_cnt-1:0);
+
+            // deliver in the order of update time
+            const bool trade_first = has_trade && ((!has_book) || (trade->update_ts_micro <= book->update_ts_micro));
+            for (int k = 0; k < 2; ++k) {
+                const bool is_trade = (k==0)? trade_first : !trade_first;
+                if (is_trade && has_trade) {
+                    beginEvent(sinfo, *trade);
+                    onTrade(symid, *trade);
+                    ++cnt;
+                } else if (!is_trade && has_book) {
+                    beginEvent(sinfo, *book);
+                    onBookUpdate(symid, *book);
+                    ++cnt;
+                }
+            }
+        }
+        m_event_ns = 0;
+        return cnt;
+    }
+
+    void AlgoBase::beginEvent(SymbolInfo& sinfo, const md::BookDepot& book) {
+        // the shm stats are of the live path, not the simulations
+        if (__builtin_expect(utils::TimeUtil::is_mocked(), 0)) {
+            sinfo._event_latency.add((long long)utils::TimeUtil::cur_micro() - (long long)book.update_ts_micro);
+            return;
+        }
+        m_event_ns = utils::LatencyStats::now_ns();
+        const uint64_t lat_ns = m_event_ns - book.update_ts_micro*1000ULL;
+        sinfo._event_latency.add((long long)lat_ns/1000);
+        sinfo._md_algo_lat->record(lat_ns);
+    }
+
+    int AlgoBase::dispatchBarEvents() {
+        int cnt = 0;
+        for (int symid = 0; symid < (int) m_symbols.size(); ++symid) {
+            auto& sinfo (*m_symbols[symid]);
+            if (!(sinfo._event_mask & EventBar)) {
+                continue;
+            }
+            md::BarPrice bar;
+            sinfo._bar_reader->read(bar);
+            if (bar.bar_time > sinfo._last_bar_time) {
+                sinfo._last_bar_time = bar.bar_time;
+                if (m_should_run) {
+                    onBar(symid, bar);
+                    ++cnt;
+                }
+            }
+        }
+        return cnt;
+    }
+
+    bool AlgoBase::hasBookEvents() const {
+        for (const auto& sinfo : m_symbols) {
+            if (sinfo->_event_mask & (EventBook|EventTrade)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string AlgoBase::EventLatency::toString() const {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "events=%lld, latency_avg_us=%.1f, latency_max_us=%lld, coalesced=%lld",
+                _cnt, _cnt? (double)_sum_micro/_cnt : 0.0, _max_micro, _coalesced);
+        return std::string(buf);
+    }
+
     AlgoBase::SymbolInfo::SymbolInfo(md::BookConfig&& bcfg, int barsec)
     : _bcfg(std::move(bcfg)),
       _barsec(barsec), 
       _bq(std::make_shared<md::BookQType>(_bcfg, true)),
       _snap_reader(_bq->newReader()),
-      _bar_reader(std::make_shared<md::BarReader>(_bcfg, barsec))
+      _bar_reader(std::make_shared<md::BarReader>(_bcfg, barsec)),
+      _event_mask(0),
+      _last_bar_time(0),
+      _md_algo_lat(utils::LatencyStats::get().hist(utils::LatencyStats::HopMdAlgo, _bcfg.symbol.c_str()))
     {
     }
 
     std::string AlgoBase::SymbolInfo::toString() const {
-        char buf[256];
-        snprintf(buf, sizeof(buf), "bcfg=%s, barsec=%d",
-                _bcfg.toString().c_str(), _barsec);
+        char buf[512];
+        if (!_event_mask) {
+            snprintf(buf, sizeof(buf), "bcfg=%s, barsec=%d",
+                    _bcfg.toString().c_str(), _barsec);
+        } else {
+            snprintf(buf, sizeof(buf), "bcfg=%s, barsec=%d, event_mask=%d, %s",
+                    _bcfg.toString().c_str(), _barsec, _event_mask, _event_latency.toString().c_str());
+        }
         return std::string(buf);
     }
 
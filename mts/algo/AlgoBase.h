@@ -8,10 +8,37 @@
 #include "FloorBase.h"
 #include "md_snap.h"
 #include "md_bar.h"
+#include "latency_stats.h"
 
 namespace algo {
     class AlgoBase {
     public:
+        // events that could be subscribed per symbol, see subscribeEvents()
+        enum EventType {
+            EventBook = 1,   // onBookUpdate() on quote updates
+            EventTrade = 2,  // onTrade() on trade updates
+            EventBar = 4     // onBar() on new bars
+        };
+
+        // latency from the book's update_ts_micro, as written to shm
+        // by the tp, to the entry of the event callback
+        struct EventLatency {
+            long long _cnt;
+            long long _sum_micro;
+            long long _max_micro;
+            long long _coalesced;  // updates dropped in coalescing
+
+            EventLatency() : _cnt(0), _sum_micro(0), _max_micro(0), _coalesced(0) {};
+            void add(long long lat_micro) {
+                ++_cnt;
+                _sum_micro += lat_micro;
+                if (lat_micro > _max_micro) {
+                    _max_micro = lat_micro;
+                }
+            }
+            std::string toString() const;
+        };
+
         struct SymbolInfo {
             const md::BookConfig _bcfg;
             const int _barsec;
@@ -19,6 +46,14 @@ namespace algo {
             std::shared_ptr<md::BookQReader> _snap_reader;
             std::shared_ptr<md::BarReader> _bar_reader;
 
+            // event states, used if _event_mask is set
+            int _event_mask;
+            std::shared_ptr<md::BookQReader> _event_reader;
+            md::BookDepot _event_buf[3];  // read buffers of dispatchBookEvents()
+            time_t _last_bar_time;
+            EventLatency _event_latency;
+            utils::LatencyHist* _md_algo_lat;  // the md_algo hop in the shm stats
+
             SymbolInfo( md::BookConfig&& bcfg, int barsec);
             std::string toString() const;
         };
@@ -68,6 +103,26 @@ namespace algo {
         void removeSymbol(int symid);
         void removeAllSymbol();
 
+        // subscribe symid to the events in event_mask, a combination of EventType,
+        // 0 to unsubscribe.  The book updates are read from the symbol's BookQ
+        // from the time of subscription.
+        void subscribeEvents(int symid, int event_mask);
+
+        // called by AlgoThread, drains the BookQ of the symbols subscribed to
+        // EventBook or EventTrade and calls onBookUpdate()/onTrade().  In case
+        // of more than one pending updates, i.e. the strategy falls behind,
+        // only the latest quote and latest trade are delivered.
+        // The queues are drained even if not shouldRun(), without callbacks.
+        // Returns the number of callbacks.
+        int dispatchBookEvents();
+
+        // called by AlgoThread every second, calls onBar() for the symbols
+        // subscribed to EventBar with a new bar. Returns the number of callbacks.
+        int dispatchBarEvents();
+
+        // true if any symbol subscribed to EventBook or EventTrade
+        bool hasBookEvents() const;
+
         // utilities
         void setShouldRun(bool should_run) { m_should_run = should_run; };
         bool shouldRun() const { return m_should_run;};
@@ -83,6 +138,17 @@ namespace algo {
         // check to see what to do for algo
         virtual void onOneSecond(uint64_t cur_micro) = 0;
 
+        // the next utc after cur_utc that onOneSecond() may act upon, 0 if none.
+        // Used by simulation to skip the idle seconds, default every second.
+        virtual time_t nextTriggerUtc(time_t cur_utc) const { return cur_utc + 1; };
+
+        // event callbacks of the subscribed symbols, see subscribeEvents()
+        // a trade update's book also has bvol_cum/svol_cum, in case of
+        // coalesced trades
+        virtual void onBookUpdate(int symid, const md::BookDepot& book) {};
+        virtual void onTrade(int symid, const md::BookDepot& book) {};
+        virtual void onBar(int symid, const md::BarPrice& bar) {};
+
         // dump current parameters and states
         virtual std::string onDump() const = 0;
 
@@ -101,6 +167,12 @@ namespace algo {
         std::string m_cfg;
         volatile bool m_should_run;
         std::vector< std::shared_ptr<SymbolInfo> > m_symbols;
+        uint64_t m_event_ns;  // entry of the event callback being run, 0 if none
+        utils::LatencyHopCache m_algo_pi_lat;  // by symbol
         virtual bool setPosition(const pm::FloorBase::PositionInstruction& pi);
+
+    private:
+        // records the latency of the book event about to be delivered
+        void beginEvent(SymbolInfo& sinfo, const md::BookDepot& book);
     };
 }
@@ -88,6 +88,10 @@ namespace algo {
         while (m_should_run) {
             while( this->run_one_loop(*this) ) {
             };
+            // book events are polled at most every event_sleep_micro
+            // when any strategy subscribed to them
+            const bool has_events = runBookEvents();
+
             // call onOneSecond 
             cur_micro = TimerType::cur_micro();
             int64_t diff_time = next_micro - cur_micro;
@@ -103,6 +107,9 @@ namespace algo {
                 if (diff_time > max_sleep_micro) {
                     diff_time = max_sleep_micro;
                 }
+                if (has_events && (diff_time > event_sleep_micro)) {
+                    diff_time = event_sleep_micro;
+                }
                 TimerType::micro_sleep(diff_time);
             }
         }
@@ -114,12 +121,39 @@ namespace algo {
     void AlgoThread::runOneSecond(uint64_t cur_micro) {
         for (auto& am : m_algo_map) {
             auto& ap = am.second;
+            ap->dispatchBarEvents();
             if (ap->shouldRun()) {
                 ap->onOneSecond(cur_micro);
             }
         }
     }
 
+    time_t AlgoThread::nextTriggerUtc(time_t cur_utc) const {
+        time_t next_utc = 0;
+        for (const auto& am : m_algo_map) {
+            const auto& ap = am.second;
+            if (ap->shouldRun()) {
+                const time_t utc = ap->nextTriggerUtc(cur_utc);
+                if (utc && ((!next_utc) || (utc < next_utc))) {
+                    next_utc = utc;
+                }
+            }
+        }
+        return next_utc;
+    }
+
+    bool AlgoThread::runBookEvents() {
+        bool has_events = false;
+        for (auto& am : m_algo_map) {
+            auto& ap = am.second;
+            if (ap->hasBookEvents()) {
+                has_events = true;
+                ap->dispatchBookEvents();
+            }
+        }
+        return has_events;
+    }
+
     void AlgoThread::handleMessage(const MsgType& msg_in) {
         // the algo command is expected to be
         // 'L': list loaded strategies
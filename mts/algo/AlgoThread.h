@@ -57,9 +57,19 @@ namespace algo {
                      const std::string& cfg);
         void setSubscriptions();
 
-        // run onOneSecond() for all strategies
+        // run onOneSecond() for all strategies, with onBar() before it
         void runOneSecond(uint64_t cur_micro);
 
+        // the earliest nextTriggerUtc() of the running strategies, 0 if none
+        time_t nextTriggerUtc(time_t cur_utc) const;
+
+        // dispatch book events of all strategies, returns true if
+        // any strategy subscribed to book events
+        bool runBookEvents();
+
+        // the longest sleep between polling book events
+        static const int event_sleep_micro = 200;
+
         friend class StratSim;
     };
 
@@ -0,0 +1,143 @@
+#include "StratSim.h"
+#include "plcc/PLCC.hpp"
+#include "csv_util.h"
+#include <thread>
+#include <vector>
+#include <atomic>
+
+/*
+ * Runs many StratSim jobs concurrently, i.e. a parameter sweep over days.
+ * The manifest has one job per line, a job is a chain of StratSim config
+ * files, such as the consecutive days of a strategy, which are simulated
+ * in order on the same worker, for strategies carrying state from one
+ * day to the next.  Lines starting with '#' are skipped.
+ *
+ * Each worker isolates a simulation with the thread local clock, the
+ * thread local PLCC from the job's config file and the thread local
+ * BookConfig provider "sim<worker>" for the shm queues of the BarPub.
+ * Different jobs should therefore have their own RecoveryPath, BarPath
+ * and SimTraceFile in the config files.  With "scale", the manifest is
+ * run with 1 up to the given threads, for the scaling of the throughput.
+ */
+
+struct Job {
+    std::vector<std::string> cfg_files;
+
+    // result
+    bool ok;
+    int sims;
+    long long steps;
+    double ms;
+};
+
+static long long now_micro() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000LL + ts.tv_nsec/1000;
+}
+
+static std::vector<Job> readManifest(const std::string& manifest_file) {
+    std::vector<Job> jobs;
+    const auto& lines(utils::CSVUtil::read_file(manifest_file));
+    for (const auto& tk : lines) {
+        if ((tk.size()==0) || (tk[0].size()==0) || (tk[0][0]=='#')) {
+            continue;
+        }
+        Job j;
+        j.cfg_files = tk;
+        j.ok = false; j.sims = 0; j.steps = 0; j.ms = 0;
+        jobs.push_back(j);
+    }
+    return jobs;
+}
+
+static void runJob(Job& j, int worker) {
+    long long t0 = now_micro();
+    md::BookConfig::threadProvider() = "sim" + std::to_string(worker);
+    // a job is run again at each thread count of the scale mode
+    j.ok = true; j.sims = 0; j.steps = 0; j.ms = 0;
+    for (const auto& cfg_file : j.cfg_files) {
+        try {
+            utils::PLCC::setThreadConfig(cfg_file.c_str());
+            const std::string trade_day (utils::ConfigureReader(cfg_file.c_str()).get<std::string>("SimDay"));
+            utils::TimeUtil::set_cur_time_micro((utils::TimeUtil::string_to_frac_UTC(trade_day.c_str(), 0, "%Y%m%d")-6*3600)*1000000ULL);
+            algo::StratSim sim(trade_day.c_str(), cfg_file.c_str());
+            sim.run();
+            ++j.sims;
+            j.steps += sim.steps();
+        } catch (const std::exception& e) {
+            fprintf(stderr, "%s failed: %s\n", cfg_file.c_str(), e.what());
+            j.ok = false;
+            break;
+        }
+    }
+    utils::PLCC::setThreadConfig(nullptr);
+    md::BookConfig::threadProvider().clear();
+    utils::TimeUtil::unset_cur_time_micro();
+    j.ms = (now_micro() - t0)/1000.0;
+}
+
+// returns the wall time in milli
+static double run(std::vector<Job>& jobs, int threads) {
+    std::atomic<size_t> next(0);
+    auto worker = [&](int worker_id) {
+        size_t i;
+        while ((i = next.fetch_add(1)) < jobs.size()) {
+            runJob(jobs[i], worker_id);
+        }
+    };
+    long long t0 = now_micro();
+    std::vector<std::thread> pool;
+    for (int i=0; i<threads; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+    return (now_micro() - t0)/1000.0;
+}
+
+static void report(const std::vector<Job>& jobs, int threads, double wall_ms, bool per_job) {
+    size_t failed = 0;
+    long long sims = 0, steps = 0;
+    double job_ms = 0;
+    for (const auto& j : jobs) {
+        if (per_job) {
+            printf("%s (%d days) %s sims: %d, steps: %lld, ms: %.1f\n",
+                    j.cfg_files[0].c_str(), (int)j.cfg_files.size(), j.ok?"OK":"FAILED", j.sims, j.steps, j.ms);
+        }
+        sims += j.sims; steps += j.steps;
+        job_ms += j.ms;
+        failed += (j.ok?0:1);
+    }
+    double sec = _MAX_(wall_ms, 1e-3)/1000.0;
+    printf("threads: %d, jobs: %zu (%zu failed), sims: %lld, wall ms: %.1f, job ms: %.1f, steps/s: %.0f, sims/hour: %.0f\n",
+            threads, jobs.size(), failed, sims, wall_ms, job_ms, steps/sec, sims/sec*3600.0);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s manifest_file [threads] [scale]\n", argv[0]);
+        printf("manifest line: cfg_file_day1, cfg_file_day2, ... simulated in order on one worker\n");
+        printf("threads default to the number of cores, scale runs with 1 to threads\n");
+        return 0;
+    }
+    auto jobs = readManifest(argv[1]);
+    int threads = (argc>2)? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    threads = _MAX_(threads, 1);
+    bool scale = (argc>3) && (strcmp(argv[3], "scale")==0);
+
+    if (!scale) {
+        double wall_ms = run(jobs, threads);
+        report(jobs, threads, wall_ms, true);
+    } else {
+        for (int n=1; n<=threads; ++n) {
+            double wall_ms = run(jobs, n);
+            report(jobs, n, wall_ms, false);
+        }
+    }
+    for (const auto& j : jobs) {
+        if (!j.ok) return 1;
+    }
+    return 0;
+}
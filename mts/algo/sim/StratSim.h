@@ -77,6 +77,21 @@ public:
         return;
     }
 
+    // the next second after cur_sec that onOneSecond() publishes, 0 if done
+    time_t nextSecond(time_t cur_sec) const {
+        if (_next_ix >= _all_bar.size()) {
+            return 0;
+        }
+        const time_t bar_time = _all_bar[_next_ix].bar_time;
+        if (cur_sec < bar_time - BAR_PERIOD) {
+            return bar_time - BAR_PERIOD;
+        }
+        if (cur_sec < bar_time) {
+            return bar_time;
+        }
+        return cur_sec + 1;
+    }
+
     static const int MTSBarSecond = 1;
 private:
     const std::string _bar_file;
@@ -161,7 +176,7 @@ private:
 class StratSim {
 public:
     explicit StratSim(const char* trade_day, const char* cfg_file = NULL)
-    : m_should_run(false) 
+    : m_should_run(false), _steps(0) 
     {
         // performs the following taasks
         // 1. initialize the trading day and timer
@@ -202,7 +217,9 @@ public:
         _sim = std::make_shared<algo::AlgoThreadMock>(_sim_name, scfg);
     }
 
-    // Simulates AlgoThread's run()
+    // Simulates AlgoThread's run(), the time jumps from one second to the
+    // next with a bar to publish or a strategy trigger, skipping the seconds
+    // in between, which have nothing to run.
     void run() {
         m_should_run = true;
         _sim->startAll();
@@ -215,12 +232,34 @@ public:
             for (auto& pub : _pub) {
                 pub->onOneSecond(cur_sec);
             }
+            _sim->runBookEvents();
             _sim->runOneSecond(_cur_micro);
-            _cur_micro += 1000000;
+            ++_steps;
+
+            const time_t next_sec = nextSecond(cur_sec);
+            if (!next_sec) {
+                break;
+            }
+            _cur_micro += (next_sec - cur_sec)*1000000ULL;
             utils::TimeUtil::set_cur_time_micro(_cur_micro);
         }
         _sim->eodPosition();
-        logInfo("Simulation done for day %s", _trade_day.c_str());
+        logInfo("Simulation done for day %s, %lld steps", _trade_day.c_str(), _steps);
+    }
+
+    // the number of seconds simulated in run()
+    long long steps() const { return _steps; };
+
+    // the next second with something to run, 0 if none
+    time_t nextSecond(time_t cur_sec) const {
+        time_t next_sec = _sim->nextTriggerUtc(cur_sec);
+        for (const auto& pub : _pub) {
+            const time_t sec = pub->nextSecond(cur_sec);
+            if (sec && ((!next_sec) || (sec < next_sec))) {
+                next_sec = sec;
+            }
+        }
+        return next_sec;
     }
 
     // ctrl-C from user, stop the run
@@ -240,6 +279,7 @@ protected:
 
     uint64_t _cur_micro;
     uint64_t _end_micro;
+    long long _steps;
 };
 
 }
@@ -73,6 +73,13 @@ namespace algo {
 
     void AR1::onStop(uint64_t) {}
 
+    time_t AR1::nextTriggerUtc(time_t cur_utc) const {
+        if (m_next_trigger_idx >= m_trigger_time.size()) {
+            return 0;
+        }
+        return _MAX_(m_trigger_time[m_next_trigger_idx], cur_utc+1);
+    }
+
     void AR1::onOneSecond(uint64_t cur_micro) {
 
         // don't run if trigger not due yet
@@ -20,6 +20,7 @@ namespace algo {
 
         // check to see what to do for algo
         void onOneSecond(uint64_t cur_micro) override;
+        time_t nextTriggerUtc(time_t cur_utc) const override;
 
         std::string onDump() const override; 
         std::string cfgFile() const override;
@@ -101,6 +101,20 @@ namespace algo {
         }
     }
 
+    time_t IDBO_TF::nextTriggerUtc(time_t cur_utc) const {
+        time_t next_utc = 0;
+        for (const auto& sp : m_state) {
+            const auto& state (*sp.second);
+            if ((size_t) state._next_trigger_idx < state._trigger_time.size()) {
+                const time_t utc = _MAX_(state._trigger_time[state._next_trigger_idx], cur_utc+1);
+                if ((!next_utc) || (utc < next_utc)) {
+                    next_utc = utc;
+                }
+            }
+        }
+        return next_utc;
+    }
+
     void IDBO_TF::setPosition(State& state, time_t cur_utc) {
         auto tgt_position = state._tgt_pos;
         if (tgt_position != state._pos) {
@@ -0,0 +1,140 @@
+#include "AlgoBase.h"
+#include "gtest/gtest.h"
+#include <fstream>
+
+const char* CFGFile = "/tmp/main.cfg";
+const char* VENUEFile = "/tmp/venue.cfg";
+
+void setupCfg() {
+    {
+        std::ofstream ofs;
+        ofs.open (CFGFile, std::ofstream::out | std::ofstream::trunc);
+        ofs << "Logger = /tmp/log" << std::endl;
+        ofs << "BarPath = /tmp" << std::endl;
+        ofs << "HistPath = /tmp" << std::endl;
+        ofs << "BarSec = [ 5 ]" << std::endl;
+        ofs << "SymbolMap = " << VENUEFile << std::endl;
+    }
+    {
+        std::ofstream ofs;
+        ofs.open (VENUEFile, std::ofstream::out | std::ofstream::trunc);
+        ofs << "tradable = {\n";
+        ofs << "    CLQ1 = {\n";
+        ofs << "        symbol = WTI\n";
+        ofs << "        exch_symbol = CL\n";
+        ofs << "        venue = NYM\n";
+        ofs << "        tick_size = 0.010000000000\n";
+        ofs << "        point_value = 1000.0\n";
+        ofs << "        px_multiplier = 0.010000000000\n";
+        ofs << "        type = FUT\n";
+        ofs << "        mts_contract = WTI_202108\n";
+        ofs << "        contract_month = 202108\n";
+        ofs << "        mts_symbol = WTI_N1\n";
+        ofs << "        N = 1\n";
+        ofs << "        expiration_days = 11\n";
+        ofs << "        tt_security_id = 9596025206223795780\n";
+        ofs << "        tt_venue = CME\n";
+        ofs << "        currency = USD\n";
+        ofs << "        expiration_date = 2021-07-20\n";
+        ofs << "        bbg_id = CLQ1 COMDTY\n";
+        ofs << "        bbg_px_multiplier = 1.0\n";
+        ofs << "        tickdata_id = CLQ21\n";
+        ofs << "        tickdata_px_multiplier = 1.000000000000\n";
+        ofs << "        tickdata_timezone = America/New_York\n";
+        ofs << "        lotspermin = 40\n";
+        ofs << "    }\n";
+        ofs << "}\n";
+        ofs << "venue = {" << std::endl;
+        ofs << "NYM   = { hours = [ -6, 0, 17, 0 ]   } " << std::endl;
+        ofs << "}" << std::endl;
+    }
+    utils::PLCC::setConfigPath(CFGFile);
+}
+
+namespace algo {
+class EventMock : public AlgoBase {
+public:
+    EventMock(pm::FloorBase::ChannelType& channel)
+    : AlgoBase("event_test", channel), _book_cnt(0), _trade_cnt(0) {
+        m_should_run = true;
+    }
+    void onStop(uint64_t cur_micro) override {};
+    void onStart(uint64_t cur_micro) override {};
+    void onReload(uint64_t cur_micro, const std::string& config_file) override {};
+    void onOneSecond(uint64_t cur_micro) override {};
+    std::string onDump() const override { return ""; };
+    std::string cfgFile() const override { return ""; };
+
+    void onBookUpdate(int symid, const md::BookDepot& book) override {
+        ++_book_cnt;
+        _book = book;
+    }
+    void onTrade(int symid, const md::BookDepot& book) override {
+        ++_trade_cnt;
+        _trade = book;
+    }
+
+    int _book_cnt, _trade_cnt;
+    md::BookDepot _book, _trade;
+};
+}
+
+TEST (AlgoEventTest, BookAndTrade) {
+    md::BookConfig bcfg("", "WTI_N1", "L1");
+    {
+        // the bar file is opened by the symbol's bar reader
+        std::ofstream ofs(bcfg.bfname(5), std::ofstream::out | std::ofstream::app);
+    }
+    md::BookQType bq(bcfg, false);
+    auto& writer (bq.theWriter());
+    auto channel = std::make_unique<utils::Floor::Channel>();
+    algo::EventMock algo(channel);
+    int symid = algo.addSymbol("", "WTI_N1", "L1", 5);
+    algo.subscribeEvents(symid, algo::AlgoBase::EventBook|algo::AlgoBase::EventTrade);
+    EXPECT_EQ(algo.dispatchBookEvents(), 0);
+
+    // one quote update, delivered as is
+    writer.updBBO(40.0, 1, 40.1, 2, utils::TimeUtil::cur_micro());
+    EXPECT_EQ(algo.dispatchBookEvents(), 1);
+    EXPECT_EQ(algo._book_cnt, 1);
+    EXPECT_DOUBLE_EQ(algo._book.getBid(), 40.0);
+    EXPECT_DOUBLE_EQ(algo._book.getAsk(), 40.1);
+
+    // one trade
+    writer.updTrade(40.0, 2);
+    EXPECT_EQ(algo.dispatchBookEvents(), 1);
+    EXPECT_EQ(algo._trade_cnt, 1);
+    EXPECT_EQ(algo._trade.update_type, 2);
+
+    // falling behind, only the latest quote and trade are delivered
+    for (int i=0; i<10; ++i) {
+        writer.updBBO(40.0 + 0.01*i, 1, true, utils::TimeUtil::cur_micro());
+    }
+    writer.updTrade(40.05, 3);
+    writer.updBBO(41.0, 5, false, utils::TimeUtil::cur_micro());
+    EXPECT_EQ(algo.dispatchBookEvents(), 2);
+    EXPECT_EQ(algo._book_cnt, 2);
+    EXPECT_EQ(algo._trade_cnt, 2);
+    EXPECT_DOUBLE_EQ(algo._book.getBid(), 40.09);
+    EXPECT_DOUBLE_EQ(algo._book.getAsk(), 41.0);
+    EXPECT_DOUBLE_EQ(algo._trade.trade_price, 40.05);
+    EXPECT_EQ(algo.dispatchBookEvents(), 0);
+
+    const auto& sinfo (algo.getSymbolInfo(symid));
+    EXPECT_EQ(sinfo._event_latency._cnt, 4);
+    EXPECT_EQ(sinfo._event_latency._coalesced, 9);
+
+    // trades only
+    algo.subscribeEvents(symid, algo::AlgoBase::EventTrade);
+    writer.updBBO(40.5, 1, true, utils::TimeUtil::cur_micro());
+    writer.updTrade(40.5, 1);
+    EXPECT_EQ(algo.dispatchBookEvents(), 1);
+    EXPECT_EQ(algo._book_cnt, 2);
+    EXPECT_EQ(algo._trade_cnt, 3);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    setupCfg();
+    return RUN_ALL_TESTS();
+}
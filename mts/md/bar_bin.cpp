@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include "md_bar.h"
+
+/*
+ * Converts a csv bar file into the binary bar file read by BarReader.
+ * Existing bar files written before the binary format can be
+ * converted with this, i.e.
+ *   bar_bin /home/mts/bar/NYM_WTI_N1_60S.csv
+ * With -p, prints a binary bar file as csv, i.e. the bar files
+ * written with BarFileFormat "bin"
+ *   bar_bin -p /home/mts/bar/NYM_WTI_N1_60S.bin > NYM_WTI_N1_60S.csv
+ */
+
+static int print(const std::string& bin_fn, FILE* fp) {
+    const md::BarBinFile bf(bin_fn);
+    if (!bf.valid()) {
+        fprintf(stderr, "failed to open %s\n", bin_fn.c_str());
+        return 1;
+    }
+    char line[256];
+    for (const md::BarRec* rec = bf.begin(); rec < bf.end(); ++rec) {
+        size_t bytes = rec->toCSVLine(line);
+        line[bytes++] = '\n';
+        fwrite(line, 1, bytes, fp);
+    }
+    return 0;
+}
+
+int main(int argc, char**argv ) {
+    if (argc < 2) {
+        printf("Usage: %s csv_file [bin_file]\n", argv[0]);
+        printf("bin_file default to the csv_file with .bin extension\n");
+        printf("       %s -p bin_file [csv_file]\n", argv[0]);
+        printf("prints bin_file as csv, to stdout if csv_file is not given\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "-p") == 0) {
+        if (argc < 3) {
+            printf("bin_file not given\n");
+            return 1;
+        }
+        FILE* fp = stdout;
+        if (argc > 3) {
+            fp = fopen(argv[3], "wt");
+            if (!fp) {
+                fprintf(stderr, "failed to create %s\n", argv[3]);
+                return 1;
+            }
+        }
+        int ret = print(argv[2], fp);
+        if (fp != stdout) {
+            fclose(fp);
+        }
+        return ret;
+    }
+    const std::string csv_fn(argv[1]);
+    const std::string bin_fn = (argc > 2)? std::string(argv[2]) : md::BarBinFile::fname(csv_fn);
+    long long cnt = md::BarBinFile::convert(csv_fn, bin_fn);
+    if (cnt < 0) {
+        printf("failed to convert %s\n", csv_fn.c_str());
+        return 1;
+    }
+    printf("converted %lld bars from %s to %s\n", cnt, csv_fn.c_str(), bin_fn.c_str());
+    return 0;
+}
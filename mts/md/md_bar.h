@@ -9,9 +9,15 @@
 #include <stdexcept>
 #include <fstream>
 #include <cstdlib>
+#include <cstddef>
 #include <array>
 #include <atomic>
 #include <unordered_map>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "md_snap.h"
 #include "csv_util.h"
@@ -45,6 +51,152 @@ std::pair<double, uint32_t> bid_reducing(double prev_px, uint32_t prev_sz, doubl
     return std::make_pair(ret_px, ret_sz);
 }
 
+static inline
+int swipe_level(double tick_size, double prev_px, double px) {
+    // number of levels between prev_px and px, in [1,10]
+    // always 1 if tick_size is not given
+    if (tick_size==0) return 1;
+    int levels = (int)(std::abs(prev_px-px)/tick_size+0.5);
+    if (__builtin_expect(levels<1,0)) levels=1;
+    if (__builtin_expect(levels>10,0)) levels=10;
+    return levels;
+}
+
+// The fixed width record of a bar line, as parsed from the csv.
+// The binary bar file stores these records, so that BarPrice from
+// the binary is the same as from the csv.
+struct BarRec {
+    int64_t bar_time;
+    double open;
+    double high;
+    double low;
+    double close;
+    int64_t totvol;
+    double last_price;
+    int64_t last_micro;
+    int64_t vbs;
+    // extended
+    double avg_bsz;
+    double avg_asz;
+    double avg_spd;
+    double bqd;
+    double aqd;
+    // optional
+    int32_t opt_v1;
+    int32_t opt_v2;
+    int32_t flags;
+    int32_t reserved;
+
+    enum {
+        HasExt = 1,
+        HasOpt = 2
+    };
+
+    BarRec() {
+        memset((char*)this, 0, sizeof(BarRec));
+    }
+
+    explicit BarRec(const std::string& csvLine) {
+        // format is utc, open, high, low, close, totvol, lastpx, last_micro, vbs
+        // extended: avg_bsz, avg_asz, avg_spd, bqdiff, aqdiff
+        // optional: opt_v1, opt_v2
+        memset((char*)this, 0, sizeof(BarRec));
+        using utils::CSVUtil;
+        thread_local CSVUtil::LineView tk;
+        CSVUtil::read_line(csvLine, tk);
+        if (__builtin_expect(tk.size() < 9, 0)) {
+            throw std::invalid_argument("bar line has less than 9 fields: " + csvLine);
+        }
+        bar_time = (time_t)CSVUtil::parse<int>(tk[0]);
+        open = CSVUtil::parse<double>(tk[1]);
+        high = CSVUtil::parse<double>(tk[2]);
+        low = CSVUtil::parse<double>(tk[3]);
+        close = CSVUtil::parse<double>(tk[4]);
+        totvol = CSVUtil::parse<long long>(tk[5]);
+        last_price = CSVUtil::parse<double>(tk[6]);
+        last_micro = CSVUtil::parse<long long>(tk[7]);
+        vbs = CSVUtil::parse<long long>(tk[8]);
+        if (tk.size() > 9) {
+            avg_bsz = CSVUtil::parse<double>(tk[9]);
+            avg_asz = CSVUtil::parse<double>(tk[10]);
+            avg_spd = CSVUtil::parse<double>(tk[11]);
+            bqd = CSVUtil::parse<double>(tk[12]);
+            aqd = CSVUtil::parse<double>(tk[13]);
+            flags |= HasExt;
+        }
+        if (tk.size() > 14) {
+            opt_v1 = CSVUtil::parse<int>(tk[14]);
+            opt_v2 = CSVUtil::parse<int>(tk[15]);
+            flags |= HasOpt;
+        }
+    }
+
+    // writes the csv line of the bar, same as BarPrice::toCSVLine() but
+    // without snprintf, buf should have at least 256 bytes.  Returns the
+    // number of chars written, not including the ending 0.
+    size_t toCSVLine(char* buf) const {
+        char* p = buf;
+        p = writeInt(p, (int)bar_time);
+        p = writePrice(writeSep(p), open);
+        p = writePrice(writeSep(p), high);
+        p = writePrice(writeSep(p), low);
+        p = writePrice(writeSep(p), close);
+        p = writeInt(writeSep(p), totvol);
+        p = writePrice(writeSep(p), last_price);
+        p = writeInt(writeSep(p), last_micro);
+        p = writeInt(writeSep(p), vbs);
+        p = writeFixed(writeSep(p), avg_bsz, 1);
+        p = writeFixed(writeSep(p), avg_asz, 1);
+        p = writeFixed(writeSep(p), avg_spd, 6);
+        p = writeInt(writeSep(p), (int)bqd);
+        p = writeInt(writeSep(p), (int)aqd);
+        if (flags & HasOpt) {
+            p = writeInt(writeSep(p), opt_v1);
+            p = writeInt(writeSep(p), opt_v2);
+        }
+        *p = 0;
+        return p - buf;
+    }
+
+    // the price as parsed from PriceCString(px)
+    static double roundPrice(double px) {
+        static const double mul10 = 1e+8; // PRICE_PRECISION
+        const double v = (double)((unsigned long long)(std::abs(px)*mul10 + 0.5))/mul10;
+        return px<0? -v:v;
+    }
+
+    // the value as parsed from "%.nf" of v, i.e. 1 for %.1f
+    static double roundFixed(double v, int decimals) {
+        double mul10 = 1;
+        for (int i=0; i<decimals; ++i) {
+            mul10 *= 10;
+        }
+        const double r = (double)utils::CSVUtil::roundScaled(v, decimals)/mul10;
+        return std::signbit(v)? -r:r;
+    }
+
+private:
+    static char* writeSep(char* p) {
+        p[0] = ',';
+        p[1] = ' ';
+        return p+2;
+    }
+
+    static char* writeInt(char* p, long long v) {
+        return utils::CSVUtil::writeInt(p, v);
+    }
+
+    // same as PriceCString(px)
+    static char* writePrice(char* p, double px) {
+        return utils::CSVUtil::writeDouble(p, px, PRICE_PRECISION);
+    }
+
+    // same as "%.nf" of the value rounded with roundFixed()
+    static char* writeFixed(char* p, double v, int decimals) {
+        return utils::CSVUtil::writeFixed(p, v, decimals);
+    }
+} __attribute__((packed));
+
 struct BarPrice {
 public:
     time_t bar_time; // the close time of the bar
@@ -70,6 +222,9 @@ public:
     double avg_spd(long long cur_micro) const {
         return get_avg(cur_micro, cumsum_spd, (prev_apx-prev_bpx));
     }
+    // the optional volumes, see toCSVLine()
+    int32_t swipe_vol() const { return opt_v1; };
+    int32_t unmatched_vol() const { return opt_v2; };
 
 private:
     // weighted avg and state - calculated on the spot
@@ -164,11 +319,7 @@ private:
     }
 
     int get_swipe_level(double prev_px, double px) const {
-        if (tick_size==0) return 1;
-        int levels = (int)(std::abs(prev_px-px)/tick_size+0.5);
-        if (__builtin_expect(levels<1,0)) levels=1;
-        if (__builtin_expect(levels>10,0)) levels=10;
-        return levels;
+        return swipe_level(tick_size, prev_px, px);
     }
 
 public:
@@ -193,46 +344,36 @@ public:
             bqt_diff_, aqt_diff_);
     }
 
-    BarPrice(const std::string& csvLine) {
-        // format is utc, open, high, low, close, totvol, lastpx, last_micro, vbs
-        // extended: avg_bsz, avg_asz, avg_spd, bqdiff, aqdiff
+    BarPrice(const std::string& csvLine) : BarPrice(BarRec(csvLine)) {}
 
+    explicit BarPrice(const BarRec& rec) {
         memset((char*)this, 0, sizeof(BarPrice));
         high = -1e+12;
         low  = 1e+12;
         write_optional = false;
 
-        auto tk = utils::CSVUtil::read_line(csvLine);
-        auto bar_time_ = (time_t)std::stoi(tk[0]);
-        auto open_ = std::stod(tk[1]);
-        auto high_ = std::stod(tk[2]);
-        auto low_ = std::stod(tk[3]);
-        auto close_ = std::stod(tk[4]);
-        long long totval_ = std::stoll(tk[5]);
-        auto last_price_ = std::stod(tk[6]);
-        auto last_micro_ = std::stoll(tk[7]);
-        long long vbs_ = std::stoll(tk[8]);
-
+        long long totval_ = rec.totvol;
+        long long vbs_ = rec.vbs;
         auto bvol_ = (uint32_t) ((totval_ + vbs_)/2);
         auto svol_ = (int32_t) (totval_ - bvol_);
 
         long long bsz_ = 0, asz_ = 0;
         double spd_ = 0;
         int bqd_ = 0, aqd_ = 0;
-        if (tk.size() > 9) {
-            bsz_ = (uint32_t) (std::stod(tk[9])+0.5);
-            asz_ = (uint32_t) (std::stod(tk[10])+0.5);
-            spd_ = std::stod(tk[11]);
-            bqd_ = int(std::stod(tk[12])+0.5);
-            aqd_ = int(std::stod(tk[13])+0.5);
-        }
-        init(bar_time_, open_, high_, low_, close_, bvol_, svol_,
-             last_micro_, last_price_, bsz_, asz_, spd_,
+        if (rec.flags & BarRec::HasExt) {
+            bsz_ = (uint32_t) (rec.avg_bsz+0.5);
+            asz_ = (uint32_t) (rec.avg_asz+0.5);
+            spd_ = rec.avg_spd;
+            bqd_ = int(rec.bqd+0.5);
+            aqd_ = int(rec.aqd+0.5);
+        }
+        init((time_t)rec.bar_time, rec.open, rec.high, rec.low, rec.close, bvol_, svol_,
+             rec.last_micro, rec.last_price, bsz_, asz_, spd_,
              bqd_, aqd_);
         // optional unmatched
-        if (tk.size() > 14) {
-            opt_v1 = std::stoi(tk[14]);
-            opt_v2 = std::stoi(tk[15]);
+        if (rec.flags & BarRec::HasOpt) {
+            opt_v1 = rec.opt_v1;
+            opt_v2 = rec.opt_v2;
             write_optional = true;
         }
     }
@@ -261,6 +402,36 @@ public:
         return toCSVLine(cur_micro);
     }
 
+    // the bar as BarRec(toCSVLine(bar_close_time)), without the formatting
+    BarRec toBarRec(time_t bar_close_time=0) const {
+        if (__builtin_expect(bar_close_time == 0,1)) {
+            bar_close_time = bar_time;
+        };
+        long long cur_micro = (long long)bar_close_time*1000000LL;
+        BarRec rec;
+        rec.bar_time = (int) bar_close_time;
+        rec.open = BarRec::roundPrice(open);
+        rec.high = BarRec::roundPrice(high);
+        rec.low = BarRec::roundPrice(low);
+        rec.close = BarRec::roundPrice(close);
+        rec.totvol = (long long)bvol+svol;
+        rec.last_price = BarRec::roundPrice(last_price);
+        rec.last_micro = last_micro;
+        rec.vbs = (long long)bvol-svol;
+        rec.avg_bsz = BarRec::roundFixed(avg_bsz(cur_micro), 1);
+        rec.avg_asz = BarRec::roundFixed(avg_asz(cur_micro), 1);
+        rec.avg_spd = BarRec::roundFixed(avg_spd(cur_micro), 6);
+        rec.bqd = bqd;
+        rec.aqd = aqd;
+        rec.flags = BarRec::HasExt;
+        if (__builtin_expect(write_optional,1)) {
+            rec.opt_v1 = opt_v1;
+            rec.opt_v2 = opt_v2;
+            rec.flags |= BarRec::HasOpt;
+        }
+        return rec;
+    }
+
     bool isValid() const {
         return prev_micro_quote>0;
     }
@@ -271,7 +442,19 @@ public:
         // state and then roll forward
         bar_time = bar_close_time;
         std::string ret = toCSVLine();
+        roll(bar_close_time);
+        return ret;
+    }
 
+    // same as writeAndRoll(), returns the bar as a BarRec
+    BarRec writeAndRollRec(time_t bar_close_time) {
+        bar_time = bar_close_time;
+        const BarRec rec = toBarRec();
+        roll(bar_close_time);
+        return rec;
+    }
+
+    void roll(time_t bar_close_time) {
         // roll forward
         open = close;
         high = close;
@@ -281,7 +464,6 @@ public:
         // optional write - unmatched trade volumes
         opt_v1 = 0; opt_v2 = 0;
         roll_state((long long)bar_close_time*1000000LL);
-        return ret;
     }
 
     void update(long long cur_micro, double last_trd_price, int32_t volume, int update_type,
@@ -459,16 +641,331 @@ public:
 };
 
 
+// The binary bar file, written along with the csv bar file by the
+// BarWriter.  It is a 64 bytes header followed by BarRec in the order
+// of bar_time.  Readers mmap the file and seek with a binary search.
+// Files written by the BarBinWriter are preallocated, the number of
+// records written is given by rec_cnt in the header.
+class BarBinFile {
+public:
+    struct Header {
+        char magic[8];
+        int32_t rec_size;
+        int32_t flags;
+        int64_t rec_cnt;  // records written, if Preallocated
+        char reserved[40];
+    } __attribute__((packed));
+    static const char* Magic() { return "MTSBAR1"; };
+    enum {
+        Preallocated = 1
+    };
+
+    // the binary file name of a csv bar file
+    static std::string fname(const std::string& csv_fn) {
+        const std::string ext(".csv");
+        if (csv_fn.size() > ext.size() && csv_fn.compare(csv_fn.size()-ext.size(), ext.size(), ext) == 0) {
+            return csv_fn.substr(0, csv_fn.size()-ext.size()) + ".bin";
+        }
+        return csv_fn + ".bin";
+    }
+
+    // BarFileFormat in the main config, "csv" (default) for the csv
+    // bar file along with the binary, or "bin" for the binary only.
+    // Looked up in the keys, as a missing key dumps the config.
+    static bool binOnly() {
+        const auto& keys (utils::PLCC::instance().listKeys());
+        if (std::find(keys.begin(), keys.end(), "BarFileFormat") == keys.end()) {
+            return false;
+        }
+        return plcc_getString("BarFileFormat") == "bin";
+    }
+
+    static int64_t* recCnt(void* hdr) {
+        return (int64_t*)((char*)hdr + offsetof(Header, rec_cnt));
+    }
+
+    // writes a binary file from the csv file, existing binary file is replaced
+    // returns number of bars written, or -1 on error
+    static long long convert(const std::string& csv_fn, const std::string& bin_fn);
+
+    // converts the csv file to its binary file if the binary file is missing
+    // or behind the csv, i.e. the csv history written before the binary.
+    // Returns number of bars written, 0 if not needed, or -1 on error
+    static long long seed(const std::string& csv_fn);
+
+    // bar time of the first line in the csv file, 0 if not found
+    static time_t csvFirstBarTime(const std::string& csv_fn) {
+        FILE* fp_ = fopen(csv_fn.c_str(), "rt");
+        if (!fp_) {
+            return 0;
+        }
+        char buf[256];
+        const bool got = (fgets(buf, sizeof(buf)-1, fp_) != nullptr);
+        fclose(fp_);
+        return got? (time_t) atoll(buf) : 0;
+    }
+
+    // bar time of the last line in the csv file, 0 if not found
+    static time_t csvLastBarTime(const std::string& csv_fn) {
+        FILE* fp_ = fopen(csv_fn.c_str(), "rt");
+        if (!fp_) {
+            return 0;
+        }
+        char buf[512];
+        fseek(fp_, 0, SEEK_END);
+        const long sz = ftell(fp_);
+        const long pos = _MAX_(sz - (long)sizeof(buf) + 1, 0L);
+        fseek(fp_, pos, SEEK_SET);
+        const size_t n = fread(buf, 1, sizeof(buf)-1, fp_);
+        fclose(fp_);
+        buf[n] = 0;
+        // skip the trailing new lines and find the start of the last line
+        int end = (int)n;
+        while (end > 0 && (buf[end-1] == '\n' || buf[end-1] == '\r')) {
+            buf[--end] = 0;
+        }
+        int start = end;
+        while (start > 0 && buf[start-1] != '\n') {
+            --start;
+        }
+        return (time_t) atoll(buf+start);
+    }
+
+    // maps the file readonly, valid() is false if not able to
+    explicit BarBinFile(const std::string& fn)
+    : m_ptr(nullptr), m_len(0), m_recs(nullptr), m_cnt(0) {
+        int fd = open(fn.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+            void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED) {
+                m_ptr = ptr;
+                m_len = st.st_size;
+                const Header* hdr = (const Header*) m_ptr;
+                if (strncmp(hdr->magic, Magic(), sizeof(hdr->magic)) == 0 && hdr->rec_size == sizeof(BarRec)) {
+                    m_recs = (const BarRec*) ((const char*)m_ptr + sizeof(Header));
+                    // a partially written record at the end is not counted
+                    m_cnt = (m_len - sizeof(Header))/sizeof(BarRec);
+                    refresh();
+                } else {
+                    logError("bad header in binary bar file %s", fn.c_str());
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~BarBinFile() {
+        if (m_ptr) {
+            munmap(m_ptr, m_len);
+            m_ptr = nullptr;
+        }
+    }
+
+    // reads the count of records written to a preallocated file.
+    // Returns false if the file is not preallocated or the writer has
+    // grown it past this mapping, in which case it should be opened again.
+    bool refresh() {
+        if (!m_recs || !(((const Header*)m_ptr)->flags & Preallocated)) {
+            return false;
+        }
+        const size_t cnt = (size_t) __atomic_load_n(recCnt(m_ptr), __ATOMIC_ACQUIRE);
+        if (cnt > (m_len - sizeof(Header))/sizeof(BarRec)) {
+            return false;
+        }
+        m_cnt = cnt;
+        return true;
+    }
+
+    bool valid() const { return m_recs != nullptr; };
+    size_t size() const { return m_cnt; };
+    const BarRec* begin() const { return m_recs; };
+    const BarRec* end() const { return m_recs + m_cnt; };
+
+    // the first bar with bar_time not less than bt
+    const BarRec* lowerBound(time_t bt) const {
+        return std::lower_bound(begin(), end(), (int64_t)bt,
+                [](const BarRec& rec, int64_t t) { return rec.bar_time < t; });
+    }
+
+    // the first bar with bar_time greater than bt
+    const BarRec* upperBound(time_t bt) const {
+        return std::upper_bound(begin(), end(), (int64_t)bt,
+                [](int64_t t, const BarRec& rec) { return t < rec.bar_time; });
+    }
+
+private:
+    void* m_ptr;
+    size_t m_len;
+    const BarRec* m_recs;
+    size_t m_cnt;
+
+    BarBinFile(const BarBinFile&) = delete;
+    void operator = (const BarBinFile&) = delete;
+};
+
+// Appends BarRec to a binary bar file, mapped and extended in chunks
+// of records, so that an append is a copy without a syscall.  The
+// rec_cnt in the header is updated after each record for the readers.
+// Writes are visible to the readers as they are made, sync() is the
+// durability point of flushing them to the disk.
+class BarBinWriter {
+public:
+    static const size_t ChunkRecs = 4096;
+
+    // opens the file to append, header written if new, throws on error
+    explicit BarBinWriter(const std::string& fn)
+    : m_fn(fn), m_fd(-1), m_ptr(nullptr), m_len(0), m_cap(0), m_cnt(0) {
+        m_fd = open(fn.c_str(), O_RDWR|O_CREAT, 0644);
+        if (m_fd < 0) {
+            logError("failed to open binary bar file %s", fn.c_str());
+            throw std::runtime_error("failed to open binary bar file " + fn);
+        }
+        struct stat st;
+        BarBinFile::Header hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        if (fstat(m_fd, &st) == 0 && st.st_size >= (off_t)sizeof(hdr) &&
+            pread(m_fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr)) {
+            if (strncmp(hdr.magic, BarBinFile::Magic(), sizeof(hdr.magic)) != 0 || hdr.rec_size != sizeof(BarRec)) {
+                close(m_fd);
+                logError("bad header in binary bar file %s", fn.c_str());
+                throw std::runtime_error("bad header in binary bar file " + fn);
+            }
+            m_cnt = (st.st_size - sizeof(hdr))/sizeof(BarRec);
+            if (hdr.flags & BarBinFile::Preallocated) {
+                m_cnt = _MIN_(m_cnt, (size_t)hdr.rec_cnt);
+            }
+        } else {
+            strcpy(hdr.magic, BarBinFile::Magic());
+            hdr.rec_size = sizeof(BarRec);
+        }
+        hdr.flags |= BarBinFile::Preallocated;
+        hdr.rec_cnt = m_cnt;
+        if (pwrite(m_fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+            close(m_fd);
+            logError("failed to write header of binary bar file %s", fn.c_str());
+            throw std::runtime_error("failed to write header of binary bar file " + fn);
+        }
+        remap(m_cnt + ChunkRecs);
+    }
+
+    ~BarBinWriter() {
+        if (m_ptr) {
+            sync(true);
+            munmap(m_ptr, m_len);
+            m_ptr = nullptr;
+        }
+        if (m_fd >= 0) {
+            // trim the unused preallocation
+            if (ftruncate(m_fd, sizeof(BarBinFile::Header) + m_cnt*sizeof(BarRec)) != 0) {
+                logError("failed to truncate binary bar file %s", m_fn.c_str());
+            }
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    void append(const BarRec& rec) {
+        if (__builtin_expect(m_cnt == m_cap, 0)) {
+            remap(m_cap + ChunkRecs);
+        }
+        memcpy(m_recs + m_cnt, &rec, sizeof(BarRec));
+        ++m_cnt;
+        __atomic_store_n(BarBinFile::recCnt(m_ptr), (int64_t)m_cnt, __ATOMIC_RELEASE);
+    }
+
+    // flushes the records to the disk, wait for the write if wait is true
+    void sync(bool wait = false) {
+        if (msync(m_ptr, sizeof(BarBinFile::Header) + m_cnt*sizeof(BarRec), wait? MS_SYNC:MS_ASYNC) != 0) {
+            logError("failed to sync binary bar file %s", m_fn.c_str());
+        }
+    }
+
+    size_t size() const { return m_cnt; };
+    const std::string& fname() const { return m_fn; };
+
+private:
+    const std::string m_fn;
+    int m_fd;
+    void* m_ptr;
+    size_t m_len;
+    BarRec* m_recs;
+    size_t m_cap;
+    size_t m_cnt;
+
+    void remap(size_t cap) {
+        const size_t len = sizeof(BarBinFile::Header) + cap*sizeof(BarRec);
+        if (ftruncate(m_fd, len) != 0) {
+            logError("failed to extend binary bar file %s to %d records", m_fn.c_str(), (int)cap);
+            throw std::runtime_error("failed to extend binary bar file " + m_fn);
+        }
+        if (m_ptr) {
+            munmap(m_ptr, m_len);
+            m_ptr = nullptr;
+        }
+        void* ptr = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (ptr == MAP_FAILED) {
+            logError("failed to map binary bar file %s", m_fn.c_str());
+            throw std::runtime_error("failed to map binary bar file " + m_fn);
+        }
+        m_ptr = ptr;
+        m_len = len;
+        m_recs = (BarRec*)((char*)m_ptr + sizeof(BarBinFile::Header));
+        m_cap = cap;
+    }
+
+    BarBinWriter(const BarBinWriter&) = delete;
+    void operator = (const BarBinWriter&) = delete;
+};
+
+inline long long BarBinFile::convert(const std::string& csv_fn, const std::string& bin_fn) {
+    FILE* fin = fopen(csv_fn.c_str(), "rt");
+    if (!fin) {
+        logError("failed to open bar file %s", csv_fn.c_str());
+        return -1;
+    }
+    std::remove(bin_fn.c_str());
+    long long cnt = 0;
+    char buf[256];
+    try {
+        BarBinWriter writer(bin_fn);
+        while (fgets(buf, sizeof(buf)-1, fin)) {
+            writer.append(BarRec{std::string(buf)});
+            ++cnt;
+        }
+    } catch (const std::exception& e) {
+        logError("failed to convert bar file %s at line %lld: %s", csv_fn.c_str(), cnt+1, e.what());
+        cnt = -1;
+    }
+    fclose(fin);
+    return cnt;
+}
+
+inline long long BarBinFile::seed(const std::string& csv_fn) {
+    const time_t csv_last = csvLastBarTime(csv_fn);
+    if (csv_last == 0) {
+        return 0;
+    }
+    const std::string bin_fn (fname(csv_fn));
+    {
+        const BarBinFile bf(bin_fn);
+        if (bf.valid() && (bf.size() > 0) && ((bf.end()-1)->bar_time >= csv_last)) {
+            return 0;
+        }
+    }
+    logInfo("seeding binary bar file %s from %s", bin_fn.c_str(), csv_fn.c_str());
+    return convert(csv_fn, bin_fn);
+}
+
 class BarReader{
 public:
     BarReader(const BookConfig& bcfg_, int barsec_)
-    : bcfg(bcfg_), barsec(barsec_), fn(bcfg.bfname(barsec)), fp(nullptr)
+    : bcfg(bcfg_), barsec(barsec_), fn(bcfg.bfname(barsec)), fp(nullptr), bin_only(BarBinFile::binOnly()), bin_cnt(0)
     {
-        fp = fopen(fn.c_str(), "rt");
-        if (!fp) {
-            logError("failed to open bar file %s", fn.c_str());
-            throw std::runtime_error(std::string("faile to open bar file ") + fn);
-        }
+        openFile();
         bp = getLatestBar();
     }
 
@@ -520,6 +1017,16 @@ public:
             return false;
         }
 
+        // use the binary bar file if it's up to date with the csv
+        bool ret = false;
+        if (readPeriodBin(bars, start_bartime, end_bartime, ret)) {
+            return ret;
+        }
+        if (bin_only) {
+            logError("Failed to read binary bar file of %s", fn.c_str());
+            return false;
+        }
+
         FILE* fp_ = fopen(fn.c_str(), "rt");
         if (!fp_) {
             logError("Failed to read bar file %s", fn.c_str());
@@ -707,13 +1214,9 @@ public:
     }
 
     BarReader(const BarReader&br)
-    : bcfg(br.bcfg), barsec(br.barsec), fn(br.fn), fp(nullptr)
+    : bcfg(br.bcfg), barsec(br.barsec), fn(br.fn), fp(nullptr), bin_only(br.bin_only), bin_cnt(0)
     {
-        fp = fopen(fn.c_str(), "rt");
-        if (!fp) {
-            logError("failed to open bar file %s", fn.c_str());
-            throw std::runtime_error(std::string("faile to open bar file ") + fn);
-        }
+        openFile();
         bp = getLatestBar();
     }
 
@@ -726,7 +1229,95 @@ private:
     FILE* fp;
     BarPrice bp;
 
+    // with BarFileFormat "bin", bars are read from the binary bar file
+    const bool bin_only;
+    std::unique_ptr<BarBinFile> bin_file;
+    size_t bin_cnt;
+
+    void openFile() {
+        if (bin_only) {
+            bin_file.reset(new BarBinFile(BarBinFile::fname(fn)));
+            if (!bin_file->valid()) {
+                logError("failed to open binary bar file of %s", fn.c_str());
+                throw std::runtime_error(std::string("faile to open binary bar file of ") + fn);
+            }
+            return;
+        }
+        fp = fopen(fn.c_str(), "rt");
+        if (!fp) {
+            logError("failed to open bar file %s", fn.c_str());
+            throw std::runtime_error(std::string("faile to open bar file ") + fn);
+        }
+    }
+
+    BarPrice getLatestBarBin() {
+        if (!bin_file->refresh()) {
+            bin_file.reset(new BarBinFile(BarBinFile::fname(fn)));
+        }
+        if (bin_file->size() > bin_cnt) {
+            bin_cnt = bin_file->size();
+            return BarPrice(*(bin_file->end()-1));
+        } else if (bin_file->size() < bin_cnt) {
+            logError("Bar file %s truncated!", BarBinFile::fname(fn).c_str());
+        }
+        return BarPrice();
+    }
+
+    bool readPeriodBin(std::vector<std::shared_ptr<BarPrice> >& bars, time_t start_bartime, time_t end_bartime, bool& ret) const {
+        // reads only the bars needed by forwardBackwardFill() from the binary
+        // file, that is from the last trading bar before the start_bartime to
+        // the first trading bar after the end_bartime. 
+        // Returns false if the binary file is not available, not up to
+        // date with the csv or starts after the csv before start_bartime,
+        // in which case the csv should be read.
+        const BarBinFile bf(BarBinFile::fname(fn));
+        if (!bf.valid() || bf.size() == 0) {
+            return false;
+        }
+        if (!bin_only) {
+            if ((bf.end()-1)->bar_time != lastBarTime()) {
+                logInfo("binary bar file not in sync with %s, reading csv", fn.c_str());
+                return false;
+            }
+            if (bf.begin()->bar_time > start_bartime) {
+                const time_t csv_first = BarBinFile::csvFirstBarTime(fn);
+                if ((csv_first != 0) && (csv_first < bf.begin()->bar_time)) {
+                    logInfo("binary bar file starts after %s, reading csv", fn.c_str());
+                    return false;
+                }
+            }
+        }
+        const BarRec* b0 = bf.lowerBound(start_bartime);
+        while (b0 > bf.begin()) {
+            --b0;
+            if (VenueConfig::get().isTradingTime(bcfg.venue, (time_t)b0->bar_time-1)) {
+                break;
+            }
+        }
+        const BarRec* b1 = bf.upperBound(end_bartime);
+        while (b1 < bf.end()) {
+            if (VenueConfig::get().isTradingTime(bcfg.venue, (time_t)(b1++)->bar_time-1)) {
+                break;
+            }
+        }
+        std::vector<std::shared_ptr<BarPrice> > allbars;
+        allbars.reserve(b1-b0);
+        for (const BarRec* b = b0; b < b1; ++b) {
+            allbars.emplace_back(std::make_shared<BarPrice>(*b));
+        }
+        ret = forwardBackwardFill(allbars, start_bartime, end_bartime, bars);
+        return true;
+    }
+
+    time_t lastBarTime() const {
+        // bar time of the last line in the csv, 0 if not found
+        return BarBinFile::csvLastBarTime(fn);
+    }
+
     BarPrice getLatestBar() {
+        if (bin_only) {
+            return getLatestBarBin();
+        }
         char buf[256];
         buf[0] = 0;
         try {
@@ -755,9 +1346,11 @@ private:
 
 class BarWriter {
 public:
+    // updates read from the queue at a time
+    enum { BatchSize = 32 };
 
     BarWriter(const BookConfig& bcfg, time_t cur_second) 
-    : m_bcfg(bcfg), m_bq(bcfg, true), m_br(m_bq.newReader())
+    : m_bcfg(bcfg), m_bq(bcfg, true), m_br(m_bq.newReader()), m_batch(BatchSize)
     {
         double tick_size = 0;
         try {
@@ -768,14 +1361,22 @@ public:
             throw std::runtime_error("BarWriter failed to get tick size for " + m_bcfg.toString());
         }
         auto bsv = m_bcfg.barsec_vec();
+        const bool bin_only = BarBinFile::binOnly();
         for (auto bs : bsv) {
             std::shared_ptr<BarInfo> binfo(new BarInfo());
             binfo->fn = m_bcfg.bfname(bs);
-            binfo->fp = fopen(binfo->fn.c_str(), "at");
-            if (!binfo->fp) {
-                logError("%s BarWriter failed to create bar file %s!", m_bcfg.toString().c_str(), binfo->fn.c_str());
-                throw std::runtime_error("BarWriter failed to create bar file " + binfo->fn);
+            if (!bin_only) {
+                binfo->fp = fopen(binfo->fn.c_str(), "at");
+                if (!binfo->fp) {
+                    logError("%s BarWriter failed to create bar file %s!", m_bcfg.toString().c_str(), binfo->fn.c_str());
+                    throw std::runtime_error("BarWriter failed to create bar file " + binfo->fn);
+                }
+                // the binary file starts with the csv history
+                if (BarBinFile::seed(binfo->fn) < 0) {
+                    logError("%s BarWriter failed to seed binary bar file of %s", m_bcfg.toString().c_str(), binfo->fn.c_str());
+                }
             }
+            binfo->bw.reset(new BarBinWriter(BarBinFile::fname(binfo->fn)));
             binfo->bar.set_tick_size(tick_size);
             m_bar.emplace(bs, binfo);
         }
@@ -838,7 +1439,7 @@ public:
             // bid/ask/last_trade
             for (int i=0; i<3; ++i) {
                 m_book.update_type = i;
-                updateState();
+                updateState(m_book);
             }
             return true;
         }
@@ -846,11 +1447,12 @@ public:
     }
 
     bool checkUpdate() {
-        if (m_br->getNextUpdate(m_book)) {
-            updateState();
-            return true;
+        // a batch of updates per read of the queue
+        const int cnt = m_br->readBatch(m_batch.data(), (int)m_batch.size());
+        for (int i=0; i<cnt; ++i) {
+            updateState(m_batch[i]);
         }
-        return false;
+        return cnt > 0;
     }
 
     void onOneSecond(time_t cur_sec) {
@@ -870,6 +1472,7 @@ public:
             // if we are passed last bar of current trading day
             if (cur_sec > binfo->end) {
                 logInfo("%s BarWriter roll trading day into next", m_bcfg.toString().c_str());
+                sync();
                 resetTradingDay(cur_sec);
                 return;
             }
@@ -883,12 +1486,30 @@ public:
                 continue;
             }
 
+            bool written = false;
             while(cur_sec >= binfo->due) {
-                const auto line = binfo->bar.writeAndRoll(binfo->due);
-                fprintf(binfo->fp, "%s\n",line.c_str());
-                fflush(binfo->fp);
+                const BarRec rec = binfo->bar.writeAndRollRec(binfo->due);
+                binfo->bw->append(rec);
+                if (binfo->fp) {
+                    char line[256];
+                    size_t bytes = rec.toCSVLine(line);
+                    line[bytes++] = '\n';
+                    fwrite(line, 1, bytes, binfo->fp);
+                }
                 binfo->due += bsec;
+                written = true;
             }
+            if (written && binfo->fp) {
+                fflush(binfo->fp);
+            }
+        }
+    }
+
+    // the durability point of the bar files, also at the end of the trading
+    // day.  Bars written are visible to the readers without a sync().
+    void sync() {
+        for (auto& bitem: m_bar) {
+            bitem.second->bw->sync();
         }
     }
 
@@ -902,7 +1523,8 @@ private:
 
     struct BarInfo {
         std::string fn;
-        FILE* fp;
+        FILE* fp;  // the csv bar file, nullptr if BarFileFormat is "bin"
+        std::unique_ptr<BarBinWriter> bw;  // the binary bar file
         time_t due;
         time_t start;
         time_t end;
@@ -912,11 +1534,14 @@ private:
         : fn(binfo.fn), fp(nullptr), due(binfo.due), end(binfo.due), 
           bar(binfo.bar) 
         {
-            fp = fopen(fn.c_str(), "at+");
-            if (!fp) {
-                logError("Failed to open bar file %s", fn.c_str());
-                throw std::runtime_error("Failed to open bar file " + fn);
+            if (binfo.fp) {
+                fp = fopen(fn.c_str(), "at+");
+                if (!fp) {
+                    logError("Failed to open bar file %s", fn.c_str());
+                    throw std::runtime_error("Failed to open bar file " + fn);
+                }
             }
+            bw.reset(new BarBinWriter(BarBinFile::fname(fn)));
         }
         ~BarInfo() {
             if (fp) {
@@ -931,12 +1556,13 @@ private:
 
     std::map<int, std::shared_ptr<BarInfo> > m_bar;
     BookDepot m_book;
+    std::vector<BookDepot> m_batch;  // updates read by checkUpdate()
 
-    void updateState() {
+    void updateState(const BookDepot& book) {
         // update all bars with different bar period
         for (auto& bitem: m_bar) {
             auto& bar = bitem.second->bar;
-            bar.update(m_book);
+            bar.update(book);
         }
     }
 };
@@ -0,0 +1,372 @@
+#pragma once
+
+#include "md_snap.h"
+
+namespace md {
+
+/*
+ * BookSoA is the struct-of-arrays layout of a BookDepot for the readers
+ * that query a book many times per update, i.e. the algo's getMid(),
+ * isValidQuote() and VWAP calls.  The prices and the sizes of each side
+ * are in their own cache aligned arrays, padded to SoALevels with zeros,
+ * so the scans of the levels are done with the SSE2 sized vector
+ * extensions of gcc.  The index of the best level,
+ * the first level with a positive size, is kept with the updates, so the
+ * getBid()/getAsk() don't scan the levels.
+ *
+ * The updates are the same as BookL2 (newPrice, delPrice, updPrice and
+ * updFromDelta) and the queries the same as BookDepot.  The BookDepot
+ * stays the wire format, use fromBookDepot()/toBookDepot() to convert.
+ */
+struct alignas(64) BookSoA {
+    enum { SoALevels = 16 };  // BookLevel padded to 64 bytes of sizes
+
+    // the SSE2 vectors, 2 prices or 4 sizes
+    typedef double VPx  __attribute__((vector_size(16), may_alias));
+    typedef int64_t VMask __attribute__((vector_size(16), may_alias));
+    typedef int32_t VSz  __attribute__((vector_size(16), may_alias));
+    typedef int32_t VSz2 __attribute__((vector_size(8), may_alias));
+    enum { PxLanes = sizeof(VPx)/sizeof(Price), SzLanes = sizeof(VSz)/sizeof(Quantity) };
+
+    // hot, read by the queries
+    alignas(64) Price px[2][SoALevels];
+    alignas(64) Quantity sz[2][SoALevels];
+    int avail_level[2];
+    int best[2];      // index of the best level, -1 if no level has a positive size
+
+    // cold, for the conversion to BookDepot
+    uint64_t update_ts_micro;
+    int update_level;
+    int update_type;
+    Price trade_price;
+    Quantity trade_size;
+    int trade_attr;
+    Quantity bvol_cum;
+    Quantity svol_cum;
+    L2Delta l2_delta;
+    TSMicro ts_micro[2][SoALevels];
+    Quantity count[2][SoALevels];
+
+    BookSoA() {
+        reset();
+    }
+
+    explicit BookSoA(const BookDepot& book) {
+        reset();
+        fromBookDepot(book);
+    }
+
+    void reset() {
+        memset((char*)this, 0, sizeof(BookSoA));
+        best[0] = best[1] = -1;
+    }
+
+    void fromBookDepot(const BookDepot& book) {
+        update_ts_micro = book.update_ts_micro;
+        update_level = book.update_level;
+        update_type = book.update_type;
+        trade_price = book.trade_price;
+        trade_size = book.trade_size;
+        trade_attr = book.trade_attr;
+        bvol_cum = book.bvol_cum;
+        svol_cum = book.svol_cum;
+        l2_delta = book.l2_delta;
+        for (int s=0; s<2; ++s) {
+            // only the levels left from the previous book are cleared,
+            // the padding is kept zero
+            const int prev_levels = avail_level[s];
+            avail_level[s] = _MAX_(_MIN_(book.avail_level[s], (int)BookLevel), 0);
+            const PriceEntry* pe = book.pe + s*BookLevel;
+            for (int i=0; i<avail_level[s]; ++i) {
+                px[s][i] = pe[i].price;
+                sz[s][i] = pe[i].size;
+                ts_micro[s][i] = pe[i].ts_micro;
+                count[s][i] = pe[i].count;
+            }
+            for (int i=avail_level[s]; i<prev_levels; ++i) {
+                set(s, i, 0, 0, 0);
+                count[s][i] = 0;
+            }
+            best[s] = findBest(s, 0);
+        }
+    }
+
+    void toBookDepot(BookDepot& book) const {
+        book.reset();
+        book.update_ts_micro = update_ts_micro;
+        book.update_level = update_level;
+        book.update_type = update_type;
+        book.trade_price = trade_price;
+        book.trade_size = trade_size;
+        book.trade_attr = trade_attr;
+        book.bvol_cum = bvol_cum;
+        book.svol_cum = svol_cum;
+        book.l2_delta = l2_delta;
+        for (int s=0; s<2; ++s) {
+            book.avail_level[s] = avail_level[s];
+            PriceEntry* pe = book.pe + s*BookLevel;
+            for (int i=0; i<avail_level[s]; ++i) {
+                pe[i].price = px[s][i];
+                pe[i].size = sz[s][i];
+                pe[i].ts_micro = ts_micro[s][i];
+                pe[i].count = count[s][i];
+            }
+        }
+    }
+
+    // updates, same as BookL2
+    bool newPrice(Price price, Quantity size, unsigned int level, bool is_bid, uint64_t ts_micro_) {
+        l2_delta.newPrice(price, size, level, is_bid);
+        const int side = is_bid?0:1;
+        const unsigned int levels = (unsigned int) avail_level[side];
+        if (__builtin_expect(((level>levels)  || (levels >= BookLevel)), 0)) {
+            logError("book soa new price wrong level %d", level);
+            return false;
+        }
+        update_level = level;
+        update_type = side;
+        for (unsigned int i=levels; i>level; --i) {
+            move(side, i-1, i);
+        }
+        set(side, level, price, size, ts_micro_);
+        ++avail_level[side];
+
+        int& b (best[side]);
+        if (b >= (int)level) {
+            ++b;
+        }
+        if ((size > 0) && ((b < 0) || ((int)level < b))) {
+            b = level;
+        }
+        return true;
+    }
+
+    bool delPrice(unsigned int level, bool is_bid) {
+        l2_delta.delPrice(level, is_bid);
+        const int side = is_bid?0:1;
+        const unsigned int levels = (unsigned int) avail_level[side];
+        if (__builtin_expect((level>=levels), 0)) {
+            logError("book soa del price wrong level %d", level);
+            return false;
+        }
+        update_level = level;
+        update_type = side;
+        for (unsigned int i=level+1; i<levels; ++i) {
+            move(side, i, i-1);
+        }
+        // keep the padding zero for the vector scans
+        --avail_level[side];
+        set(side, avail_level[side], 0, 0, 0);
+        count[side][avail_level[side]] = 0;
+
+        int& b (best[side]);
+        if (b == (int)level) {
+            b = findBest(side, level);
+        } else if (b > (int)level) {
+            --b;
+        }
+        return true;
+    }
+
+    bool updPrice(Price price, Quantity size, unsigned int level, bool is_bid, uint64_t ts_micro_) {
+        l2_delta.updPrice(price, size, level, is_bid);
+        const int side = is_bid?0:1;
+        if (__builtin_expect((level>=(unsigned int)avail_level[side]), 0)) {
+            logError("book soa update price wrong level %d", level);
+            return false;
+        }
+        if (__builtin_expect(((px[side][level] == price) && (sz[side][level] == size)), 0)) {
+            return false;
+        }
+        update_level = level;
+        update_type = side;
+        set(side, level, price, size, ts_micro_);
+
+        int& b (best[side]);
+        if (size > 0) {
+            if ((b < 0) || ((int)level < b)) {
+                b = level;
+            }
+        } else if (b == (int)level) {
+            b = findBest(side, level+1);
+        }
+        return true;
+    }
+
+    bool addTrade(Price price, Quantity size, int attr) {
+        l2_delta.addTrade(price, size, attr);
+        trade_price = price;
+        trade_size = size;
+        trade_attr = attr;
+        if (attr == 0) {
+            bvol_cum += size;
+        } else if (attr == 1) {
+            svol_cum += size;
+        }
+        update_type = 2;
+        return true;
+    }
+
+    bool updFromDelta(const L2Delta* delta, uint64_t ts_micro_) {
+        update_ts_micro = ts_micro_;
+        switch(delta->type) {
+        case 1: return newPrice(delta->px, delta->qty, delta->level, delta->side==0, ts_micro_);
+        case 2: return delPrice(delta->level, delta->side==0);
+        case 3: return updPrice(delta->px, delta->qty, delta->level, delta->side==0, ts_micro_);
+        case 4:
+            {
+                Quantity qty = delta->qty;
+                return addTrade(delta->px, (qty<0)?-qty:qty, (qty<0)?1:0);
+            }
+        }
+        return false;
+    }
+
+    // queries, same as BookDepot
+    Price getBestPrice(bool isBid) const {
+        const int side = isBid?0:1;
+        return (best[side] < 0)? 0 : px[side][best[side]];
+    }
+
+    Price getBid() const { return getBestPrice(true); }
+    Price getAsk() const { return getBestPrice(false); }
+
+    Price getBid(Quantity* size) const {
+        if (best[0] < 0) return 0;
+        *size = sz[0][best[0]];
+        return px[0][best[0]];
+    }
+
+    Price getAsk(Quantity* size) const {
+        if (best[1] < 0) return 0;
+        *size = sz[1][best[1]];
+        return px[1][best[1]];
+    }
+
+    const PriceEntry getBestPE(bool isBid) const {
+        const int side = isBid?0:1;
+        const int b = best[side];
+        if (b < 0) return PriceEntry();
+        PriceEntry pe;
+        pe.price = px[side][b]; pe.size = sz[side][b];
+        pe.ts_micro = ts_micro[side][b]; pe.count = count[side][b];
+        return pe;
+    }
+
+    const PriceEntry getBestBidPE() const { return getBestPE(true); }
+    const PriceEntry getBestAskPE() const { return getBestPE(false); }
+
+    Price getMid() const {
+        if ((avail_level[0] < 1) || (avail_level[1] < 1))
+            return 0;
+        return (getBid() + getAsk())/2;
+    }
+
+    double getMidDouble() const {
+        return getMid();
+    }
+
+    bool isValidQuote() const {
+        const Price bp=getBid(), ap=getAsk();
+        return (bp*ap!= 0) && (ap>bp);
+    }
+
+    Price getVWAP(int level, bool isBid, Quantity* q=NULL) const {
+        // volume weighted price of the top level levels, including
+        // the zero size levels as BookDepot::getVWAP()
+        const int side = isBid?0:1;
+        const int lvl = _MIN_(level, avail_level[side]);
+        const VPx lvlv = {(double)lvl, (double)lvl};
+        VPx lane = {0, 1}, pxsz = {0}, qty = {0};
+        for (int i=0; i<lvl; i+=PxLanes) {
+            const VMask m = (lane < lvlv);
+            const VPx s = __builtin_convertvector(*(const VSz2*)&sz[side][i], VPx);
+            pxsz += (VPx)((VMask)(*(const VPx*)&px[side][i] * s) & m);
+            qty += (VPx)((VMask)s & m);
+            lane += (double)PxLanes;
+        }
+        const Quantity qsum = (Quantity)(qty[0] + qty[1]);
+        if (q) *q = qsum;
+        return (pxsz[0] + pxsz[1])/qsum;
+    }
+
+    int getLevelsForSize(Quantity size, bool isBid, Quantity* q=NULL) const {
+        // the number of top levels with the cumulative size first reaching
+        // size, or avail_level if the side is not deep enough. q, if given,
+        // is set to the cumulative size of the levels returned.
+        // The sizes are non-negative, so the cumulative sizes don't decrease
+        // and the levels short of size are counted from the prefix sums.
+        const int side = isBid?0:1;
+        const int levels = avail_level[side];
+        const VSz zero = {0};
+        const VSz sizev = {size, size, size, size};
+        VSz carry = zero, shortv = zero;
+        alignas(16) Quantity cum[SoALevels];
+        for (int i=0; i<levels; i+=SzLanes) {
+            // inclusive prefix sum of 4 lanes in 2 shifts
+            VSz x = *(const VSz*)&sz[side][i];
+            x += __builtin_shuffle(x, zero, (VSz){4, 0, 1, 2});
+            x += __builtin_shuffle(x, zero, (VSz){4, 4, 0, 1});
+            x += carry;
+            *(VSz*)&cum[i] = x;
+            shortv -= (x < sizev);  // -1 for the lanes short of size
+            if (x[3] >= size) {
+                break;
+            }
+            carry = __builtin_shuffle(x, (VSz){3, 3, 3, 3});
+        }
+        const int n = _MIN_(shortv[0] + shortv[1] + shortv[2] + shortv[3] + 1, levels);
+        if (q) *q = (n > 0)? cum[n-1] : 0;
+        return n;
+    }
+
+    int getPriceLevel(Price price, bool isBid) const {
+        // the level price would be at, i.e. the number of levels better than
+        // price: higher bids or lower asks, assuming the levels are sorted
+        const int side = isBid?0:1;
+        const int levels = avail_level[side];
+        const double eps = 1e-10;
+        const VPx lvlv = {(double)levels, (double)levels};
+        const VPx lo = {price - eps, price - eps}, hi = {price + eps, price + eps};
+        VPx lane = {0, 1};
+        VMask better = {0};
+        for (int i=0; i<levels; i+=PxLanes) {
+            const VPx p = *(const VPx*)&px[side][i];
+            better -= (isBid? (p > hi) : (p < lo)) & (lane < lvlv);
+            lane += (double)PxLanes;
+        }
+        return (int)(better[0] + better[1]);
+    }
+
+    int findLevel(Price price, bool isBid) const {
+        // the level with price, -1 if not found
+        const int side = isBid?0:1;
+        const int lvl = getPriceLevel(price, isBid);
+        return ((lvl < avail_level[side]) && px_equal(px[side][lvl], price))? lvl : -1;
+    }
+
+private:
+    void move(int side, int from, int to) {
+        px[side][to] = px[side][from];
+        sz[side][to] = sz[side][from];
+        ts_micro[side][to] = ts_micro[side][from];
+        count[side][to] = count[side][from];
+    }
+
+    void set(int side, int level, Price price, Quantity size, TSMicro ts) {
+        px[side][level] = price;
+        sz[side][level] = size;
+        ts_micro[side][level] = ts;
+    }
+
+    int findBest(int side, int from) const {
+        for (int i=from; i<avail_level[side]; ++i) {
+            if (sz[side][i] > 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+}
@@ -6,7 +6,11 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <type_traits>
 #include <cmath>
+#include <mutex>
+#include <memory>
+#include <thread>
 
 #include "plcc/PLCC.hpp"
 #include "time_util.h"
@@ -17,6 +21,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 
 namespace md {
@@ -200,7 +207,7 @@ struct BookConfig {
     };
 
     BookConfig(const std::string& v_, const std::string& s_, const std::string& bt_) 
-    : venue(v_), type(bt_) {
+    : venue(v_), type(bt_), provider(threadProvider()) {
         const auto* ti = utils::SymbolMapReader::get().getTradableInfo(s_);
         symbol = ti->_tradable;
         if (venue.size()==0) {
@@ -213,7 +220,7 @@ struct BookConfig {
     // venue could have a '@' to specify a provider, i.e. bbg@CME, or tt@ICE
     // it is possible to omit venue, i.e.,  bbg@/SPX_N1
     BookConfig(const std::string& venu_symbol, const std::string& bt) :
-        type(bt) {
+        type(bt), provider(threadProvider()) {
         size_t n = strlen(venu_symbol.c_str());
         auto pos = venu_symbol.find("/");
         if (pos == std::string::npos) {
@@ -252,6 +259,14 @@ struct BookConfig {
         logDebug("BookConfig %s", toString().c_str());
     }
 
+    // the provider of the constructors where it is not given, empty by default.
+    // It is per thread, so simulations running on multiple threads could each
+    // publish and read their own queues and bar files, see StratSim.
+    static std::string& threadProvider() {
+        static thread_local std::string provider;
+        return provider;
+    }
+
     std::string qname() const {
         auto qn = venue+"_"+symbol+"_"+type;
         if (provider.size()>0) {
@@ -978,21 +993,337 @@ struct BookL2 {
     }
 };
 
+// BookDelta is the compact record of the delta mode BookQ.
+// A delta record carries the L2Delta(s) of one book update,
+// from which the reader rebuilds the book locally. The writer
+// periodically publishes the full BookDepot as a run of snapshot
+// chunks for the readers to sync on start or after an overflow.
+struct BookDelta {
+    enum { ChunkLen = 32, MaxDelta = ChunkLen/sizeof(L2Delta) };
+    enum { Kind_Delta = 0, Kind_Snap = 1 };
+    enum { SnapChunks = (sizeof(BookDepot) + ChunkLen - 1)/ChunkLen };
+#pragma pack(push,1)
+    char kind;       // 0: delta, 1: snapshot chunk
+    char flags;      // delta: count of L2Delta, snapshot: 1 if it is also an update
+    short chunk;     // snapshot chunk index
+    int reserved;
+    uint64_t update_ts_micro;
+    char data[ChunkLen]; // L2Delta array or the BookDepot chunk
+#pragma pack(pop)
+
+    BookDelta() {
+        memset((char*)this, 0, sizeof(BookDelta));
+    }
+
+    const L2Delta* getDelta(int i) const {
+        return (const L2Delta*) (data + i*sizeof(L2Delta));
+    }
+
+    bool isSnapStart() const {
+        return (kind == Kind_Snap) && (chunk == 0);
+    }
+
+    std::string toString() const {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%llu %s(%d) chunk(%d)",
+                (unsigned long long) update_ts_micro,
+                kind==Kind_Delta?"Delta":"Snap", (int) flags, (int) chunk);
+        return std::string(buf);
+    }
+};
+
+// Full: each update is the full BookDepot, see BookDepot
+// Delta: each update is a BookDelta, see BookDelta
+enum BookQMode {
+    BookQ_Full = 0,
+    BookQ_Delta = 1
+};
+
+// The last value of the top of book and trade of a symbol, two cache
+// lines, the first with the BBO.  seq is a seqlock, odd while being
+// written, 0 if never written.
+struct LVCRec {
+    uint32_t seq;
+    int32_t trade_attr;
+    uint64_t update_ts_micro;
+    PriceEntry bid;  // as getBestBidPE()
+    PriceEntry ask;  // as getBestAskPE()
+    // second line
+    Price trade_price;
+    Quantity trade_size;
+    Quantity bvol_cum;
+    Quantity svol_cum;
+} __attribute__((aligned(64)));
+
+static_assert(sizeof(LVCRec) == 128, "LVCRec not two cache lines");
+
+// Last value cache: a shm segment of LVCRec of all symbols, updated by
+// the BookQ writers of the tp on each book written, so that a reader
+// gets the BBO of any symbol from a record, without attaching its BookQ
+// and copying the BookDepot.  The records are indexed by an id claimed
+// on first use of the key, see key(), and stay for the life of the
+// segment.
+// The waits are bounded, so that a writer dying in the middle of a
+// claim or an update doesn't hang the others: a reader gives up after
+// MaxReadRetry, falling back to the BookQ, a writer takes over a record
+// that stays odd for MaxWaitSpin polls and a key still being claimed
+// after MaxWaitSpin polls is not found.
+class LVC {
+public:
+    enum {
+        MaxSymbols = 2048,
+        KeyLen = 48,
+        MaxReadRetry = 64,      // reads of a record being written
+        MaxWaitSpin = 1<<16     // polls of a claim or write in progress, yielding
+    };
+    static constexpr const char* ShmName = "/mts_lvc";
+    static constexpr const char* Magic = "MTSLVC1";
+
+    // the segment of the process, created if not exists
+    static LVC& get() {
+        static LVC lvc(ShmName);
+        return lvc;
+    }
+
+    // the key of the book, the qname without the type, as L1 and L2
+    // books of a symbol update the same record
+    static std::string key(const BookConfig& bcfg) {
+        std::string k = bcfg.venue + "_" + bcfg.symbol;
+        return bcfg.provider.size()? bcfg.provider + "_" + k : k;
+    }
+
+    explicit LVC(const std::string& shm_name, bool read_only=false);
+    ~LVC();
+
+    // the id of the key, claimed if not found and writable,
+    // -1 if not found in read only or the segment is full
+    int id(const std::string& key);
+
+    // the id of the key if exists, -1 otherwise
+    int find(const std::string& key) const;
+
+    // writes the BBO and trade of the book, the L1 and L2 writers of
+    // a symbol could update the same record concurrently
+    void update(int id, const BookDepot& book);
+
+    // a consistent copy of the record, false if never written or
+    // being written after MaxReadRetry reads
+    bool read(int id, LVCRec& rec) const;
+
+    // the BBO as md::getBBO()
+    bool getBBO(int id, double& bidpx, int& bidsz, double& askpx, int& asksz) const {
+        LVCRec rec;
+        if (!read(id, rec)) {
+            return false;
+        }
+        bidpx = rec.bid.price;
+        bidsz = rec.bid.size;
+        askpx = rec.ask.price;
+        asksz = rec.ask.size;
+        return true;
+    }
+
+    size_t size() const { return sizeof(Header) + sizeof(KeySlot)*MaxSymbols + sizeof(LVCRec)*MaxSymbols; };
+
+private:
+    struct Header {
+        char magic[8];
+        int max_symbols;
+        int rec_size;
+        char reserved[48];
+    };
+    struct KeySlot {
+        char key[KeyLen];
+        int state;  // SlotFree, SlotClaimed or SlotReady
+        int reserved[3];
+    };
+    enum { SlotFree = 0, SlotClaimed = 1, SlotReady = 2 };
+
+    const std::string m_shm_name;
+    const bool m_read_only;
+    int m_fd;
+    void* m_ptr;
+    Header* m_hdr;
+    KeySlot* m_key;
+    LVCRec* m_rec;
+
+    static uint32_t hash(const std::string& key) {
+        uint32_t h = 2166136261u;
+        for (char c : key) {
+            h = (h ^ (uint8_t)c) * 16777619u;
+        }
+        return h;
+    }
+    int lookup(const std::string& key, bool claim);
+};
+
+inline LVC::LVC(const std::string& shm_name, bool read_only)
+: m_shm_name(shm_name), m_read_only(read_only), m_fd(-1), m_ptr(nullptr) {
+    m_fd = read_only? shm_open(m_shm_name.c_str(), O_RDONLY, S_IRUSR) :
+                      shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (m_fd == -1) {
+        throw std::runtime_error(m_shm_name + ": LVC: shm_open failed " + std::string(strerror(errno)));
+    }
+    struct stat st;
+    if ((fstat(m_fd, &st) != 0) || ((size_t) st.st_size != size())) {
+        if (read_only || (ftruncate(m_fd, size()) == -1)) {
+            ::close(m_fd);
+            throw std::runtime_error(m_shm_name + ": LVC: size mismatch or failed to truncate");
+        }
+    }
+    m_ptr = mmap(NULL, size(), read_only? PROT_READ : (PROT_READ|PROT_WRITE), MAP_SHARED, m_fd, 0);
+    if (m_ptr == MAP_FAILED) {
+        ::close(m_fd);
+        throw std::runtime_error(m_shm_name + ": LVC: mmap failed " + std::string(strerror(errno)));
+    }
+    m_hdr = (Header*)m_ptr;
+    m_key = (KeySlot*)((char*)m_ptr + sizeof(Header));
+    m_rec = (LVCRec*)((char*)m_key + sizeof(KeySlot)*MaxSymbols);
+    if (!read_only && (m_hdr->magic[0] == 0)) {
+        // a new segment, zero filled by ftruncate
+        m_hdr->max_symbols = MaxSymbols;
+        m_hdr->rec_size = sizeof(LVCRec);
+        memcpy(m_hdr->magic, Magic, sizeof(m_hdr->magic));
+    }
+    if ((memcmp(m_hdr->magic, Magic, sizeof(m_hdr->magic)) != 0) ||
+        (m_hdr->max_symbols != MaxSymbols) || (m_hdr->rec_size != (int)sizeof(LVCRec))) {
+        munmap(m_ptr, size());
+        ::close(m_fd);
+        throw std::runtime_error(m_shm_name + ": LVC: not a last value cache of this version");
+    }
+}
+
+inline LVC::~LVC() {
+    munmap(m_ptr, size());
+    ::close(m_fd);
+}
+
+inline int LVC::id(const std::string& key) {
+    return lookup(key, !m_read_only);
+}
+
+inline int LVC::find(const std::string& key) const {
+    return const_cast<LVC*>(this)->lookup(key, false);
+}
+
+inline int LVC::lookup(const std::string& key, bool claim) {
+    if (__builtin_expect(key.size() >= KeyLen, 0)) {
+        return -1;
+    }
+    const uint32_t h = hash(key);
+    for (int k=0; k<MaxSymbols; ++k) {
+        const int idx = (int)((h+k)%MaxSymbols);
+        KeySlot& s (m_key[idx]);
+        int state = __atomic_load_n(&s.state, __ATOMIC_ACQUIRE);
+        if ((state == SlotFree) && claim) {
+            if (__atomic_compare_exchange_n(&s.state, &state, (int)SlotClaimed, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                memcpy(s.key, key.c_str(), key.size()+1);
+                __atomic_store_n(&s.state, (int)SlotReady, __ATOMIC_RELEASE);
+                return idx;
+            }
+        }
+        // claimed by others, wait for the key
+        for (int spin=0; state == SlotClaimed; ++spin) {
+            if (__builtin_expect(spin == MaxWaitSpin, 0)) {
+                logError("LVC %s: key slot %d claim not finished, %s not found", m_shm_name.c_str(), idx, key.c_str());
+                return -1;
+            }
+            std::this_thread::yield();
+            state = __atomic_load_n(&s.state, __ATOMIC_ACQUIRE);
+        }
+        if (state == SlotFree) {
+            break;
+        }
+        if (strcmp(s.key, key.c_str()) == 0) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+inline void LVC::update(int id, const BookDepot& book) {
+    LVCRec& r (m_rec[id]);
+    uint32_t s = __atomic_load_n(&r.seq, __ATOMIC_RELAXED);
+    uint32_t odd_seq = 0;
+    int spin = 0;
+    while (true) {
+        if (!(s & 1)) {
+            if (__atomic_compare_exchange_n(&r.seq, &s, s+1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        // being written, count the polls while it stays at the same seq
+        if (s != odd_seq) {
+            odd_seq = s;
+            spin = 0;
+        } else if (__builtin_expect(++spin >= MaxWaitSpin, 0)) {
+            // the writer is gone, take it over at the next odd seq,
+            // s+2, and finish at s+3
+            if (__atomic_compare_exchange_n(&r.seq, &s, s+2, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                logError("LVC %s: record %d stuck at seq %u, taken over", m_shm_name.c_str(), id, s);
+                s += 1;
+                break;
+            }
+            continue;
+        }
+        std::this_thread::yield();
+        s = __atomic_load_n(&r.seq, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r.update_ts_micro = book.update_ts_micro;
+    r.bid = book.getBestBidPE();
+    r.ask = book.getBestAskPE();
+    r.trade_price = book.trade_price;
+    r.trade_size = book.trade_size;
+    r.trade_attr = book.trade_attr;
+    r.bvol_cum = book.bvol_cum;
+    r.svol_cum = book.svol_cum;
+    __atomic_store_n(&r.seq, s+2, __ATOMIC_RELEASE);
+}
+
+inline bool LVC::read(int id, LVCRec& rec) const {
+    const LVCRec& r (m_rec[id]);
+    for (int k=0; k<MaxReadRetry; ++k) {
+        const uint32_t s0 = __atomic_load_n(&r.seq, __ATOMIC_ACQUIRE);
+        if (__builtin_expect(s0 & 1, 0)) {
+            continue;
+        }
+        memcpy((char*)&rec, (const char*)&r, sizeof(LVCRec));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__builtin_expect(__atomic_load_n(&r.seq, __ATOMIC_RELAXED) == s0, 1)) {
+            return s0 != 0;
+        }
+    }
+    return false;
+}
+
 template <template<int, int> class BufferType >
 class BookQ {
 public:
     static const int BookLen = sizeof(BookDepot);
     static const int QLen = (1024*8*BookLen);
+    static const int DeltaLen = sizeof(BookDelta);
+    static const int DeltaQLen = (1024*64*DeltaLen);
+    // delta updates between two periodic snapshots
+    static const int SnapInterval = 256;
+
     // This is to enforce that for SwQueue, at most one writer should
     // be created for each BookQ
     typedef utils::SwQueue<QLen, BookLen, BufferType> QType;
+    typedef utils::SwQueue<DeltaQLen, DeltaLen, BufferType> DQType;
     const BookConfig _cfg;
     const std::string _q_name;
+    const BookQMode _mode;
     class Writer;
     class Reader;
 
-    BookQ(const BookConfig& config, bool readonly, bool init_to_zero=false) :
-        _cfg(config), _q_name(_cfg.qname()), _q(_q_name.c_str(), readonly, init_to_zero),
+    // the delta mode uses a separate shm queue named with "_D"
+    // so the full mode writer and readers are not affected
+    BookQ(const BookConfig& config, bool readonly, bool init_to_zero=false, BookQMode mode=BookQ_Full) :
+        _cfg(config), _q_name(_cfg.qname() + (mode==BookQ_Delta?"_D":"")), _mode(mode),
+        _q (mode==BookQ_Full?  new QType (_q_name.c_str(), readonly, init_to_zero):NULL),
+        _dq(mode==BookQ_Delta? new DQType(_q_name.c_str(), readonly, init_to_zero):NULL),
         _writer(readonly? NULL:new Writer(*this))
     {
         /*
@@ -1014,6 +1345,20 @@ public:
         return std::make_shared<Reader>(*this);
     }
 
+    // the shm file of the queue and the file mapped, for
+    // ShmCircularBuffer queues
+    const std::string& shmFile() const {
+        return _mode==BookQ_Delta? _dq->buffer().shmFile() : _q->buffer().shmFile();
+    }
+    bool fileId(dev_t& dev, ino_t& ino) const {
+        return _mode==BookQ_Delta? _dq->buffer().fileId(dev, ino) : _q->buffer().fileId(dev, ino);
+    }
+
+    // total bytes published to the queue by the writer
+    utils::QPos getWriteBytes() {
+        return _mode==BookQ_Delta? _dq->theWriter().getWritePos() : _q->theWriter().getWritePos();
+    }
+
     ~BookQ() {
         if (_writer) {
             delete _writer;
@@ -1022,7 +1367,8 @@ public:
     }
 
 private:
-    QType _q;
+    std::unique_ptr<QType> _q;
+    std::unique_ptr<DQType> _dq;
     Writer* _writer;
     friend class Writer;
     friend class Reader;
@@ -1038,54 +1384,70 @@ public:
         // will ensure book is not NULL
         void newPrice(double price, Quantity size, int level, bool is_bid, uint64_t ts_micro) {
             if (__builtin_expect(_bookL2.newPrice(price, size, level, is_bid, ts_micro), 1)) {
+                                addDelta();
                                 updateQ(ts_micro);
             }
         }
 
         void delPrice(int level, bool is_bid, uint64_t ts_micro) {
             if (__builtin_expect((_bookL2.delPrice(level, is_bid)),1)) {
+                                addDelta();
                                 updateQ(ts_micro);
             }
         }
 
         void updPrice(double price, Quantity size, int level, bool is_bid, uint64_t ts_micro) {
             if (__builtin_expect(_bookL2.updPrice(price, size, level, is_bid, ts_micro),1)) {
+                                addDelta();
                                 updateQ(ts_micro);
             }
         }
 
         void updBBO(double price, Quantity size, bool is_bid, uint64_t ts_micro) {
             if (__builtin_expect(_bookL2.updBBO(price, size, is_bid, ts_micro), 1)) {
+                addDelta();
                 updateQ(ts_micro);
             }
         }
 
         void updBBO(double bp, Quantity bsz, double ap, Quantity asz, uint64_t ts_micro) {
+            // both deltas are kept, an unchanged side is a noop
+            // to the delta readers other than setting the l2_delta
             bool has_update = _bookL2.updBBO(bp, bsz, true, ts_micro);
+            addDelta();
             has_update |= _bookL2.updBBO(ap, asz, false, ts_micro);
+            addDelta();
             if (__builtin_expect(has_update, 1)) {
                 updateQ(ts_micro);
+            } else {
+                _delta.flags = 0;
             }
         }
 
 
         void updBBOPriceOnly(double price, bool is_bid, uint64_t ts_micro) {
             if (_bookL2.updBBOPriceOnly(price, is_bid, ts_micro)) {
+                addDelta();
                 updateQ(ts_micro);
             }
         }
 
         void updBBOSizeOnly(Quantity size, bool is_bid, uint64_t ts_micro) {
             if (_bookL2.updBBOSizeOnly(size, is_bid, ts_micro)) {
+                addDelta();
                 updateQ(ts_micro);
             }
         }
 
         bool updTrade(double price, Quantity size) {
             if(__builtin_expect(_bookL2.addTrade(price,size),1)) {
+                addDelta();
                 updateQ(utils::TimeUtil::cur_micro());
                 return true;
             }
+            // the trade price/size of the book is set even if not valid,
+            // the delta readers have to get it from a snapshot
+            _delta_snap = true;
             return false;
         };
 
@@ -1095,6 +1457,7 @@ public:
         // to get a trade direction from L1 book.
         bool updTradeFromL1(double price, Quantity size, const BookDepot& bookL1) {
                 if(__builtin_expect(_bookL2.addTrade(price,size, bookL1.trade_attr),1)) {
+                    addDelta();
                     updateQ(utils::TimeUtil::cur_micro());
                     return true;
                 }
@@ -1103,6 +1466,7 @@ public:
 
         void resetBook() {
             _bookL2.reset();
+            _delta_snap = true;
         }
 
         const BookL2* getBook() const {
@@ -1122,7 +1486,8 @@ public:
         ~Writer() {};
     private:
         BookQ& _bq;
-        typename BookQ::QType::Writer& _wq;  // the writer's queue
+        typename BookQ::QType::Writer* _wq;   // the writer's queue, full mode
+        typename BookQ::DQType::Writer* _dwq; // the writer's queue, delta mode
         BookL2 _bookL2; // the L2 books, each book per queue
         bool _l2_snap;  // only used in updateQ(), true if current
                         // book is not written due to valid check
@@ -1132,10 +1497,49 @@ public:
                         // state during updates (i.e. update bid and then
                         // ask, etc) that is invalid
 
+        // delta mode states
+        const bool _delta_mode;
+        bool _delta_snap;     // next write has to be a snapshot
+        int _delta_cnt;       // deltas written since last snapshot
+        BookDelta _delta;     // the pending delta record
+
+        // the last value cache record of the symbol, only written by
+        // the shm books of the tp, see LVC
+        LVC* _lvc;
+        int _lvc_id;
+
         friend class BookQ<BufferType>;
-        Writer(BookQ& bq) : _bq(bq), _wq(_bq._q.theWriter()),
-                        _bookL2(_bq._cfg), _l2_snap(false) {
+        Writer(BookQ& bq) : _bq(bq),
+                        _wq (bq._mode==BookQ_Full?  &_bq._q->theWriter() :NULL),
+                        _dwq(bq._mode==BookQ_Delta? &_bq._dq->theWriter():NULL),
+                        _bookL2(_bq._cfg), _l2_snap(false),
+                        _delta_mode(bq._mode==BookQ_Delta), _delta_snap(true), _delta_cnt(0),
+                        _lvc(nullptr), _lvc_id(-1) {
                 resetBook();
+                if (std::is_same<BufferType<QLen, BookLen>, utils::ShmCircularBuffer<QLen, BookLen>>::value) {
+                    try {
+                        _lvc = &LVC::get();
+                        _lvc_id = _lvc->id(LVC::key(_bq._cfg));
+                    } catch (const std::exception& e) {
+                        logError("BookQ %s: last value cache not available: %s", _bq._q_name.c_str(), e.what());
+                    }
+                    if (_lvc_id < 0) {
+                        _lvc = nullptr;
+                    }
+                }
+        }
+
+        void addDelta() {
+            if (__builtin_expect(!_delta_mode, 1)) {
+                return;
+            }
+            if (__builtin_expect(_delta.flags >= BookDelta::MaxDelta, 0)) {
+                // more deltas than a record holds, snapshot it
+                _delta_snap = true;
+                return;
+            }
+            memcpy(_delta.data + _delta.flags*sizeof(L2Delta), (char*)&_bookL2._book.l2_delta, sizeof(L2Delta));
+            ++_delta.flags;
         }
 
         void updateQ(uint64_t ts_micro) {
@@ -1146,19 +1550,64 @@ public:
                     _l2_snap = false;
                 }
                 _bookL2._book.update_ts_micro = ts_micro;
-                _wq.put((char*)&(_bookL2._book));
+                if (__builtin_expect(_delta_mode, 0)) {
+                    writeDelta(ts_micro);
+                } else {
+                    _wq->put((char*)&(_bookL2._book));
+                }
+                if (_lvc && !utils::TimeUtil::is_mocked()) {
+                    // simulations don't write to the cache of the tp
+                    _lvc->update(_lvc_id, _bookL2._book);
+                }
             } else {
                 // make sure the next L2 write is a snap
                 // since we may be missing updates
                 _l2_snap = true;
+                _delta_snap = true;
+                _delta.flags = 0;
             }
         }
+
+        void writeDelta(uint64_t ts_micro) {
+            if (__builtin_expect(_delta_snap, 0)) {
+                // readers may have lost the deltas, the
+                // snapshot is taken as an update
+                writeSnap(true);
+            } else {
+                _delta.kind = BookDelta::Kind_Delta;
+                _delta.update_ts_micro = ts_micro;
+                _dwq->put((char*)&_delta);
+                if (__builtin_expect(++_delta_cnt >= SnapInterval, 0)) {
+                    writeSnap(false);
+                }
+            }
+            _delta.flags = 0;
+        }
+
+        void writeSnap(bool is_update) {
+            const char* bk = (const char*)&(_bookL2._book);
+            BookDelta snap;
+            snap.kind = BookDelta::Kind_Snap;
+            snap.flags = is_update?1:0;
+            snap.update_ts_micro = _bookL2._book.update_ts_micro;
+            for (int i=0; i<BookDelta::SnapChunks; ++i) {
+                const int bytes = _MIN_((int)BookDelta::ChunkLen, (int)(sizeof(BookDepot) - i*BookDelta::ChunkLen));
+                snap.chunk = i;
+                memcpy(snap.data, bk + i*BookDelta::ChunkLen, bytes);
+                _dwq->put((char*)&snap);
+            }
+            _delta_snap = false;
+            _delta_cnt = 0;
+        }
     };
 
     // reader always assumes a normalized BookL2
     class Reader {
     public:
         bool getNextUpdate(BookDepot& book) {
+            if (__builtin_expect(_bq._mode == BookQ_Delta, 0)) {
+                return getNextDelta(book);
+            }
             utils::QStatus stat = _rq->copyNextIn((char*)&book);
             switch (stat) {
             case utils::QStat_OK :
@@ -1186,7 +1635,61 @@ public:
             throw std::runtime_error("BookQ Reader got unknown qstat.");
         }
 
+        // reads up to max_books next updates into book, as getNextUpdate()
+        // in a loop, with one position read, memcpy and overflow check per
+        // contiguous run of the queue.  Returns the updates read, 0 if none.
+        int readBatch(BookDepot* book, int max_books) {
+            if (__builtin_expect(_bq._mode == BookQ_Delta, 0)) {
+                int cnt = 0;
+                while ((cnt < max_books) && getNextDelta(book[cnt])) {
+                    ++cnt;
+                }
+                return cnt;
+            }
+            int cnt = 0;
+            while (cnt < max_books) {
+                int items = 0;
+                utils::QStatus stat = _rq->copyNextBatchIn((char*)(book + cnt), max_books - cnt, items);
+                switch (stat) {
+                case utils::QStat_OK :
+                    _rq->advance(items);
+                    cnt += items;
+                    continue;
+                case utils::QStat_EAGAIN :
+                    return cnt;
+                case utils::QStat_OVERFLOW :
+                {
+                    int lost_updates = _rq->catchUp();
+                    logError("venue read queue %s overflow, lost %d updates. Trying to catch up."
+                            ,_bq._q_name.c_str(), lost_updates);
+                    continue;
+                }
+                case utils::QStat_ERROR :
+                {
+                    _rq->advanceToTop();
+                    logError("venue read queue %s error. Trying to sync."
+                            ,_bq._q_name.c_str());
+                    continue;
+                }
+                }
+                logError("readBatch read queue %s unknown qstat %d, exiting..."
+                        ,_bq._q_name.c_str(), (int) stat);
+                throw std::runtime_error("BookQ Reader got unknown qstat.");
+            }
+            return cnt;
+        }
+
         bool getLatestUpdate(BookDepot& book) {
+            if (__builtin_expect(_bq._mode == BookQ_Delta, 0)) {
+                // apply all deltas upto the top
+                BookDepot bk;
+                while (getNextDelta(bk)) {};
+                if (__builtin_expect(!_synced, 0)) {
+                    return false;
+                }
+                book = _book._book;
+                return true;
+            }
             _rq->seekToTop();
             utils::QStatus stat = _rq->copyNextIn((char*)&book);
             switch (stat) {
@@ -1202,6 +1705,14 @@ public:
         }
 
         bool getLatestUpdateAndAdvance(BookDepot& book) {
+            if (__builtin_expect(_bq._mode == BookQ_Delta, 0)) {
+                // true only if there were new updates
+                bool has_update = false;
+                while (getNextDelta(book)) {
+                    has_update = true;
+                };
+                return has_update;
+            }
             if (__builtin_expect(!_rq->advanceToTop(),0)) {
                 return false;
             }
@@ -1237,7 +1748,16 @@ public:
             return false;
         }
 
-        Reader(BookQ& bq) : _bq(bq), _rq(_bq._q.newReader()){};
+        Reader(BookQ& bq) : _bq(bq),
+            _rq (bq._mode==BookQ_Full?  bq._q->newReader() :NULL),
+            _drq(bq._mode==BookQ_Delta? bq._dq->newReader():NULL),
+            _book(bq._cfg), _synced(false), _snap_chunk(-1)
+        {
+            if (_drq) {
+                // sync to the current book, no update
+                resync();
+            }
+        };
 
         ~Reader() {
         }
@@ -1245,31 +1765,279 @@ public:
     private:
         BookQ& _bq;
         std::shared_ptr< typename BookQ::QType::Reader> _rq;  // the reader's queue
+        std::shared_ptr< typename BookQ::DQType::Reader> _drq;  // the reader's queue, delta mode
+
+        // delta mode states
+        BookL2 _book;        // the book rebuilt from deltas
+        bool _synced;        // false if the book needs a snapshot
+        int _snap_chunk;     // next expected snapshot chunk, -1 if none
+        BookDepot _snap;     // snapshot being assembled
+        BookDelta _rec;
         friend class BookQ<BufferType>;
+
+        // delta mode getNextUpdate()
+        bool getNextDelta(BookDepot& book) {
+            while (true) {
+                if (__builtin_expect(!_synced, 0)) {
+                    if (!resync()) {
+                        return false;
+                    }
+                    // the resync'ed book is an update
+                    book = _book._book;
+                    return true;
+                }
+                utils::QStatus stat = _drq->copyNextIn((char*)&_rec);
+                switch (stat) {
+                case utils::QStat_OK :
+                {
+                    _drq->advance();
+                    bool is_update = false;
+                    if (__builtin_expect(!applyDelta(_rec, is_update), 0)) {
+                        logError("delta read queue %s got bad record %s. Trying to sync.",
+                                _bq._q_name.c_str(), _rec.toString().c_str());
+                        _synced = false;
+                        continue;
+                    }
+                    if (is_update) {
+                        book = _book._book;
+                        return true;
+                    }
+                    continue;
+                }
+                case utils::QStat_EAGAIN :
+                    return false;
+                case utils::QStat_OVERFLOW :
+                case utils::QStat_ERROR :
+                {
+                    logError("delta read queue %s %s. Trying to sync from a snapshot.",
+                            _bq._q_name.c_str(), utils::QStatStr(stat));
+                    _synced = false;
+                    continue;
+                }
+                }
+                logError("getNextUpdate read queue %s unknown qstat %d, exiting..."
+                        ,_bq._q_name.c_str(), (int) stat);
+                throw std::runtime_error("BookQ Reader got unknown qstat.");
+            }
+        }
+
+        // applies a record to the book, is_update is set
+        // if the record completes an update to the book
+        bool applyDelta(const BookDelta& rec, bool& is_update) {
+            is_update = false;
+            if (__builtin_expect(rec.kind == BookDelta::Kind_Delta, 1)) {
+                if (__builtin_expect(_snap_chunk >= 0, 0)) {
+                    // snapshot not completed
+                    return false;
+                }
+                for (int i=0; i<rec.flags; ++i) {
+                    _book.updFromDelta(rec.getDelta(i), rec.update_ts_micro);
+                }
+                _book._book.update_ts_micro = rec.update_ts_micro;
+                is_update = true;
+                return true;
+            }
+            // snapshot chunk
+            if (rec.chunk == 0) {
+                _snap_chunk = 0;
+            }
+            if (__builtin_expect(rec.chunk != _snap_chunk, 0)) {
+                _snap_chunk = -1;
+                return false;
+            }
+            const int bytes = _MIN_((int)BookDelta::ChunkLen, (int)(sizeof(BookDepot) - rec.chunk*BookDelta::ChunkLen));
+            memcpy(((char*)&_snap) + rec.chunk*BookDelta::ChunkLen, rec.data, bytes);
+            if (++_snap_chunk == BookDelta::SnapChunks) {
+                _book._book = _snap;
+                _snap_chunk = -1;
+                is_update = (rec.flags != 0);
+            }
+            return true;
+        }
+
+        // find the latest complete snapshot and apply deltas
+        // up to the current write position.
+        // Returns true if synced
+        bool resync() {
+            const utils::QPos top = _drq->getWritePos();
+            utils::QPos pos = top - DeltaLen;
+            const utils::QPos lowest = top - (DeltaQLen - DeltaLen);
+            while ((pos >= 0) && (pos >= lowest)) {
+                // search backwards for the latest snapshot start
+                if (_drq->copyPosInRandomAccess((char*)&_rec, pos) != utils::QStat_OK) {
+                    break;
+                }
+                if (!_rec.isSnapStart()) {
+                    pos -= DeltaLen;
+                    continue;
+                }
+                // replay from the snapshot
+                _snap_chunk = -1;
+                utils::QPos p = pos;
+                bool ok = true;
+                for (; ok && (p < top); p += DeltaLen) {
+                    bool is_update;
+                    ok = (_drq->copyPosInRandomAccess((char*)&_rec, p) == utils::QStat_OK) &&
+                         applyDelta(_rec, is_update);
+                }
+                if (ok && (_snap_chunk == -1)) {
+                    _drq->setPos(top);
+                    _synced = true;
+                    return true;
+                }
+                // the snapshot is being written or overflown
+                _snap_chunk = -1;
+                pos -= DeltaLen;
+            }
+            _drq->setPos(top);
+            return false;
+        }
     };
 };
 
+
 using BookQType = BookQ<utils::ShmCircularBuffer> ;
 using BookQReader = BookQType::Reader;
 using BookQWriter = BookQType::Writer;
 
+// Process-wide readers of the BookQ queried by LatestBook(), so that a
+// query doesn't shm_open and mmap the queue and munmap it after.  Each
+// queue is attached on first query of its symbol and level and kept.  At
+// most every CheckIntervalMicro the shm file of a queue is checked, and
+// the queue re-attached if the tp re-created it, i.e. unlinked and created
+// a new segment of the name.  A writer re-initializing the same segment
+// is seen by the kept reader.
+class BookQRegistry {
+public:
+    enum { CheckIntervalMicro = 1000000 };
+
+    static BookQRegistry& get() {
+        static BookQRegistry reg;
+        return reg;
+    }
+
+    // the latest update of the queue, as getLatestUpdate() of a reader.
+    // The queue is of the thread's provider, see BookConfig::threadProvider()
+    bool latestBook(const std::string& symbol, const std::string& levelStr, BookDepot& myBook) {
+        const uint64_t now = mono_micro();
+        const std::string key (BookConfig::threadProvider() + "@" + symbol + "/" + levelStr);
+        std::lock_guard<std::mutex> lock(m_mtx);
+        auto iter = m_entry.find(key);
+        if (__builtin_expect(iter == m_entry.end(), 0)) {
+            iter = m_entry.emplace(key, attach(symbol, levelStr, now)).first;
+        } else if (__builtin_expect(now - iter->second.check_micro > CheckIntervalMicro, 0)) {
+            if (!sameFile(iter->second)) {
+                logInfo("BookQRegistry: %s re-created, re-attaching", iter->second.bq->_q_name.c_str());
+                iter->second = attach(symbol, levelStr, now);
+            }
+            iter->second.check_micro = now;
+        }
+        try {
+            return iter->second.reader->getLatestUpdate(myBook);
+        } catch (const std::exception& e) {
+            // attached again on next query
+            m_entry.erase(iter);
+            throw;
+        }
+    }
+
+    // queues attached
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_entry.size();
+    }
+
+    // detaches all queues
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_entry.clear();
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<BookQType> bq;
+        std::shared_ptr<BookQReader> reader;
+        std::string shm_file;   // of the queue
+        dev_t dev;              // of the file mapped
+        ino_t ino;
+        uint64_t check_micro;
+    };
+
+    mutable std::mutex m_mtx;
+    std::unordered_map<std::string, Entry> m_entry;  // by provider@symbol/level
+
+    BookQRegistry() {};
+    BookQRegistry(const BookQRegistry&) = delete;
+    BookQRegistry& operator=(const BookQRegistry&) = delete;
+
+    // not the mocked time of simulations
+    static uint64_t mono_micro() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec*1000000ULL + ts.tv_nsec/1000;
+    }
+
+    // the shm file, followed to hugetlbfs if linked there, is still
+    // the file mapped
+    static bool sameFile(const Entry& e) {
+        struct stat st;
+        return (stat(e.shm_file.c_str(), &st) == 0) && (st.st_dev == e.dev) && (st.st_ino == e.ino);
+    }
+
+    static Entry attach(const std::string& symbol, const std::string& levelStr, uint64_t now) {
+        Entry e;
+        e.bq = std::make_shared<BookQType>(BookConfig(symbol, levelStr), true);
+        e.shm_file = e.bq->shmFile();
+        if (!e.bq->fileId(e.dev, e.ino)) {
+            e.dev = 0;
+            e.ino = 0;
+        }
+        e.reader = e.bq->newReader();
+        e.check_micro = now;
+        return e;
+    }
+};
+
 // query book by symbol and a book type: "L1 or L2"
 // symbol could be in form of venue/tradable, or just tradable, or just a MTS symbol
 static inline
 bool LatestBook(const std::string& symbol, const std::string& levelStr, BookDepot& myBook) {
-    BookConfig bcfg(symbol, levelStr);
-    BookQType bq(bcfg, true);
-    auto book_reader = bq.newReader();
-    if (!book_reader) {
-        logError("Couldn't get book reader!");
-        return false;
+    return BookQRegistry::get().latestBook(symbol, levelStr, myBook);
+}
+
+// the last value cache id of the symbol, -1 if the cache is not
+// available or the symbol is not written to it, or in simulation
+static inline
+int LVCId(const std::string& symbol) {
+    if (__builtin_expect(utils::TimeUtil::is_mocked(), 0)) {
+        return -1;
+    }
+    // found ids are kept, as they stay for the life of the segment
+    thread_local std::unordered_map<std::string, int> ids;
+    const auto iter = ids.find(symbol);
+    if (__builtin_expect(iter != ids.end(), 1)) {
+        return iter->second;
+    }
+    int id = -1;
+    try {
+        id = LVC::get().find(LVC::key(BookConfig(symbol, "L1")));
+    } catch (const std::exception& e) {
+        return -1;
+    }
+    if (id >= 0) {
+        ids.emplace(symbol, id);
     }
-    bool ret = book_reader->getLatestUpdate(myBook);
-    return ret;
+    return id;
 }
 
 static inline
 bool getBBO(const std::string& symbol, double& bidpx, int& bidsz, double& askpx, int& asksz) {
+    // the cached top of book written by the tp, see LVC,
+    // otherwise the latest update of the L1 queue
+    const int id = LVCId(symbol);
+    if ((id >= 0) && LVC::get().getBBO(id, bidpx, bidsz, askpx, asksz)) {
+        return true;
+    }
     BookDepot myBook;
     if (!LatestBook(symbol, "L1", myBook)) {
         return false;
@@ -1283,6 +2051,13 @@ bool getBBO(const std::string& symbol, double& bidpx, int& bidsz, double& askpx,
 
 static inline
 bool getBBOPriceEntry(const std::string& symbol, PriceEntry& bid_pe, PriceEntry& ask_pe) {
+    const int id = LVCId(symbol);
+    LVCRec rec;
+    if ((id >= 0) && LVC::get().read(id, rec)) {
+        bid_pe = rec.bid;
+        ask_pe = rec.ask;
+        return true;
+    }
     BookDepot myBook;
     if (!LatestBook(symbol, "L1", myBook)) {
         return false;
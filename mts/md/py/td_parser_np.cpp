@@ -65,10 +65,59 @@ static PyObject* td_parser_np(PyObject *self, PyObject *args) {
     return NULL;
 }
 
+// same as td_parser_np, but returns the bars as a [cols, n] array,
+// the columns as in md::BarColumns, instead of writing a csv
+static PyObject* td_parser_columns_np(PyObject *self, PyObject *args) {
+    PyArrayObject *quote, *trade;
+    int sutc, eutc, barsec;
+    double tick_size;
+    if (!PyArg_ParseTuple(args, "OOiiid",
+                &quote, &trade, &sutc, &eutc, &barsec,
+                &tick_size)) {
+        printf("cannot parse, got %d, %d, %d\n", sutc,eutc,barsec);
+        return NULL;
+    }
+
+    if ((quote->nd != 2) || (quote->dimensions[1] != 5)) {
+        PyErr_SetString(PyExc_ValueError, "quote must be shape [n,5]");
+        return NULL;
+    }
+    if ((trade->nd != 2) || (trade->dimensions[1] != 3)) {
+        PyErr_SetString(PyExc_ValueError, "trade must be shape [n,3]");
+        return NULL;
+    }
+    if ((eutc<=sutc+1) || (barsec<1)) {
+        PyErr_SetString(PyExc_ValueError, "sutc>eutc-1 and barsec>0");
+        return NULL;
+    }
+    if (!((quote->flags&1) && (trade->flags&1))) {
+        PyErr_SetString(PyExc_ValueError, "quote and trade must be c-contiguous");
+        return NULL;
+    }
+
+    md::TickData2Bar tp("", "", sutc, eutc, barsec, tick_size);
+    md::BarColumns bars;
+    if (!tp.parseColumns((double*)quote->data,
+                         (double*)trade->data,
+                         quote->dimensions[0],
+                         trade->dimensions[0],
+                         bars)) {
+        bars.resize(0);
+    }
+    npy_intp dims[2] = {md::BarColumns::Cols, (npy_intp)bars.n};
+    PyObject* ret = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (ret && bars.n) {
+        memcpy(PyArray_DATA((PyArrayObject*)ret), bars.d.data(), bars.d.size()*sizeof(double));
+    }
+    return ret;
+}
+
 static PyMethodDef TDParserMethods[] =
 {
     {"td_parser_np", td_parser_np, METH_VARARGS,
         "tickdata parser"},
+    {"td_parser_columns_np", td_parser_columns_np, METH_VARARGS,
+        "tickdata parser to bar columns"},
     {NULL,NULL,0,NULL}
 };
 
@@ -45,14 +45,17 @@ int main(int argc, char**argv) {
     BookQType bq(bcfg, true);
     auto book_reader = bq.newReader();
     BookDepot myBook;
+    std::vector<BookDepot> batch(64);
 
     //uint64_t start_tm = utils::TimeUtil::cur_time_micro();
     user_stopped = false;
     while (!user_stopped) {
         if (dump_all) {
-            if (book_reader->getNextUpdate(myBook)) {
-                    printf("%s\n", myBook.prettyPrint().c_str());
-            } else {
+            const int cnt = book_reader->readBatch(batch.data(), (int)batch.size());
+            for (int i=0; i<cnt; ++i) {
+                printf("%s\n", batch[i].prettyPrint().c_str());
+            }
+            if (!cnt) {
                 usleep(1000);
             }
         } else {
@@ -0,0 +1,134 @@
+#include "td_parser.h"
+#include <thread>
+#include <vector>
+
+/*
+ * Rebuilds bars from the tickdata quote/trade csv files in parallel.
+ * The manifest is a csv file with one task per line:
+ *   symbol, day, quote_file, trade_file, utc_start, utc_end, barsec, tick_size, out_file
+ * Lines starting with '#' are skipped.  Worker threads take the tasks
+ * in order, each task with its own TickData2Bar, so the only shared
+ * state is the next task index.  With "scale", the manifest is run with
+ * 1 up to the given threads, for the scaling of the throughput.
+ */
+
+struct Task {
+    std::string symbol, day, quote_file, trade_file, out_file;
+    time_t utc_start, utc_end;
+    int barsec;
+    double tick_size;
+
+    // result
+    bool ok;
+    size_t ticks, bars;
+    double ms;
+};
+
+static long long now_micro() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000LL + ts.tv_nsec/1000;
+}
+
+static std::vector<Task> readManifest(const std::string& manifest_file) {
+    std::vector<Task> tasks;
+    const auto& lines(utils::CSVUtil::read_file(manifest_file));
+    for (const auto& tk : lines) {
+        if (tk[0].size() && tk[0][0]=='#') {
+            continue;
+        }
+        if (tk.size() < 9) {
+            fprintf(stderr, "skipping manifest line of %d columns starting with %s\n", (int)tk.size(), tk[0].c_str());
+            continue;
+        }
+        Task t;
+        t.symbol = tk[0]; t.day = tk[1];
+        t.quote_file = tk[2]; t.trade_file = tk[3];
+        t.utc_start = (time_t)std::stoll(tk[4]);
+        t.utc_end = (time_t)std::stoll(tk[5]);
+        t.barsec = std::stoi(tk[6]);
+        t.tick_size = std::stod(tk[7]);
+        t.out_file = tk[8];
+        t.ok = false; t.ticks = 0; t.bars = 0; t.ms = 0;
+        tasks.push_back(t);
+    }
+    return tasks;
+}
+
+static void runTask(Task& t) {
+    long long t0 = now_micro();
+    try {
+        md::TickData2Bar tp(t.quote_file, t.trade_file, t.utc_start, t.utc_end, t.barsec, t.tick_size);
+        t.ok = tp.parse(t.out_file);
+        t.ticks = tp.tickCount();
+        t.bars = tp.barCount();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s %s failed: %s\n", t.symbol.c_str(), t.day.c_str(), e.what());
+        t.ok = false;
+    }
+    t.ms = (now_micro() - t0)/1000.0;
+}
+
+// returns the wall time in milli
+static double run(std::vector<Task>& tasks, int threads) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < tasks.size()) {
+            runTask(tasks[i]);
+        }
+    };
+    long long t0 = now_micro();
+    std::vector<std::thread> pool;
+    for (int i=0; i<threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+    return (now_micro() - t0)/1000.0;
+}
+
+static void report(const std::vector<Task>& tasks, int threads, double wall_ms, bool per_task) {
+    size_t ticks = 0, bars = 0, failed = 0;
+    double task_ms = 0;
+    for (const auto& t : tasks) {
+        if (per_task) {
+            printf("%s %s %s ticks: %zu, bars: %zu, ms: %.1f\n",
+                    t.symbol.c_str(), t.day.c_str(), t.ok?"OK":"FAILED", t.ticks, t.bars, t.ms);
+        }
+        ticks += t.ticks; bars += t.bars;
+        task_ms += t.ms;
+        failed += (t.ok?0:1);
+    }
+    double sec = _MAX_(wall_ms, 1e-3)/1000.0;
+    printf("threads: %d, tasks: %zu (%zu failed), wall ms: %.1f, task ms: %.1f, ticks/s: %.0f, bars/s: %.0f\n",
+            threads, tasks.size(), failed, wall_ms, task_ms, ticks/sec, bars/sec);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s manifest_file [threads] [scale]\n", argv[0]);
+        printf("manifest line: symbol, day, quote_file, trade_file, utc_start, utc_end, barsec, tick_size, out_file\n");
+        printf("threads default to the number of cores, scale runs with 1 to threads\n");
+        return 0;
+    }
+    auto tasks = readManifest(argv[1]);
+    int threads = (argc>2)? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    threads = _MAX_(threads, 1);
+    bool scale = (argc>3) && (strcmp(argv[3], "scale")==0);
+
+    if (!scale) {
+        double wall_ms = run(tasks, threads);
+        report(tasks, threads, wall_ms, true);
+    } else {
+        for (int n=1; n<=threads; ++n) {
+            double wall_ms = run(tasks, n);
+            report(tasks, n, wall_ms, false);
+        }
+    }
+    for (const auto& t : tasks) {
+        if (!t.ok) return 1;
+    }
+    return 0;
+}
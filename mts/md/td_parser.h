@@ -9,15 +9,18 @@ namespace md {
 
 class BarsFileWriter {
 public:
-    BarsFileWriter (const std::string& file): _fp(0) {
+    BarsFileWriter (const std::string& file): _fp(0), _cnt(0) {
         _fp = fopen(file.c_str(), "wt");
         if (!_fp) throw std::runtime_error("failed to open" + file + " for writing!");
     }
 
     void emplace_back(const std::string& line) {
         fprintf(_fp, "%s\n", line.c_str());
+        ++_cnt;
     }
 
+    size_t size() const { return _cnt; };
+
     ~BarsFileWriter() {
         if (_fp) {
             fclose(_fp);
@@ -26,6 +29,7 @@ public:
     }
 private:
     FILE* _fp;
+    size_t _cnt;
 };
 
 class NullWriter {
@@ -51,6 +55,83 @@ struct Array2D {
     size_t _N, _M;
 };
 
+// Bars from the batch path of TickData2Bar, see parseColumns().
+// The columns follow BarRec, plus the quote and trade update counts.
+// Stored column major, column c of bar i at d[c*n+i], so that each
+// column is contiguous and the whole is a [Cols, n] array for numpy.
+struct BarColumns {
+    enum Col {
+        BarTime, Open, High, Low, Close, TotVol, LastPx, LastMicro, Vbs,
+        AvgBsz, AvgAsz, AvgSpd, Bqd, Aqd, OptV1, OptV2, QuoteCnt, TradeCnt,
+        Cols
+    };
+    size_t n;
+    std::vector<double> d;
+
+    BarColumns(): n(0) {};
+    void resize(size_t n_) {
+        n = n_;
+        d.assign(Cols*n, 0);
+    }
+    double* col(int c) { return &d[c*n]; };
+    const double* col(int c) const { return &d[c*n]; };
+    double get(size_t i, int c) const { return d[c*n+i]; };
+
+    // same as the BarPrice::toCSVLine() with optional fields
+    std::string toCSVLine(size_t i) const {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%d, %s, %s, %s, %s, %lld, %s, %lld, %lld, "
+                                   "%.1f, %.1f, %f, %d, %d, %d, %d",
+                 (int)get(i,BarTime), PriceCString(get(i,Open)), PriceCString(get(i,High)),
+                 PriceCString(get(i,Low)), PriceCString(get(i,Close)), (long long)get(i,TotVol),
+                 PriceCString(get(i,LastPx)), (long long)get(i,LastMicro), (long long)get(i,Vbs),
+                 get(i,AvgBsz), get(i,AvgAsz), get(i,AvgSpd), (int)get(i,Bqd), (int)get(i,Aqd),
+                 (int)get(i,OptV1), (int)get(i,OptV2));
+        return std::string(buf);
+    }
+};
+
+// The quote/trade sequence as merged by TickData2Bar, in columns.
+// It takes the place of BarPrice in the merge, and the bars are
+// computed from it afterwards bucket by bucket.
+struct TickTape {
+    std::vector<long long> micro;
+    std::vector<char> is_trade;
+    std::vector<double> bpx, apx, tpx;
+    std::vector<int> bsz, asz, vol; // vol is signed trade size
+    bool ordered; // micro non-decreasing
+
+    TickTape(): ordered(true) {};
+
+    void reserve(size_t n) {
+        micro.reserve(n); is_trade.reserve(n);
+        bpx.reserve(n); apx.reserve(n); tpx.reserve(n);
+        bsz.reserve(n); asz.reserve(n); vol.reserve(n);
+    }
+    size_t size() const { return micro.size(); };
+
+    // same interface as BarPrice used by the merge
+    void set_write_optional(bool) {};
+    void set_tick_size(double) {};
+
+    void updateQuote(long long cur_micro, double bidpx, int bidsz, double askpx, int asksz) {
+        add(cur_micro, false, bidpx, bidsz, askpx, asksz, 0, 0);
+    }
+    void updateTrade(long long cur_micro, double price, uint32_t size, bool is_buy) {
+        add(cur_micro, true, 0, 0, 0, 0, price, is_buy?(int32_t)size:-(int32_t)size);
+    }
+
+private:
+    void add(long long cur_micro, bool trd, double bp, int bs, double ap, int as, double px, int v) {
+        if (__builtin_expect(micro.size() && cur_micro < micro.back(), 0)) {
+            ordered = false;
+        }
+        micro.push_back(cur_micro); is_trade.push_back(trd);
+        bpx.push_back(bp); bsz.push_back(bs); apx.push_back(ap); asz.push_back(as);
+        tpx.push_back(px); vol.push_back(v);
+    }
+};
+
 class TickData2Bar {
 public:
     TickData2Bar(const std::string& quote_csv,
@@ -61,7 +142,8 @@ public:
                  double tick_size=0):
         _quote_csv(quote_csv), _trade_csv(trade_csv),
         _start_utc(start_utc), _end_utc(end_utc),
-        _barsec(barsec), _tick_size(tick_size) {}
+        _barsec(barsec), _tick_size(tick_size),
+        _tick_cnt(0), _bar_cnt(0) {}
 
     bool parse(std::vector<std::string>& bars) {
         return get_bar(_quote_csv, _trade_csv, 
@@ -71,11 +153,17 @@ public:
 
     bool parse(const std::string& out_csv_file) {
         BarsFileWriter bars(out_csv_file);
-        return get_bar(_quote_csv, _trade_csv,
-                       _start_utc, _end_utc, _barsec, bars,
-                       (NullWriter*)nullptr);
+        bool ret = get_bar(_quote_csv, _trade_csv,
+                           _start_utc, _end_utc, _barsec, bars,
+                           (NullWriter*)nullptr);
+        _bar_cnt = bars.size();
+        return ret;
     }
 
+    // quote+trade ticks read and bars written by the last parse from csv
+    size_t tickCount() const { return _tick_cnt; };
+    size_t barCount() const { return _bar_cnt; };
+
     template<typename QuoteType, typename TradeType>
     bool parseArray(const QuoteType& q, const TradeType& t,
                     size_t qlen, size_t tlen,
@@ -93,6 +181,34 @@ public:
         return get_bar_array(qa, ta, qlen, tlen, _start_utc, _end_utc, _barsec, bars, (NullWriter*)nullptr);
     }
 
+    // the bars of parseDoubleArray() before they are written to csv
+    bool parseDoubleArray(const double* q, const double* t,
+                          size_t qlen, size_t tlen,
+                          std::vector<md::BarPrice>& bars) {
+        Array2D<double> qa((double*)q, qlen, 5);
+        Array2D<double> ta((double*)t, tlen, 3);
+        return get_bar_array(qa, ta, qlen, tlen, _start_utc, _end_utc, _barsec, bars, (NullWriter*)nullptr);
+    }
+
+    // The batch path of parseDoubleArray(), writing bars to columns
+    // instead of csv lines.  The ticks are merged into a TickTape, which
+    // is segmented into bar buckets by time, and each bucket reduced into
+    // one bar.  It gives the same bars as the csv.
+    bool parseColumns(const double* q, const double* t,
+                      size_t qlen, size_t tlen,
+                      BarColumns& bars) {
+        Array2D<double> qa((double*)q, qlen, 5);
+        Array2D<double> ta((double*)t, tlen, 3);
+        TickTape tape;
+        tape.reserve(qlen+tlen);
+        NullWriter nw;
+        if (!merge_ticks(qa, ta, qlen, tlen, _start_utc, _end_utc, _barsec, tape, nw, (NullWriter*)nullptr)) {
+            return false;
+        }
+        get_bar_columns(tape, _start_utc, _end_utc, _barsec, bars);
+        return true;
+    }
+
     // getting the tick-by-tick dump from quote/trade csv
     bool tickDump(std::vector<std::string>& tickdump) {
         NullWriter bars;
@@ -120,6 +236,7 @@ private:
     time_t _start_utc, _end_utc; // fist bar close at start_utc+barsec
     int _barsec;
     double _tick_size;
+    size_t _tick_cnt, _bar_cnt;
 
     template<typename BarDumpType>
     time_t check_roll(long long cur_micro,
@@ -136,9 +253,34 @@ private:
         return bar_due;
     }
 
-    template<typename QuoteType, typename BarDumpType, typename TickDumpType>
+    time_t check_roll(long long cur_micro,
+                      md::BarPrice& bar,
+                      time_t bar_due,
+                      int barsec,
+                      std::vector<md::BarPrice>& bars) {
+        // as above, keeping the bars instead of the csv lines
+        time_t cur_sec = (time_t) (cur_micro/1000000LL);
+        for (; bar_due<=cur_sec; bar_due+=barsec) {
+            bar.bar_time = bar_due;
+            bars.push_back(bar);
+            bar.roll(bar_due);
+        }
+        return bar_due;
+    }
+
+    template<typename BarDumpType>
+    time_t check_roll(long long cur_micro,
+                      TickTape& tape,
+                      time_t bar_due,
+                      int barsec,
+                      BarDumpType& bars) {
+        // the tape is segmented into bars afterwards
+        return bar_due;
+    }
+
+    template<typename QuoteType, typename BarType, typename BarDumpType, typename TickDumpType>
     time_t update_quote(const QuoteType& q,
-                        md::BarPrice& bp,
+                        BarType& bp,
                         time_t bar_due,
                         int barsec,
                         BarDumpType& bars,
@@ -156,10 +298,10 @@ private:
         return bar_due;
     }
 
-    template<typename TradeType, typename BarDumpType, typename TickDumpType>
+    template<typename TradeType, typename BarType, typename BarDumpType, typename TickDumpType>
     time_t update_trade(const TradeType& t,
                         bool is_buy,
-                        md::BarPrice& bp,
+                        BarType& bp,
                         time_t bar_due,
                         int barsec,
                         BarDumpType& bars,
@@ -204,11 +346,28 @@ private:
                        BarDumpType& bars,
                        TickDumpType* tickdump,
                        md::BookDepot* bookp=nullptr) {
+        md::BarPrice bp;
+        return merge_ticks(q, t, qlen, tlen, start_utc, end_utc, barsec, bp, bars, tickdump, bookp);
+    }
+
+    // merge the quotes and trades in sequence, and update them to bp,
+    // BarType is a BarPrice, or a TickTape for the batch path
+    template<typename QuoteType, typename TradeType, typename BarType, typename BarDumpType, typename TickDumpType>
+    bool merge_ticks(const QuoteType& q,
+                     const TradeType& t,
+                     size_t qlen,
+                     size_t tlen,
+                     const time_t start_utc,
+                     const time_t end_utc,
+                     const int barsec,
+                     BarType& bp,
+                     BarDumpType& bars,
+                     TickDumpType* tickdump,
+                     md::BookDepot* bookp=nullptr) {
 
         size_t tix=0, qix=0;
         // intialize the first qix and tix
         // remove any tix earlier than qix
-        md::BarPrice bp;
         bp.set_write_optional(true);
         bp.set_tick_size(_tick_size);
         time_t bar_utc = start_utc+barsec; // first bar close time
@@ -373,6 +532,281 @@ private:
         return true;
     };
 
+    // Bar bucket k closes at start_utc+(k+1)*barsec and has the ticks
+    // before it, same as the roll in check_roll().  Each bucket is reduced
+    // over the tape columns: OHLC is the first/max/min/last of a close
+    // column, volumes and counts are sums, the time weighted sizes and
+    // spread are sums over the quote columns in tick order.  Quote diffs
+    // and unmatched volumes are per quote increments from the previous
+    // quote, summed per bucket.  The formulas follow BarPrice::update(),
+    // so that the bars are bit for bit the csv bars.
+    void get_bar_columns(const TickTape& tape,
+                         time_t start_utc,
+                         time_t end_utc,
+                         int barsec,
+                         BarColumns& bars) {
+        const size_t n = (end_utc>=start_utc+barsec)? (size_t)((end_utc-start_utc)/barsec) : 0;
+        const size_t m = tape.size();
+        bars.resize(n);
+
+        const long long* micro = tape.micro.data();
+        const char* is_trade = tape.is_trade.data();
+
+        // the bar rolls on the latest time seen, which is
+        // the tick time itself unless the tape is out of order
+        const long long* roll_micro = micro;
+        std::vector<long long> max_micro;
+        if (__builtin_expect(!tape.ordered, 0)) {
+            max_micro.resize(m);
+            long long mx = 0;
+            for (size_t i=0; i<m; ++i) {
+                mx = std::max(mx, micro[i]);
+                max_micro[i] = mx;
+            }
+            roll_micro = max_micro.data();
+        }
+        std::vector<size_t> bix(n+1, 0);
+        for (size_t k=0; k<n; ++k) {
+            const long long due_micro = (long long)(start_utc+(time_t)(k+1)*barsec)*1000000LL;
+            bix[k+1] = std::lower_bound(roll_micro+bix[k], roll_micro+m, due_micro) - roll_micro;
+        }
+
+        // the live ticks, i.e. without the crossed quotes that BarPrice
+        // skips, and the quotes among them
+        std::vector<size_t> li, qi;  // tape index of live ticks, live index of quotes
+        li.reserve(m); qi.reserve(m);
+        for (size_t i=0; i<m; ++i) {
+            if (is_trade[i] || !(tape.apx[i]-tape.bpx[i]<1e-10)) {
+                if (!is_trade[i]) {
+                    qi.push_back(li.size());
+                }
+                li.push_back(i);
+            }
+        }
+        const size_t nl = li.size(), nq = qi.size();
+        std::vector<size_t> lb(n+1, 0), qb(n+1, 0);  // bucket starts in li and qi
+        for (size_t k=0; k<=n; ++k) {
+            lb[k] = std::lower_bound(li.begin(), li.end(), bix[k]) - li.begin();
+            qb[k] = std::lower_bound(qi.begin(), qi.end(), lb[k]) - qi.begin();
+        }
+
+        // live columns: close after the tick, signed trade volume and
+        // the cumulative volume before the tick
+        std::vector<double> cls(nl);
+        std::vector<int32_t> vol(nl);
+        std::vector<long long> cum_vol(nl+1, 0);
+        for (size_t j=0; j<nl; ++j) {
+            const size_t i = li[j];
+            cls[j] = is_trade[i]? tape.tpx[i] : (tape.bpx[i]+tape.apx[i])/2.0;
+            vol[j] = is_trade[i]? tape.vol[i] : 0;
+            cum_vol[j+1] = cum_vol[j] + vol[j];
+        }
+
+        // quote columns, the previous quote's at r-1, zeros before the first
+        std::vector<long long> qt(nq);
+        std::vector<double> qbpx(nq+1, 0), qapx(nq+1, 0);
+        std::vector<int> qbsz(nq+1, 0), qasz(nq+1, 0);
+        std::vector<int32_t> qv3(nq);   // trade volume since the previous quote
+        std::vector<char> qptrd(nq);    // the previous live tick is a trade
+        for (size_t r=0; r<nq; ++r) {
+            const size_t j = qi[r], i = li[j];
+            qt[r] = micro[i];
+            qbpx[r+1] = tape.bpx[i]; qbsz[r+1] = tape.bsz[i];
+            qapx[r+1] = tape.apx[i]; qasz[r+1] = tape.asz[i];
+            qv3[r] = (int32_t)(cum_vol[j] - (r? cum_vol[qi[r-1]+1] : 0));
+            qptrd[r] = (j>0) && is_trade[li[j-1]];
+        }
+
+        // the time weighted sums per bucket, in tick order, keeping the
+        // averages seen by each quote before it is added.  The weight is
+        // from the latest quote, the roll or the first live tick
+        std::vector<double> qavg_bsz(nq), qavg_asz(nq);
+        std::vector<double> cum_bsz(n), cum_asz(n), cum_spd(n);
+        std::vector<long long> cum_micro(n), last_quote(n);
+        const size_t first_bar = nl? (size_t)(std::upper_bound(lb.begin(), lb.end(), 0) - lb.begin() - 1) : n;
+        for (size_t k=0; k<n; ++k) {
+            long long pq = 0;  // prev_micro_quote, 0 before the first live tick
+            if (k > first_bar) {
+                pq = (long long)(start_utc+(time_t)k*barsec)*1000000LL;
+            } else if (k == first_bar) {
+                pq = micro[li[0]];
+            }
+            double cb = 0, ca = 0, cs = 0;
+            long long cm = 0;
+            for (size_t r=qb[k]; r<qb[k+1]; ++r) {
+                const long long tau = qt[r]-pq;
+                qavg_bsz[r] = tw_avg(cb, qbsz[r], tau, cm);
+                qavg_asz[r] = tw_avg(ca, qasz[r], tau, cm);
+                if (__builtin_expect(tau>0,1)) {
+                    cb += (qbsz[r]*tau);
+                    ca += (qasz[r]*tau);
+                    cs += ((qapx[r]-qbpx[r])*tau);
+                    cm += tau;
+                    pq = qt[r];
+                }
+            }
+            cum_bsz[k] = cb; cum_asz[k] = ca; cum_spd[k] = cs;
+            cum_micro[k] = cm; last_quote[k] = pq;
+        }
+
+        // the quote diff and unmatched volume increments of each quote
+        std::vector<int> dbqd(nq, 0), daqd(nq, 0);
+        std::vector<int32_t> dv1(nq, 0), dv2(nq, 0);
+        for (size_t r=0; r<nq; ++r) {
+            quote_diff(qbpx[r], qbsz[r], qapx[r], qasz[r],
+                       qbpx[r+1], qbsz[r+1], qapx[r+1], qasz[r+1],
+                       qptrd[r], qv3[r], qavg_bsz[r], qavg_asz[r],
+                       dbqd[r], daqd[r], dv1[r], dv2[r]);
+        }
+
+        // the bucket reductions, carrying close and the last trade
+        double close = 0, last_px = 0;
+        long long last_us = 0;
+        for (size_t k=0; k<n; ++k) {
+            const size_t j0 = lb[k], j1 = lb[k+1];
+            const size_t r0 = qb[k], r1 = qb[k+1];
+            const time_t due = start_utc+(time_t)(k+1)*barsec;
+            const long long due_micro = (long long)due*1000000LL;
+
+            double open = close, high = close, low = close;
+            if (k == 0) {
+                high = -1e+12; low = 1e+12;
+            }
+            size_t j = j0;
+            if (k == first_bar) {
+                open = high = low = cls[j0];
+            }
+            for (; j<j1; ++j) {
+                high = cls[j]>high? cls[j] : high;
+                low = cls[j]<low? cls[j] : low;
+            }
+            if (j1>j0) {
+                close = cls[j1-1];
+            }
+            uint32_t bvol = 0, svol = 0;
+            for (j=j0; j<j1; ++j) {
+                bvol += (vol[j]>0? vol[j] : 0);
+                svol -= (vol[j]<0? vol[j] : 0);
+            }
+            for (j=j1; j>j0; --j) {
+                if (is_trade[li[j-1]]) {
+                    last_px = tape.tpx[li[j-1]];
+                    last_us = micro[li[j-1]];
+                    break;
+                }
+            }
+            int bqd = 0, aqd = 0;
+            int32_t v1 = 0, v2 = 0;
+            for (size_t r=r0; r<r1; ++r) {
+                bqd += dbqd[r]; aqd += daqd[r];
+                v1 += dv1[r]; v2 += dv2[r];
+            }
+            const size_t pr = r1;  // the latest quote, at r1-1, is the previous
+            const long long tau = due_micro-last_quote[k];
+            long long tcnt = 0;
+            for (size_t i=bix[k]; i<bix[k+1]; ++i) {
+                tcnt += is_trade[i];
+            }
+            bars.col(BarColumns::BarTime)[k] = (double)due;
+            bars.col(BarColumns::Open)[k] = open;
+            bars.col(BarColumns::High)[k] = high;
+            bars.col(BarColumns::Low)[k] = low;
+            bars.col(BarColumns::Close)[k] = close;
+            bars.col(BarColumns::TotVol)[k] = (double)((long long)bvol+svol);
+            bars.col(BarColumns::LastPx)[k] = last_px;
+            bars.col(BarColumns::LastMicro)[k] = (double)last_us;
+            bars.col(BarColumns::Vbs)[k] = (double)((long long)bvol-svol);
+            bars.col(BarColumns::AvgBsz)[k] = tw_avg(cum_bsz[k], qbsz[pr], tau, cum_micro[k]);
+            bars.col(BarColumns::AvgAsz)[k] = tw_avg(cum_asz[k], qasz[pr], tau, cum_micro[k]);
+            bars.col(BarColumns::AvgSpd)[k] = tw_avg(cum_spd[k], (qapx[pr]-qbpx[pr]), tau, cum_micro[k]);
+            bars.col(BarColumns::Bqd)[k] = bqd;
+            bars.col(BarColumns::Aqd)[k] = aqd;
+            bars.col(BarColumns::OptV1)[k] = v1;
+            bars.col(BarColumns::OptV2)[k] = v2;
+            bars.col(BarColumns::QuoteCnt)[k] = (double)(bix[k+1]-bix[k]-tcnt);
+            bars.col(BarColumns::TradeCnt)[k] = (double)tcnt;
+        }
+    }
+
+    // BarPrice::get_avg()
+    template<typename DType1, typename DType2>
+    static double tw_avg(DType1 cum_qty, DType2 cur_qty, long long tau, long long cum_micro) {
+        if (__builtin_expect(tau+cum_micro<=0,0)) {
+            tau=1; // allow same micro with prev_micro_quote
+        }
+        return (double)(cum_qty+cur_qty*tau)/(double)(cum_micro+tau);
+    }
+
+    // the bqd/aqd and the optional volumes BarPrice::update() adds for a
+    // quote, given the previous quote, if the previous live tick is a
+    // trade, the trade volume since the previous quote and the averages
+    void quote_diff(double prev_bpx, int prev_bsz, double prev_apx, int prev_asz,
+                    double bidpx, int bidsz, double askpx, int asksz,
+                    bool prev_trade, int32_t opt_v3, double avg_bsz, double avg_asz,
+                    int& bqd, int& aqd, int32_t& opt_v1, int32_t& opt_v2) const {
+        if (prev_trade) {
+            // check unmatched volume
+            int32_t r_sz = 0;
+            int32_t qdiff = 0;
+            if (prev_bsz*prev_asz*opt_v3!=0) {
+                if (opt_v3>0) {
+                    if (std::abs(prev_apx-askpx)<1e-10) {
+                        r_sz=bid_reducing(-prev_apx, prev_asz, -askpx, asksz).second;
+                        qdiff = opt_v3-r_sz;
+                    } else {
+                        int sz_l2=opt_v3-prev_asz;
+                        opt_v1 += (sz_l2>0?sz_l2:0);
+                        int levels = swipe_level(_tick_size, prev_apx,askpx);
+                        int sz0 = (prev_asz+(int)((levels-1)*avg_asz+0.5));
+                        if (sz0>opt_v3) {
+                            aqd -= (sz0-opt_v3);
+                        }
+                    }
+                } else if (opt_v3<0) {
+                    if (std::abs(prev_bpx-bidpx)<1e-10) {
+                        r_sz = bid_reducing(prev_bpx, prev_bsz, bidpx, bidsz).second;
+                        qdiff = -opt_v3-r_sz;
+                    } else {
+                        int sz_l2 = opt_v3+prev_bsz;
+                        opt_v1 += (sz_l2<0?sz_l2:0);
+                        int levels = swipe_level(_tick_size, prev_bpx,bidpx);
+                        int sz0 = (prev_bsz+(int)((levels-1)*avg_bsz+0.5));
+                        if (sz0>-opt_v3) {
+                            bqd -= (sz0+opt_v3);
+                        }
+                    }
+                }
+                if (qdiff>0) {
+                    opt_v2 += (opt_v3>0?qdiff:-qdiff);
+                }
+            }
+            return;
+        }
+        if (prev_bsz*prev_asz==0) {
+            return;
+        }
+        if (std::abs(bidpx-prev_bpx)<1e-10) {
+            bqd += (bidsz - prev_bsz);
+        } else {
+            int levels = swipe_level(_tick_size, prev_bpx, bidpx);
+            if (bidpx < prev_bpx) {
+                bqd -= (prev_bsz+(int)((levels-1)*avg_bsz+0.5));
+            } else {
+                bqd += (bidsz+(int)((levels-1)*avg_bsz+0.5));
+            }
+        }
+        if (std::abs(askpx - prev_apx)<1e-10) {
+            aqd += (asksz - prev_asz);
+        } else {
+            int levels = swipe_level(_tick_size, prev_apx,askpx);
+            if (askpx > prev_apx) {
+                aqd -= (prev_asz+(int)((levels-1)*avg_asz+0.5));
+            } else {
+                aqd += (asksz+(int)((levels-1)*avg_asz+0.5));
+            }
+        }
+    }
+
     template<typename BarDumpType, typename TickDumpType>
     bool get_bar(const std::string& quote_csv,
                  const std::string& trade_csv,
@@ -384,6 +818,11 @@ private:
                  md::BookDepot* bookp=nullptr) {
         const auto& qs(utils::CSVUtil::read_file(quote_csv));
         const auto& ts(utils::CSVUtil::read_file(trade_csv));
+        _tick_cnt = qs.size() + ts.size();
+        if (__builtin_expect(qs.size()<2,0)) {
+            printf("not enough quotes in %s\n", quote_csv.c_str());
+            return false;
+        }
 
         // note:q/t type is not double**, but double(*)[N]
         auto q=new double[qs.size()][quote_cols];
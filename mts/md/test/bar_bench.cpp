@@ -0,0 +1,85 @@
+#include "md_bar.h"
+#include <time.h>
+
+/*
+ * Compares BarReader::readLatest() from the csv bar file
+ * and from the binary bar file, on a year of 60 second bars.
+ * The config should have the symbol, i.e. the main.cfg
+ * written by br_test.  Note the bar file of BarSec 60 is
+ * overwritten.
+ */
+
+static const int BarSec = 60;
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static long long writeBars(const md::BookConfig& bcfg, int days) {
+    const std::string fn = bcfg.bfname(BarSec);
+    FILE* fp = fopen(fn.c_str(), "wt");
+    if (!fp) {
+        printf("failed to create %s\n", fn.c_str());
+        return 0;
+    }
+    time_t t0 = time(nullptr);
+    t0 = t0 - t0%BarSec - (time_t)days*24*3600;
+    md::BarPrice bar("0, 40.0, 40.1, 39.9, 40.05, 0, 0, 0, 0");
+    long long cnt = 0;
+    double px = 40.0;
+    unsigned int seed = 7;
+    for (time_t t = t0; t <= t0 + (time_t)days*24*3600; t += BarSec) {
+        if (!md::VenueConfig::get().isTradingTime(bcfg.venue, t-1)) {
+            continue;
+        }
+        px += 0.01*((rand_r(&seed)%3)-1);
+        bar.update((long long)t*1000000LL, px, 1, 2, 0,0,0,0);
+        fprintf(fp, "%s\n", bar.writeAndRoll(t).c_str());
+        ++cnt;
+    }
+    fclose(fp);
+    return cnt;
+}
+
+static void run(const md::BookConfig& bcfg, int barcnt, int loops, const char* name) {
+    md::BarReader br(bcfg, BarSec);
+    long long t0 = now_ns();
+    size_t sz = 0;
+    for (int i=0; i<loops; ++i) {
+        std::vector<std::shared_ptr<md::BarPrice> > bars;
+        br.readLatest(bars, barcnt);
+        sz += bars.size();
+    }
+    long long t1 = now_ns();
+    printf("%-6s readLatest(%d): %.3f ms per read, bars read %lld\n",
+            name, barcnt, (t1-t0)/1e6/loops, (long long)sz/loops);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s config_file [days] [loops]\n", argv[0]);
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    int days = (argc>2)? atoi(argv[2]) : 365;
+    int loops = (argc>3)? atoi(argv[3]) : 10;
+
+    md::BookConfig bcfg("", "WTI_N1", "L1");
+    const std::string csv_fn = bcfg.bfname(BarSec);
+    const std::string bin_fn = md::BarBinFile::fname(csv_fn);
+    std::remove(bin_fn.c_str());
+    long long cnt = writeBars(bcfg, days);
+    printf("wrote %lld bars to %s\n", cnt, csv_fn.c_str());
+
+    const std::vector<int> barcnt {100, 1000, 10000};
+    for (auto n : barcnt) {
+        run(bcfg, n, loops, "csv");
+    }
+    md::BarBinFile::convert(csv_fn, bin_fn);
+    for (auto n : barcnt) {
+        run(bcfg, n, loops, "binary");
+    }
+    return 0;
+}
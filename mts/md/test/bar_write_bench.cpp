@@ -0,0 +1,141 @@
+#include "md_bar.h"
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * The stall of BarWriter::onOneSecond() writing the due bars of many
+ * symbols and bar periods at a second boundary, for:
+ *   old: csv line with snprintf, fprintf and fflush per bar, then the
+ *        BarRec parsed from the line, fwrite and fflush
+ *   csv: BarRec appended to the mapped binary file, csv line from
+ *        BarRec::toCSVLine(), one fflush per file
+ *   bin: BarRec appended to the mapped binary file only
+ * Files are written to the given directory, default /tmp/bar_write_bench.
+ */
+
+static const int BarSec[] = {1, 5, 60};
+static const int NumBarSec = sizeof(BarSec)/sizeof(int);
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+struct BarFile {
+    md::BarPrice bar;
+    FILE* fp;
+    FILE* bfp;
+    std::unique_ptr<md::BarBinWriter> bw;
+};
+
+static void run(char mode, int symbols, int seconds, const std::string& dir) {
+    std::vector<BarFile> files(symbols*NumBarSec);
+    for (int s=0; s<symbols; ++s) {
+        for (int k=0; k<NumBarSec; ++k) {
+            auto& f (files[s*NumBarSec+k]);
+            const std::string fn = dir + "/" + mode + "_" + std::to_string(s) + "_" + std::to_string(BarSec[k]) + "S.csv";
+            std::remove(fn.c_str());
+            std::remove(md::BarBinFile::fname(fn).c_str());
+            f.fp = (mode=='b')? nullptr : fopen(fn.c_str(), "at");
+            f.bfp = (mode=='o')? fopen(md::BarBinFile::fname(fn).c_str(), "ab") : nullptr;
+            if (mode != 'o') {
+                f.bw.reset(new md::BarBinWriter(md::BarBinFile::fname(fn)));
+            }
+        }
+    }
+
+    time_t t0 = time(nullptr);
+    t0 -= t0%60;
+    unsigned int seed = 7;
+    std::vector<double> px(symbols, 40.0);
+    std::vector<long long> stall;
+    for (time_t t = t0+1; t <= t0+seconds; ++t) {
+        // a few updates per symbol within the second
+        for (int s=0; s<symbols; ++s) {
+            for (int u=0; u<4; ++u) {
+                px[s] += 0.01*((int)(rand_r(&seed)%3)-1);
+                const long long upd_micro = (long long)(t-1)*1000000LL + (u+1)*200000LL;
+                const double bpx = px[s]-0.01, apx = px[s]+0.01;
+                for (int k=0; k<NumBarSec; ++k) {
+                    files[s*NumBarSec+k].bar.update(upd_micro, px[s], (u==3)?1:0, (u==3)?2:(u%2), bpx, 10+u, apx, 12-u);
+                }
+            }
+        }
+
+        const long long ns0 = now_ns();
+        for (int s=0; s<symbols; ++s) {
+            for (int k=0; k<NumBarSec; ++k) {
+                if (t % BarSec[k]) {
+                    continue;
+                }
+                auto& f (files[s*NumBarSec+k]);
+                if (mode == 'o') {
+                    const auto line = f.bar.writeAndRoll(t);
+                    fprintf(f.fp, "%s\n",line.c_str());
+                    fflush(f.fp);
+                    const md::BarRec rec(line);
+                    fwrite(&rec, sizeof(rec), 1, f.bfp);
+                    fflush(f.bfp);
+                    continue;
+                }
+                const md::BarRec rec = f.bar.writeAndRollRec(t);
+                f.bw->append(rec);
+                if (f.fp) {
+                    char line[256];
+                    size_t bytes = rec.toCSVLine(line);
+                    line[bytes++] = '\n';
+                    fwrite(line, 1, bytes, f.fp);
+                    fflush(f.fp);
+                }
+            }
+        }
+        stall.push_back(now_ns() - ns0);
+    }
+
+    for (auto& f : files) {
+        if (f.fp) fclose(f.fp);
+        if (f.bfp) fclose(f.bfp);
+    }
+
+    std::vector<long long> minute;
+    for (size_t i=59; i<stall.size(); i+=60) {
+        // the seconds with all of the bar periods due
+        minute.push_back(stall[i]);
+    }
+    auto stats = [](std::vector<long long>& v, const char* name) {
+        if (v.size() == 0) return;
+        std::sort(v.begin(), v.end());
+        double sum = 0;
+        for (auto x : v) sum += x;
+        printf("    %-7s mean: %.1f us, median: %.1f us, p99: %.1f us, max: %.1f us\n", name,
+                sum/v.size()/1000.0, v[v.size()/2]/1000.0, v[(size_t)(v.size()*0.99)]/1000.0, v.back()/1000.0);
+    };
+    printf("%s %d symbols x %d bar periods, %d seconds\n",
+            mode=='o'?"old":(mode=='c'?"csv":"bin"), symbols, NumBarSec, seconds);
+    stats(stall, "second");
+    stats(minute, "minute");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s mode[o/c/b/a] [symbols] [seconds] [dir]\n", argv[0]);
+        printf("  o: old csv and fflush per bar, c: csv with mapped binary, b: mapped binary only, a: all\n");
+        printf("  symbols default 50, seconds default 600, dir default /tmp/bar_write_bench\n");
+        return 0;
+    }
+    utils::PLCC::ToggleTest(true);
+    char mode = argv[1][0];
+    int symbols = (argc>2)? atoi(argv[2]) : 50;
+    int seconds = (argc>3)? atoi(argv[3]) : 600;
+    std::string dir = (argc>4)? std::string(argv[4]) : std::string("/tmp/bar_write_bench");
+    mkdir(dir.c_str(), 0755);
+    if (mode == 'a') {
+        run('o', symbols, seconds, dir);
+        run('c', symbols, seconds, dir);
+        run('b', symbols, seconds, dir);
+    } else {
+        run(mode, symbols, seconds, dir);
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "md_book_soa.h"
+#include <time.h>
+
+/*
+ * Compares the BookDepot (array of PriceEntry) and the BookSoA layout
+ * on a day of L2 updates, each followed by the queries of an algo:
+ * getMid(), isValidQuote(), getBid/getAsk with size, VWAP of 5 levels
+ * on both sides and the levels for a size.
+ *   delta: L2 deltas applied with BookL2 vs BookSoA, the tp side
+ *   book:  full books read as BookDepot, copied vs converted to BookSoA,
+ *          the algo side reading the BookQ
+ *   query: the queries alone on the books in each layout
+ * The day is either recorded, a file of BookDepot::toCSV() lines of all
+ * levels such as the booktap dump, or generated with the given updates.
+ * The config should have the symbol, i.e. the main.cfg written by br_test.
+ */
+
+// the queries of a book are repeated per update, keep the compiler
+// from reusing the results of the previous query
+#define QUERY_BARRIER() asm volatile("" ::: "memory")
+
+static const size_t QueryWindow = 64;
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+// generates a day of L2 deltas around a random walk mid, mostly
+// size updates of the top levels, with levels added and deleted
+static std::vector<md::L2Delta> genDay(int updates, md::BookL2& l2) {
+    std::vector<md::L2Delta> day;
+    unsigned int seed = 7;
+    double mid = 40.0;
+    for (int i=0; i<BookLevel; ++i) {
+        day.emplace_back(); day.back().newPrice(mid-0.01*(i+1), 10+i, i, true);
+        day.emplace_back(); day.back().newPrice(mid+0.01*(i+1), 10+i, i, false);
+    }
+    uint64_t ts = 1;
+    for (const auto& d : day) {
+        l2.updFromDelta(&d, ++ts);
+    }
+    while ((int)day.size() < updates) {
+        int r = rand_r(&seed);
+        bool is_bid = r&1;
+        int side = is_bid?0:1;
+        int levels = l2._book.avail_level[side];
+        int level = (r>>1)%4;
+        md::L2Delta d;
+        switch ((r>>4)%16) {
+        case 0:
+            // price moves away, the top level is deleted and one added at the end
+            d.delPrice(0, is_bid);
+            day.push_back(d);
+            l2.updFromDelta(&d, ++ts);
+            d.newPrice(l2._book.pe[side*BookLevel+levels-2].price + (is_bid?-0.01:0.01), 10, levels-1, is_bid);
+            break;
+        case 1:
+            // price moves in, a new top level with the last level deleted
+            d.delPrice(levels-1, is_bid);
+            day.push_back(d);
+            l2.updFromDelta(&d, ++ts);
+            d.newPrice(l2._book.pe[side*BookLevel].price + (is_bid?0.01:-0.01), 1+(r>>8)%5, 0, is_bid);
+            break;
+        case 2:
+            d.addTrade(l2._book.pe[(1-side)*BookLevel].price, 1+(r>>8)%5, side);
+            break;
+        default:
+            d.updPrice(l2._book.pe[side*BookLevel+level].price, 1+(r>>8)%50, level, is_bid);
+            break;
+        }
+        day.push_back(d);
+        l2.updFromDelta(&d, ++ts);
+    }
+    return day;
+}
+
+template<typename Book>
+static double query(const Book& b) {
+    md::Quantity bq=0, aq=0, q1=0, q2=0;
+    double sum = b.getMid();
+    sum += b.isValidQuote()? 1:0;
+    sum += b.getBid(&bq) + b.getAsk(&aq) + bq + aq;
+    const double bvwap = b.getVWAP(5, true, &q1), avwap = b.getVWAP(5, false, &q2);
+    return sum + (q1? bvwap:0) + (q2? avwap:0);
+}
+
+static int levelsForSize(const md::BookDepot& b, md::Quantity size, bool is_bid) {
+    const int side = is_bid?0:1;
+    int n = 0, cum = 0;
+    while ((n < b.avail_level[side]) && (cum < size)) {
+        cum += b.pe[side*BookLevel + n++].size;
+    }
+    return n;
+}
+
+static void report(const char* name, long long ns, int updates, double chk) {
+    printf("    %-6s %.1f ns per update with queries (%.0f)\n", name, (double)ns/updates, chk);
+}
+
+static void runDelta(const std::vector<md::L2Delta>& day, const md::BookConfig& bcfg, int queries) {
+    md::BookL2 l2(bcfg);
+    long long t0 = now_ns();
+    double chk = 0;
+    uint64_t ts = 0;
+    for (const auto& d : day) {
+        l2.updFromDelta(&d, ++ts);
+        for (int q=0; q<queries; ++q) {
+            chk += query(l2._book) + levelsForSize(l2._book, 20, q&1);
+            QUERY_BARRIER();
+        }
+    }
+    report("aos", now_ns()-t0, day.size(), chk);
+
+    md::BookSoA soa;
+    t0 = now_ns();
+    chk = 0; ts = 0;
+    for (const auto& d : day) {
+        soa.updFromDelta(&d, ++ts);
+        for (int q=0; q<queries; ++q) {
+            chk += query(soa) + soa.getLevelsForSize(20, q&1);
+            QUERY_BARRIER();
+        }
+    }
+    report("soa", now_ns()-t0, day.size(), chk);
+}
+
+static void runBook(const std::vector<md::BookDepot>& books, int queries) {
+    md::BookDepot book;
+    long long t0 = now_ns();
+    double chk = 0;
+    for (const auto& b : books) {
+        book = b;
+        for (int q=0; q<queries; ++q) {
+            chk += query(book) + levelsForSize(book, 20, q&1);
+            QUERY_BARRIER();
+        }
+    }
+    report("aos", now_ns()-t0, books.size(), chk);
+
+    md::BookSoA soa;
+    t0 = now_ns();
+    chk = 0;
+    for (const auto& b : books) {
+        soa.fromBookDepot(b);
+        for (int q=0; q<queries; ++q) {
+            chk += query(soa) + soa.getLevelsForSize(20, q&1);
+            QUERY_BARRIER();
+        }
+    }
+    report("soa", now_ns()-t0, books.size(), chk);
+}
+
+// the queries alone, on a window of the books already in each layout,
+// the window is the few books of the symbols an algo trades, in cache
+static void runQuery(const std::vector<md::BookDepot>& books, int queries) {
+    const size_t window = _MIN_(books.size(), (size_t)QueryWindow);
+    std::vector<md::BookSoA> soa_books;
+    for (size_t i=0; i<window; ++i) {
+        soa_books.emplace_back(books[i]);
+    }
+    const int rounds = _MAX_((int)(books.size()/window), 1);
+    const long long cnt = (long long)rounds*window*queries;
+
+    long long t0 = now_ns();
+    double chk = 0;
+    for (int r=0; r<rounds; ++r) {
+        for (size_t i=0; i<window; ++i) {
+            for (int q=0; q<queries; ++q) {
+                chk += query(books[i]) + levelsForSize(books[i], 20, q&1);
+                QUERY_BARRIER();
+            }
+        }
+    }
+    printf("    %-6s %.1f ns per query (%.0f)\n", "aos", (double)(now_ns()-t0)/cnt, chk);
+
+    t0 = now_ns();
+    chk = 0;
+    for (int r=0; r<rounds; ++r) {
+        for (size_t i=0; i<window; ++i) {
+            for (int q=0; q<queries; ++q) {
+                chk += query(soa_books[i]) + soa_books[i].getLevelsForSize(20, q&1);
+                QUERY_BARRIER();
+            }
+        }
+    }
+    printf("    %-6s %.1f ns per query (%.0f)\n", "soa", (double)(now_ns()-t0)/cnt, chk);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s main_config [updates|book_csv_file] [queries]\n", argv[0]);
+        printf("  updates default 2000000 generated, or a recorded day of BookDepot csv lines\n");
+        printf("  queries per update default 4\n");
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    md::BookConfig bcfg("", "WTI_N1", "L2");
+    const std::string day_arg = (argc>2)? std::string(argv[2]) : std::string("2000000");
+    const int queries = (argc>3)? atoi(argv[3]) : 4;
+
+    std::vector<md::L2Delta> day;
+    std::vector<md::BookDepot> books;
+    if (day_arg.find_first_not_of("0123456789") == std::string::npos) {
+        md::BookL2 l2(bcfg);
+        day = genDay(atoi(day_arg.c_str()), l2);
+        l2.reset();
+        for (const auto& d : day) {
+            l2.updFromDelta(&d, 1);
+            books.push_back(l2._book);
+        }
+    } else {
+        for (const auto& line : utils::CSVUtil::read_file(day_arg)) {
+            md::BookDepot b;
+            b.updateFrom(line);
+            books.push_back(b);
+        }
+    }
+    printf("BookSoA %d bytes, BookDepot %d bytes, %d queries per update\n",
+            (int)sizeof(md::BookSoA), (int)sizeof(md::BookDepot), queries);
+    if (day.size()) {
+        printf("delta: %d L2 updates\n", (int)day.size());
+        runDelta(day, bcfg, queries);
+    }
+    printf("book: %d books\n", (int)books.size());
+    runBook(books, queries);
+    printf("query: %d books\n", (int)_MIN_(books.size(), (size_t)QueryWindow));
+    runQuery(books, queries);
+    return 0;
+}
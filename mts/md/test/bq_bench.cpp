@@ -0,0 +1,94 @@
+#include "md_snap.h"
+#include <time.h>
+
+/*
+ * Compares the full and delta mode of BookQ on
+ * bytes per update and reader nanos per update,
+ * for a L1 (bbo only) and a L2 (5 levels) feed.
+ * The config should have the symbol, i.e. the main.cfg
+ * written by br_test.
+ */
+
+typedef md::BookQ<utils::CircularBuffer> BQType;
+
+// keep the batch less than the full queue length
+// so that the full mode reader doesn't overflow
+static const int Batch = 4096;
+
+static void writeL1(BQType::Writer& w, unsigned int& seed, uint64_t ts) {
+    int r = rand_r(&seed);
+    bool is_bid = r&1;
+    int sz = 1 + (r>>3)%20;
+    switch ((r>>8)%3) {
+    case 0: w.updBBO(40.0+(is_bid?-0.01:0.01)*(1+(r>>1)%3), sz, is_bid, ts); break;
+    case 1: w.updBBO(39.99, sz, 40.01, sz+1, ts); break;
+    default: w.updBBOSizeOnly(sz, is_bid, ts); break;
+    }
+}
+
+static void writeL2(BQType::Writer& w, unsigned int& seed, uint64_t ts) {
+    int r = rand_r(&seed);
+    bool is_bid = r&1;
+    int level = (r>>1)%5;
+    int sz = 1 + (r>>4)%20;
+    w.updPrice(40.0+(is_bid?-0.01:0.01)*(level+1), sz, level, is_bid, ts);
+}
+
+static void run(const char* feed, md::BookQMode mode, int count) {
+    md::BookConfig bcfg("", "WTI_N1", feed);
+    BQType bq(bcfg, false, true, mode);
+    auto& w(bq.theWriter());
+    auto r(bq.newReader());
+    bool is_l2 = (feed[1]=='2');
+
+    if (is_l2) {
+        // fill 5 levels each side
+        for (int i=0; i<5; ++i) {
+            w.newPrice(39.99-0.01*i, 10, i, true, 1);
+            w.newPrice(40.01+0.01*i, 10, i, false, 1);
+        }
+    } else {
+        w.updBBO(39.99, 10, 40.01, 10, 1);
+    }
+    md::BookDepot book;
+    while (r->getNextUpdate(book));
+
+    unsigned int seed = 7;
+    uint64_t ts = 2;
+    utils::QPos bytes0 = bq.getWriteBytes();
+    long long updates = 0, read_ns = 0;
+    for (int n=0; n<count; n+=Batch) {
+        for (int i=0; i<Batch; ++i) {
+            if (is_l2) {
+                writeL2(w, seed, ++ts);
+            } else {
+                writeL1(w, seed, ++ts);
+            }
+        }
+        timespec ts0, ts1;
+        clock_gettime(CLOCK_MONOTONIC, &ts0);
+        while (r->getNextUpdate(book)) {
+            ++updates;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts1);
+        read_ns += (ts1.tv_sec-ts0.tv_sec)*1000000000LL + (ts1.tv_nsec-ts0.tv_nsec);
+    }
+    long long bytes = (long long) (bq.getWriteBytes() - bytes0);
+    printf("%s %-5s updates: %lld, bytes/update: %.1f, reader ns/update: %.1f\n",
+            feed, mode==md::BookQ_Delta?"delta":"full",
+            updates, (double)bytes/_MAX_(updates,1LL), (double)read_ns/_MAX_(updates,1LL));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s config_file [update_count]\n", argv[0]);
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    int count = (argc>2)? atoi(argv[2]) : 1024*1024;
+    run("L1", md::BookQ_Full, count);
+    run("L1", md::BookQ_Delta, count);
+    run("L2", md::BookQ_Full, count);
+    run("L2", md::BookQ_Delta, count);
+    return 0;
+}
@@ -1,6 +1,9 @@
 #include "td_parser.h"
+#include "md_book_soa.h"
 #include "gtest/gtest.h"
 #include <fstream>
+#include <thread>
+#include <atomic>
 
 const char* CFGFile = "/tmp/main.cfg";
 const char* VENUEFile = "/tmp/venue.cfg";
@@ -68,6 +71,7 @@ public:
             std::ofstream ofs;
             ofs.open(_bcfg.bfname(_barsec), std::ofstream::out | std::ofstream::trunc);
         }
+        std::remove(md::BarBinFile::fname(_bcfg.bfname(_barsec)).c_str());
     }
 
     void writeBar(time_t t, double px ) {
@@ -305,6 +309,147 @@ TEST_F (BRFixture, ReadBackwardForward) {
     EXPECT_DOUBLE_EQ(barHist[9]->close, px-0.1);
 }
 
+TEST_F (BRFixture, BinaryBar) {
+    // bars with gaps and a non-trading period, read from csv and
+    // from the binary file should be the same
+    time_t utc_now = (time_t)utils::TimeUtil::string_to_frac_UTC("20201207-17:00:00",0);
+    double px = 40.01;
+    for (int b = -600; b <= 4200; b += 5) {
+        px += 0.01;
+        if ((b/5)%7 == 3) {
+            continue;
+        }
+        writeBar(utc_now + b, px);
+    }
+    const std::string csv_fn = _bcfg.bfname(_barsec);
+    const std::string bin_fn = md::BarBinFile::fname(csv_fn);
+    EXPECT_EQ(bin_fn.substr(bin_fn.size()-4), ".bin");
+
+    md::BarReader br (_bcfg, _barsec);
+    const std::vector<std::pair<int,int> > periods {
+        {-700, -500}, {-300, 0}, {-100, 3700}, {3600, 4300}, {-600, 4200}, {4200, 4400}
+    };
+    std::vector<std::vector<std::shared_ptr<md::BarPrice> > > csv_bars;
+    for (const auto& p : periods) {
+        std::vector<std::shared_ptr<md::BarPrice> > bars;
+        EXPECT_TRUE(br.readPeriod(bars, utc_now+p.first, utc_now+p.second));
+        csv_bars.push_back(bars);
+    }
+
+    // the csv history is seeded to a missing binary file, once
+    std::remove(bin_fn.c_str());
+    EXPECT_GT(md::BarBinFile::seed(csv_fn), 0);
+    EXPECT_EQ(md::BarBinFile::seed(csv_fn), 0);
+    EXPECT_EQ(md::BarBinFile(bin_fn).size(), utils::CSVUtil::read_file(csv_fn).size());
+
+    EXPECT_GT(md::BarBinFile::convert(csv_fn, bin_fn), 0);
+    {
+        md::BarBinFile bf(bin_fn);
+        EXPECT_TRUE(bf.valid());
+        EXPECT_EQ(bf.lowerBound(utc_now-600)->bar_time, utc_now-600);
+        EXPECT_EQ(bf.upperBound(utc_now+4200), bf.end());
+    }
+    for (size_t i=0; i<periods.size(); ++i) {
+        std::vector<std::shared_ptr<md::BarPrice> > bars;
+        EXPECT_TRUE(br.readPeriod(bars, utc_now+periods[i].first, utc_now+periods[i].second));
+        EXPECT_EQ(bars.size(), csv_bars[i].size());
+        for (size_t k=0; k<bars.size() && k<csv_bars[i].size(); ++k) {
+            EXPECT_EQ(bars[k]->toCSVLine(), csv_bars[i][k]->toCSVLine());
+        }
+    }
+
+    // a binary file with only the latest bars, i.e. not seeded, is not
+    // used for the periods before its first bar
+    {
+        std::remove(bin_fn.c_str());
+        md::BarBinWriter writer(bin_fn);
+        writer.append(md::BarPrice(csv_bars[4].back()->toCSVLine()).toBarRec());
+    }
+    for (size_t i=0; i<periods.size(); ++i) {
+        std::vector<std::shared_ptr<md::BarPrice> > bars;
+        EXPECT_TRUE(br.readPeriod(bars, utc_now+periods[i].first, utc_now+periods[i].second));
+        EXPECT_EQ(bars.size(), csv_bars[i].size());
+        for (size_t k=0; k<bars.size() && k<csv_bars[i].size(); ++k) {
+            EXPECT_EQ(bars[k]->toCSVLine(), csv_bars[i][k]->toCSVLine());
+        }
+    }
+
+    // the binary file is not used once the csv gets ahead
+    writeBar(utc_now + 4205, 60.0);
+    std::vector<std::shared_ptr<md::BarPrice> > bars;
+    EXPECT_TRUE(br.readPeriod(bars, utc_now+4200, utc_now+4205));
+    EXPECT_DOUBLE_EQ(bars.back()->close, 60.0);
+}
+
+TEST_F (BRFixture, BarRecWriter) {
+    // the BarRec of a bar and its csv line should be the same as
+    // the csv line written by the BarPrice
+    const auto& lines(utils::CSVUtil::read_file("tests/bar_test.csv"));
+    md::BarPrice bar;
+    char buf[256];
+    unsigned int seed = 3;
+    time_t bt = 0;
+    for (const auto& line: lines) {
+        bar.update(line);
+        if (rand_r(&seed)%7 == 0) {
+            bt = std::stoll(line[0])/1000000LL + 1;
+            const std::string csv_line (md::BarPrice(bar).writeAndRoll(bt));
+            const md::BarRec rec (bar.writeAndRollRec(bt));
+            rec.toCSVLine(buf);
+            EXPECT_EQ(std::string(buf), csv_line);
+            EXPECT_EQ(md::BarPrice(rec).toCSVLine(), md::BarPrice(csv_line).toCSVLine());
+        }
+    }
+    md::BarPrice neg(bt, -1.5, 0.25, -40.12345678, 123456.00000001, 1, 3, 0, -0.1, 0, 0, -0.0000004);
+    neg.toBarRec().toCSVLine(buf);
+    EXPECT_EQ(std::string(buf), neg.toCSVLine());
+
+    // the averages are rounded as "%.1f" and "%.6f", also on the ties
+    for (double v : {0.15, 0.25, 0.35, 2.5, 1.45, -0.25, 0.0000005, 0.0000015, 1.0000025}) {
+        for (int d : {1, 6}) {
+            snprintf(buf, sizeof(buf), "%.*f", d, v);
+            EXPECT_EQ(md::BarRec::roundFixed(v, d), strtod(buf, nullptr)) << v << " " << d;
+        }
+    }
+
+    // records written are read with refresh(), also after the
+    // writer extended the file
+    const std::string bin_fn ("/tmp/br_test_writer.bin");
+    std::remove(bin_fn.c_str());
+    const size_t cnt = md::BarBinWriter::ChunkRecs + 10;
+    {
+        md::BarBinWriter writer(bin_fn);
+        md::BarBinFile bf(bin_fn);
+        EXPECT_TRUE(bf.valid());
+        EXPECT_EQ(bf.size(), 0);
+        for (size_t i=0; i<cnt; ++i) {
+            md::BarRec rec;
+            rec.bar_time = (int64_t) i+1;
+            writer.append(rec);
+            if (i == 0) {
+                EXPECT_TRUE(bf.refresh());
+                EXPECT_EQ(bf.size(), 1);
+            }
+        }
+        EXPECT_FALSE(bf.refresh());
+        md::BarBinFile bf2(bin_fn);
+        EXPECT_EQ(bf2.size(), cnt);
+        EXPECT_EQ((bf2.end()-1)->bar_time, (int64_t)cnt);
+    }
+    {
+        // reopen to append
+        md::BarBinWriter writer(bin_fn);
+        EXPECT_EQ(writer.size(), cnt);
+        md::BarRec rec;
+        rec.bar_time = (int64_t) cnt+1;
+        writer.append(rec);
+    }
+    md::BarBinFile bf(bin_fn);
+    EXPECT_EQ(bf.size(), cnt+1);
+    EXPECT_EQ(bf.lowerBound(cnt)->bar_time, (int64_t)cnt);
+    std::remove(bin_fn.c_str());
+}
+
 TEST_F (BRFixture, Tickdata) {
     // case 1 the normal case
 
@@ -547,6 +692,482 @@ TEST_F (BRFixture, Tickdata) {
     std::remove(trade_file.c_str());
 }
 
+TEST_F (BRFixture, TickdataColumns) {
+    // the batch parseColumns() should give the same bars, bit for bit, as
+    // the BarPrice of parseDoubleArray(), which are the csv bars, on a
+    // random walk of quotes and trades with same milli ticks, swipes,
+    // crossed quotes and empty bars
+    const long long t0 = 1675281149882LL;
+    const double tick = 0.25;
+    unsigned int seed = 11;
+    std::vector<double> q, t;
+    long long ts = t0;
+    double bpx = 4126.5;
+    int spd = 1;
+    for (int i=0; i<20000; ++i) {
+        int r = rand_r(&seed);
+        if (r%7 != 0) {
+            // 0 to 3 milli, with gaps of seconds
+            ts += (r>>3)%4 + ((r>>5)%500==0? 3000:0);
+        }
+        if ((r>>8)%5 == 0) {
+            bpx += tick*((r>>11)%3-1);
+            spd = 1+(r>>13)%2;
+        }
+        double apx = bpx + tick*spd;
+        if ((r>>14)%200 == 0) {
+            apx = bpx; // crossed
+        }
+        q.insert(q.end(), {(double)ts, bpx, (double)(1+(r>>16)%30), apx, (double)(1+(r>>21)%30)});
+        if ((r>>26)%3 == 0) {
+            // trade on the quote, or a level through it
+            double px = ((r>>28)&1)? apx:bpx;
+            if ((r>>29)%4 == 0) {
+                px += ((r>>28)&1)? tick:-tick;
+            }
+            t.insert(t.end(), {(double)(ts+(r>>30)%2), px, (double)(1+(r>>17)%20)});
+        }
+    }
+    const size_t qlen = q.size()/5, tlen = t.size()/3;
+    const time_t utc_start = t0/1000+1;
+    const time_t utc_end = ts/1000+2;
+    const std::string out_csv = "/tmp/td_columns_test.csv";
+
+    for (int barsec : {1, 5, 60}) {
+        for (double tick_size : {0.0, tick}) {
+            md::TickData2Bar tp("", "", utc_start, utc_end, barsec, tick_size);
+            EXPECT_TRUE(tp.parseDoubleArray(q.data(), t.data(), qlen, tlen, out_csv));
+            std::vector<std::string> lines;
+            {
+                std::ifstream ifs(out_csv);
+                std::string line;
+                while (std::getline(ifs, line)) {
+                    lines.push_back(line);
+                }
+            }
+            std::vector<md::BarPrice> ref;
+            EXPECT_TRUE(tp.parseDoubleArray(q.data(), t.data(), qlen, tlen, ref));
+            ASSERT_EQ(ref.size(), lines.size());
+            for (size_t i=0; i<ref.size(); ++i) {
+                EXPECT_EQ(ref[i].toCSVLine(), lines[i]);
+            }
+
+            md::BarColumns bars;
+            EXPECT_TRUE(tp.parseColumns(q.data(), t.data(), qlen, tlen, bars));
+            ASSERT_EQ(bars.n, ref.size());
+            ASSERT_GT(bars.n, 0);
+            size_t diff = 0;
+            long long qcnt = 0, tcnt = 0;
+            for (size_t i=0; i<bars.n; ++i) {
+                const auto& b (ref[i]);
+                const long long due_micro = (long long)b.bar_time*1000000LL;
+                const double expected[md::BarColumns::QuoteCnt] = {
+                    (double)b.bar_time, b.open, b.high, b.low, b.close,
+                    (double)((long long)b.bvol+b.svol), b.last_price, (double)b.last_micro,
+                    (double)((long long)b.bvol-b.svol), b.avg_bsz(due_micro), b.avg_asz(due_micro),
+                    b.avg_spd(due_micro), (double)b.bqd, (double)b.aqd,
+                    (double)b.swipe_vol(), (double)b.unmatched_vol()
+                };
+                for (int c=0; c<md::BarColumns::QuoteCnt; ++c) {
+                    const double v = bars.get(i, c);
+                    if (memcmp(&v, &expected[c], sizeof(double)) != 0) {
+                        if (diff++ < 3) {
+                            ADD_FAILURE() << "barsec " << barsec << " bar " << i << " col " << c
+                                          << ": " << v << " vs " << expected[c];
+                        }
+                    }
+                }
+                qcnt += (long long)bars.get(i, md::BarColumns::QuoteCnt);
+                tcnt += (long long)bars.get(i, md::BarColumns::TradeCnt);
+            }
+            EXPECT_EQ(diff, 0);
+            EXPECT_GT(qcnt, 0);
+            EXPECT_GT(tcnt, 0);
+        }
+    }
+    std::remove(out_csv.c_str());
+}
+
+TEST_F (BRFixture, BookQDelta) {
+    // same updates written to a full and a delta BookQ,
+    // the delta reader should rebuild the same books
+    using BQ = md::BookQ<utils::CircularBuffer>;
+    BQ bq_full (_bcfg, false, true, md::BookQ_Full);
+    BQ bq_delta(_bcfg, false, true, md::BookQ_Delta);
+    auto& wf (bq_full.theWriter());
+    auto& wd (bq_delta.theWriter());
+    auto rf (bq_full.newReader());
+    auto rd (bq_delta.newReader());
+
+    md::BookDepot bf, bd;
+    unsigned int seed = 7;
+    long long ts = 1675198786000000LL;
+    int cnt = 0;
+    for (int i=0; i<3000; ++i) {
+        int r = rand_r(&seed);
+        bool is_bid = r&1;
+        double px = 40.0 + (is_bid? -0.01: 0.01)*(1+(r>>1)%3);
+        int sz = 1 + (r>>3)%20;
+        ++ts;
+        switch ((r>>8)%4) {
+        case 0 : wf.updBBO(px, sz, is_bid, ts); wd.updBBO(px, sz, is_bid, ts); break;
+        case 1 : wf.updBBO(39.99, sz, 40.01, sz+1, ts); wd.updBBO(39.99, sz, 40.01, sz+1, ts); break;
+        case 2 : wf.updBBOSizeOnly(sz, is_bid, ts); wd.updBBOSizeOnly(sz, is_bid, ts); break;
+        case 3 :
+            {
+                // trade has the current time
+                const auto& bk (*wf.getSnap());
+                wf.updTradeFromL1(px, sz, bk); wd.updTradeFromL1(px, sz, bk);
+                break;
+            }
+        }
+        while (rf->getNextUpdate(bf)) {
+            EXPECT_TRUE(rd->getNextUpdate(bd));
+            if (bf.update_type == 2) {
+                // trades are stamped by the writers at different times
+                bd.update_ts_micro = bf.update_ts_micro;
+            }
+            EXPECT_EQ(memcmp((char*)&bf, (char*)&bd, sizeof(md::BookDepot)), 0);
+            ++cnt;
+        }
+        EXPECT_FALSE(rd->getNextUpdate(bd));
+    }
+    EXPECT_GT(cnt, 1000);
+
+    // a new reader syncs to the latest book
+    auto rd2 (bq_delta.newReader());
+    EXPECT_TRUE(rd2->getLatestUpdate(bd));
+    EXPECT_EQ(memcmp((char*)wd.getSnap(), (char*)&bd, sizeof(md::BookDepot)), 0);
+
+    // overflow the delta queue, reader should resync from a snapshot
+    for (int i=0; i<BQ::DeltaQLen/BQ::DeltaLen + 100; ++i) {
+        wd.updBBOSizeOnly(1 + i%10, i%2, ++ts);
+    }
+    EXPECT_TRUE(rd->getNextUpdate(bd));
+    EXPECT_EQ(memcmp((char*)wd.getSnap(), (char*)&bd, sizeof(md::BookDepot)), 0);
+    EXPECT_FALSE(rd->getNextUpdate(bd));
+}
+
+TEST_F (BRFixture, BookQReadBatch) {
+    // batches read the same updates as getNextUpdate(),
+    // across the wrap point of the queue and after an overflow
+    using BQ = md::BookQ<utils::CircularBuffer>;
+    for (auto mode : {md::BookQ_Full, md::BookQ_Delta}) {
+        BQ bq (_bcfg, false, true, mode);
+        auto& w (bq.theWriter());
+        auto r1 (bq.newReader());
+        auto rb (bq.newReader());
+
+        std::vector<md::BookDepot> batch(100);
+        md::BookDepot bk;
+        unsigned int seed = 11;
+        long long ts = 1675198786000000LL;
+        int cnt = 0;
+        while (cnt < 3*BQ::QLen/BQ::BookLen) {
+            const int n = 1 + rand_r(&seed)%300;
+            for (int i=0; i<n; ++i) {
+                w.updBBO(40.0 - 0.01*(i%3), 1 + i%20, 40.01 + 0.01*(i%2), 1 + i%7, ++ts);
+            }
+            int k;
+            while ((k = rb->readBatch(batch.data(), (int)batch.size())) > 0) {
+                EXPECT_LE(k, (int)batch.size());
+                for (int i=0; i<k; ++i) {
+                    EXPECT_TRUE(r1->getNextUpdate(bk));
+                    EXPECT_EQ(memcmp((char*)&bk, (char*)&batch[i], sizeof(md::BookDepot)), 0);
+                }
+                cnt += k;
+            }
+            EXPECT_FALSE(r1->getNextUpdate(bk));
+        }
+
+        // overflow, the batches catch up and end at the latest book
+        const int qlen = (mode == md::BookQ_Full)? BQ::QLen/BQ::BookLen : BQ::DeltaQLen/BQ::DeltaLen;
+        for (int i=0; i<qlen + 100; ++i) {
+            w.updBBOSizeOnly(1 + i%10, i%2, ++ts);
+        }
+        int k, last = 0;
+        while ((k = rb->readBatch(batch.data(), (int)batch.size())) > 0) {
+            last = k;
+        }
+        EXPECT_GT(last, 0);
+        EXPECT_EQ(memcmp((char*)w.getSnap(), (char*)&batch[last-1], sizeof(md::BookDepot)), 0);
+    }
+}
+
+TEST_F (BRFixture, BookSoA) {
+    // same random L2 updates to a BookL2 and a BookSoA,
+    // the queries and the converted BookDepot should match
+    md::BookL2 l2(_bcfg);
+    md::BookSoA soa;
+    const md::BookDepot& book (l2._book);
+    unsigned int seed = 11;
+    long long ts = 1675198786000000LL;
+    for (int i=0; i<20000; ++i) {
+        int r = rand_r(&seed);
+        bool is_bid = r&1;
+        const int side = is_bid?0:1;
+        const int levels = book.avail_level[side];
+        // about 1/8 of the sizes are zero
+        int sz = (r>>3)%8? 1 + (r>>6)%20 : 0;
+        double px = 40.0 + (is_bid? -0.01: 0.01)*(1+(r>>11)%12);
+        ++ts;
+        md::L2Delta delta;
+        switch ((r>>16)%6) {
+        case 0 :
+        case 1 : delta.newPrice(px, sz, levels? (r>>20)%(levels+1):0, is_bid); break;
+        case 2 : delta.delPrice(levels? (r>>20)%levels:0, is_bid); break;
+        case 5 : delta.addTrade(px, 1+sz, side); break;
+        default: delta.updPrice(px, sz, levels? (r>>20)%levels:0, is_bid); break;
+        }
+        if ((delta.type==1) && (levels>=BookLevel)) {
+            delta.delPrice(levels-1, is_bid);
+        }
+        EXPECT_EQ(l2.updFromDelta(&delta, ts), soa.updFromDelta(&delta, ts));
+
+        md::Quantity q1=0, q2=0;
+        EXPECT_DOUBLE_EQ(book.getBid(), soa.getBid());
+        EXPECT_DOUBLE_EQ(book.getAsk(), soa.getAsk());
+        EXPECT_DOUBLE_EQ(book.getBid(&q1), soa.getBid(&q2));
+        EXPECT_EQ(q1, q2);
+        EXPECT_DOUBLE_EQ(book.getAsk(&q1), soa.getAsk(&q2));
+        EXPECT_EQ(q1, q2);
+        EXPECT_DOUBLE_EQ(book.getMid(), soa.getMid());
+        EXPECT_EQ(book.isValidQuote(), soa.isValidQuote());
+        EXPECT_EQ(book.getBestBidPE().toString(), soa.getBestBidPE().toString());
+        EXPECT_EQ(book.getBestAskPE().toString(), soa.getBestAskPE().toString());
+        for (int lvl=1; lvl<=BookLevel; lvl+=4) {
+            double v1 = book.getVWAP(lvl, is_bid, &q1);
+            double v2 = soa.getVWAP(lvl, is_bid, &q2);
+            EXPECT_EQ(q1, q2);
+            if (q1) {
+                EXPECT_NEAR(v1, v2, 1e-10);
+            }
+        }
+
+        // levels for size and price level, against the scalar loops
+        const int tgt = 1 + (r>>24)%60;
+        int cum = 0, n = 0;
+        while ((n < book.avail_level[side]) && (cum < tgt)) {
+            cum += book.pe[side*BookLevel + n++].size;
+        }
+        EXPECT_EQ(n, soa.getLevelsForSize(tgt, is_bid, &q2));
+        int ref_cum = 0;
+        for (int k=0; k<n; ++k) ref_cum += book.pe[side*BookLevel+k].size;
+        EXPECT_EQ(ref_cum, q2);
+        int better = 0;
+        for (int k=0; k<book.avail_level[side]; ++k) {
+            const double p = book.pe[side*BookLevel+k].price;
+            better += is_bid? (p > px+1e-10) : (p < px-1e-10);
+        }
+        EXPECT_EQ(better, soa.getPriceLevel(px, is_bid));
+
+        md::BookDepot bd;
+        soa.toBookDepot(bd);
+        for (int s=0; s<2; ++s) {
+            EXPECT_EQ(book.avail_level[s], bd.avail_level[s]);
+            for (int k=0; k<book.avail_level[s]; ++k) {
+                const auto& pe1 (book.pe[s*BookLevel+k]);
+                const auto& pe2 (bd.pe[s*BookLevel+k]);
+                EXPECT_TRUE((pe1.price==pe2.price) && (pe1.size==pe2.size) && (pe1.ts_micro==pe2.ts_micro));
+            }
+        }
+        EXPECT_EQ(0, memcmp(&book.l2_delta, &bd.l2_delta, sizeof(md::L2Delta)));
+        if (book.update_type == 2) {
+            EXPECT_EQ(book.bvol_cum, bd.bvol_cum);
+            EXPECT_EQ(book.svol_cum, bd.svol_cum);
+        }
+    }
+
+    // round trip from the BookDepot, and the level search on a sorted book
+    md::BookL2 l2s(_bcfg);
+    for (int k=0; k<BookLevel; ++k) {
+        l2s.newPrice(39.99-0.01*k, (k==0)?0:k, k, true, ts);
+        l2s.newPrice(40.01+0.01*k, k+1, k, false, ts);
+    }
+    md::BookSoA soa2(l2s._book);
+    md::BookDepot bd2;
+    soa2.toBookDepot(bd2);
+    EXPECT_EQ(0, memcmp(l2s._book.pe, bd2.pe, sizeof(bd2.pe)));
+    EXPECT_DOUBLE_EQ(39.98, soa2.getBid());
+    EXPECT_EQ(3, soa2.findLevel(39.96, true));
+    EXPECT_EQ(-1, soa2.findLevel(39.955, true));
+    EXPECT_EQ(9, soa2.findLevel(40.10, false));
+    EXPECT_EQ(10, soa2.getPriceLevel(40.2, false));
+    EXPECT_EQ(0, soa2.getPriceLevel(40.0, true));
+}
+
+TEST_F (BRFixture, LVC) {
+    {
+        // ids are claimed once per key, another process finds the same
+        const char* shm = "/mts_lvc_test";
+        shm_unlink(shm);
+        md::LVC lvc(shm);
+        int id1 = lvc.id("NYM_CLQ1"), id2 = lvc.id("ICE_BRNQ1");
+        EXPECT_GE(id1, 0);
+        EXPECT_NE(id1, id2);
+        EXPECT_EQ(id1, lvc.id("NYM_CLQ1"));
+        md::LVC tap(shm, true);
+        EXPECT_EQ(tap.find("ICE_BRNQ1"), id2);
+        EXPECT_EQ(tap.find("NYM_CLQ2"), -1);
+        EXPECT_EQ(tap.id("NYM_CLQ2"), -1);
+
+        // not written yet
+        md::LVCRec rec;
+        EXPECT_FALSE(tap.read(id1, rec));
+
+        md::BookDepot bk;
+        bk.update_ts_micro = 1675198786000001ULL;
+        bk.pe[0] = md::PriceEntry(39.99, 3, 1, bk.update_ts_micro);
+        bk.pe[BookLevel] = md::PriceEntry(40.01, 5, 1, bk.update_ts_micro);
+        bk.avail_level[0] = bk.avail_level[1] = 1;
+        bk.trade_price = 40.01;
+        bk.trade_size = 2;
+        bk.bvol_cum = 2;
+        lvc.update(id1, bk);
+        EXPECT_TRUE(tap.read(id1, rec));
+        EXPECT_EQ(rec.seq, 2u);
+        EXPECT_EQ(rec.update_ts_micro, bk.update_ts_micro);
+        EXPECT_EQ(rec.trade_size, 2);
+        EXPECT_EQ(rec.bvol_cum, 2);
+        double bp, ap;
+        int bs, as;
+        EXPECT_TRUE(tap.getBBO(id1, bp, bs, ap, as));
+        EXPECT_DOUBLE_EQ(bp, 39.99);
+        EXPECT_DOUBLE_EQ(ap, 40.01);
+        EXPECT_EQ(bs, 3);
+        EXPECT_EQ(as, 5);
+        EXPECT_FALSE(tap.read(id2, rec));
+
+        // a reader never sees a record torn between updates
+        std::atomic<bool> done(false);
+        std::thread writer([&]() {
+            md::BookDepot b;
+            b.avail_level[0] = b.avail_level[1] = 1;
+            for (int i=1; i<=200000; ++i) {
+                b.pe[0] = md::PriceEntry(40.0-0.01*(i%7), i, 1, i);
+                b.pe[BookLevel] = md::PriceEntry(40.0+0.01*(i%7), i, 1, i);
+                b.update_ts_micro = i;
+                b.trade_size = i;
+                lvc.update(id2, b);
+            }
+            done = true;
+        });
+        int reads = 0;
+        while (!done) {
+            if (tap.read(id2, rec)) {
+                const int i = (int)rec.update_ts_micro;
+                EXPECT_EQ(rec.bid.size, i);
+                EXPECT_EQ(rec.ask.size, i);
+                EXPECT_EQ(rec.trade_size, i);
+                EXPECT_TRUE(double_eq(rec.ask.price-40.0, 40.0-rec.bid.price));
+                ++reads;
+            }
+        }
+        writer.join();
+        EXPECT_TRUE(tap.read(id2, rec));
+        EXPECT_EQ(rec.trade_size, 200000);
+        EXPECT_EQ(rec.seq, 400000u);
+
+        // a writer died in the middle of an update, the readers give up
+        // and the next writer takes the record over
+        int fd = shm_open(shm, O_RDWR, 0);
+        ASSERT_NE(fd, -1);
+        char* seg = (char*)mmap(NULL, lvc.size(), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        ASSERT_NE(seg, MAP_FAILED);
+        uint32_t* seq = (uint32_t*)(seg + lvc.size() - sizeof(md::LVCRec)*(md::LVC::MaxSymbols-id1));
+        EXPECT_EQ(*seq, 2u);
+        *seq = 3;
+        EXPECT_FALSE(tap.read(id1, rec));
+        bk.trade_size = 5;
+        lvc.update(id1, bk);
+        EXPECT_TRUE(tap.read(id1, rec));
+        EXPECT_EQ(rec.seq, 6u);
+        EXPECT_EQ(rec.trade_size, 5);
+        munmap(seg, lvc.size());
+        ::close(fd);
+        shm_unlink(shm);
+    }
+    {
+        // the tp's BookQ writer updates the cache, read by getBBO()
+        md::BookQType bq(_bcfg, false, true);
+        auto& w (bq.theWriter());
+        w.updBBO(39.98, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+        w.updTrade(40.02, 4);
+        const int id = md::LVCId("WTI_N1");
+        ASSERT_GE(id, 0);
+        EXPECT_EQ(id, md::LVC::get().find(md::LVC::key(_bcfg)));
+        md::LVCRec rec;
+        EXPECT_TRUE(md::LVC::get().read(id, rec));
+        EXPECT_DOUBLE_EQ(rec.trade_price, 40.02);
+        EXPECT_EQ(rec.trade_size, 4);
+        double bp, ap;
+        int bs, as;
+        EXPECT_TRUE(md::getBBO("WTI_N1", bp, bs, ap, as));
+        EXPECT_DOUBLE_EQ(bp, 39.98);
+        EXPECT_DOUBLE_EQ(ap, 40.02);
+        EXPECT_EQ(bs, 7);
+        EXPECT_EQ(as, 9);
+        md::PriceEntry bpe, ape;
+        EXPECT_TRUE(md::getBBOPriceEntry("WTI_N1", bpe, ape));
+        EXPECT_EQ(bpe.size, 7);
+        EXPECT_DOUBLE_EQ(ape.price, 40.02);
+        shm_unlink(bq._q_name.c_str());
+    }
+}
+
+TEST_F (BRFixture, BookQRegistry) {
+    auto& reg (md::BookQRegistry::get());
+    reg.clear();
+    md::BookDepot bk;
+    {
+        // the queue is attached once, the kept reader sees new updates
+        md::BookQType bq(_bcfg, false, true);
+        bq.theWriter().updBBO(39.98, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.98);
+        EXPECT_EQ(reg.size(), 1u);
+        bq.theWriter().updBBO(39.97, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.97);
+        EXPECT_EQ(reg.size(), 1u);
+
+        // the tp re-creates the queue, seen after the check interval
+        shm_unlink(bq._q_name.c_str());
+        md::BookQType bq2(_bcfg, false, true);
+        bq2.theWriter().updBBO(39.90, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.97);
+        utils::TimeUtil::micro_sleep(md::BookQRegistry::CheckIntervalMicro + 100000);
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.90);
+        EXPECT_EQ(reg.size(), 1u);
+
+        // re-initialized in place by a restarted tp
+        md::BookQType bq3(_bcfg, false, true);
+        EXPECT_FALSE(md::LatestBook("WTI_N1", "L1", bk));
+        bq3.theWriter().updBBO(39.95, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.95);
+
+        // a simulation thread reads the queue of its provider
+        std::thread th([&]() {
+                md::BookConfig::threadProvider() = "simreg";
+                md::BookQType bqs(md::BookConfig("WTI_N1", "L1"), false, true);
+                bqs.theWriter().updBBO(39.50, 7, 40.02, 9, utils::TimeUtil::cur_micro());
+                md::BookDepot bks;
+                EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bks));
+                EXPECT_DOUBLE_EQ(bks.getBid(), 39.50);
+                shm_unlink(bqs._q_name.c_str());
+            });
+        th.join();
+        EXPECT_EQ(reg.size(), 2u);
+        EXPECT_TRUE(md::LatestBook("WTI_N1", "L1", bk));
+        EXPECT_DOUBLE_EQ(bk.getBid(), 39.95);
+        shm_unlink(bq3._q_name.c_str());
+    }
+    reg.clear();
+    EXPECT_EQ(reg.size(), 0u);
+}
 
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,102 @@
+#include "md_bar.h"
+#include <time.h>
+
+/*
+ * Catch up time of a L2 BookQ reader after a 1 second stall, reading
+ * one update at a time with getNextUpdate() and in batches with
+ * readBatch(), each update applied to a bar as the BarWriter does.
+ * The writer keeps writing at rate updates per second during the stall,
+ * at rates over the queue length, 8192, the reader overflows and
+ * catches up from the oldest update still in the queue.
+ * The config should have the symbol, i.e. the main.cfg
+ * written by br_test.
+ */
+
+typedef md::BookQ<utils::CircularBuffer> BQType;
+
+static const int Rounds = 50;
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static void writeL2(BQType::Writer& w, unsigned int& seed, uint64_t ts) {
+    int r = rand_r(&seed);
+    bool is_bid = r&1;
+    int level = (r>>1)%5;
+    int sz = 1 + (r>>4)%20;
+    w.updPrice(40.0+(is_bid?-0.01:0.01)*(level+1), sz, level, is_bid, ts);
+}
+
+// batch 0 for getNextUpdate()
+static void run(int rate, int batch) {
+    md::BookConfig bcfg("", "WTI_N1", "L2");
+    BQType bq(bcfg, false, true, md::BookQ_Full);
+    auto& w(bq.theWriter());
+    auto r(bq.newReader());
+    for (int i=0; i<5; ++i) {
+        w.newPrice(39.99-0.01*i, 10, i, true, 1);
+        w.newPrice(40.01+0.01*i, 10, i, false, 1);
+    }
+    md::BookDepot book;
+    while (r->getNextUpdate(book));
+
+    std::vector<md::BookDepot> buf(_MAX_(batch, 1));
+    md::BarPrice bar;
+    bar.set_tick_size(0.01);
+    unsigned int seed = 7;
+    uint64_t ts = 2;
+    long long updates = 0, total_ns = 0, max_ns = 0;
+    for (int k=0; k<Rounds; ++k) {
+        // the stall
+        for (int i=0; i<rate; ++i) {
+            writeL2(w, seed, ++ts);
+        }
+        const long long t0 = now_ns();
+        if (batch) {
+            int n;
+            while ((n = r->readBatch(buf.data(), batch)) > 0) {
+                for (int i=0; i<n; ++i) {
+                    bar.update(buf[i]);
+                }
+                updates += n;
+            }
+        } else {
+            while (r->getNextUpdate(book)) {
+                bar.update(book);
+                ++updates;
+            }
+        }
+        const long long ns = now_ns() - t0;
+        total_ns += ns;
+        max_ns = _MAX_(max_ns, ns);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), batch? "readBatch %d" : "getNextUpdate", batch);
+    printf("rate %6d/s %-14s catch up us mean %8.1f max %8.1f  updates/stall %6lld  ns/update %5.1f\n",
+            rate, name, total_ns/1000.0/Rounds, max_ns/1000.0, updates/Rounds,
+            (double)total_ns/_MAX_(updates, 1LL));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s config_file [rate...]\n", argv[0]);
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    std::vector<int> rates;
+    for (int i=2; i<argc; ++i) {
+        rates.push_back(atoi(argv[i]));
+    }
+    if (!rates.size()) {
+        rates = {2000, 8000, 50000};
+    }
+    for (int rate : rates) {
+        for (int batch : {0, 16, 64, 256}) {
+            run(rate, batch);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "md_snap.h"
+#include <fstream>
+#include <memory>
+#include <time.h>
+
+/*
+ * A RiskMonitor MTM valuation of positions in 100 symbols, with the
+ * prices from
+ *   latest:  LatestBook() per symbol, the BookQ attached and the
+ *            BookDepot copied out on each call, as getBBO() without
+ *            the cache
+ *   readers: a BookQ reader kept per symbol, getLatestUpdate()
+ *   lvc:     the last value cache, an LVCRec per symbol
+ * Writes its own config of 100 tradables to /tmp/lvc_bench_*.cfg and
+ * the L1 BookQ of each, removed at the end.
+ */
+
+static const int Symbols = 100;
+static const char* CFGFile = "/tmp/lvc_bench_main.cfg";
+static const char* VENUEFile = "/tmp/lvc_bench_venue.cfg";
+
+static std::string tradable(int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "S%03dQ1", i);
+    return std::string(buf);
+}
+
+static void setupCfg() {
+    {
+        std::ofstream ofs (CFGFile, std::ofstream::out | std::ofstream::trunc);
+        ofs << "Logger = /tmp/log" << std::endl;
+        ofs << "SymbolMap = " << VENUEFile << std::endl;
+    }
+    std::ofstream ofs (VENUEFile, std::ofstream::out | std::ofstream::trunc);
+    ofs << "tradable = {\n";
+    for (int i=0; i<Symbols; ++i) {
+        ofs << "    " << tradable(i) << " = {\n";
+        ofs << "        symbol = S" << i << "\n";
+        ofs << "        exch_symbol = S" << i << "\n";
+        ofs << "        venue = NYM\n";
+        ofs << "        tick_size = 0.010000000000\n";
+        ofs << "        point_value = 1000.0\n";
+        ofs << "        px_multiplier = 0.010000000000\n";
+        ofs << "        type = FUT\n";
+        ofs << "        mts_contract = S" << i << "_202108\n";
+        ofs << "        contract_month = 202108\n";
+        ofs << "        mts_symbol = S" << i << "_N1\n";
+        ofs << "        N = 1\n";
+        ofs << "        expiration_days = 11\n";
+        ofs << "        tt_security_id = " << 1000+i << "\n";
+        ofs << "        tt_venue = CME\n";
+        ofs << "        currency = USD\n";
+        ofs << "        expiration_date = 2021-07-20\n";
+        ofs << "        bbg_id = " << tradable(i) << " COMDTY\n";
+        ofs << "        bbg_px_multiplier = 1.0\n";
+        ofs << "        tickdata_id = " << tradable(i) << "\n";
+        ofs << "        tickdata_px_multiplier = 1.000000000000\n";
+        ofs << "        tickdata_timezone = America/New_York\n";
+        ofs << "        lotspermin = 40\n";
+        ofs << "    }\n";
+    }
+    ofs << "}\n";
+    ofs << "venue = {" << std::endl;
+    ofs << "NYM   = { hours = [ -6, 0, 17, 0 ]   } " << std::endl;
+    ofs << "}" << std::endl;
+    utils::PLCC::setConfigPath(CFGFile);
+}
+
+static uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+// mtm of a long position of 1+i lots valued at the bid
+template<typename GetBBO>
+static double mtm(const std::vector<std::string>& sym, GetBBO&& get_bbo) {
+    double val = 0;
+    for (int i=0; i<(int)sym.size(); ++i) {
+        double bp, ap;
+        int bs, as;
+        if (get_bbo(i, bp, bs, ap, as)) {
+            val += (1+i)*bp*1000.0;
+        }
+    }
+    return val;
+}
+
+template<typename GetBBO>
+static void run(const char* name, const std::vector<std::string>& sym, int rounds, GetBBO&& get_bbo) {
+    double chk = mtm(sym, get_bbo);
+    const uint64_t t0 = mono_ns();
+    for (int r=0; r<rounds; ++r) {
+        chk += mtm(sym, get_bbo);
+    }
+    const double ns = (double)(mono_ns()-t0)/rounds;
+    printf("%-8s mtm of %d symbols: %10.1f us, %8.1f ns/symbol (%.0f)\n",
+            name, (int)sym.size(), ns/1000.0, ns/sym.size(), chk/(rounds+1));
+}
+
+int main(int argc, char** argv) {
+    const int rounds = (argc>1)? atoi(argv[1]) : 1000;
+    setupCfg();
+
+    // the tp's writers, one L1 BookQ per symbol
+    std::vector<std::string> sym;
+    std::vector<std::shared_ptr<md::BookQType>> bqs;
+    for (int i=0; i<Symbols; ++i) {
+        sym.push_back(tradable(i));
+        md::BookConfig bcfg(sym.back(), "L1");
+        bqs.emplace_back(new md::BookQType(bcfg, false, true));
+        bqs.back()->theWriter().updBBO(40.0+i-0.01, 10+i, 40.0+i+0.01, 20+i, utils::TimeUtil::cur_micro());
+    }
+
+    run("latest", sym, rounds, [&sym](int i, double& bp, int& bs, double& ap, int& as) {
+            md::BookDepot book;
+            if (!md::LatestBook(sym[i], "L1", book)) {
+                return false;
+            }
+            bp = book.getBid(&bs);
+            ap = book.getAsk(&as);
+            return true;
+        });
+
+    std::vector<std::shared_ptr<md::BookQReader>> readers;
+    for (const auto& bq : bqs) {
+        readers.push_back(bq->newReader());
+    }
+    run("readers", sym, rounds*10, [&readers](int i, double& bp, int& bs, double& ap, int& as) {
+            md::BookDepot book;
+            if (!readers[i]->getLatestUpdate(book)) {
+                return false;
+            }
+            bp = book.getBid(&bs);
+            ap = book.getAsk(&as);
+            return true;
+        });
+
+    std::vector<int> ids;
+    for (const auto& s : sym) {
+        ids.push_back(md::LVCId(s));
+    }
+    run("lvc", sym, rounds*100, [&ids](int i, double& bp, int& bs, double& ap, int& as) {
+            return md::LVC::get().getBBO(ids[i], bp, bs, ap, as);
+        });
+    run("getBBO", sym, rounds*10, [&sym](int i, double& bp, int& bs, double& ap, int& as) {
+            return md::getBBO(sym[i], bp, bs, ap, as);
+        });
+
+    for (const auto& bq : bqs) {
+        shm_unlink(bq->_q_name.c_str());
+    }
+    return 0;
+}
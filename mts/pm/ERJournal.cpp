@@ -0,0 +1,257 @@
+#include "ERJournal.h"
+#include "plcc/PLCC.hpp"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace pm {
+    std::string ERJournal::fname(const std::string& er_persist_file) {
+        const std::string ext(".csv");
+        if (er_persist_file.size() > ext.size() &&
+            er_persist_file.compare(er_persist_file.size()-ext.size(), ext.size(), ext) == 0) {
+            return er_persist_file.substr(0, er_persist_file.size()-ext.size()) + ".bin";
+        }
+        return er_persist_file + ".bin";
+    }
+
+    class ERJournal::Writer {
+    public:
+        explicit Writer(const std::string& journal_file)
+        : m_fname(journal_file), m_fd(-1), m_should_run(true), m_good(true), m_queued(0), m_written(0)
+        {
+            m_fd = open();
+            m_thread = std::thread([this] { run(); });
+        }
+
+        ~Writer() {
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_should_run = false;
+            }
+            m_cv.notify_one();
+            m_thread.join();
+            if (m_fd >= 0) {
+                close(m_fd);
+            }
+        }
+
+        bool put(const ExecutionReport& er) {
+            // queued even if the journal is not open, the writer retries
+            bool notify, is_open;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                notify = (m_pending.size() == 0);
+                m_pending.emplace_back();
+                m_pending.back().er = er;
+                ++m_queued;
+                is_open = (m_fd >= 0);
+            }
+            // the writer only waits with nothing pending
+            if (notify) {
+                m_cv.notify_one();
+            }
+            return is_open;
+        }
+
+        bool flush() {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            const uint64_t target = m_queued;
+            m_done_cv.wait(lock, [this, target] { return m_written >= target; });
+            const bool ret = m_good;
+            m_good = true;
+            return ret;
+        }
+
+    private:
+        const std::string m_fname;
+        int m_fd;
+        bool m_should_run;
+        bool m_good;
+        uint64_t m_queued, m_written;
+        std::vector<Record> m_pending;
+        std::mutex m_mtx;
+        std::condition_variable m_cv, m_done_cv;
+        std::thread m_thread;
+
+        int open() const {
+            int fd = ::open(m_fname.c_str(), O_RDWR|O_CREAT, 0644);
+            if (fd < 0) {
+                logError("failed to open execution report journal %s", m_fname.c_str());
+            }
+            return fd;
+        }
+
+        void reopenIfRemoved() {
+            // the journal could be removed or replaced, i.e. by convert()
+            struct stat st_fd, st_fn;
+            if ((m_fd < 0) || (fstat(m_fd, &st_fd) != 0) || (stat(m_fname.c_str(), &st_fn) != 0) ||
+                (st_fd.st_ino != st_fn.st_ino) || (st_fd.st_dev != st_fn.st_dev)) {
+                const int fd = open();
+                std::lock_guard<std::mutex> lock(m_mtx);
+                if (m_fd >= 0) {
+                    close(m_fd);
+                }
+                m_fd = fd;
+            }
+        }
+
+        void run() {
+            std::vector<Record> rec_vec;
+            std::unique_lock<std::mutex> lock(m_mtx);
+            while (true) {
+                m_cv.wait(lock, [this] { return (m_pending.size() > 0) || !m_should_run; });
+                if (m_pending.size() == 0) {
+                    break;
+                }
+                rec_vec.swap(m_pending);
+                lock.unlock();
+                reopenIfRemoved();
+                const bool ret = (m_fd >= 0) && ERJournal::write(m_fd, rec_vec);
+                if (!ret) {
+                    logError("failed to append %d execution reports to journal %s, the first one: %s",
+                            (int)rec_vec.size(), m_fname.c_str(), rec_vec[0].er.toString().c_str());
+                }
+                lock.lock();
+                m_good = m_good && ret;
+                m_written += rec_vec.size();
+                rec_vec.clear();
+                m_done_cv.notify_all();
+            }
+        }
+    };
+
+    ERJournal::Writer& ERJournal::writer(const std::string& journal_file) {
+        // writers live until exit, draining their queues at destruction
+        static std::mutex mtx;
+        static std::map<std::string, std::unique_ptr<Writer> > writers;
+        std::lock_guard<std::mutex> lock(mtx);
+        auto& w (writers[journal_file]);
+        if (!w) {
+            w.reset(new Writer(journal_file));
+        }
+        return *w;
+    }
+
+    bool ERJournal::write(int fd, std::vector<Record>& rec_vec) {
+        bool ret = false;
+        flock(fd, LOCK_EX);
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            off_t pos = st.st_size;
+            uint64_t max_recv_micro = 0;
+            if (pos < (off_t)sizeof(Header)) {
+                // new file
+                Header hdr;
+                memset(&hdr, 0, sizeof(hdr));
+                strcpy(hdr.magic, Magic());
+                hdr.rec_size = sizeof(Record);
+                pos = 0;
+                if (pwrite(fd, &hdr, sizeof(hdr), pos) == (ssize_t)sizeof(hdr)) {
+                    pos = sizeof(hdr);
+                }
+            } else {
+                // a partially written record at the end is overwritten
+                pos = sizeof(Header) + (pos - sizeof(Header))/sizeof(Record)*sizeof(Record);
+                if ((pos > (off_t)sizeof(Header)) &&
+                    (pread(fd, &max_recv_micro, sizeof(max_recv_micro), pos - sizeof(Record)) != (ssize_t)sizeof(max_recv_micro))) {
+                    max_recv_micro = 0;
+                }
+            }
+            for (auto& rec : rec_vec) {
+                max_recv_micro = _MAX_(max_recv_micro, rec.er.m_recv_micro);
+                rec.max_recv_micro = max_recv_micro;
+            }
+            const ssize_t bytes = rec_vec.size()*sizeof(Record);
+            ret = (pos >= (off_t)sizeof(Header)) &&
+                  (pwrite(fd, rec_vec.data(), bytes, pos) == bytes);
+        }
+        flock(fd, LOCK_UN);
+        return ret;
+    }
+
+    bool ERJournal::append(const ExecutionReport& er, const std::string& journal_file) {
+        return writer(journal_file).put(er);
+    }
+
+    bool ERJournal::flush(const std::string& journal_file) {
+        return writer(journal_file).flush();
+    }
+
+    bool ERJournal::read(const std::string& journal_file, uint64_t start_micro, uint64_t end_micro,
+                         std::vector<ExecutionReport>& er_vec, bool* covered) {
+        if (covered) {
+            *covered = false;
+        }
+        int fd = open(journal_file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+            close(fd);
+            return false;
+        }
+        void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            logError("failed to map execution report journal %s", journal_file.c_str());
+            return false;
+        }
+        const Header* hdr = (const Header*) ptr;
+        if (strncmp(hdr->magic, Magic(), sizeof(hdr->magic)) != 0 || hdr->rec_size != sizeof(Record)) {
+            logError("bad header in execution report journal %s", journal_file.c_str());
+            munmap(ptr, st.st_size);
+            return false;
+        }
+        const Record* begin = (const Record*)((const char*)ptr + sizeof(Header));
+        const Record* end = begin + (st.st_size - sizeof(Header))/sizeof(Record);
+        if (covered) {
+            *covered = (begin < end) && (begin->er.m_recv_micro <= start_micro);
+        }
+        // the running max is sorted, records before the first one with
+        // max_recv_micro not less than start_micro are all earlier
+        const Record* rec = std::lower_bound(begin, end, start_micro,
+                [](const Record& r, uint64_t t) { return r.max_recv_micro < t; });
+        for (; rec < end; ++rec) {
+            if ((rec->er.m_recv_micro >= start_micro) && (rec->er.m_recv_micro < end_micro)) {
+                er_vec.push_back(rec->er);
+            }
+        }
+        munmap(ptr, st.st_size);
+        return true;
+    }
+
+    long long ERJournal::convert(const std::string& er_persist_file, const std::string& journal_file) {
+        std::vector<Record> rec_vec;
+        for (const auto& line : utils::CSVUtil::read_file(er_persist_file)) {
+            try {
+                rec_vec.emplace_back();
+                rec_vec.back().er = ExecutionReport::fromCSVLine(line);
+            } catch (const std::invalid_argument& e) {
+                rec_vec.pop_back();
+                logDebug("Invalid argument - failed to load execution report: %s", e.what());
+            } catch (const std::exception& e) {
+                rec_vec.pop_back();
+                logError("failed to load execution report: %s", e.what());
+            }
+        }
+        // written to a new file, a writer of the journal reopens it
+        std::remove(journal_file.c_str());
+        int fd = open(journal_file.c_str(), O_RDWR|O_CREAT, 0644);
+        if (fd < 0) {
+            logError("failed to open execution report journal %s", journal_file.c_str());
+            return -1;
+        }
+        const bool ret = write(fd, rec_vec);
+        close(fd);
+        return ret? (long long)rec_vec.size() : -1;
+    }
+}
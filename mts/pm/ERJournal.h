@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ExecutionReport.h"
+#include <vector>
+
+namespace pm {
+    // Append-only binary journal of the execution reports, written along
+    // with the csv ERPersistFile, see ExecutionReport::persist().  Records
+    // are of fixed size, each with the running maximum of m_recv_micro up
+    // to and including itself, as the time index for read() to find the
+    // reports received since a given time with a binary search.
+    class ERJournal {
+    public:
+        struct Header {
+            char magic[8];
+            int32_t rec_size;
+            char reserved[52];
+        } __attribute__((packed));
+
+        struct Record {
+            uint64_t max_recv_micro;
+            ExecutionReport er;
+        };
+
+        static const char* Magic() { return "MTSERJ1"; };
+
+        static std::string fname(const std::string& er_persist_file);
+            // the journal file of an ERPersistFile, with the .bin extension
+
+        static bool append(const ExecutionReport& er, const std::string& journal_file);
+            // queues er to the writer of the journal, created if not exist.
+            // Each journal has a writer thread with the file kept open, which
+            // writes the queued reports in one pwrite with the file locked,
+            // as both the tp and the floor write to it.  Returns false if the
+            // journal cannot be opened
+
+        static bool flush(const std::string& journal_file);
+            // waits until the reports queued to the journal are written,
+            // returns false if any of them failed to be written
+
+        static bool read(const std::string& journal_file, uint64_t start_micro, uint64_t end_micro,
+                         std::vector<ExecutionReport>& er_vec, bool* covered = nullptr);
+            // appends the execution reports received in [start_micro, end_micro)
+            // to er_vec, in the order written. Returns false if the journal
+            // cannot be read. If given, covered is set to true if the journal
+            // starts no later than start_micro, i.e. has all the reports since then
+
+        static long long convert(const std::string& er_persist_file, const std::string& journal_file);
+            // writes a journal from the csv ERPersistFile, existing journal is replaced
+            // returns the number of reports written, or -1 on error
+
+    private:
+        class Writer;
+        static Writer& writer(const std::string& journal_file);
+        static bool write(int fd, std::vector<Record>& rec_vec);
+            // appends rec_vec at the end of fd, with the running max set
+    };
+}
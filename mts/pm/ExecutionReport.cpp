@@ -1,7 +1,9 @@
 #include "ExecutionReport.h"
+#include "ERJournal.h"
 #include "time_util.h"
 #include <cmath>
 #include <random>
+#include <sys/stat.h>
 #include "plcc/PLCC.hpp"
 #include "md_snap.h"
 
@@ -41,11 +43,11 @@ namespace pm {
     ExecutionReport ExecutionReport::fromCSVLine(const utils::CSVUtil::LineTokens& token_vec) {
         int64_t reserved=0;
         if (token_vec.size() > 10) {
-            reserved = std::stoll(token_vec[10]);
+            reserved = utils::CSVUtil::parse<long long>(token_vec[10]);
         }
         return ExecutionReport(token_vec[0], token_vec[1], token_vec[2], token_vec[3],
-                token_vec[4], std::stoi(token_vec[5]), std::stod(token_vec[6]),
-                token_vec[7], token_vec[8], std::stoull(token_vec[9]),reserved);
+                token_vec[4], utils::CSVUtil::parse<int>(token_vec[5]), utils::CSVUtil::parse<double>(token_vec[6]),
+                token_vec[7], token_vec[8], utils::CSVUtil::parse<unsigned long long>(token_vec[9]),reserved);
     }
 
     utils::CSVUtil::LineTokens ExecutionReport::toCSVLine() const {
@@ -130,6 +132,19 @@ namespace pm {
         return plcc_getString("ERPersistFile");
     }
 
+    static int64_t mtime_nano(const std::string& fn) {
+        struct stat st;
+        return (stat(fn.c_str(), &st)==0)? (int64_t)st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec : 0;
+    }
+
+    bool ExecutionReport::persist(const ExecutionReport& er) {
+        // csv first, so the journal is not older than the csv unless
+        // the csv is written by others without the journal
+        const std::string& erfile (ERPersistFile());
+        bool ret = utils::CSVUtil::write_line_to_file(er.toCSVLine(), erfile, true);
+        return ERJournal::append(er, ERJournal::fname(erfile)) && ret;
+    }
+
     bool ExecutionReport::loadFromPersistence(const std::string& start_time_local, const std::string& end_time_local, const std::string& out_file, const std::string& er_persist_file) {
         // read fills from the fill file and dump lines to out_file since start_utc.
         // start_time_local is specified with a local time string in YYYYMMDD-HH:MM:SS (inclusive)
@@ -137,7 +152,6 @@ namespace pm {
         // end_time_local, if not empty, has same time format for end time (exclusive)
 
         const std::string& erfile (er_persist_file==""? ERPersistFile():er_persist_file);
-        const auto lines = utils::CSVUtil::read_file(erfile);
         utils::CSVUtil::FileTokens line_vec;
 
         uint64_t smicro = utils::TimeUtil::string_to_frac_UTC(start_time_local.c_str(), 0) * 1000000;
@@ -146,6 +160,20 @@ namespace pm {
                 (utils::TimeUtil::string_to_frac_UTC(end_time_local.c_str(), 0) * 1000000) : 
                 (uint64_t)(-1));
 
+        // the journal is used unless the csv is written after it, i.e. by a writer
+        // without the journal, or the journal is truncated before the start time
+        const std::string& jfile (ERJournal::fname(erfile));
+        std::vector<ExecutionReport> er_vec;
+        bool covered = false;
+        if ((mtime_nano(erfile) <= mtime_nano(jfile)) &&
+            ERJournal::read(jfile, smicro, emicro, er_vec, &covered) && covered) {
+            for (const auto& er : er_vec) {
+                line_vec.emplace_back(er.toCSVLine());
+            }
+            return utils::CSVUtil::write_file(line_vec, out_file, false);
+        }
+
+        const auto lines = utils::CSVUtil::read_file(erfile);
         for (const auto& line : lines ) {
             try {
                 auto er (pm::ExecutionReport::fromCSVLine(line));
@@ -31,6 +31,8 @@ namespace pm {
         );
 
         static std::string ERPersistFile();
+        static bool persist(const ExecutionReport& er);
+            // writes er to the ERPersistFile and its binary journal, see ERJournal
         static ExecutionReport fromCSVLine(const utils::CSVUtil::LineTokens& token_vec);
 
         // functions to output to a csv line
@@ -39,6 +41,8 @@ namespace pm {
 
         // this loads execution reports from the persist that are received
         // between given start_time_local and end_time_local and writes out_file
+        // The binary journal of the persist is used if it covers the start time,
+        // instead of reading the whole csv file
         static bool loadFromPersistence(const std::string& start_time_local, 
                                         const std::string& end_time_local, 
                                         const std::string& out_file, 
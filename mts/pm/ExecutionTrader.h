@@ -4,6 +4,7 @@
 #include "PositionManager.h"
 #include <string>
 #include <memory>
+#include <vector>
 
 /*
  * To be called by thread of FloorTrader (FT), which holds FloorCPR (channel, pm and risk)
@@ -44,6 +45,7 @@ namespace pm {
         uint64_t _next_micro;  // time to be checked next
         bool _done;
         std::shared_ptr<void> _states;  // derived states
+        int _sched_idx;  // position in the floor's ETSchedule, -1 if not scheduled
 
         template<typename T>
         ETInfo(const PIType& pi, \
@@ -52,10 +54,11 @@ namespace pm {
           _enter_micro(utils::TimeUtil::cur_micro()),
           _next_micro(_enter_micro), // default to be checked next
           _done(false),
-          _states(std::static_pointer_cast<void>(state)) {
+          _states(std::static_pointer_cast<void>(state)),
+          _sched_idx(-1) {
         };
 
-        ETInfo(): _enter_micro(0), _next_micro((uint64_t)0x7fffffffffffffffLL), _done(true) {};
+        ETInfo(): _enter_micro(0), _next_micro((uint64_t)0x7fffffffffffffffLL), _done(true), _sched_idx(-1) {};
 
         template<typename T>
         void setStates(std::shared_ptr<T> states) {
@@ -78,6 +81,122 @@ namespace pm {
         }
     };
 
+    /*
+     * The ETInfo not done, in a min-heap on _next_micro indexed by
+     * _sched_idx, so that the floor's loop only touches the due ones and
+     * gets its sleep from the top.  The ETs reschedule by setting
+     * _next_micro and _done in their callbacks, the floor calls update()
+     * after each, which takes done ones out of the heap.  The key is kept
+     * in the heap, an ETInfo changed without update() stays where it was.
+     */
+    class ETSchedule {
+    public:
+        size_t size() const { return m_heap.size(); };
+
+        // the earliest _next_micro, -1 if none scheduled
+        uint64_t nextMicro() const {
+            return m_heap.size()? m_heap[0].key : (uint64_t)-1;
+        };
+
+        // (re)schedules ei on its _next_micro, or removes it if done
+        void update(const std::shared_ptr<ETInfo>& ei) {
+            if (ei->_done) {
+                remove(ei);
+                return;
+            }
+            int i = ei->_sched_idx;
+            if (i < 0) {
+                i = (int) m_heap.size();
+                m_heap.push_back({ei->_next_micro, ei});
+                ei->_sched_idx = i;
+                up(i);
+                return;
+            }
+            const uint64_t key = m_heap[i].key;
+            m_heap[i].key = ei->_next_micro;
+            if (ei->_next_micro < key) {
+                up(i);
+            } else {
+                down(i);
+            }
+        }
+
+        void remove(const std::shared_ptr<ETInfo>& ei) {
+            const int i = ei->_sched_idx;
+            if (i < 0) {
+                return;
+            }
+            ei->_sched_idx = -1;
+            const int last = (int) m_heap.size() - 1;
+            if (i != last) {
+                m_heap[i] = std::move(m_heap[last]);
+                m_heap[i].ei->_sched_idx = i;
+                m_heap.pop_back();
+                up(i);
+                down(i);
+            } else {
+                m_heap.pop_back();
+            }
+        }
+
+        // takes out those due at cur_micro, to be run and updated
+        void popDue(uint64_t cur_micro, std::vector<std::shared_ptr<ETInfo>>& due) {
+            while (m_heap.size() && (m_heap[0].key <= cur_micro)) {
+                due.push_back(m_heap[0].ei);
+                remove(m_heap[0].ei);
+            }
+        }
+
+        void clear() {
+            for (auto& n : m_heap) {
+                n.ei->_sched_idx = -1;
+            }
+            m_heap.clear();
+        }
+
+    private:
+        struct Node {
+            uint64_t key;
+            std::shared_ptr<ETInfo> ei;
+        };
+        std::vector<Node> m_heap;
+
+        void swap(int i, int j) {
+            std::swap(m_heap[i], m_heap[j]);
+            m_heap[i].ei->_sched_idx = i;
+            m_heap[j].ei->_sched_idx = j;
+        }
+
+        void up(int i) {
+            while (i > 0) {
+                const int p = (i-1)/2;
+                if (m_heap[p].key <= m_heap[i].key) {
+                    break;
+                }
+                swap(i, p);
+                i = p;
+            }
+        }
+
+        void down(int i) {
+            const int n = (int) m_heap.size();
+            while (true) {
+                int c = 2*i+1;
+                if (c >= n) {
+                    break;
+                }
+                if ((c+1 < n) && (m_heap[c+1].key < m_heap[c].key)) {
+                    ++c;
+                }
+                if (m_heap[i].key <= m_heap[c].key) {
+                    break;
+                }
+                swap(i, c);
+                i = c;
+            }
+        }
+    };
+
     class ExecutionTrader {
         /*
          * A logic object, driven by the thread wrapper. It operates 
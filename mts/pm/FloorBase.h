@@ -142,6 +142,11 @@ namespace pm {
             int type; // trading style etc
             int64_t reserved;  // lpm, etc
 
+            // latency stamps in nano seconds, see utils::LatencyStats
+            uint64_t sent_ns;   // sent by the algo
+            uint64_t recv_ns;   // received by the floor, cleared on its first order
+            uint64_t order_ns;  // last order sent, cleared on its first execution report
+
             // bid/ask on creation time
             std::shared_ptr<PositionInstructionStat> pis; // statistics of the fills so far
 
@@ -157,7 +162,7 @@ namespace pm {
             };
 
             PositionInstruction()
-            : qty(0), px(0),target_utc(0), type(-1), reserved(0) {
+            : qty(0), px(0),target_utc(0), type(-1), reserved(0), sent_ns(0), recv_ns(0), order_ns(0) {
                 algo[0] = 0;
                 symbol[0] = 0;
                 last_utc = 0;
@@ -169,7 +174,7 @@ namespace pm {
                                 int target_utc_ = 0,
                                 TYPE type_ = MARKET) 
             : qty (qty_desired_), px(px_limit_), target_utc(target_utc_), type((int)type_),
-              reserved(0),pis(std::make_shared<PositionInstructionStat>(symbol_, algo_))
+              reserved(0), sent_ns(0), recv_ns(0), order_ns(0), pis(std::make_shared<PositionInstructionStat>(symbol_, algo_))
             {
                 if ( (algo_.size() > sizeof(algo)-1) ||
                      (symbol_.size() > sizeof(symbol)-1) ) {
@@ -189,7 +194,7 @@ namespace pm {
             }*/
 
             PositionInstruction(const char* pi_str) :
-            px(0), target_utc(0), reserved(0) {
+            px(0), target_utc(0), reserved(0), sent_ns(0), recv_ns(0), order_ns(0) {
                 // format of algo, symbol, qty [, px_str|twap_str]
                 // the twap_str starts with 'T', followed by a number and a 's|m|h'
                 // for example T5m
@@ -342,6 +347,10 @@ namespace pm {
         bool parseKeyValue (const std::string& cmd, std::map<std::string, std::string>& key_map) const;
     };
 
+    // order path messages are expected to fit in the Floor::Message inline buffer
+    static_assert(sizeof(pm::ExecutionReport) <= utils::Floor::Message::InlineSize, "ExecutionReport exceeds Floor::Message::InlineSize");
+    static_assert(sizeof(FloorBase::PositionInstruction) <= utils::Floor::Message::InlineSize, "PositionInstruction exceeds Floor::Message::InlineSize");
+
     // function definitions
     
     inline
@@ -5,6 +5,7 @@
 #include "ExecutionReport.h"
 #include "RiskMonitor.h"
 #include "time_util.h"
+#include "latency_stats.h"
 #include <stdexcept>
 #include <atomic>
 #include <unordered_map>
@@ -68,6 +69,8 @@ namespace pm {
         std::string sendCancelReplacePx(const char* clOrdId, double new_price);
         std::string sendCancelReplaceSize(const char* clOrdId, uint64_t size); // size positive, same sign with original
         std::string sendCancelReplaceByString(const char* bsstr);
+        std::string sendReplace(const std::shared_ptr<const OpenOrder>& oo, int64_t qty, double px);
+        // replaces oo to qty (sign significant) and px, without a command string to be parsed
 
         // ***
         // position utilities
@@ -118,6 +121,7 @@ namespace pm {
         void clearAllOpenOrders();
         enum {
             PendingOrderTimeOutSec    = 5,      // unacklast_utc of pi compares with current utc
+            CheckpointIntervalSec     = 60,     // position checkpoint interval, if updated
         };
 
         /* TODO - in case the friend class doesn't work
@@ -129,6 +133,14 @@ namespace pm {
         PositionManager m_pm;
         volatile bool m_should_run;
         std::string m_recovery_file;
+        time_t m_checkpoint_utc;       // last checkpoint time
+        uint64_t m_checkpoint_micro;   // max recv micro of the pm at last checkpoint
+
+        // latency histograms by symbol, see stampOrder()
+        mutable utils::LatencyHopCache m_floor_order_lat;
+        utils::LatencyHopCache m_order_er_lat;
+
+        void checkpoint(time_t cur_utc);
 
         // The purpose of m_orderMap is to 1. decide if an OO should be scanned.
         // 2. check the if an entered order has been updated within a timeout
@@ -166,6 +178,10 @@ namespace pm {
         bool sendOrder_InContract(int64_t trade_qty, const std::shared_ptr<PositionInstruction>& pi);
         bool scanOrderMap(time_t cur_utc) const;
 
+        // records the floor_order latency on the first order of the pi
+        // and stamps the order sent for the order_er latency
+        void stampOrder(PositionInstruction& pi) const;
+
 
         // TWAP traders
         /*
@@ -215,7 +231,11 @@ namespace pm {
       m_eod_pending(false),
       m_loaded_time(0),
       m_pm(m_name),
-      m_should_run(false)
+      m_should_run(false),
+      m_checkpoint_utc(0),
+      m_checkpoint_micro(0),
+      m_floor_order_lat(utils::LatencyStats::HopFloorOrder),
+      m_order_er_lat(utils::LatencyStats::HopOrderER)
     {};
 
     template<typename Derived> 
@@ -279,6 +299,10 @@ namespace pm {
                         // this pauses trading for all globally
                         pm::risk::Monitor::get().status().notify_pause("","",true);
                     }
+                    if (__builtin_expect(cur_utc >= m_checkpoint_utc + CheckpointIntervalSec, 0) &&
+                        (m_pm.getMaxRecvMicro() != m_checkpoint_micro)) {
+                        checkpoint(cur_utc);
+                    }
                 }
                 // all good, call derived
                 static_cast<Derived*>(this)->run_loop_derived();
@@ -287,6 +311,9 @@ namespace pm {
 
         // done for the loop, exiting
         logInfo("FloorCPR loop: Stop received, exit.");
+        if (m_loaded) {
+            checkpoint(utils::TimeUtil::cur_utc());
+        }
         clearAllOpenOrders();
         static_cast<Derived*>(this)->shutdown_derived();
         m_started = false;
@@ -320,6 +347,7 @@ namespace pm {
 
                 m_loaded_time = time(nullptr);
                 clearAllOpenOrders();
+                checkpoint(m_loaded_time);
                 m_loaded = true;
                 addPositionSubscriptions();
                 static_cast<Derived*>(this)->start_derived();
@@ -337,6 +365,7 @@ namespace pm {
                     logInfo("before resetting daily pnl:\n%s", m_pm.toString(nullptr, nullptr, true).c_str());
                     m_pm.resetPnl();
                     logInfo("after resetting daily pnl:\n%s", m_pm.toString(nullptr, nullptr, true).c_str());
+                    checkpoint(utils::TimeUtil::cur_utc());
                     logInfo("%s EoD Done!", m_name.c_str());
                 }
                 m_eod_pending = false;
@@ -425,6 +454,11 @@ namespace pm {
             // update the last utc of this pi, used to alert for order
             // sent that was not heard back from for a while
             pi->last_utc = 0;  // disable the check, as order was updated
+            if (pi->order_ns) {
+                // the first report since the order sent
+                m_order_er_lat.hist(pi->symbol)->record(utils::LatencyStats::now_ns() - pi->order_ns);
+                pi->order_ns = 0;
+            }
 
             // update fill stats if it's a new fill
             if (is_newfill) {
@@ -509,7 +543,7 @@ namespace pm {
                     // generating a fill and add to the erpersist and update
                     const auto& er (ExecutionReport::genSyntheticFills(symbol, algo, qty, px, "PA"));
                     // append it to the er report
-                    utils::CSVUtil::write_line_to_file(er.toCSVLine(), ExecutionReport::ERPersistFile(), true);
+                    ExecutionReport::persist(er);
                     handleExecutionReport(er);
                 } catch (std::exception& e) {
                     respstr = std::string("Failed to ajust position: ") + e.what();
@@ -726,6 +760,9 @@ namespace pm {
                     size_t bytes = snprintf(ordstr, sizeof(ordstr), "%c %s, %s, %d, %s, %s", *bsstr, algo.c_str(), symbol.c_str(), qty, PriceCString(px),ordId.c_str());
                     FloorBase::MsgType req(FloorBase::SendOrderReq, ordstr, bytes + 1);
                     FloorBase::MsgType resp;
+                    if (pi) {
+                        stampOrder(*pi);
+                    }
                     if (!m_channel->requestAndCheckAck(req, resp, 1, FloorBase::SendOrderAck)) {
                         return std::string("problem sending order: ") + std::string(req.buf);
                     }
@@ -756,9 +793,12 @@ namespace pm {
 
     template<typename Derived> 
     std::string FloorCPR<Derived>::sendCancelReplacePx(const char* clOrdId, double new_price) {
-        char cmd[256];
-        snprintf(cmd, sizeof(cmd), "R %s,,%f", clOrdId, new_price);
-        return sendCancelReplaceByString(std::string(cmd));
+        const auto& oo (m_pm.getOO(clOrdId));
+        if (!oo) {
+            logError("Cannot find clOrdId %s", clOrdId);
+            return std::string("clOrdId not found: ") + std::string(clOrdId);
+        }
+        return sendReplace(oo, oo->m_open_qty, new_price);
     }
 
     template<typename Derived> 
@@ -805,7 +845,6 @@ namespace pm {
                 const std::string& algo (oo->m_idp->get_algo());
                 const std::string& symbol(oo->m_idp->get_symbol());
                 int64_t qty = oo->m_open_qty; // sign significant
-                int64_t ord_qty = oo->m_ord_qty; // sign significant
                 double px = oo->m_open_px;
 
                 char ordStr[256];
@@ -813,7 +852,6 @@ namespace pm {
                 if (*bsstr == 'C') {
                     bytes = snprintf(ordStr, sizeof(ordStr), "C %s, %s", line[0].c_str(), algo.c_str());
                 } else {
-                    int64_t qty_delta = 0;
                     if ((line[1] == "") && (line[2] == "")) {
                         logError("Both qty and px are emtpy, nothing to be replaced");
                         return "nothing to be replaced";
@@ -826,12 +864,7 @@ namespace pm {
                             return "replace qty must be positive";
                         }
                         // now make qty to be signed
-                        qty_new *= (oo->m_open_qty>0?1:-1);
-
-                        // replace uses order qty
-                        qty_delta = qty_new - qty;
-                        ord_qty += qty_delta;
-                        qty = qty_new;
+                        qty = qty_new * (oo->m_open_qty>0?1:-1);
                     }
                     if (line[2] != "") {
                         // replace px, parse line[2] as px_str
@@ -841,29 +874,7 @@ namespace pm {
                         }
                     }
 
-                    // if we have anything to be replaced
-                    if (__builtin_expect((qty == oo->m_open_qty) && (std::abs(px - oo->m_open_px)<1e-10),0)) {
-                        logError("Nothing to be replaced from %s with command %s!", oo->toString().c_str(), bsstr);
-                        return "nothing to be replaced!";
-                    }
-
-                    if (!risk::Monitor::get().checkReplace(oo->m_idp->get_algo(), oo->m_idp->get_symbol(), qty_delta, m_pm)) {
-                        //errors logged in the function
-                        return std::string("Risk failed for request! ") + std::string(bsstr);
-                    }
-
-                    const std::string replaceClOrdId = ExecutionReport::genReplaceClOrdId(line[0]);
-                    bytes = snprintf(ordStr, sizeof(ordStr), "R %s, %lld, %s, %s, %s, %s", line[0].c_str(), (long long)ord_qty, PriceCString(px), algo.c_str(), symbol.c_str(), replaceClOrdId.c_str());
-
-                    // update m_orderMap if necessary
-                    if (qty != 0) {
-                        auto iter = m_orderMap.find(line[0]);
-                        if (iter != m_orderMap.end()) {
-                            auto& pi(iter->second);
-                            pi->last_utc=utils::TimeUtil::cur_utc();
-                            m_orderMap[replaceClOrdId] = pi;
-                        }
-                    }
+                    return sendReplace(oo, qty, px);
                 }
                 FloorBase::MsgType req(FloorBase::SendOrderReq, ordStr, bytes+1);
                 FloorBase::MsgType resp;
@@ -881,6 +892,52 @@ namespace pm {
         return "";
     }
 
+    template<typename Derived> 
+    std::string FloorCPR<Derived>::sendReplace(const std::shared_ptr<const OpenOrder>& oo, int64_t qty, double px) {
+        try {
+            // if we have anything to be replaced
+            if (__builtin_expect((qty == oo->m_open_qty) && (std::abs(px - oo->m_open_px)<1e-10),0)) {
+                logError("Nothing to be replaced from %s to qty %lld px %s!", oo->toString().c_str(), (long long)qty, PriceCString(px));
+                return "nothing to be replaced!";
+            }
+
+            // replace uses order qty
+            const int64_t qty_delta = qty - oo->m_open_qty;
+            const int64_t ord_qty = oo->m_ord_qty + qty_delta;
+            const std::string& algo (oo->m_idp->get_algo());
+            const std::string& symbol(oo->m_idp->get_symbol());
+            if (!risk::Monitor::get().checkReplace(algo, symbol, qty_delta, m_pm)) {
+                //errors logged in the function
+                return std::string("Risk failed for replace of ") + std::string(oo->m_clOrdId);
+            }
+
+            const std::string clOrdId (oo->m_clOrdId);
+            const std::string replaceClOrdId = ExecutionReport::genReplaceClOrdId(clOrdId);
+            char ordStr[256];
+            size_t bytes = snprintf(ordStr, sizeof(ordStr), "R %s, %lld, %s, %s, %s, %s", clOrdId.c_str(), (long long)ord_qty, PriceCString(px), algo.c_str(), symbol.c_str(), replaceClOrdId.c_str());
+
+            // update m_orderMap if necessary
+            if (qty != 0) {
+                auto iter = m_orderMap.find(clOrdId);
+                if (iter != m_orderMap.end()) {
+                    auto& pi(iter->second);
+                    pi->last_utc=utils::TimeUtil::cur_utc();
+                    pi->order_ns = utils::LatencyStats::now_ns();
+                    m_orderMap[replaceClOrdId] = pi;
+                }
+            }
+            FloorBase::MsgType req(FloorBase::SendOrderReq, ordStr, bytes+1);
+            FloorBase::MsgType resp;
+            if (!m_channel->requestAndCheckAck(req, resp, 1, FloorBase::SendOrderAck)) {
+                return std::string("problem sending order: ") + std::string(req.buf);
+            }
+        } catch (const std::exception& e) {
+            logError("Exception when send replace of %s: %s", oo->m_clOrdId, e.what());
+            return std::string("Exception when send replace of ") + std::string(oo->m_clOrdId) + " : " + std::string(e.what());
+        }
+        return "";
+    }
+
     template<typename Derived> 
     std::string FloorCPR<Derived>::sendOrder(const bool isBuy, 
             const char* algo, const char* symbol,
@@ -955,6 +1012,17 @@ namespace pm {
         return true;
     }
 
+    template<typename Derived> 
+    void FloorCPR<Derived>::stampOrder(PositionInstruction& pi) const {
+        const uint64_t cur_ns = utils::LatencyStats::now_ns();
+        if (pi.recv_ns) {
+            // the first order of the instruction
+            m_floor_order_lat.hist(pi.symbol)->record(cur_ns - pi.recv_ns);
+            pi.recv_ns = 0;
+        }
+        pi.order_ns = cur_ns;
+    }
+
     template<typename Derived> 
     bool FloorCPR<Derived>::scanOrderMap(time_t cur_utc) const {
         // order timeout set to 
@@ -1014,6 +1082,16 @@ namespace pm {
 #endif
     }
 
+    template<typename Derived> 
+    void FloorCPR<Derived>::checkpoint(time_t cur_utc) {
+        // the checkpoint is loaded by the pm on the next start,
+        // replaying only the execution reports since then
+        m_checkpoint_utc = cur_utc;
+        if (m_pm.checkpoint()) {
+            m_checkpoint_micro = m_pm.getMaxRecvMicro();
+        }
+    }
+
     template<typename Derived> 
     bool FloorCPR<Derived>::loadRecoveryFromFill(const std::string& loadTime, std::string* errstr) {
         const std::string endTime = utils::TimeUtil::frac_UTC_to_string(0, 0);
@@ -1154,8 +1232,8 @@ namespace pm {
                 const auto& er0 (ExecutionReport::genSyntheticFills(symbol, algo, -qty0, cur_px, "IM0"));
                 const auto& er1 (ExecutionReport::genSyntheticFills(oo->m_idp->get_symbol(), oo->m_idp->get_algo(), qty0, cur_px, "IM1"));
                 // append it to the er report
-                utils::CSVUtil::write_line_to_file(er0.toCSVLine(), ExecutionReport::ERPersistFile(), true);
-                utils::CSVUtil::write_line_to_file(er1.toCSVLine(), ExecutionReport::ERPersistFile(), true);
+                ExecutionReport::persist(er0);
+                ExecutionReport::persist(er1);
                 
                 // update position
                 handleExecutionReport(er0);
@@ -13,7 +13,14 @@ namespace pm {
     };
 
     FloorManager::FloorManager(const std::string& name)
-    : FloorCPR<FloorManager>(name) {
+    : FloorCPR<FloorManager>(name),
+      m_peg(m_pm,
+            [this](const std::shared_ptr<const OpenOrder>& oo, double& px, bool& aggressive) {
+                return pegOpenOrder(oo, px, aggressive);
+            },
+            [this](const std::shared_ptr<const OpenOrder>& oo, double px) {
+                return replaceOpenOrder(oo, px);
+            }) {
     };
 
     FloorManager::~FloorManager() {
@@ -44,7 +51,9 @@ namespace pm {
         static int check_utc = 0;
         static const int check_interval = 5;
 
-        utils::TimeUtil::micro_sleep(IdleSleepMicro);
+        // wakes up on a new message instead of sleeping through it,
+        // and polls the touch of the pegged orders
+        m_channel->waitNext(m_peg.waitMicro(IdleSleepMicro));
         auto cur_utc = utils::TimeUtil::cur_utc();
         if (__builtin_expect(cur_utc>check_utc, 0)) {
             check_utc = cur_utc + check_interval;
@@ -58,6 +67,7 @@ namespace pm {
 
     void FloorManager::handleExecutionReport_derived(const pm::ExecutionReport& er) {
         // extra handling after receiving an er
+        m_peg.onER(er);
     };
 
     bool FloorManager::handleUserReq_derived(const MsgType& msg, std::string& respstr) {
@@ -272,7 +282,7 @@ namespace pm {
         if (iter != m_orderMap.end()) {
             const auto& pi = iter->second;
             const int64_t cur_micro = utils::TimeUtil::cur_micro();
-            if (cur_micro - (int64_t)oo->m_open_micro > 100000LL) {
+            if (cur_micro - (int64_t)oo->m_open_micro > (int64_t)PegScanner::MinAgeMicro) {
                 if (pi->type == PositionInstruction::PASSIVE) {
                     peg_passive = true;
                     return true;
@@ -286,52 +296,33 @@ namespace pm {
         return false;
     }
 
-    bool FloorManager::scanOpenOrders() {
-        static uint64_t last_scan_micro = 0;
-        auto cur_micro = utils::TimeUtil::cur_micro();
-        if ((int64_t) (cur_micro - last_scan_micro) < (int64_t) ScanIntervalMicro) {
+    bool FloorManager::pegOpenOrder(const std::shared_ptr<const OpenOrder>& oo, double& px, bool& aggressive) const {
+        bool peg_passive = false;
+        if (!shouldScan(oo, peg_passive)) {
             return false;
         }
-        last_scan_micro = cur_micro;
-
-        // trade out open orders with less 
-        bool ret = false;
-        const auto& vec(m_pm.listOO());
-        for (const auto& oo: vec) {
-            //logDebug("scanning oo: %s", oo->toString().c_str());
-            bool peg_passive = false;
-            if (!shouldScan(oo, peg_passive)) {
-                continue;
-            }
-            double px_now = getPegPxBP(oo, peg_passive, MaxPegTickDiff, 0.5);
-            double px_diff = oo->m_open_px - px_now; 
-            if (std::abs(px_diff) > 1e-10) {
-                ret = true;
-                logDebug("Price moved away for %s, new px: %s, px-diff: %s, trading in", oo->toString().c_str(), PriceCString(px_now), PriceCString(px_diff));
+        px = getPegPxBP(oo, peg_passive, MaxPegTickDiff, 0.5);
+        aggressive = !peg_passive;
+        return true;
+    }
 
-                // additional check on the replacement
-                logDebug("Price moved away detail: oo_price: %.8f(%s), px_now: %.8f(%s), px_diff: %.8f(%s)",
-                        oo->m_open_px, PriceCString(oo->m_open_px), px_now, PriceCString(px_now), px_diff, PriceCString(px_diff));
+    bool FloorManager::replaceOpenOrder(const std::shared_ptr<const OpenOrder>& oo, double px) {
+        logDebug("Price moved away for %s, new px: %s, px-diff: %s, trading in", oo->toString().c_str(), PriceCString(px), PriceCString(oo->m_open_px - px));
 
-                char tstr[256];
-                snprintf(tstr, sizeof(tstr), "R %s,,%s", oo->m_clOrdId, PriceCString(px_now));
-                std::string errstr = sendCancelReplaceByString(tstr);
-                if (errstr != "") {
-                    logError("failed to send replace order %s error = %s", 
-                            tstr, errstr.c_str());
-                    continue;
-                }
-                // In case the cancel is rejected, the fill 
-                // should be in the way to be applied without oo
-                // and orderMap entry, which is fine
-                m_pm.deleteOO(oo->m_clOrdId);
-                if (!peg_passive) {
-                    // avoid burst and wait for rtt
-                    last_scan_micro = last_scan_micro - ScanIntervalMicro + PegAggIntervalMilli*1000;
-                };
-                break;
-            }
+        const std::string errstr = sendReplace(oo, oo->m_open_qty, px);
+        if (errstr != "") {
+            logError("failed to send replace order of %s to %s error = %s",
+                    oo->m_clOrdId, PriceCString(px), errstr.c_str());
+            return false;
         }
-        return ret;
+        // In case the cancel is rejected, the fill 
+        // should be in the way to be applied without oo
+        // and orderMap entry, which is fine
+        m_pm.deleteOO(oo->m_clOrdId);
+        return true;
+    }
+
+    bool FloorManager::scanOpenOrders() {
+        return m_peg.scan(utils::TimeUtil::cur_micro()) > 0;
     }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FloorCPR.h"
+#include "PegScanner.h"
 
 namespace pm {
     class FloorManager: public FloorCPR<FloorManager> {
@@ -36,13 +37,16 @@ namespace pm {
         enum {
             IdleSleepMicro       = 50000,    // sleep duration
 
-            // execution related parameters
-            ScanIntervalMicro    = 100000,    // open order scan interval
+            // execution related parameters, see also PegScanner
             MaxPegTickDiff     = 3,       // maximum spreads before go aggressive in peg
-            PegAggIntervalMilli  = 2000,      // OO Peg, wait between consecutive aggressive
         };
 
+        // the open orders pegged, evaluated on the moves of their touch
+        PegScanner m_peg;
+
         bool shouldScan(const std::shared_ptr<const OpenOrder>& oo, bool& peg_passive) const;
+        bool pegOpenOrder(const std::shared_ptr<const OpenOrder>& oo, double& px, bool& aggressive) const;
+        bool replaceOpenOrder(const std::shared_ptr<const OpenOrder>& oo, double px);
         bool scanOpenOrders();
     };
 };
@@ -9,7 +9,8 @@
 
 namespace pm {
     FloorTrader::FloorTrader(const std::string& instance_name)
-    : FloorCPR<FloorTrader>(instance_name) {
+    : FloorCPR<FloorTrader>(instance_name),
+      m_pi_floor_lat(utils::LatencyStats::HopPIFloor) {
         // config file expected as config/floortrader_instance_name.cfg
         const auto cfg(utils::ConfigureReader((std::string("config/")+instance_name + ".cfg").c_str()));
 
@@ -133,21 +134,21 @@ namespace pm {
     }
 
     void FloorTrader::run_loop_derived() {
-        /*scan through m_eiMap and run bool onRun(etinfo)
-          if all false, then check onlyme and sleep IdleSleepMicro
+        /*run bool onRun(etinfo) of the due ones in m_sched, each once,
+          then check onlyme and sleep until the next due, at most IdleSleepMicro
          */
         uint64_t cur_micro = utils::TimeUtil::cur_micro();
         // run everything that should be run
-        for (auto& kv:m_eiMap) {
-            auto& etinfo (kv.second);
-            if (etinfo->_done) {
-                continue;
-            }
-            // get the next run time
-            if (etinfo->_next_micro<=cur_micro) {
-                int tp_ = etinfo->_pi->type;
-                m_et[tp_]->onRun(etinfo);
+        m_due.clear();
+        m_sched.popDue(cur_micro, m_due);
+        for (auto& etinfo : m_due) {
+            int tp_ = etinfo->_pi->type;
+            m_et[tp_]->onRun(etinfo);
+            if ((!etinfo->_done) && (etinfo->_next_micro < cur_micro - 1000000)) {
+                logError("State(%s) out of _next_micro update for one second, put it to run next cycle", etinfo->toString().c_str());
+                etinfo->_next_micro = cur_micro + IdleSleepMicro;
             }
+            m_sched.update(etinfo);
         }
 
         // check  onlyme if needed
@@ -159,25 +160,11 @@ namespace pm {
 
         // figure out this sleep time
         cur_micro = utils::TimeUtil::cur_micro();
-        uint64_t min_next_micro = cur_micro + IdleSleepMicro;
-        for (auto& kv:m_eiMap) {
-            auto& etinfo (kv.second);
-            if (etinfo->_done) {
-                continue;
-            }
-            auto nm = etinfo->_next_micro;
-            if (nm < cur_micro - 1000000) {
-                logError("State(%s) out of _next_micro update for one second, put it to run next cycle", etinfo->toString().c_str());
-                etinfo->_next_micro = cur_micro + IdleSleepMicro;
-                continue;
-            }
-            // get the minimum next run time
-            min_next_micro = _MIN_(nm,min_next_micro);
-        }
-        cur_micro = utils::TimeUtil::cur_micro();
+        const uint64_t min_next_micro = _MIN_(m_sched.nextMicro(), cur_micro + IdleSleepMicro);
         if (min_next_micro > cur_micro + MinSleepMicro) {
             // 2 micro is a safe upper bound for a context switch
-            utils::TimeUtil::micro_sleep(min_next_micro-cur_micro-2);
+            // a new message wakes up the wait
+            m_channel->waitNext(min_next_micro-cur_micro-2);
         }
         // otherwise, just spin
     }
@@ -206,6 +193,14 @@ namespace pm {
         PositionInstruction* pip0 = (PositionInstruction*)msg.buf ; 
         logInfo("SetPositionReq: %s, %s, %d, %f", pip0->algo, pip0->symbol, (int)pip0->qty, (double)pip0->px);
         auto pip = std::make_shared<PositionInstruction>(pip0->algo, pip0->symbol, pip0->qty, pip0->px,pip0->target_utc, (PositionInstruction::TYPE) pip0->type);
+        const uint64_t cur_ns = utils::LatencyStats::now_ns();
+        if (pip0->sent_ns) {
+            m_pi_floor_lat.hist(pip->symbol)->record(cur_ns - pip0->sent_ns);
+        }
+        // the twap slices are scheduled, not counted in floor_order
+        if ((pip->type != PositionInstruction::TWAP) && (pip->type != PositionInstruction::TWAP2)) {
+            pip->recv_ns = cur_ns;
+        }
         addPositionInstruction(pip);
         m_msgout.copyString("Ack");
         return true;
@@ -219,10 +214,12 @@ namespace pm {
             const auto& old_pi(etinfo->_pi);
             if (old_pi->type == pi->type) {
                 m_et[pi->type]->onUpdate(pi, etinfo);
+                m_sched.update(etinfo);
                 return;
             }
             // remove that key
             logInfo("trader type switch detected for %s. New: (%s), Existing: (%s), removing existing", m_name.c_str(), pi->toString().c_str(), old_pi->toString().c_str());
+            m_sched.remove(etinfo);
             m_eiMap.erase(iter);
         }
         // should I handle it (type + symbol)
@@ -232,7 +229,9 @@ namespace pm {
             return;
         }
         logInfo("trader %s add PI(%s)", m_name.c_str(), pi->toString().c_str());
-        m_eiMap[key] = trader->onEntry(pi);
+        auto etinfo (trader->onEntry(pi));
+        m_eiMap[key] = etinfo;
+        m_sched.update(etinfo);
     }
 
     void FloorTrader::handleExecutionReport_derived(const pm::ExecutionReport& er) {
@@ -245,6 +244,7 @@ namespace pm {
         if (iter!=m_eiMap.end()) {
             auto& etinfo(iter->second);
             m_et[etinfo->_pi->type]->onER(er, etinfo);
+            m_sched.update(etinfo);
         }
     }
 
@@ -70,8 +70,11 @@
  *      etinfo's state such as done
  *
  *  run_loop_derived()
- *      scan through m_eiMap and run bool onRun(etinfo)
- *      if all false, then sleep a IdleSleepMicro
+ *      takes the due etinfo from m_sched and run bool onRun(etinfo)
+ *      then sleep until the next due, at most IdleSleepMicro.
+ *      The ETs reschedule by setting _next_micro and _done in
+ *      onEntry/onUpdate/onRun/onER, each followed by m_sched.update(),
+ *      done ones are not in m_sched until restarted
  *
  *  handlePositionReq_derived()
  *      handles set target position from C++ and user cmd 'X'
@@ -115,6 +118,9 @@ namespace pm {
         // only one type can active for algo+symbol at any time
         // see also handlePositionReq_derived()
         std::map<std::string, std::shared_ptr<ETInfo>> m_eiMap; 
+
+        // the etinfo of m_eiMap not done, by _next_micro
+        ETSchedule m_sched;
         
     private:
         enum {
@@ -123,6 +129,8 @@ namespace pm {
             MinSleepMicro        = 10,        // would spin instead
         };
         time_t m_last_onlyme_second;
+        std::vector<std::shared_ptr<ETInfo>> m_due;  // run in this loop
+        utils::LatencyHopCache m_pi_floor_lat;       // by symbol
         void addPositionInstruction(const std::shared_ptr<PositionInstruction> & pi);
         std::shared_ptr<ExecutionTrader> createTrader(int type, const std::string& trader_cfg_fn);
         void checkOnlyMe();
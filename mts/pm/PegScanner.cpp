@@ -0,0 +1,126 @@
+#include "PegScanner.h"
+#include "md_snap.h"
+#include <cmath>
+
+namespace pm {
+    PegScanner::PegScanner(const PositionManager& pm, PegFunc peg, ReplaceFunc replace)
+    : m_pm(pm), m_peg(peg), m_replace(replace), m_polled(0), m_hold_micro(0), m_sweep_micro(0) {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+    PegScanner::Symbol& PegScanner::add(const std::string& symbol) {
+        auto iter = m_sym.find(symbol);
+        if (iter != m_sym.end()) {
+            return iter->second;
+        }
+        auto& s (m_sym[symbol]);
+        s.lvc_id = md::LVCId(symbol);
+        if (s.lvc_id >= 0) {
+            ++m_polled;
+        }
+        return s;
+    }
+
+    void PegScanner::onER(const ExecutionReport& er) {
+        add(er.m_symbol).dirty = true;
+    }
+
+    bool PegScanner::touchMoved(Symbol& s) const {
+        md::LVCRec rec;
+        if (!md::LVC::get().read(s.lvc_id, rec)) {
+            return false;
+        }
+        if ((rec.bid.price == s.bidpx) && (rec.ask.price == s.askpx) &&
+            (rec.bid.size == s.bidsz) && (rec.ask.size == s.asksz)) {
+            return false;
+        }
+        s.bidpx = rec.bid.price;
+        s.askpx = rec.ask.price;
+        s.bidsz = rec.bid.size;
+        s.asksz = rec.ask.size;
+        return true;
+    }
+
+    int PegScanner::scan(uint64_t cur_micro) {
+        ++m_stats.scans;
+        if (__builtin_expect(cur_micro >= m_sweep_micro, 0)) {
+            m_sweep_micro = cur_micro + SweepIntervalMicro;
+            for (const auto& oo : m_pm.listOO()) {
+                add(oo->m_idp->get_symbol());
+            }
+        }
+        if (cur_micro < m_hold_micro) {
+            return 0;
+        }
+        int replaces = 0;
+        auto iter = m_sym.find(m_resume);
+        for (size_t cnt = m_sym.size(); cnt > 0; --cnt) {
+            if (iter == m_sym.end()) {
+                iter = m_sym.begin();
+            }
+            auto& s (iter->second);
+            const bool moved = (s.lvc_id >= 0) && touchMoved(s);
+            if ((!moved) && (!s.dirty) && (cur_micro < s.due_micro)) {
+                ++iter;
+                continue;
+            }
+            if (!evaluate(iter->first, s, cur_micro, replaces)) {
+                // no open orders
+                if (s.lvc_id >= 0) {
+                    --m_polled;
+                }
+                iter = m_sym.erase(iter);
+            } else {
+                ++iter;
+            }
+            if ((cur_micro < m_hold_micro) || (replaces >= MaxReplacesPerScan)) {
+                m_resume = (iter == m_sym.end())? "" : iter->first;
+                break;
+            }
+        }
+        return replaces;
+    }
+
+    uint64_t PegScanner::waitMicro(uint64_t max_micro) const {
+        return m_polled? _MIN_((uint64_t)PollMicro, max_micro) : max_micro;
+    }
+
+    bool PegScanner::evaluate(const std::string& symbol, Symbol& s, uint64_t cur_micro, int& replaces) {
+        ++m_stats.symbols;
+        s.dirty = false;
+        s.due_micro = (s.lvc_id >= 0)? (uint64_t)-1 : cur_micro + ScanIntervalMicro;
+        const auto& vec (m_pm.listOO(nullptr, &symbol));
+        if (!vec.size()) {
+            return false;
+        }
+        for (const auto& oo : vec) {
+            if (replaces >= MaxReplacesPerScan) {
+                // the rest on the next scan
+                s.dirty = true;
+                break;
+            }
+            if (cur_micro <= oo->m_open_micro + MinAgeMicro) {
+                // evaluated once aged
+                s.due_micro = _MIN_(s.due_micro, oo->m_open_micro + MinAgeMicro + 1);
+                continue;
+            }
+            ++m_stats.orders;
+            double px;
+            bool aggressive;
+            if ((!m_peg(oo, px, aggressive)) || (std::abs(px - oo->m_open_px) < 1e-10)) {
+                continue;
+            }
+            if (!m_replace(oo, px)) {
+                continue;
+            }
+            ++replaces;
+            ++m_stats.replaces;
+            if (aggressive) {
+                // wait for the round trip
+                m_hold_micro = cur_micro + AggHoldMicro;
+                break;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "PositionManager.h"
+#include <unordered_map>
+#include <functional>
+
+/*
+ * The peg scan of the FloorManager's open orders, driven by the moves of
+ * the touch instead of a timer over all open orders.
+ *
+ * Open orders are indexed by symbol.  A symbol is evaluated, i.e. its open
+ * orders peg()'ed and replace()'ed if the peg price differs, when
+ *   - the BBO (price or size) in the last value cache moved, polled
+ *     every PollMicro from the record of the symbol, a cache line
+ *   - an execution report of the symbol changed its open orders
+ *   - an open order of it ages over MinAgeMicro
+ *   - every ScanIntervalMicro for symbols not in the last value cache,
+ *     i.e. in simulation, as the timer scan before
+ * Symbols of other open orders, i.e. loaded at start, are picked up every
+ * SweepIntervalMicro.  After an aggressive replace, no order is replaced
+ * for AggHoldMicro to wait for the round trip.  At most MaxReplacesPerScan
+ * replaces are sent by a scan, the next scan resumes from the symbol
+ * after the last one evaluated, so that a move of many symbols at once
+ * is spread over the polls rather than sent in a burst.
+ */
+
+namespace pm {
+    class PegScanner {
+    public:
+        // whether oo is pegged, and if so, its peg price now and if the peg
+        // price is aggressive
+        using PegFunc = std::function<bool(const std::shared_ptr<const OpenOrder>& oo, double& px, bool& aggressive)>;
+
+        // replaces oo to px, returns false if not sent
+        using ReplaceFunc = std::function<bool(const std::shared_ptr<const OpenOrder>& oo, double px)>;
+
+        enum {
+            PollMicro          = 500,      // wait between polls of the cache
+            ScanIntervalMicro  = 100000,   // symbols not in the cache
+            SweepIntervalMicro = 1000000,  // open orders not from an er
+            MinAgeMicro        = 100000,   // before an open order is pegged
+            AggHoldMicro       = 2000000,  // after an aggressive replace
+            MaxReplacesPerScan = 4,        // the rest are sent on the next scans
+        };
+
+        struct Stats {
+            uint64_t scans;       // calls of scan()
+            uint64_t symbols;     // evaluated
+            uint64_t orders;      // peg()'ed
+            uint64_t replaces;    // sent
+        };
+
+        PegScanner(const PositionManager& pm, PegFunc peg, ReplaceFunc replace);
+
+        void onER(const ExecutionReport& er);
+        // the symbol of er is evaluated on the next scan
+
+        int scan(uint64_t cur_micro);
+        // evaluates the symbols moved, returns the replaces sent
+
+        uint64_t waitMicro(uint64_t max_micro) const;
+        // the wait before the next scan, at most max_micro
+
+        size_t symbols() const { return m_sym.size(); };
+        const Stats& stats() const { return m_stats; };
+
+    private:
+        struct Symbol {
+            int lvc_id;           // -1 if not in the last value cache
+            double bidpx, askpx;  // at the last evaluation
+            int bidsz, asksz;
+            uint64_t due_micro;   // evaluated then at the latest
+            bool dirty;           // open orders changed
+            Symbol() : lvc_id(-1), bidpx(0), askpx(0), bidsz(0), asksz(0), due_micro(0), dirty(true) {};
+        };
+
+        const PositionManager& m_pm;
+        PegFunc m_peg;
+        ReplaceFunc m_replace;
+        std::unordered_map<std::string, Symbol> m_sym;
+        size_t m_polled;           // symbols in the cache
+        uint64_t m_hold_micro;     // no replace until
+        uint64_t m_sweep_micro;    // next sweep of all open orders
+        std::string m_resume;      // the symbol the next scan starts from
+        Stats m_stats;
+
+        Symbol& add(const std::string& symbol);
+        bool touchMoved(Symbol& s) const;
+        bool evaluate(const std::string& symbol, Symbol& s, uint64_t cur_micro, int& replaces);
+    };
+};
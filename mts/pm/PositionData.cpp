@@ -28,14 +28,54 @@ namespace pm {
             throw std::runtime_error(tokens[1] + ": symbol not found!");
         }
         m_contract_size = getPointValue();
-        int64_t qty = std::stoll(tokens[2]);
-        double vap = std::stod(tokens[3]);
+        int64_t qty = utils::CSVUtil::parse<long long>(tokens[2]);
+        double vap = utils::CSVUtil::parse<double>(tokens[3]);
         // intra-day realized pnl starts with 0
         //double pnl = std::stod(tokens[4]);
-        m_last_micro = std::stoll(tokens[5]);
+        m_last_micro = utils::CSVUtil::parse<long long>(tokens[5]);
         resetPositionUnsafe(qty, vap, m_last_micro);
     }
 
+    IntraDayPosition::IntraDayPosition(const PositionCheckpoint& ckpt, const OpenOrderCheckpoint* oo_ckpt)
+    : m_algo(ckpt.m_algo), m_symbol(ckpt.m_symbol), m_contract_size(getPointValue()),
+      m_qty(ckpt.m_qty), m_vap(ckpt.m_vap), m_pnl(ckpt.m_pnl), m_last_micro(ckpt.m_last_micro)
+    {
+        for (int i=0; i<ckpt.m_oo_cnt; ++i) {
+            const auto& ooc (oo_ckpt[i]);
+            auto oo = std::make_shared<OpenOrder>(this);
+            memcpy(oo->m_clOrdId, ooc.m_clOrdId, sizeof(IDType));
+            oo->m_clOrdId[IDLen-1] = 0;
+            oo->m_ord_qty = ooc.m_ord_qty;
+            oo->m_open_qty = ooc.m_open_qty;
+            oo->m_open_px = ooc.m_open_px;
+            oo->m_open_micro = ooc.m_open_micro;
+            m_oo.emplace(oo->m_clOrdId, oo);
+        }
+    }
+
+    PositionCheckpoint IntraDayPosition::toCheckpoint(std::vector<OpenOrderCheckpoint>& oo_ckpt) const {
+        PositionCheckpoint ckpt;
+        memset(&ckpt, 0, sizeof(ckpt));
+        strncpy(ckpt.m_algo, m_algo.c_str(), sizeof(SymbolType)-1);
+        strncpy(ckpt.m_symbol, m_symbol.c_str(), sizeof(SymbolType)-1);
+        ckpt.m_qty = m_qty;
+        ckpt.m_vap = m_vap;
+        ckpt.m_pnl = m_pnl;
+        ckpt.m_last_micro = m_last_micro;
+        ckpt.m_oo_cnt = (int32_t) m_oo.size();
+        for (const auto& oop : m_oo) {
+            const auto& oo (*oop.second);
+            OpenOrderCheckpoint ooc;
+            memcpy(ooc.m_clOrdId, oo.m_clOrdId, sizeof(IDType));
+            ooc.m_ord_qty = oo.m_ord_qty;
+            ooc.m_open_qty = oo.m_open_qty;
+            ooc.m_open_px = oo.m_open_px;
+            ooc.m_open_micro = oo.m_open_micro;
+            oo_ckpt.push_back(ooc);
+        }
+        return ckpt;
+    }
+
     IntraDayPosition::~IntraDayPosition() {}
 
     void IntraDayPosition::update(const ExecutionReport& er) {
@@ -213,8 +253,8 @@ namespace pm {
         const auto* ti = utils::SymbolMapReader::get().getByTradable(m_symbol);
         for (const auto& line: prev_vec) {
             if ( (line[0] == m_algo) && (line[1] == ti->_mts_contract) ) {
-                const double last_mtm = std::stod(line[4]);  // refer to toCSVLineMtm() for position
-                const double last_pnl = std::stod(line[5]);
+                const double last_mtm = utils::CSVUtil::parse<double>(line[4]);  // refer to toCSVLineMtm() for position
+                const double last_pnl = utils::CSVUtil::parse<double>(line[5]);
                 return this->toCSVLine(true, -(last_mtm-last_pnl), ref_px);
             }
         }
@@ -23,6 +23,27 @@ namespace pm {
     struct OpenOrder;
         // Forward declaration of open order data structure
 
+    // binary records of the intra-day position and its open orders,
+    // see PositionManager::checkpoint()
+    struct PositionCheckpoint {
+        SymbolType m_algo;
+        SymbolType m_symbol;
+        int64_t m_qty;
+        double m_vap;
+        double m_pnl;
+        uint64_t m_last_micro;
+        int32_t m_oo_cnt;  // number of OpenOrderCheckpoint following
+        int32_t m_reserved;
+    };
+
+    struct OpenOrderCheckpoint {
+        IDType m_clOrdId;
+        int64_t m_ord_qty;
+        int64_t m_open_qty;
+        double m_open_px;
+        uint64_t m_open_micro;
+    };
+
     class IntraDayPosition {
     public:
         IntraDayPosition();
@@ -41,6 +62,13 @@ namespace pm {
         explicit IntraDayPosition(const utils::CSVUtil::LineTokens& tokens);
             // create intra-day position from a csv line
 
+        IntraDayPosition(const PositionCheckpoint& ckpt, const OpenOrderCheckpoint* oo_ckpt);
+            // create intra-day position from a checkpoint, with the realized pnl
+            // and ckpt.m_oo_cnt open orders from oo_ckpt
+
+        PositionCheckpoint toCheckpoint(std::vector<OpenOrderCheckpoint>& oo_ckpt) const;
+            // returns the checkpoint of this position, with open orders appended to oo_ckpt
+
         ~IntraDayPosition();
 
         void update(const ExecutionReport& er);
@@ -8,6 +8,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "plcc/PLCC.hpp"
 #include "csv_util.h"
@@ -18,11 +19,35 @@
 
 #define EoDPositionCSVFile "eod_pos"
 #define FillCSVFile "fills.csv"
+#define CheckpointFile "pm.ckpt"
 
 namespace pm {
+    // execution reports received this much before the latest one of a
+    // checkpoint are replayed on load, in case they are not yet updated.
+    // All kinds of execution reports received within it are deduplicated,
+    // see updateThisER()
+    static const int ReplayMarginSec = 60;
+
+    struct CheckpointHeader {
+        char magic[8];
+        int32_t pos_cnt;
+        int32_t oo_cnt;
+        int32_t er_cnt;
+        int32_t reserved;
+        uint64_t cut_micro;    // the latest receive time of the execution reports
+        uint64_t load_micro;   // replay from this time on load
+        uint64_t write_micro;
+    };
+    static const char* CheckpointMagic = "MTSPMC2";
+
+    struct CheckpointER {
+        char key[SymbolLen+2*IDLen+32];  // key of m_fill_execid or m_recent_er_key
+        int64_t is_fill;
+    };
+
     PositionManager::PositionManager(const std::string& name, const std::string& recover_path) :
     m_name(name), m_recovery_path(recover_path.size()==0? plcc_getString("RecoveryPath"): recover_path),
-    m_load_second(loadEoD()), m_last_micro(0)
+    m_last_micro(0), m_max_recv_micro(0), m_load_second(loadEoD())
     {}
 
     std::string PositionManager::getLoadUtc() const {
@@ -47,6 +72,10 @@ namespace pm {
         return m_recovery_path + "/" + EoDPositionCSVFile + "_mtm.csv";
     }
 
+    std::string PositionManager::checkpoint_file() const {
+        return m_recovery_path + "/" + m_name + "_" + CheckpointFile;
+    }
+
     std::string PositionManager::fill_csv() const {
         // getting current (snap to previous) trading day 
         const auto utc_second  { (time_t) (utils::TimeUtil::cur_micro() / 1000000ULL) };
@@ -99,6 +128,9 @@ namespace pm {
 
     std::string PositionManager::loadEoD() {
         std::string latest_day;
+        if (loadCheckpoint(latest_day)) {
+            return latest_day;
+        }
         const auto& line_vec(loadEoD_CSVLines(eod_csv(), &latest_day));
         for (auto& token_vec: line_vec) {
             try {
@@ -115,8 +147,7 @@ namespace pm {
                     // we find a duplicated line, failed
                     throw std::runtime_error(std::string("PM load failed: duplicated position found: ") + idp->toString());
                 }
-                m_algo_pos[algo][symbol]=idp;
-                m_symbol_pos[symbol][algo]=idp;
+                addPosition(algo, symbol, idp);
             } catch (const std::exception& e) {
                 logError("Failed to read position: %s, please check position!", e.what());
             }
@@ -129,6 +160,15 @@ namespace pm {
         // this could happen if the recovery overlaps with real-time
         // fills, or otherwise a previous fill is resent
         bool is_newfill = false;
+        // the non-fills replayed after a checkpoint load are not applied
+        // again, i.e. a new order ack would reset the open qty of the fills
+        // that followed it.  The fills are checked after the risk, which
+        // checks haveThisFill() itself
+        if ((!er.isFill()) && updateThisER(er)) {
+            logInfo("update(): Warning! duplicated execution report not updated: %s", er.toString().c_str());
+            return false;
+        }
+
         // make sure we update risk before update pm
         if (update_risk) {
             bool ret = risk::Monitor::get().updateER(er, *this, do_notify_pause);
@@ -139,7 +179,7 @@ namespace pm {
 
         if (er.isFill()) {
             is_newfill = true;
-            if ( updateThisFill(er) ) {
+            if ( updateThisER(er) ) {
                 logInfo("update(): Warning! duplicated fill not updated: %s", er.toString().c_str());
                 return false;
             }
@@ -154,11 +194,11 @@ namespace pm {
         auto idp = m_algo_pos[er.m_algo][er.m_symbol];
         if (!idp) {
             idp = std::make_shared<IntraDayPosition>(er.m_symbol, er.m_algo);
-            m_algo_pos[er.m_algo][er.m_symbol] = idp;
-            m_symbol_pos[er.m_symbol][er.m_algo] = idp;
+            addPosition(er.m_algo, er.m_symbol, idp);
         }
         idp->update(er);
         m_last_micro = er.m_recv_micro;
+        m_max_recv_micro = _MAX_(m_max_recv_micro, er.m_recv_micro);
 
         // if it's a fill, need to persist
         if (persist_fill && er.isFill()) {
@@ -287,6 +327,133 @@ namespace pm {
         return utils::CSVUtil::write_file(line_vec, eod_csv());
     }
 
+    bool PositionManager::checkpoint() const {
+        // write to a temp file and rename, so a crash during the write
+        // leaves the previous checkpoint
+        std::vector<PositionCheckpoint> pos_vec;
+        std::vector<OpenOrderCheckpoint> oo_vec;
+        for (const auto& ap: m_algo_pos) {
+            for (const auto& sp: ap.second) {
+                if (sp.second) {
+                    pos_vec.push_back(sp.second->toCheckpoint(oo_vec));
+                }
+            }
+        }
+        std::vector<CheckpointER> er_vec(m_recent_er.size());
+        for (size_t i=0; i<m_recent_er.size(); ++i) {
+            const auto& key (m_recent_er[i].second);
+            memset(&er_vec[i], 0, sizeof(CheckpointER));
+            strncpy(er_vec[i].key, key.c_str(), sizeof(er_vec[i].key)-1);
+            er_vec[i].is_fill = (m_recent_er_key.find(key) == m_recent_er_key.end());
+        }
+
+        CheckpointHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        strcpy(hdr.magic, CheckpointMagic);
+        hdr.pos_cnt = (int32_t) pos_vec.size();
+        hdr.oo_cnt = (int32_t) oo_vec.size();
+        hdr.er_cnt = (int32_t) er_vec.size();
+        hdr.cut_micro = m_max_recv_micro;
+        // replay from the margin before the latest execution report, duplicated
+        // reports are detected with the recent ones.  Not before the load time,
+        // as the fills before it are in the loaded position
+        hdr.load_micro = utils::TimeUtil::string_to_frac_UTC(m_load_second.c_str(), 0) * 1000000ULL;
+        if (hdr.cut_micro > hdr.load_micro + ReplayMarginSec*1000000ULL) {
+            hdr.load_micro = hdr.cut_micro - ReplayMarginSec*1000000ULL;
+        }
+        hdr.write_micro = utils::TimeUtil::cur_micro();
+
+        const std::string fname (checkpoint_file());
+        const std::string tmp_fname (fname + ".tmp");
+        FILE* fp = fopen(tmp_fname.c_str(), "wb");
+        if (!fp) {
+            logError("Failed to create checkpoint file %s", tmp_fname.c_str());
+            return false;
+        }
+        bool ret = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1) &&
+                   (fwrite(pos_vec.data(), sizeof(PositionCheckpoint), pos_vec.size(), fp) == pos_vec.size()) &&
+                   (fwrite(oo_vec.data(), sizeof(OpenOrderCheckpoint), oo_vec.size(), fp) == oo_vec.size()) &&
+                   (fwrite(er_vec.data(), sizeof(CheckpointER), er_vec.size(), fp) == er_vec.size()) &&
+                   (fflush(fp) == 0) && (fsync(fileno(fp)) == 0);
+        fclose(fp);
+        if (!ret || (std::rename(tmp_fname.c_str(), fname.c_str()) != 0)) {
+            logError("Failed to write checkpoint file %s", fname.c_str());
+            std::remove(tmp_fname.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool PositionManager::loadCheckpoint(std::string& load_second) {
+        const std::string fname (checkpoint_file());
+        struct stat ckpt_info, eod_info;
+        if (stat(fname.c_str(), &ckpt_info) != 0) {
+            return false;
+        }
+        if ((stat(eod_csv().c_str(), &eod_info) == 0) && (eod_info.st_mtime > ckpt_info.st_mtime)) {
+            logInfo("checkpoint %s older than %s, not loaded", fname.c_str(), eod_csv().c_str());
+            return false;
+        }
+
+        FILE* fp = fopen(fname.c_str(), "rb");
+        if (!fp) {
+            return false;
+        }
+        CheckpointHeader hdr;
+        std::vector<PositionCheckpoint> pos_vec;
+        std::vector<OpenOrderCheckpoint> oo_vec;
+        std::vector<CheckpointER> er_vec;
+        bool ret = (fread(&hdr, sizeof(hdr), 1, fp) == 1) &&
+                   (strncmp(hdr.magic, CheckpointMagic, sizeof(hdr.magic)) == 0) &&
+                   (hdr.pos_cnt >= 0) && (hdr.oo_cnt >= 0) && (hdr.er_cnt >= 0);
+        if (ret) {
+            pos_vec.resize(hdr.pos_cnt);
+            oo_vec.resize(hdr.oo_cnt);
+            er_vec.resize(hdr.er_cnt);
+            ret = (fread(pos_vec.data(), sizeof(PositionCheckpoint), pos_vec.size(), fp) == pos_vec.size()) &&
+                  (fread(oo_vec.data(), sizeof(OpenOrderCheckpoint), oo_vec.size(), fp) == oo_vec.size()) &&
+                  (fread(er_vec.data(), sizeof(CheckpointER), er_vec.size(), fp) == er_vec.size());
+        }
+        fclose(fp);
+        if (!ret) {
+            logError("Failed to read checkpoint file %s, loading from EoD position", fname.c_str());
+            return false;
+        }
+
+        size_t oo_pos = 0;
+        for (const auto& pc: pos_vec) {
+            if ((pc.m_oo_cnt < 0) || (oo_pos + pc.m_oo_cnt > oo_vec.size())) {
+                logError("Bad open order count in checkpoint file %s", fname.c_str());
+                break;
+            }
+            try {
+                auto idp = std::make_shared<IntraDayPosition>(pc, oo_vec.data() + oo_pos);
+                oo_pos += pc.m_oo_cnt;
+                addPosition(idp->get_algo(), idp->get_symbol(), idp);
+                for (const auto& oo: idp->listOO()) {
+                    m_oo_map[oo->m_clOrdId] = oo;
+                }
+            } catch (const std::exception& e) {
+                logError("Failed to read position: %s, please check position!", e.what());
+            }
+        }
+        for (const auto& cer: er_vec) {
+            const std::string key (cer.key, strnlen(cer.key, sizeof(cer.key)));
+            if (cer.is_fill) {
+                m_fill_execid.insert(key);
+            } else {
+                m_recent_er_key.insert(key);
+            }
+            m_recent_er.emplace_back(hdr.cut_micro, key);
+        }
+        m_last_micro = hdr.cut_micro;
+        m_max_recv_micro = hdr.cut_micro;
+        load_second = utils::TimeUtil::frac_UTC_to_string(hdr.load_micro/1000000ULL, 0);
+        logInfo("loaded checkpoint %s: %d positions, %d open orders, %d recent execution reports, load time %s",
+                fname.c_str(), hdr.pos_cnt, hdr.oo_cnt, hdr.er_cnt, load_second.c_str());
+        return true;
+    }
+
     bool PositionManager::operator==(const PositionManager& pm) const {
         return (diff(pm)+pm.diff(*this)).size()==0;
     }
@@ -382,31 +549,36 @@ namespace pm {
     }
 
     int64_t PositionManager::getPosition_Market(const std::string* algo_p, const std::string* mkt_p, double* mtm_pnl_p) const {
-        std::vector<std::string> algos;
+        int algo_id = -1, mkt_id = -1;
         if (algo_p) {
-            if (__builtin_expect( m_algo_pos.find(*algo_p) == m_algo_pos.end(), 0)) {
+            const auto iter = m_algo_id.find(*algo_p);
+            if (__builtin_expect( iter == m_algo_id.end(), 0)) {
                 logInfo("PositionManager: no position found for algo %s", (*algo_p).c_str());
                 if (mtm_pnl_p) *mtm_pnl_p=0;
                 return 0;
             }
-            algos.push_back(*algo_p);
-        } else {
-            for (const auto& al: m_algo_pos) {
-                algos.push_back(al.first);
+            algo_id = iter->second;
+        }
+        if (mkt_p) {
+            const auto iter = m_mkt_id.find(*mkt_p);
+            if (iter == m_mkt_id.end()) {
+                // no position in this market
+                if (mtm_pnl_p) *mtm_pnl_p=0;
+                return 0;
             }
+            mkt_id = iter->second;
         }
         int64_t qty = 0;
         double mtm_pnl = 0;
-        for (const auto& algo: algos) {
-            std::vector<std::string> symbols;
-            for (const auto& sym : m_algo_pos.find(algo)->second) {
-                const auto& tradable (sym.first);
-                if ((!mkt_p) || (*mkt_p == utils::SymbolMapReader::get().getTradableMkt(tradable))) {
-                    const auto& idp(sym.second);
-                    qty += idp->getPosition();
-                    qty += idp->getOpenQty();
+        const int id0 = algo_p? algo_id : 0;
+        const int id1 = algo_p? algo_id+1 : (int)m_algo_mkt_pos.size();
+        for (int id = id0; id < id1; ++id) {
+            for (const auto& mp : m_algo_mkt_pos[id]) {
+                if ((!mkt_p) || (mp.mkt_id == mkt_id)) {
+                    qty += mp.idp->getPosition();
+                    qty += mp.idp->getOpenQty();
                     if (mtm_pnl_p) {
-                        mtm_pnl += idp->getMtmPnl();
+                        mtm_pnl += mp.idp->getMtmPnl();
                     }
                 }
             }
@@ -417,6 +589,37 @@ namespace pm {
         return qty;
     }
 
+    void PositionManager::addPosition(const std::string& algo, const std::string& symbol, const std::shared_ptr<IntraDayPosition>& idp) {
+        m_algo_pos[algo][symbol] = idp;
+        m_symbol_pos[symbol][algo] = idp;
+
+        auto aiter = m_algo_id.find(algo);
+        if (aiter == m_algo_id.end()) {
+            aiter = m_algo_id.emplace(algo, (int)m_algo_mkt_pos.size()).first;
+            m_algo_mkt_pos.emplace_back();
+        }
+        const auto& mkt (utils::SymbolMapReader::get().getTradableMkt(symbol));
+        auto miter = m_mkt_id.find(mkt);
+        if (miter == m_mkt_id.end()) {
+            miter = m_mkt_id.emplace(mkt, (int)m_mkt_id.size()).first;
+        }
+        m_algo_mkt_pos[aiter->second].push_back(MktPosition{miter->second, idp.get()});
+    }
+
+    void PositionManager::buildIdIndex() {
+        m_algo_id.clear();
+        m_mkt_id.clear();
+        m_algo_mkt_pos.clear();
+        // only the existing entries are assigned by addPosition()
+        for (const auto& ap: m_algo_pos) {
+            for (const auto& sp: ap.second) {
+                if (sp.second) {
+                    addPosition(ap.first, sp.first, sp.second);
+                }
+            }
+        }
+    }
+
     std::vector<std::shared_ptr<const IntraDayPosition> > PositionManager::listPosition(const std::string* algo, const std::string* symbol) const {
         std::vector<std::shared_ptr<const IntraDayPosition> > vec;
         if (algo && (*algo).size()) {
@@ -544,6 +747,33 @@ namespace pm {
         }
     }
 
+    void PositionManager::retain(const std::function<bool(const std::string& symbol)>& keep) {
+        for (auto iter = m_symbol_pos.begin(); iter != m_symbol_pos.end(); ) {
+            if (keep(iter->first)) {
+                ++iter;
+                continue;
+            }
+            for (const auto& ap : iter->second) {
+                auto aiter = m_algo_pos.find(ap.first);
+                if (aiter != m_algo_pos.end()) {
+                    aiter->second.erase(iter->first);
+                    if (!aiter->second.size()) {
+                        m_algo_pos.erase(aiter);
+                    }
+                }
+            }
+            iter = m_symbol_pos.erase(iter);
+        }
+        for (auto iter = m_oo_map.begin(); iter != m_oo_map.end(); ) {
+            if (keep(iter->second->m_idp->get_symbol())) {
+                ++iter;
+            } else {
+                iter = m_oo_map.erase(iter);
+            }
+        }
+        buildIdIndex();
+    }
+
     double PositionManager::getPnl(const std::string* algo, 
                   const std::string* symbol) const {
         const auto vec = listPosition(algo, symbol);
@@ -560,13 +790,20 @@ namespace pm {
         logInfo("%s gets all positions from %s", m_name.c_str(), pm.m_name.c_str());
         m_algo_pos = pm.m_algo_pos;
         m_symbol_pos = pm.m_symbol_pos;
+        buildIdIndex();
         m_last_micro = pm.m_last_micro;
+        m_max_recv_micro = pm.m_max_recv_micro;
         m_fill_execid = pm.m_fill_execid;
+        m_recent_er = pm.m_recent_er;
+        m_recent_er_key = pm.m_recent_er_key;
     }
 
     std::string PositionManager::toString(const std::string* ptr_algo, const std::string* ptr_symbol, bool summary) const {
+        return toString(listPosition(ptr_algo, ptr_symbol), summary);
+    }
+
+    std::string PositionManager::toString(const std::vector<std::shared_ptr<const IntraDayPosition> >& idp_vec, bool summary) {
         std::string ret;
-        const auto idp_vec(listPosition(ptr_algo, ptr_symbol));
         if (idp_vec.size() == 0) {
             return "Nothing Found.";
         }
@@ -611,13 +848,34 @@ namespace pm {
         return ret;
     }
 
-    bool PositionManager::updateThisFill(const ExecutionReport& er) {
-        // assuming this er is a fill, check to see if we have seen this er
-        const std::string key = std::string(er.m_execId) + std::string(er.m_clOrdId);
-        if (m_fill_execid.find(key) != m_fill_execid.end()) {
-            return true;
+    bool PositionManager::updateThisER(const ExecutionReport& er) {
+        // check to see if we have seen this er.  Fills are keyed by execId and
+        // clOrdId and kept for haveThisFill(), the other reports are keyed by
+        // status, cumQty, symbol, execId and clOrdId and kept within ReplayMarginSec,
+        // the symbol as the mleg underlying updates share the clOrdId of the mleg
+        const bool is_fill = er.isFill();
+        std::string key;
+        if (is_fill) {
+            key = std::string(er.m_execId) + std::string(er.m_clOrdId);
+            if (m_fill_execid.find(key) != m_fill_execid.end()) {
+                return true;
+            }
+            m_fill_execid.insert(key);
+        } else {
+            key = std::string(er.m_tag39) + "/" + std::to_string(er.m_reserved) + "/" +
+                  std::string(er.m_symbol) + "/" + std::string(er.m_execId) + "/" + std::string(er.m_clOrdId);
+            if (!m_recent_er_key.insert(key).second) {
+                return true;
+            }
+        }
+        m_recent_er.emplace_back(er.m_recv_micro, key);
+        const uint64_t max_recv_micro = _MAX_(m_max_recv_micro, er.m_recv_micro);
+        while ((m_recent_er.size() > 0) &&
+               (m_recent_er.front().first + ReplayMarginSec*1000000ULL < max_recv_micro)) {
+            // fill keys are not in m_recent_er_key
+            m_recent_er_key.erase(m_recent_er.front().second);
+            m_recent_er.pop_front();
         }
-        m_fill_execid.insert(key);
         return false;
     }
 
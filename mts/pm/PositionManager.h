@@ -6,6 +6,8 @@
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
+#include <deque>
+#include <functional>
 
 namespace pm {
     using PositionMap = std::map<std::string, std::map<std::string, std::shared_ptr<IntraDayPosition> > >;
@@ -33,11 +35,25 @@ namespace pm {
         void deleteOO(const char* clOrdId);
         // delete an open order, not from execution report
 
+        void retain(const std::function<bool(const std::string& symbol)>& keep);
+        // keeps only the positions and open orders of the symbols that keep() is
+        // true, i.e. the markets of a shard, see PositionShards
+
         void resetPnl();
         // reset daily pnl to be 0
         
         bool persist() const;
         // writes the intraday positions to EoDPosition
+
+        bool checkpoint() const;
+        // writes the intra-day positions, open orders and the recent execution reports to
+        // checkpoint_file(), loaded instead of EoDPosition by the constructor
+        // if not older than it.  The load utc becomes ReplayMarginSec before
+        // the latest execution report (but not before the previous load utc),
+        // so only the tail of the replay is needed.
+
+        uint64_t getMaxRecvMicro() const { return m_max_recv_micro; };
+        // the latest receive time of the execution reports updated
         
         int64_t getPosition(const std::string& algo, const std::string& symbol, 
                            double* vap=nullptr, double* pnl=nullptr, int64_t* oqty=nullptr, 
@@ -100,6 +116,8 @@ namespace pm {
         std::string getRecoveryPath() const { return m_recovery_path; };
 
         std::string toString(const std::string* ptr_algo=nullptr, const std::string* ptr_symbol=nullptr, bool summary=false) const;
+        static std::string toString(const std::vector<std::shared_ptr<const IntraDayPosition> >& idp_vec, bool summary);
+        // the positions and open orders of idp_vec as toString()
 
         // const utilities 
         std::string eod_csv() const;
@@ -109,6 +127,8 @@ namespace pm {
         // get name of eod position csv file
         std::string fill_csv() const;
         // get the name of fill csv file
+        std::string checkpoint_file() const;
+        // get the name of the binary checkpoint file
         bool isMLegUnderlyingUpdate(const ExecutionReport& er) const;
         // whether this er is for underlying of a mleg order that is currently open
         // used to determine if open order map should be updated by this er
@@ -116,22 +136,49 @@ namespace pm {
         const utils::CSVUtil::FileTokens loadEoD_CSVLines(const std::string& eod_file, std::string* latest_day_ptr) const;
 
         bool haveThisFill(const ExecutionReport& er) const;
+        // the keys of the fills applied, as checked by haveThisFill()
+        const std::unordered_set<std::string>& getFillKeys() const { return m_fill_execid; };
 
     protected:
         const std::string m_name;
         const std::string m_recovery_path;
         PositionMap m_algo_pos;
         PositionMap m_symbol_pos;
-        const std::string m_load_second;
+        // algo and market are interned to dense ids when a position is added,
+        // and the positions of each algo are listed by algo_id with the market
+        // id, so the aggregations of getPosition_Market() only compare ints.
+        struct MktPosition {
+            int mkt_id;
+            const IntraDayPosition* idp;  // owned by m_algo_pos
+        };
+        std::unordered_map<std::string, int> m_algo_id;
+        std::unordered_map<std::string, int> m_mkt_id;
+        std::vector<std::vector<MktPosition> > m_algo_mkt_pos;
         uint64_t m_last_micro;
+        uint64_t m_max_recv_micro;
         std::unordered_set<std::string> m_fill_execid;
 
+        // the execution reports received within ReplayMarginSec of m_max_recv_micro,
+        // as (recv_micro, key), for the checkpoint.  The keys of the fills are in
+        // m_fill_execid, the keys of the others in m_recent_er_key
+        std::deque<std::pair<uint64_t, std::string> > m_recent_er;
+        std::unordered_set<std::string> m_recent_er_key;
+
         // this is a map used to fast find OO from clOrdId, otherwise
         // we will have to go through all the idp to find the OO.
         std::unordered_map<std::string, std::shared_ptr<const OpenOrder> > m_oo_map;
 
+        const std::string m_load_second;
+
+        void addPosition(const std::string& algo, const std::string& symbol, const std::shared_ptr<IntraDayPosition>& idp);
+        // adds idp to m_algo_pos, m_symbol_pos and the id index
+        void buildIdIndex();
+        // rebuild the id index from m_algo_pos
+
         std::string loadEoD();
         // for each position, check with pm
+        bool loadCheckpoint(std::string& load_second);
+        // loads checkpoint_file() if it is not older than eod_csv()
         
         template<typename V, typename MIter>
         void addAllMapVal(V& vec, const MIter& iter1, const MIter& iter2) const {
@@ -140,7 +187,8 @@ namespace pm {
             };
         }
 
-        bool updateThisFill(const ExecutionReport& er);
+        bool updateThisER(const ExecutionReport& er);
+        // returns true if er is already applied, otherwise records it
     };
 };
 
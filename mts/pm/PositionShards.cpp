@@ -0,0 +1,236 @@
+#include "PositionShards.h"
+#include "RiskMonitor.h"
+#include "latency_stats.h"
+#include "time_util.h"
+
+namespace pm {
+    std::shared_ptr<const IntraDayPosition> PositionShards::Snapshot::idp(size_t i) const {
+        // the open orders of pos i follow those of the previous
+        size_t oo_start = 0;
+        for (size_t k=0; k<i; ++k) {
+            oo_start += pos[k].m_oo_cnt;
+        }
+        return std::make_shared<const IntraDayPosition>(pos[i], oo.data() + oo_start);
+    }
+
+    PositionShards::PositionShards(const std::string& name, int shards, const std::string& recover_path)
+    : m_name(name), m_posted(0), m_should_run(false) {
+        if (shards < 1) {
+            throw std::runtime_error(name + ": PositionShards needs at least one shard");
+        }
+        for (int i=0; i<shards; ++i) {
+            m_shard.emplace_back(new Shard());
+        }
+        for (int i=0; i<shards; ++i) {
+            auto& sh (*m_shard[i]);
+            sh.pm.reset(new PositionManager(name, recover_path));
+            sh.pm->retain([this, i](const std::string& symbol) {
+                    return shardOf(symbol) == i;
+                });
+            publish(sh, 0);
+        }
+        // the shards are loaded with the same fills
+        m_router_fill = m_shard[0]->pm->getFillKeys();
+    }
+
+    PositionShards::~PositionShards() {
+        stop();
+    }
+
+    void PositionShards::start() {
+        if (m_should_run) {
+            return;
+        }
+        m_should_run = true;
+        for (auto& sh : m_shard) {
+            Shard* shp = sh.get();
+            sh->th = std::thread([this, shp]() { run(*shp); });
+        }
+        logInfo("%s PositionShards started with %d shards", m_name.c_str(), shards());
+    }
+
+    void PositionShards::stop() {
+        if (!m_should_run) {
+            return;
+        }
+        drain();
+        m_should_run = false;
+        for (auto& sh : m_shard) {
+            if (sh->th.joinable()) {
+                sh->th.join();
+            }
+        }
+    }
+
+    int PositionShards::shardOfMkt(const std::string& mkt) const {
+        return (int) (std::hash<std::string>()(mkt) % m_shard.size());
+    }
+
+    int PositionShards::shardOf(const std::string& symbol) const {
+        // symbols not in the map, i.e. a reject without symbol, have mkt ""
+        return shardOfMkt(utils::SymbolMapReader::get().getTradableMkt(symbol));
+    }
+
+    void PositionShards::post(const ExecutionReport& er, uint64_t recv_ns) {
+        auto iter = m_router_shard.find(er.m_symbol);
+        if (__builtin_expect(iter == m_router_shard.end(), 0)) {
+            iter = m_router_shard.emplace(er.m_symbol, shardOf(er.m_symbol)).first;
+        }
+        auto& sh (*m_shard[iter->second]);
+        const uint64_t h = sh.head.load(std::memory_order_relaxed);
+        while (__builtin_expect(h - sh.tail.load(std::memory_order_acquire) >= RingSize, 0)) {
+            // full, wait for the worker
+            std::this_thread::yield();
+        }
+        if (er.isFill()) {
+            m_router_fill.insert(std::string(er.m_execId) + std::string(er.m_clOrdId));
+        }
+        auto& slot (sh.ring[h & (RingSize-1)]);
+        slot.er = er;
+        slot.recv_ns = recv_ns? recv_ns : utils::LatencyStats::now_ns();
+        sh.head.store(h+1, std::memory_order_release);
+        ++m_posted;
+    }
+
+    bool PositionShards::postRisk(const ExecutionReport& er, bool do_pause_notify, uint64_t recv_ns) {
+        const bool ret = risk::Monitor::get().updateER(er, *this, do_pause_notify);
+        if (__builtin_expect(!ret, 0)) {
+            logError("PositionShards update er resulted in risk violation");
+        }
+        post(er, recv_ns);
+        return ret;
+    }
+
+    bool PositionShards::haveThisFill(const ExecutionReport& er) const {
+        const std::string key = std::string(er.m_execId) + std::string(er.m_clOrdId);
+        return (m_router_fill.find(key) != m_router_fill.end());
+    }
+
+    void PositionShards::drain() const {
+        for (const auto& sh : m_shard) {
+            const uint64_t h = sh->head.load(std::memory_order_acquire);
+            while (sh->published.load(std::memory_order_acquire) < h) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    uint64_t PositionShards::applied() const {
+        uint64_t cnt = 0;
+        for (const auto& sh : m_shard) {
+            cnt += sh->published.load(std::memory_order_acquire);
+        }
+        return cnt;
+    }
+
+    std::shared_ptr<const PositionShards::Snapshot> PositionShards::snapshot(int shard) const {
+        return std::atomic_load(&m_shard[shard]->snap);
+    }
+
+    void PositionShards::run(Shard& sh) {
+        int idle = 0;
+        while (true) {
+            const uint64_t t = sh.tail.load(std::memory_order_relaxed);
+            uint64_t h = sh.head.load(std::memory_order_acquire);
+            if (t == h) {
+                if (!m_should_run) {
+                    break;
+                }
+                if (++idle < IdleSpin) {
+                    std::this_thread::yield();
+                } else {
+                    utils::TimeUtil::micro_sleep(IdleSleepMicro);
+                }
+                continue;
+            }
+            idle = 0;
+            // apply the batch, then publish and ack it.  The batch is
+            // limited so that a fill burst is acked as it is applied
+            h = (h - t > MaxBatch)? t + MaxBatch : h;
+            for (uint64_t i=t; i<h; ++i) {
+                sh.pm->update(sh.ring[i & (RingSize-1)].er);
+            }
+            publish(sh, h);
+            if (m_ack) {
+                for (uint64_t i=t; i<h; ++i) {
+                    const auto& slot (sh.ring[i & (RingSize-1)]);
+                    m_ack(slot.er, slot.recv_ns);
+                }
+            }
+            sh.published.store(h, std::memory_order_release);
+            sh.tail.store(h, std::memory_order_release);
+        }
+    }
+
+    void PositionShards::publish(Shard& sh, uint64_t applied) {
+        auto snap = std::make_shared<Snapshot>();
+        const auto& idp_vec (sh.pm->listPosition());
+        snap->pos.reserve(idp_vec.size());
+        for (const auto& idp : idp_vec) {
+            snap->pos.push_back(idp->toCheckpoint(snap->oo));
+            snap->open_qty.push_back(idp->getOpenQty());
+            snap->mkt.push_back(utils::SymbolMapReader::get().getTradableMkt(idp->get_symbol()));
+        }
+        snap->applied = applied;
+        std::atomic_store(&sh.snap, std::shared_ptr<const Snapshot>(snap));
+    }
+
+    int64_t PositionShards::getPosition_Market(const std::string* algo_p, const std::string* mkt_p, double* mtm_pnl_p) const {
+        int64_t qty = 0;
+        double mtm_pnl = 0;
+        const int s0 = mkt_p? shardOfMkt(*mkt_p) : 0;
+        const int s1 = mkt_p? s0+1 : shards();
+        for (int s=s0; s<s1; ++s) {
+            const auto& snap (snapshot(s));
+            for (size_t i=0; i<snap->pos.size(); ++i) {
+                const auto& pos (snap->pos[i]);
+                if ((algo_p && (*algo_p != pos.m_algo)) || (mkt_p && (*mkt_p != snap->mkt[i]))) {
+                    continue;
+                }
+                qty += pos.m_qty + snap->open_qty[i];
+                if (mtm_pnl_p) {
+                    mtm_pnl += snap->idp(i)->getMtmPnl();
+                }
+            }
+        }
+        if (mtm_pnl_p) {
+            *mtm_pnl_p = mtm_pnl;
+        }
+        return qty;
+    }
+
+    std::vector<std::shared_ptr<const IntraDayPosition> > PositionShards::listPosition(const std::string* ptr_algo, const std::string* ptr_symbol) const {
+        std::vector<std::shared_ptr<const IntraDayPosition> > vec;
+        const bool has_algo = ptr_algo && ptr_algo->size();
+        const bool has_symbol = ptr_symbol && ptr_symbol->size();
+        const int s0 = has_symbol? shardOf(*ptr_symbol) : 0;
+        const int s1 = has_symbol? s0+1 : shards();
+        for (int s=s0; s<s1; ++s) {
+            const auto& snap (snapshot(s));
+            size_t oo_start = 0;
+            for (size_t i=0; i<snap->pos.size(); ++i) {
+                const auto& pos (snap->pos[i]);
+                if ((!has_algo || (*ptr_algo == pos.m_algo)) &&
+                    (!has_symbol || (*ptr_symbol == pos.m_symbol))) {
+                    vec.push_back(std::make_shared<const IntraDayPosition>(pos, snap->oo.data() + oo_start));
+                }
+                oo_start += pos.m_oo_cnt;
+            }
+        }
+        return vec;
+    }
+
+    double PositionShards::getPnl(const std::string* ptr_algo, const std::string* ptr_symbol) const {
+        double pnl = 0;
+        for (const auto& idp : listPosition(ptr_algo, ptr_symbol)) {
+            double pnl0;
+            idp->getPosition(nullptr, &pnl0);
+            pnl += pnl0;
+        }
+        return pnl;
+    }
+
+    std::string PositionShards::toString(const std::string* ptr_algo, const std::string* ptr_symbol, bool summary) const {
+        return PositionManager::toString(listPosition(ptr_algo, ptr_symbol), summary);
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "PositionManager.h"
+#include <atomic>
+#include <thread>
+#include <functional>
+
+/*
+ * The position state of a floor sharded by market across worker threads.
+ *
+ * The router, i.e. the floor thread, posts each execution report to the
+ * shard of its market, a single-writer ring per shard.  Each shard owns a
+ * PositionManager of its markets, applies the reports in batches and
+ * publishes an immutable snapshot of its positions after each batch, as
+ * the binary checkpoint records.  Queries, such as the engine level risk
+ * of a market, the positions of an algo across markets and the GUI dumps,
+ * are answered from the snapshots, so they don't stall the workers, and a
+ * burst of fills in one market doesn't delay the others.
+ *
+ * Shards are loaded as the PositionManager of the floor's name, keeping
+ * only their markets.  They don't checkpoint or persist, the floor's
+ * PositionManager remains the record.  A floor runs them with the config
+ * PositionShards, see FloorCPR.
+ */
+
+namespace pm {
+    class PositionShards {
+    public:
+        // the positions of a shard when the snapshot was taken
+        struct Snapshot {
+            std::vector<PositionCheckpoint> pos;
+            std::vector<OpenOrderCheckpoint> oo;   // m_oo_cnt of each pos, in order
+            std::vector<int64_t> open_qty;         // of each pos
+            std::vector<std::string> mkt;          // of each pos
+            uint64_t applied;                      // reports applied
+
+            // the intra-day position i, with its open orders
+            std::shared_ptr<const IntraDayPosition> idp(size_t i) const;
+        };
+
+        // called by the workers with each report applied and published,
+        // and the recv_ns given to post()
+        using AckFunc = std::function<void(const ExecutionReport& er, uint64_t recv_ns)>;
+
+        enum {
+            RingSize = 1024*16,    // reports pending per shard, power of 2
+            MaxBatch = 64,         // reports applied per snapshot
+            IdleSpin = 1000,       // polls before the worker sleeps
+            IdleSleepMicro = 50
+        };
+
+        PositionShards(const std::string& name, int shards, const std::string& recover_path = "");
+        ~PositionShards();
+
+        void setAck(AckFunc ack) { m_ack = ack; };
+        // to be set before start()
+
+        void start();
+        void stop();
+        // start and stop the workers, stop() returns after the
+        // reports posted are applied
+
+        int shards() const { return (int) m_shard.size(); };
+        int shardOf(const std::string& symbol) const;
+        // the shard of the symbol's market
+
+        void post(const ExecutionReport& er, uint64_t recv_ns = 0);
+        // routes er to its shard, spins if the shard's ring is full.
+        // Called from the router thread only.  recv_ns is passed to the
+        // ack, 0 for now.
+
+        bool postRisk(const ExecutionReport& er, bool do_pause_notify = false, uint64_t recv_ns = 0);
+        // updates the risk monitor with er, checking the positions
+        // from the snapshots, and posts it, as PositionManager::update()
+        // with update_risk.  Returns false on a risk violation.
+
+        void drain() const;
+        // returns when the reports posted are applied, published and acked
+
+        std::shared_ptr<const Snapshot> snapshot(int shard) const;
+        // the latest snapshot of the shard
+
+        uint64_t posted() const { return m_posted; };
+        uint64_t applied() const;
+
+        // the queries from the snapshots, as those of the PositionManager
+        int64_t getPosition_Market(const std::string* algo_p = nullptr, const std::string* mkt_p = nullptr, double* mtm_pnl = nullptr) const;
+        double getPnl(const std::string* ptr_algo = nullptr, const std::string* ptr_symbol = nullptr) const;
+        std::vector<std::shared_ptr<const IntraDayPosition> > listPosition(const std::string* ptr_algo = nullptr, const std::string* ptr_symbol = nullptr) const;
+        std::string toString(const std::string* ptr_algo = nullptr, const std::string* ptr_symbol = nullptr, bool summary = false) const;
+
+        bool haveThisFill(const ExecutionReport& er) const;
+        // whether the fill was loaded or posted, for the risk monitor to
+        // skip a duplicated fill.  Called from the router thread only.
+
+    private:
+        struct Slot {
+            ExecutionReport er;
+            uint64_t recv_ns;
+        };
+
+        struct Shard {
+            std::unique_ptr<PositionManager> pm;
+            std::vector<Slot> ring;
+            alignas(64) std::atomic<uint64_t> head;   // written by the router
+            alignas(64) std::atomic<uint64_t> tail;   // written by the worker
+            alignas(64) std::atomic<uint64_t> published;  // applied and acked
+            std::shared_ptr<const Snapshot> snap;     // by std::atomic_load/store
+            std::thread th;
+            Shard() : ring(RingSize), head(0), tail(0), published(0) {};
+        };
+
+        const std::string m_name;
+        std::vector<std::unique_ptr<Shard>> m_shard;
+        std::unordered_map<std::string, int> m_router_shard;  // symbol to shard, router only
+        std::unordered_set<std::string> m_router_fill;       // fill keys loaded or posted, router only
+        uint64_t m_posted;
+        std::atomic<bool> m_should_run;
+        AckFunc m_ack;
+
+        PositionShards(const PositionShards&) = delete;
+        PositionShards& operator=(const PositionShards&) = delete;
+
+        int shardOfMkt(const std::string& mkt) const;
+        void run(Shard& sh);
+        void publish(Shard& sh, uint64_t applied);
+    };
+};
@@ -17,27 +17,11 @@ namespace risk {
  **********/
 // const and static utilities
 const std::vector<std::string>& Config::listAlgo() const {
-    static std::vector<std::string> algo_vector;
-    if (__builtin_expect(algo_vector.size()==0, 0)) {
-        for (const auto& kv: m_strat_max_pos) {
-            algo_vector.push_back(kv.first);
-        }
-    }
-    return algo_vector;
+    return m_algo_list;
 }
 
 const std::vector<std::string>& Config::listMarket() const {
-    static std::vector<std::string> mkt_vec;
-    if (__builtin_expect(mkt_vec.size() == 0, 0)) {
-        std::set<std::string> mkt_set;
-        for (const auto& symbol: listSymbol()) {
-            mkt_set.insert(symbol.substr(0, symbol.find('_')));
-        }
-        for (const auto& mkt: mkt_set) {
-            mkt_vec.push_back(mkt);
-        };
-    }
-    return mkt_vec;
+    return m_mkt_list;
 }
 
 const std::vector<std::string>& Config::listSymbol() const {
@@ -49,13 +33,11 @@ const std::vector<std::string>& Config::listSymbol() const {
 }
 
 bool Config::algoExists(const std::string& algo) const{
-    static std::set<std::string> algo_set(listAlgo().begin(), listAlgo().end());
-    return (algo_set.find(algo) != algo_set.end());
+    return algoId(algo) >= 0;
 }
 
 bool Config::marketExists(const std::string& mkt) const {
-    static std::set<std::string> mkt_set(listMarket().begin(), listMarket().end());
-    return (mkt_set.find(mkt) != mkt_set.end());
+    return marketId(mkt) >= 0;
 }
 
 bool Config::symbolExists(const std::string& symbol) const {
@@ -63,24 +45,51 @@ bool Config::symbolExists(const std::string& symbol) const {
     return (symbol_set.find(symbol) != symbol_set.end());
 }
 
+int Config::algoId(const std::string& algo) const {
+    const auto iter = m_algo_id.find(algo);
+    return (iter != m_algo_id.end())? iter->second : -1;
+}
+
+int Config::marketId(const std::string& mkt) const {
+    const auto iter = m_mkt_id.find(mkt);
+    return (iter != m_mkt_id.end())? iter->second : -1;
+}
+
+int Config::symbolMarketId(const std::string& tradable_symbol) const {
+    const auto iter = m_symbol_mkt_id.find(tradable_symbol);
+    if (__builtin_expect(iter != m_symbol_mkt_id.end(), 1)) {
+        return iter->second;
+    }
+    // not a tradable, i.e. a mts symbol, try the symbol map
+    return marketId(utils::SymbolMapReader::get().getTradableMkt(tradable_symbol));
+}
+
 // return the mkt of symbol if algo+symbol found in map
 std::string Config::checkAlgoSymbol(const std::string& algo, const std::string& tradable_symbol, bool verbose) const {
-    if (__builtin_expect(!algoExists(algo),0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id, verbose),0)) {
+        return "";
+    }
+    return m_mkt_list[mkt_id];
+}
+
+bool Config::checkAlgoSymbol(const std::string& algo, const std::string& tradable_symbol, int& algo_id, int& mkt_id, bool verbose) const {
+    algo_id = algoId(algo);
+    if (__builtin_expect(algo_id < 0,0)) {
         if (verbose) {
             logError("RiskMonitor failed to find algo(%s)", algo.c_str());
         }
-        return "";
+        return false;
     }
-
-    const auto& mkt(utils::SymbolMapReader::get().getTradableMkt(tradable_symbol));
-    if (__builtin_expect(!marketExists(mkt),0)) {
+    mkt_id = symbolMarketId(tradable_symbol);
+    if (__builtin_expect(mkt_id < 0,0)) {
         if (verbose) {
             logError("RiskMonitor failed to find mkt(%s) from symbol(%s)", 
-                mkt.c_str(), tradable_symbol.c_str());
+                utils::SymbolMapReader::get().getTradableMkt(tradable_symbol).c_str(), tradable_symbol.c_str());
         }
-        return "";
+        return false;
     }
-    return mkt;
+    return true;
 }
 
 std::string Config::toStringConfig() const {
@@ -133,12 +142,48 @@ void Config::load (const std::string& risk_file) {
     // 3. ppp file
 
     auto reader = utils::ConfigureReader::getJson(risk_file.c_str());
+    build_market_id();
     read_system(*reader); // read into m_volume_spread_file, m_prie_band, m_ppp_file
     if (m_scale.size() == 0) {
         read_strat_scale(*reader);  // into m_scale
     }
     read_engine(*reader);
     read_strategy(*reader);
+    build_algo_id();
+}
+
+void Config::build_market_id() {
+    // markets are from the symbols subscribed, in sorted order
+    std::set<std::string> mkt_set;
+    for (const auto& symbol: listSymbol()) {
+        mkt_set.insert(symbol.substr(0, symbol.find('_')));
+    }
+    m_mkt_list.assign(mkt_set.begin(), mkt_set.end());
+    m_mkt_id.clear();
+    for (size_t i=0; i<m_mkt_list.size(); ++i) {
+        m_mkt_id[m_mkt_list[i]] = (int) i;
+    }
+
+    // tradables of these markets
+    m_symbol_mkt_id.clear();
+    for (const auto* ti: utils::SymbolMapReader::get().listAllTradable()) {
+        const auto iter = m_mkt_id.find(ti->_symbol);
+        if (iter != m_mkt_id.end()) {
+            m_symbol_mkt_id[ti->_tradable] = iter->second;
+        }
+    }
+}
+
+void Config::build_algo_id() {
+    // algos are the strategies with limits
+    m_algo_list.clear();
+    for (const auto& kv: m_strat_max_pos) {
+        m_algo_list.push_back(kv.first);
+    }
+    m_algo_id.clear();
+    for (size_t i=0; i<m_algo_list.size(); ++i) {
+        m_algo_id[m_algo_list[i]] = (int) i;
+    }
 }
 
 void Config::read_strat_scale(const utils::ConfigureReader& reader) {
@@ -499,7 +544,8 @@ Status::Status(std::shared_ptr<Config> cfg)
 : m_name("default"),
   m_persist_file(cfg->m_status_file),
   m_fcu(m_name.c_str()),
-  m_cfg(cfg)
+  m_cfg(cfg),
+  m_status(cfg->algoCount()*cfg->marketCount())
 {
     // read the latest trading status 
     // and populate m_status
@@ -518,9 +564,11 @@ bool Status::setPause(const std::string& algo, const std::string& market, bool i
 
     // market could be a ':' delimitered list
     const auto& mkt_list (utils::CSVUtil::read_line(market.c_str(),':'));
+    const int algo_id = m_cfg->algoId(algo);
     for (const auto& mkt:mkt_list) {
-        if (__builtin_expect(m_cfg->algoExists(algo) && m_cfg->marketExists(mkt), 1)) {
-            m_status[algo][mkt].set_pause(if_pause);
+        const int mkt_id = m_cfg->marketId(mkt);
+        if (__builtin_expect((algo_id >= 0) && (mkt_id >= 0), 1)) {
+            m_status[algo_id*m_cfg->marketCount()+mkt_id].set_pause(if_pause);
             //debug
             //printf("setting pause %s, %s, %s\n", algo.c_str(), market.c_str(), if_pause?"Paused":"Live");
 
@@ -557,11 +605,11 @@ bool Status::setPauseAll(bool if_pause) {
 }
 
 bool Status::getPause(const std::string& algo, const std::string& market) const {
-    const auto iter = m_status.find(algo);
-    if (iter != m_status.end()) {
-        const auto iter2 = iter->second.find(market);
-        if (iter2 != iter->second.end()) {
-            return iter2->second.is_paused();
+    const int algo_id = m_cfg->algoId(algo);
+    if (algo_id >= 0) {
+        const int mkt_id = m_cfg->marketId(market);
+        if (mkt_id >= 0) {
+            return getPause(algo_id, mkt_id);
         } else {
             logError("RiskMonitor(%s) getPause() failed - market %s not found", 
                     m_name.c_str(), market.c_str());
@@ -620,13 +668,14 @@ void Status::notify_pause(const std::string& algo, const std::string& market, bo
 const std::string Status::toStringStatus() const {
     std::string ret;
     int pause_cnt = 0;
-    for (const auto& stat: m_status) {
-        const auto& strat(stat.first);
+    const int mkt_cnt = m_cfg->marketCount();
+    for (int algo_id = 0; algo_id < m_cfg->algoCount(); ++algo_id) {
+        const auto& strat(m_cfg->algoName(algo_id));
         std::string ret0 = strat + ", ";
         int this_cnt = 0;
-        for (const auto& kv: stat.second) {
-            const auto& mkt(kv.first);
-            const auto& if_pause(kv.second.is_paused());
+        for (int mkt_id = 0; mkt_id < mkt_cnt; ++mkt_id) {
+            const auto& mkt(m_cfg->marketName(mkt_id));
+            const auto& if_pause(getPause(algo_id, mkt_id));
             if (if_pause) {
                 ret0 += ((this_cnt>0?":":"") + mkt);
                 this_cnt++;
@@ -634,7 +683,7 @@ const std::string Status::toStringStatus() const {
         }
         if (this_cnt) {
             pause_cnt += this_cnt;
-            if (this_cnt == (int)stat.second.size()) {
+            if (this_cnt == mkt_cnt) {
                 ret += (strat + ", ALL, ON\n");
             } else {
                 ret += (ret0 + ", ON\n");
@@ -699,29 +748,41 @@ ChannelType m_flr_client;
  ********/
 
 // State could create from config, or retrieved from previous persist
-State::State(std::shared_ptr<Config> cfg) : m_name("default"), m_cfg(cfg) {
+State::State(std::shared_ptr<Config> cfg) : m_name("default"), m_cfg(cfg), m_mkt_cnt(cfg->marketCount()) {
     init();
 }
 
-bool State::checkOrder(const std::string& algo,
-                       const std::string& mkt,
+bool State::getId(const std::string& algo, const std::string& mkt, int& algo_id, int& mkt_id) const {
+    algo_id = m_cfg->algoId(algo);
+    mkt_id = m_cfg->marketId(mkt);
+    if (__builtin_expect((algo_id < 0) || (mkt_id < 0), 0)) {
+        logError("RiskMonitor(%s) %s:%s not found", m_name.c_str(), algo.c_str(), mkt.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool State::checkOrder(int algo_id,
+                       int mkt_id,
                        int64_t ord_qty,
                        time_t cur_utc) {
     // checks the strategy and eng level count+rate limiters, if all good, then update all
     // otherwise, log error and return false
+    const auto& algo (m_cfg->algoName(algo_id));
+    const auto& mkt (m_cfg->marketName(mkt_id));
 
     // strat level order side, check only
     uint64_t cur_micro = cur_utc*1000*1000ULL;
     int cnt = (int)std::abs(ord_qty);
 
     // fat finger?
-    if (__builtin_expect(m_cfg->m_eng_fat_finger[mkt] < cnt,0)) {
+    if (__builtin_expect(m_eng_fat_finger[mkt_id] < cnt,0)) {
         logError("RiskMonitor(%s) %s:%s order size too large (fat finger detected): %d > %d",
-                m_name.c_str(), algo.c_str(), mkt.c_str(), cnt, (int)m_cfg->m_eng_fat_finger[mkt]);
+                m_name.c_str(), algo.c_str(), mkt.c_str(), cnt, (int)m_eng_fat_finger[mkt_id]);
         return false;
     }
 
-    auto& [rle_s, re_s] = m_strat[algo][mkt][0];  // < rle, re >
+    auto& [rle_s, re_s] = m_strat[idx(algo_id, mkt_id)][0];  // < rle, re >
     if (__builtin_expect(rle_s->checkOnly(cur_micro, 1)!=0, 0)) {
         logError("RiskMonitor(%s) %s:%s order of %d would break strategy order count: %s",
                 m_name.c_str(), algo.c_str(), mkt.c_str(), ord_qty, rle_s->toString().c_str());
@@ -734,14 +795,14 @@ bool State::checkOrder(const std::string& algo,
     }
 
     // engine level order side, check only
-    auto& [rle_e, re_e] = m_eng[mkt][0];  // < rle, re >
+    auto& [rle_e, re_e] = m_eng[mkt_id][0];  // < rle, re >
     if (__builtin_expect(rle_e->checkOnly(cur_micro, 1)!=0, 0)) {
         logError("RiskMonitor(%s) %s:%s order of %d would break engine order count: %s",
                 m_name.c_str(), algo.c_str(), mkt.c_str(), ord_qty, rle_e->toString().c_str());
         return false;
     }
 
-    if (__builtin_expect(!checkTradeRate(cur_utc, mkt, cnt, re_e), 0)) {
+    if (__builtin_expect(!checkTradeRate(cur_utc, mkt_id, cnt, re_e), 0)) {
         return false;
     }
 
@@ -753,8 +814,8 @@ bool State::checkOrder(const std::string& algo,
     return true;
 }
 
-bool State::reportFill (const std::string& algo,
-                        const std::string& mkt,
+bool State::reportFill (int algo_id,
+                        int mkt_id,
                         int64_t fill_qty,
                         time_t cur_utc) {
     // do updateOnly for all rate limits, since the fill already happened,
@@ -764,25 +825,26 @@ bool State::reportFill (const std::string& algo,
     // strat level report side, update and check return
     uint64_t cur_micro = cur_utc * 1000ULL*1000ULL;
     int cnt = (int)std::abs(fill_qty);
-    auto& re_s (m_strat[algo][mkt][1].second);  // < rle, re >
+    auto& re_s (m_strat[idx(algo_id, mkt_id)][1].second);  // < rle, re >
     if (__builtin_expect(re_s->updateOnly(cur_micro, cnt)!=0, 0)) {
         logError("RiskMonitor(%s) %s:%s reported fill of %d violates strategy trade rate: %s", 
-                m_name.c_str(), algo.c_str(), mkt.c_str(), fill_qty, re_s->toString().c_str());
+                m_name.c_str(), m_cfg->algoName(algo_id).c_str(), m_cfg->marketName(mkt_id).c_str(), 
+                fill_qty, re_s->toString().c_str());
         ret = false;
     }
 
     // engine level report side, update and check return
-    auto& re_e(m_eng[mkt][1].second);  // < rle, re >
+    auto& re_e(m_eng[mkt_id][1].second);  // < rle, re >
     re_e->updateOnly(cur_micro, cnt, false);
-    if (__builtin_expect(!checkTradeRate(cur_utc, mkt, 0, re_e), 0)) {
+    if (__builtin_expect(!checkTradeRate(cur_utc, mkt_id, 0, re_e), 0)) {
         ret = false;
     }
 
     return ret;
 }
 
-bool State::reportNew (const std::string& algo,
-                       const std::string& mkt,
+bool State::reportNew (int algo_id,
+                       int mkt_id,
                        time_t cur_utc) {
     // do updateOnly of 1 for all order count limiters, 
     // and check the results, log error if non-zero returned
@@ -790,31 +852,33 @@ bool State::reportNew (const std::string& algo,
 
     // strat level report side, update and check return
     uint64_t cur_micro = cur_utc * 1000ULL*1000ULL;
-    auto& rle_s(m_strat[algo][mkt][1].first);  // < rle, re >
+    auto& rle_s(m_strat[idx(algo_id, mkt_id)][1].first);  // < rle, re >
     if (__builtin_expect(rle_s->updateOnly(cur_micro, 1)!=0, 0)) {
         logError("RiskMonitor(%s) %s:%s reported NEW violates strategy order count: %s",
-                m_name.c_str(), algo.c_str(), mkt.c_str(), rle_s->toString().c_str());
+                m_name.c_str(), m_cfg->algoName(algo_id).c_str(), m_cfg->marketName(mkt_id).c_str(), 
+                rle_s->toString().c_str());
         ret = false;
     }
 
     // engine level report side, update and check return
-    auto& rle_e (m_eng[mkt][1].first);  // < rle, re >
+    auto& rle_e (m_eng[mkt_id][1].first);  // < rle, re >
     if (__builtin_expect(rle_e->updateOnly(cur_micro, 1)!=0, 0)) {
         logError("RiskMonitor(%s) %s:%s reported  NEW violates engine order count: %s",
-                m_name.c_str(), algo.c_str(), mkt.c_str(), rle_e->toString().c_str());
+                m_name.c_str(), m_cfg->algoName(algo_id).c_str(), m_cfg->marketName(mkt_id).c_str(), 
+                rle_e->toString().c_str());
         ret = false;
     }
 
     return ret;
 }
 
-void State::reportCancel (const std::string& algo,
-                          const std::string& mkt) {
+void State::reportCancel (int algo_id,
+                          int mkt_id) {
     // remove order count from both order and report side
     for (int i=0; i<2; ++i) {
-        auto& rle_s(m_strat[algo][mkt][i].first);  // < rle, re >
+        auto& rle_s(m_strat[idx(algo_id, mkt_id)][i].first);  // < rle, re >
         rle_s->removeOnly(1);
-        auto& rle_e(m_eng[mkt][i].first);  // < rle, re >
+        auto& rle_e(m_eng[mkt_id][i].first);  // < rle, re >
         rle_e->removeOnly(1);
     }
 }
@@ -824,11 +888,28 @@ void State::init() {
     //
     // Engine level first, populate m_eng from m_cfg's m_eng_count and m_eng_rate_limit
     //
-    //using LimitMap = std::unordered_map<
-    //    std::string,         // per-mkt
-    //        std::pair<std::shared_ptr<utils::RateLimiterEns>,     // order count limits
-    //                  std::shared_ptr<utils::RateEstimator>>[2]>; // order rate/turn over limits
-    for (const auto& mkt: m_cfg->listMarket()) {
+    // Limits are in vectors indexed by mkt_id, or algo_id*m_mkt_cnt+mkt_id
+    // in the order of m_cfg->listMarket() and m_cfg->listAlgo()
+    const int algo_cnt = m_cfg->algoCount();
+    m_eng.assign(m_mkt_cnt, Limits());
+    m_strat.assign(algo_cnt*m_mkt_cnt, Limits());
+    m_flip.assign(algo_cnt*m_mkt_cnt, Limits());
+    m_prev_direction.assign(algo_cnt*m_mkt_cnt, 0);
+    m_eng_max_pos.assign(m_mkt_cnt, 0);
+    m_eng_fat_finger.assign(m_mkt_cnt, 0);
+    m_eng_rate_limit.assign(m_mkt_cnt, nullptr);
+    m_strat_pnl_drawdown.assign(algo_cnt, 0);
+    m_strat_max_pos.assign(algo_cnt*m_mkt_cnt, 0);
+    m_strat_mkt_pnl_drawdown.assign(algo_cnt*m_mkt_cnt, 0);
+
+    for (int mkt_id = 0; mkt_id < m_mkt_cnt; ++mkt_id) {
+        const auto& mkt (m_cfg->marketName(mkt_id));
+        m_eng_max_pos[mkt_id] = m_cfg->m_eng_max_pos[mkt];
+        m_eng_fat_finger[mkt_id] = m_cfg->m_eng_fat_finger[mkt];
+        const auto& rl_iter (m_cfg->m_eng_rate_limit.find(mkt));
+        if (rl_iter != m_cfg->m_eng_rate_limit.end()) {
+            m_eng_rate_limit[mkt_id] = &rl_iter->second;
+        }
         const auto& cl (m_cfg->m_eng_count[mkt]);  // vector< <ords, secs> >
         const auto& rl (m_cfg->m_eng_rate_limit[mkt]); // vector< vector <rate, secs> >
         
@@ -860,19 +941,25 @@ void State::init() {
         }
         std::shared_ptr<utils::RateEstimator> re_1 (std::make_shared<utils::RateEstimator>(rl_cfg, bucket_seconds));
         std::shared_ptr<utils::RateEstimator> re_2 (std::make_shared<utils::RateEstimator>(rl_cfg, bucket_seconds));
-        m_eng[mkt][0] = std::make_pair(rle_1, re_1);
-        m_eng[mkt][1] = std::make_pair(rle_2, re_2);
+        m_eng[mkt_id][0] = std::make_pair(rle_1, re_1);
+        m_eng[mkt_id][1] = std::make_pair(rle_2, re_2);
     }
 
     // populate the 
     //     std::unordered_map<std::string, std::unordered_map<std::string, std::vector<std::pair<int, int>>> m_strat_count;
     //     std::unordered_map<std::string, std::unordered_map<std::string, std::vector<std::pair<double, int>>> m_strat_rate_limit; // strat - mkt - vector< <turnover_rate, seconds> >
     // onto
-    //     std::unordered_map<std::string, LimitMap> m_strat;
-    //     std::unordered_map<std::string, LimitMap> m_flip;
-
-    for (const auto& algo: m_cfg->listAlgo()) {
-        for (const auto& mkt: m_cfg->listMarket()) {
+    //     std::vector<Limits> m_strat;
+    //     std::vector<Limits> m_flip;
+
+    for (int algo_id = 0; algo_id < algo_cnt; ++algo_id) {
+        const auto& algo (m_cfg->algoName(algo_id));
+        m_strat_pnl_drawdown[algo_id] = m_cfg->m_strat_pnl_drawdown[algo];
+        for (int mkt_id = 0; mkt_id < m_mkt_cnt; ++mkt_id) {
+            const auto& mkt (m_cfg->marketName(mkt_id));
+            const int sidx = idx(algo_id, mkt_id);
+            m_strat_max_pos[sidx] = m_cfg->m_strat_max_pos[algo][mkt];
+            m_strat_mkt_pnl_drawdown[sidx] = m_cfg->m_strat_mkt_pnl_drawdown[algo][mkt];
             const auto& cl (m_cfg->m_strat_count[algo][mkt]); // vector< <orders, seconds> >
             const auto& rl (m_cfg->m_strat_rate_limit[algo][mkt]); // vector< turnover_rate, seconds> >
             const auto& fl (m_cfg->m_strat_flip[algo][mkt]); // vector< <flips, seconds> >
@@ -897,8 +984,8 @@ void State::init() {
             int bucket_seconds = 30; // rates are aggregated at bucket seconds
             std::shared_ptr<utils::RateEstimator> re_1 (std::make_shared<utils::RateEstimator>(rl_cfg, bucket_seconds));
             std::shared_ptr<utils::RateEstimator> re_2 (std::make_shared<utils::RateEstimator>(rl_cfg, bucket_seconds));
-            m_strat[algo][mkt][0] = std::make_pair(rle_1, re_1);
-            m_strat[algo][mkt][1] = std::make_pair(rle_2, re_2);
+            m_strat[sidx][0] = std::make_pair(rle_1, re_1);
+            m_strat[sidx][1] = std::make_pair(rle_2, re_2);
 
             // flip count, only has rate_limit at both sides
             hist_mul = 1; // allow more cancel as needed
@@ -908,32 +995,32 @@ void State::init() {
             }
             std::shared_ptr<utils::RateLimiterEns> rlf_1 (std::make_shared<utils::RateLimiterEns>(fl_cfg));
             std::shared_ptr<utils::RateLimiterEns> rlf_2 (std::make_shared<utils::RateLimiterEns>(fl_cfg));
-            m_flip[algo][mkt][0].first = rlf_1;
-            m_flip[algo][mkt][1].first = rlf_1;
+            m_flip[sidx][0].first = rlf_1;
+            m_flip[sidx][1].first = rlf_1;
         }
     }
     logInfo("RiskMonitor State started!\n%s",toString().c_str());
 }
 
-bool State::checkTradeRate(time_t cur_utc, const std::string& mkt, int ord_cnt, std::shared_ptr<utils::RateEstimator>& re) {
+bool State::checkTradeRate(time_t cur_utc, int mkt_id, int ord_cnt, std::shared_ptr<utils::RateEstimator>& re) {
     // current trade rate, all lookbacks
     const auto& rates (re->checkRates(cur_utc,ord_cnt));
 
     // current bar index
     int bar_idx = getBarIdx(cur_utc);
 
-    const auto& iter(m_cfg->m_eng_rate_limit.find(mkt));
-    if (__builtin_expect(iter==m_cfg->m_eng_rate_limit.end(),0)) {
-        logInfo("RiskMonitor(%s) warning: %s trade rate not defined and couldn't check", m_name.c_str(), mkt.c_str());
+    const auto* eng_rl (m_eng_rate_limit[mkt_id]);
+    if (__builtin_expect(!eng_rl,0)) {
+        logInfo("RiskMonitor(%s) warning: %s trade rate not defined and couldn't check", m_name.c_str(), m_cfg->marketName(mkt_id).c_str());
         return true;
     }
 
     // check it against the m_cfg->m_eng_rate_limit on bar_idx
-    const auto& rl (iter->second[bar_idx]); // vector<rate, seconds> at bar_idx
+    const auto& rl ((*eng_rl)[bar_idx]); // vector<rate, seconds> at bar_idx
     for(size_t i=0; i<rates.size(); ++i) {
         if (__builtin_expect(rates[i]*rl[i].second > rl[i].first,0)) {
             logError("RiskMonitor(%s) %s engine trade rate violation for lookback of %d seconds: cur(%.2f orders), participation_limit(%.2f orders)",
-                    m_name.c_str(), mkt.c_str(), (int)rl[i].second, rates[i]*rl[i].second, rl[i].first);
+                    m_name.c_str(), m_cfg->marketName(mkt_id).c_str(), (int)rl[i].second, rates[i]*rl[i].second, rl[i].first);
             return false;
         }
     }
@@ -949,7 +1036,7 @@ int State::getBarIdx(time_t cur_utc) const {
     return bar_idx;
 }
 
-bool State::checkFlip(const std::string& algo, const std::string& mkt, long long new_pos_qty, bool is_fill_report, time_t cur_utc) {
+bool State::checkFlip(int algo_id, int mkt_id, long long new_pos_qty, bool is_fill_report, time_t cur_utc) {
     // check if the "new_pos_qty" causes a "flip", i.e.
     // a non-zero position with a different sign with previous non-zero position
     // if is_fill_report, update m_prev_direction[algo][mkt] from prev_pos_qty to new_pos_qty
@@ -963,33 +1050,24 @@ bool State::checkFlip(const std::string& algo, const std::string& mkt, long long
         return true;
     }
 
-    // new_pos_qty non-zero
-    int64_t prev_pos_qty = 0;
-    auto iter = m_prev_direction.find(algo);
-    if (__builtin_expect( iter != m_prev_direction.end(), 1)) {
-        auto iter2 = iter->second.find(mkt);
-        if (__builtin_expect( iter2 != iter->second.end(), 1)) {
-            prev_pos_qty = iter2->second;
-            if (is_fill_report) {
-                iter2->second = new_pos_qty;
-            }
-            if (__builtin_expect(prev_pos_qty * new_pos_qty < 0,0)) {
-                // this would flip the direction of previous position
-                // check the flip count
-                bool ret = is_fill_report?
-                    (m_flip[algo][mkt][1].first->updateOnly(cur_utc*1000000ULL, 1) == 0):
-                    (m_flip[algo][mkt][0].first->checkOnly(cur_utc*1000000ULL, 1) == 0);
-                if (__builtin_expect(!ret, 0)) {
-                    logError("RiskMonitor(%s) %s:%s position flip detected on new position of %lld!", 
-                            m_name.c_str(), algo.c_str(), mkt.c_str(), new_pos_qty);
-                }
-                return ret;
-            }
-        }
-    }
-    // not found, update non-zero qty
+    // new_pos_qty non-zero, previous position of 0 is not yet set
+    const int sidx = idx(algo_id, mkt_id);
+    auto& prev_direction (m_prev_direction[sidx]);
+    const int64_t prev_pos_qty = prev_direction;
     if (is_fill_report) {
-        m_prev_direction[algo][mkt] = new_pos_qty;
+        prev_direction = new_pos_qty;
+    }
+    if (__builtin_expect(prev_pos_qty * new_pos_qty < 0,0)) {
+        // this would flip the direction of previous position
+        // check the flip count
+        bool ret = is_fill_report?
+            (m_flip[sidx][1].first->updateOnly(cur_utc*1000000ULL, 1) == 0):
+            (m_flip[sidx][0].first->checkOnly(cur_utc*1000000ULL, 1) == 0);
+        if (__builtin_expect(!ret, 0)) {
+            logError("RiskMonitor(%s) %s:%s position flip detected on new position of %lld!", 
+                    m_name.c_str(), m_cfg->algoName(algo_id).c_str(), m_cfg->marketName(mkt_id).c_str(), new_pos_qty);
+        }
+        return ret;
     }
     return true;
 }
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <vector>
 #include <tuple>
+#include <array>
 
 #include "flr.h" //includes FloorBase.h and then floor.h
 #include "rate_limiter.h"
@@ -69,6 +70,22 @@ struct Config {
     // return the mkt of symbol if algo+symbol found in map
     std::string checkAlgoSymbol(const std::string& algo, const std::string& tradable_symbol, bool verbose=true) const;
 
+    // the integer id version of the above, used by the checks on the hot path.
+    // return true if algo+symbol found, with algo_id and mkt_id set
+    bool checkAlgoSymbol(const std::string& algo, const std::string& tradable_symbol, int& algo_id, int& mkt_id, bool verbose=true) const;
+
+    // algo and market are interned to dense ids at load, in the order of
+    // listAlgo() and listMarket(), so that the states can be kept in
+    // flat arrays indexed by algo_id*marketCount()+mkt_id. 
+    // The id is -1 if not found.
+    int algoId(const std::string& algo) const;
+    int marketId(const std::string& mkt) const;
+    int symbolMarketId(const std::string& tradable_symbol) const;
+    int algoCount() const { return (int) m_algo_list.size(); };
+    int marketCount() const { return (int) m_mkt_list.size(); };
+    const std::string& algoName(int algo_id) const { return m_algo_list[algo_id]; };
+    const std::string& marketName(int mkt_id) const { return m_mkt_list[mkt_id]; };
+
     // convenience const functions
     bool isPaperTrading(const std::string& algo) const;
     std::string ManualStrategyName() const { return m_manual_strat; };
@@ -87,7 +104,14 @@ struct Config {
     Config(const std::string& risk_file,
         std::unordered_map<std::string, double> input_scale);
 private:
+    std::vector<std::string> m_algo_list, m_mkt_list;
+    std::unordered_map<std::string, int> m_algo_id, m_mkt_id;
+    // market id of the tradables in the symbol map
+    std::unordered_map<std::string, int> m_symbol_mkt_id;
+
     void load (const std::string& risk_file);
+    void build_market_id();
+    void build_algo_id();
     void read_strat_scale(const utils::ConfigureReader& reader);
     void read_system(const utils::ConfigureReader& reader);
 
@@ -122,6 +146,9 @@ public:
     bool setPauseAlgo(const std::string& algo, bool if_pause);  // this pauses algo for all symbols
     bool setPauseAll(bool if_pause);  // this pauses all
     bool getPause(const std::string& algo, const std::string& market) const;
+    bool getPause(int algo_id, int mkt_id) const {
+        return m_status[algo_id*m_cfg->marketCount()+mkt_id].is_paused();
+    };
     std::string queryPause(const std::string& algo, const std::string& market) const;
 
     // this sends message on the floor to notify a new pause status being initiated by
@@ -185,8 +212,8 @@ private:
     };
 
     pm::FloorClientUser m_fcu; // used for send out pause command upon failed checks
-    std::unordered_map<std::string, std::unordered_map<std::string, StatusInfo>> m_status;
     std::shared_ptr<Config> m_cfg;
+    std::vector<StatusInfo> m_status; // indexed by algo_id*marketCount()+mkt_id
     std::string m_tag50;
 };
 
@@ -205,26 +232,47 @@ public:
 
     // checks the strategy and eng level limiters, if all good, then update all
     // otherwise, log error and return false
-    bool checkOrder (const std::string& algo,
-                     const std::string& mkt,
+    bool checkOrder (int algo_id,
+                     int mkt_id,
                      int64_t ord_qty,
                      time_t cur_utc);
 
     // do updateOnly for all rate limiters, since the fill already happened,
     // and check the results, log error if non-zero returned
-    bool reportFill (const std::string& algo,
-                     const std::string& mkt,
+    bool reportFill (int algo_id,
+                     int mkt_id,
                      int64_t fill_qty,
                      time_t cur_utc);
 
     // do updateOnly for all limiters, and check the results, log error if non-zero returned
-    bool reportNew (const std::string& algo,
-                     const std::string& mkt,
-                     time_t cur_utc);
+    bool reportNew (int algo_id,
+                    int mkt_id,
+                    time_t cur_utc);
 
     // remove order count from both order and report side
-    void reportCancel (const std::string& algo,
-                     const std::string& mkt);
+    void reportCancel (int algo_id,
+                       int mkt_id);
+
+    // the string versions of the above, algo and mkt are
+    // looked up from the config, see Config::algoId()
+    bool checkOrder (const std::string& algo, const std::string& mkt, int64_t ord_qty, time_t cur_utc) {
+        int algo_id, mkt_id;
+        return getId(algo, mkt, algo_id, mkt_id) && checkOrder(algo_id, mkt_id, ord_qty, cur_utc);
+    };
+    bool reportFill (const std::string& algo, const std::string& mkt, int64_t fill_qty, time_t cur_utc) {
+        int algo_id, mkt_id;
+        return getId(algo, mkt, algo_id, mkt_id) && reportFill(algo_id, mkt_id, fill_qty, cur_utc);
+    };
+    bool reportNew (const std::string& algo, const std::string& mkt, time_t cur_utc) {
+        int algo_id, mkt_id;
+        return getId(algo, mkt, algo_id, mkt_id) && reportNew(algo_id, mkt_id, cur_utc);
+    };
+    void reportCancel (const std::string& algo, const std::string& mkt) {
+        int algo_id, mkt_id;
+        if (getId(algo, mkt, algo_id, mkt_id)) {
+            reportCancel(algo_id, mkt_id);
+        }
+    };
 
 
     // check the max position, the pnl and flip
@@ -240,13 +288,24 @@ public:
     //     eng_qty:  the aggreated position of mkt of all algos in engine
     //     mkt_pnl:  the mark-to-market pnl of algo+mkt (all _N aggreated)
     //     algo_pnl: the mark-to-market pnl of algo (all mkts aggregated)
+    template<typename PositionManager>
+    bool checkPosition(int algo_id,
+                       int mkt_id,
+                       int64_t qty,
+                       const PositionManager& pm,
+                       bool is_from_report,
+                       time_t cur_utc);
+
     template<typename PositionManager>
     bool checkPosition(const std::string& algo,
                        const std::string& mkt,
                        int64_t qty,
                        const PositionManager& pm,
                        bool is_from_report,
-                       time_t cur_utc);
+                       time_t cur_utc) {
+        int algo_id, mkt_id;
+        return getId(algo, mkt, algo_id, mkt_id) && checkPosition(algo_id, mkt_id, qty, pm, is_from_report, cur_utc);
+    };
 
     // run periodical tasks, possibly
     // update rate estimation, output logs for gui
@@ -260,22 +319,33 @@ public:
 private:
     // for each symbol, define two pairs of limiters,
     // first updated from strategy, second updated from execution report
-    using LimitMap = std::unordered_map<
-        std::string, // per-mkt
+    using Limits = std::array<
             std::pair<std::shared_ptr<utils::RateLimiterEns>,   // order count limits
                       std::shared_ptr<utils::RateEstimator>     // order rate/turn over limits
-                     > [2] // first: ord_upd, second: er_upd
-        >;
+                     >, 2>; // first: ord_upd, second: er_upd
 
+    // the limits and states are in flat arrays, the engine level
+    // indexed by mkt_id, the strategy level by algo_id*m_mkt_cnt+mkt_id
     std::shared_ptr<Config> m_cfg;
-    LimitMap m_eng; // engine level limiters
-    std::unordered_map<std::string, LimitMap> m_strat; // strate level limiters
-    std::unordered_map<std::string, LimitMap> m_flip;  // strate level position flips limiters
-    std::unordered_map<std::string, std::unordered_map<std::string, long long>> m_prev_direction;
+    int m_mkt_cnt;
+    std::vector<Limits> m_eng; // engine level limiters
+    std::vector<Limits> m_strat; // strate level limiters
+    std::vector<Limits> m_flip;  // strate level position flips limiters
+    std::vector<long long> m_prev_direction;
+
+    // the limit values copied from the config at init
+    std::vector<long long> m_eng_max_pos;
+    std::vector<long long> m_eng_fat_finger;
+    std::vector<const std::vector<std::vector<std::pair<double,int>>>*> m_eng_rate_limit; // nullptr if not defined
+    std::vector<double> m_strat_pnl_drawdown;
+    std::vector<long long> m_strat_max_pos;
+    std::vector<double> m_strat_mkt_pnl_drawdown;
 
     void init();
-    bool checkTradeRate(time_t cur_utc, const std::string& mtk, int ord_cnt, std::shared_ptr<utils::RateEstimator>& re);
-    bool checkFlip(const std::string& algo, const std::string& mkt, long long new_pos_qty, bool is_fill_report, time_t cur_utc);
+    int idx(int algo_id, int mkt_id) const { return algo_id*m_mkt_cnt + mkt_id; };
+    bool getId(const std::string& algo, const std::string& mkt, int& algo_id, int& mkt_id) const;
+    bool checkTradeRate(time_t cur_utc, int mkt_id, int ord_cnt, std::shared_ptr<utils::RateEstimator>& re);
+    bool checkFlip(int algo_id, int mkt_id, long long new_pos_qty, bool is_fill_report, time_t cur_utc);
 };
 
 class Monitor {
@@ -356,8 +426,8 @@ private:
     Monitor(const Monitor& rm) = delete;
     void operator = (const Monitor& rm) = delete;
 
-    bool checkNewOrder_mkt(const std::string& algo,
-                       const std::string& mkt,
+    bool checkNewOrder_mkt(int algo_id,
+                       int mkt_id,
                        int64_t ord_qty,
                        time_t cur_utc);
 };
@@ -402,15 +472,15 @@ bool Monitor::checkNewOrder(const std::string& algo,
     if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
         return true;
     }
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol));
-    if (__builtin_expect(mkt == "",0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id),0)) {
         // algo or symbol not found
         return false;
     }
-    if (__builtin_expect(!checkNewOrder_mkt(algo, mkt, ord_qty, cur_utc),0)) {
+    if (__builtin_expect(!checkNewOrder_mkt(algo_id, mkt_id, ord_qty, cur_utc),0)) {
         return false;
     }
-    if (__builtin_expect(!m_state.checkPosition(algo, mkt, ord_qty, pm, false, cur_utc), 0)) {
+    if (__builtin_expect(!m_state.checkPosition(algo_id, mkt_id, ord_qty, pm, false, cur_utc), 0)) {
         return false;
     }
     return true;
@@ -426,17 +496,17 @@ bool Monitor::checkReplace (const std::string& algo,
     if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
         return true;
     }
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol));
-    if (__builtin_expect(mkt == "",0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id),0)) {
         // algo or symbol not found
         return false;
     }
-    if (__builtin_expect(m_status.getPause(algo, mkt), 0)) {
+    if (__builtin_expect(m_status.getPause(algo_id, mkt_id), 0)) {
         // in pause
         return false;
     }
     // skip the order count limit checks
-    if (__builtin_expect(!m_state.checkPosition(algo, mkt, qty_delta, pm, false, cur_utc), 0)) {
+    if (__builtin_expect(!m_state.checkPosition(algo_id, mkt_id, qty_delta, pm, false, cur_utc), 0)) {
         return false;
     }
     return true;
@@ -452,12 +522,12 @@ bool Monitor::checkNewOrder(const std::string& algo,
     if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
         return true;
     }
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol));
-    if (__builtin_expect(mkt == "",0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id),0)) {
         // algo or symbol not found
         return false;
     }
-    return checkNewOrder_mkt(algo, mkt, ord_qty, cur_utc);
+    return checkNewOrder_mkt(algo_id, mkt_id, ord_qty, cur_utc);
 }
 
 inline
@@ -467,12 +537,12 @@ bool Monitor::checkReplace (const std::string& algo,
     if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
         return true;
     }
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol));
-    if (__builtin_expect(mkt == "",0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id),0)) {
         // algo or symbol not found
         return false;
     }
-    if (__builtin_expect(m_status.getPause(algo, mkt), 0)) {
+    if (__builtin_expect(m_status.getPause(algo_id, mkt_id), 0)) {
         // in pause
         return false;
     }
@@ -490,8 +560,8 @@ bool Monitor::updateER(const ExecutionReport& er, bool do_notify_pause) {
     if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
         return true;
     }
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol, false));
-    if (__builtin_expect(mkt == "",0)) {
+    int algo_id, mkt_id;
+    if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id, false),0)) {
         // algo or symbol not found
         return true;
     }
@@ -499,7 +569,7 @@ bool Monitor::updateER(const ExecutionReport& er, bool do_notify_pause) {
     const auto qty = er.m_qty;
 
     if (er.isNew()) {
-        if (__builtin_expect(m_state.reportNew(algo, mkt, cur_utc), 1)) {
+        if (__builtin_expect(m_state.reportNew(algo_id, mkt_id, cur_utc), 1)) {
             return true;
         }
         logError("RiskMonitor(%s) detected count violation on NEW: \n%s",
@@ -507,10 +577,10 @@ bool Monitor::updateER(const ExecutionReport& er, bool do_notify_pause) {
         // fall down for pause notification
     } else if (er.isCancel()) {
         //update the m_rateLimiter_order
-        m_state.reportCancel(algo, mkt);
+        m_state.reportCancel(algo_id, mkt_id);
         return true;
     } else if (er.isFill()) {
-        if (__builtin_expect(m_state.reportFill(algo, mkt, qty, cur_utc),1)) {
+        if (__builtin_expect(m_state.reportFill(algo_id, mkt_id, qty, cur_utc),1)) {
             return true;
         }
         logError("RiskMonitor(%s) detected count/rate vilation on Fill: \n%s",
@@ -519,6 +589,7 @@ bool Monitor::updateER(const ExecutionReport& er, bool do_notify_pause) {
         // rejectsions, etc, not risk related
         return true;
     }
+    const auto& mkt (m_cfg->marketName(mkt_id));
     if (do_notify_pause) {
         logError("RiskMonitor(%s) notifying trading pause on %s:%s!", 
             m_name.c_str(), algo.c_str(), mkt.c_str());
@@ -544,15 +615,16 @@ bool Monitor::updateER(const ExecutionReport& er, const PositionManager& pm, boo
         if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
             return true;
         }
-        const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable_symbol, false));
-        if (__builtin_expect(mkt == "",0)) {
+        int algo_id, mkt_id;
+        if (__builtin_expect(!m_cfg->checkAlgoSymbol(algo, tradable_symbol, algo_id, mkt_id, false),0)) {
             // algo or symbol not found
             return good;
         }
         const auto qty = er.m_qty;
-        if (__builtin_expect(m_state.checkPosition(algo, mkt, qty, pm, true, (time_t) (er.m_recv_micro/1000000ULL)),1)) {
+        if (__builtin_expect(m_state.checkPosition(algo_id, mkt_id, qty, pm, true, (time_t) (er.m_recv_micro/1000000ULL)),1)) {
             return good;
         }
+        const auto& mkt (m_cfg->marketName(mkt_id));
 
         // we don't need to notify if previous check not good
         if (good) {
@@ -588,22 +660,19 @@ void Monitor::set_instance_name(const std::string& name) {
 }
 
 inline
-bool Monitor::checkNewOrder_mkt(const std::string& algo,
-                                const std::string& mkt,
+bool Monitor::checkNewOrder_mkt(int algo_id,
+                                int mkt_id,
                                 int64_t ord_qty,
                                 time_t cur_utc) {
 
-    if (__builtin_expect(m_cfg->isManualStrategy(algo), 0)) {
-        return true;
-    }
-
-    if (__builtin_expect(m_status.getPause(algo, mkt), 0)) {
-        logError("RiskMonitor(%s) %s:%s is Paused!", m_name.c_str(), algo.c_str(), mkt.c_str());
+    if (__builtin_expect(m_status.getPause(algo_id, mkt_id), 0)) {
+        logError("RiskMonitor(%s) %s:%s is Paused!", m_name.c_str(), 
+                m_cfg->algoName(algo_id).c_str(), m_cfg->marketName(mkt_id).c_str());
         // in pause
         return false;
     }
     cur_utc = cur_utc?cur_utc:utils::TimeUtil::cur_utc();
-    if (__builtin_expect(!m_state.checkOrder(algo, mkt, ord_qty, cur_utc),0)) {
+    if (__builtin_expect(!m_state.checkOrder(algo_id, mkt_id, ord_qty, cur_utc),0)) {
         // failed order count limiters
         return false;
     }
@@ -613,9 +682,9 @@ bool Monitor::checkNewOrder_mkt(const std::string& algo,
 
 inline
 long long Monitor::maxPosition(const std::string& algo, const std::string& tradable) const {
-    const auto& mkt (m_cfg->checkAlgoSymbol(algo, tradable, false));
-    if (mkt=="") return 0;
-    return m_cfg->m_strat_max_pos.find(algo)->second.find(mkt)->second;
+    int algo_id, mkt_id;
+    if (!m_cfg->checkAlgoSymbol(algo, tradable, algo_id, mkt_id, false)) return 0;
+    return m_cfg->m_strat_max_pos.find(algo)->second.find(m_cfg->marketName(mkt_id))->second;
 }
 
 /**********
@@ -684,8 +753,8 @@ void Status::set_operator_id(const FMType& fm, const std::string& operator_id) {
  *******/
 
 template<typename PositionManager>
-bool State::checkPosition(const std::string& algo,
-                          const std::string& mkt,
+bool State::checkPosition(int algo_id,
+                          int mkt_id,
                           int64_t qty,
                           const PositionManager& pm,
                           bool is_from_report,
@@ -703,6 +772,9 @@ bool State::checkPosition(const std::string& algo,
     //     eng_qty:  the aggreated position of mkt of all algos in engine
     //     mkt_pnl:  the mark-to-market pnl of algo+mkt (all _N aggreated)
     //     algo_pnl: the mark-to-market pnl of algo (all mkts aggregated)
+    const auto& algo (m_cfg->algoName(algo_id));
+    const auto& mkt (m_cfg->marketName(mkt_id));
+    const int sidx = idx(algo_id, mkt_id);
 
     // getting these quantities
     int64_t algo_qty = 0, eng_qty = 0;
@@ -714,64 +786,68 @@ bool State::checkPosition(const std::string& algo,
     bool eng_risk_reduce   = (eng_qty+qty) * qty < 0;
 
     // check for algo maximum position
-    if (__builtin_expect(std::abs((long long)(algo_qty+qty)) > m_cfg->m_strat_max_pos[algo][mkt],0)) {
+    const long long strat_max_pos = m_strat_max_pos[sidx];
+    if (__builtin_expect(std::abs((long long)(algo_qty+qty)) > strat_max_pos,0)) {
         // risk reducing ?
         if (!strat_risk_reduce) {
             logError("RiskMonitor(%s) %s:%s qty %lld violates strategy maxpos: |%lld| > %lld", 
                     m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, 
-                    (long long) (algo_qty+qty), (long long) m_cfg->m_strat_max_pos[algo][mkt]);
+                    (long long) (algo_qty+qty), strat_max_pos);
             return false;
         }
         logInfo("RiskMonitor(%s) %s:%s allowing risk reducing qty of %lld, although it violates strategy maxpos:  |%lld| > %lld", 
                 m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, 
-                (long long) (algo_qty+qty), (long long) m_cfg->m_strat_max_pos[algo][mkt]);
+                (long long) (algo_qty+qty), strat_max_pos);
     }
 
     // check for eng maximum position
-    if (__builtin_expect(std::abs((long long)(eng_qty+qty)) > m_cfg->m_eng_max_pos[mkt],0)) {
+    const long long eng_max_pos = m_eng_max_pos[mkt_id];
+    if (__builtin_expect(std::abs((long long)(eng_qty+qty)) > eng_max_pos,0)) {
         // risk reducing ?
         if (!eng_risk_reduce) {
             logError("RiskMonitor(%s) %s:%s qty %lld violates engine maxpos: |%lld| > %lld", 
                     m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, 
-                    (long long) (eng_qty+qty), (long long) m_cfg->m_eng_max_pos[mkt]);
+                    (long long) (eng_qty+qty), eng_max_pos);
             return false;
         }
         logInfo("RiskMonitor(%s) %s:%s allowing risk reducing qty of %lld, although it violates engine maxpos: |%lld| > %lld", 
                 m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, 
-                (long long) (eng_qty+qty), (long long) m_cfg->m_eng_max_pos[mkt]);
+                (long long) (eng_qty+qty), eng_max_pos);
     }
 
     // check for algo pnl drawdown
     // TODO - consider moving the PNL check as a function
-    if (__builtin_expect(algo_pnl < m_cfg->m_strat_pnl_drawdown[algo],0)) {
+    const double strat_pnl_drawdown = m_strat_pnl_drawdown[algo_id];
+    if (__builtin_expect(algo_pnl < strat_pnl_drawdown,0)) {
         // risk reducing ?
         if (!strat_risk_reduce) {
             logError("RiskMonitor(%s) %s:%s strategy(%s) overall mtm_pnl %lld hits drawdown %lld", 
                     m_name.c_str(), algo.c_str(), mkt.c_str(), algo.c_str(), (long long) algo_pnl,
-                    (long long) m_cfg->m_strat_pnl_drawdown[algo]);
+                    (long long) strat_pnl_drawdown);
             return false;
         }
         logInfo("RiskMonitor(%s) %s:%s allowing risk reducing qty of %lld, although strategy's mtmpnl %lld hits drawdown %lld", 
                 m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, (long long) algo_pnl,
-                (long long) m_cfg->m_strat_pnl_drawdown[algo]);
+                (long long) strat_pnl_drawdown);
     }
 
     // check for algo-mkt pnl drawdown
-    if (__builtin_expect(mkt_pnl < m_cfg->m_strat_mkt_pnl_drawdown[algo][mkt],0)) {
+    const double strat_mkt_pnl_drawdown = m_strat_mkt_pnl_drawdown[sidx];
+    if (__builtin_expect(mkt_pnl < strat_mkt_pnl_drawdown,0)) {
         // risk reducing ?
         if (!strat_risk_reduce) {
             logError("RiskMonitor(%s) %s:%s strategy's market(%s) mtm_pnl %lld hits drawdown %lld", 
                     m_name.c_str(), algo.c_str(), mkt.c_str(), mkt.c_str(), (long long) mkt_pnl,
-                    (long long) m_cfg->m_strat_mkt_pnl_drawdown[algo][mkt]);
+                    (long long) strat_mkt_pnl_drawdown);
             return false;
         }
         logInfo("RiskMonitor(%s) %s:%s allowing risk reducing qty of %lld, although strategy's market(%s) mtm_pnl %lld hits drawdown %lld", 
                 m_name.c_str(), algo.c_str(), mkt.c_str(), (long long) qty, mkt.c_str(), (long long) mkt_pnl,
-                (long long) m_cfg->m_strat_mkt_pnl_drawdown[algo][mkt]);
+                (long long) strat_mkt_pnl_drawdown);
     }
 
     // check for too much position direction flippings
-    if (__builtin_expect(!checkFlip(algo, mkt, algo_qty+qty, is_from_report, cur_utc),0)) {
+    if (__builtin_expect(!checkFlip(algo_id, mkt_id, algo_qty+qty, is_from_report, cur_utc),0)) {
         return false;
     }
 
@@ -0,0 +1,141 @@
+#include "latency_stats.h"
+#include "time_util.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Prints the percentiles of the latency histograms in the shm stats,
+ * per hop over all symbols followed by each symbol of the hop, in
+ * micro seconds, i.e.
+ *   lattap               print once
+ *   lattap -i 5          print every 5 seconds, the counts since the last,
+ *                        with the max since start or the reset
+ *   lattap order_er      print the hops starting with order_er
+ *   lattap -r            zero the histograms
+ */
+
+using utils::LatencyHist;
+using utils::LatencyStats;
+
+static const char* Hops[] = {
+    LatencyStats::HopMdAlgo,
+    LatencyStats::HopAlgoPI,
+    LatencyStats::HopPIFloor,
+    LatencyStats::HopFloorOrder,
+    LatencyStats::HopOrderER
+};
+
+// (hop, symbol) to the histogram
+using HistMap = std::map<std::pair<std::string, std::string>, LatencyHist>;
+
+static HistMap snapshot(const LatencyStats& stats) {
+    HistMap hm;
+    stats.forEach([&hm](const LatencyStats::Slot& s) {
+            hm[std::make_pair(std::string(s.hop), std::string(s.symbol))] = s.hist;
+        });
+    return hm;
+}
+
+// the counts of cur since prev
+static LatencyHist diff(const LatencyHist& cur, const LatencyHist* prev) {
+    LatencyHist h (cur);
+    if (prev) {
+        h.sum_ns -= prev->sum_ns;
+        for (int b=0; b<LatencyHist::Buckets; ++b) {
+            h.cnt[b] -= prev->cnt[b];
+        }
+    }
+    return h;
+}
+
+static void printHist(const std::string& hop, const std::string& symbol, const LatencyHist& h) {
+    printf("%-12s %-16s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+            hop.c_str(), symbol.size()? symbol.c_str():"ALL",
+            (unsigned long long)h.count(), h.mean()/1000.0,
+            h.percentile(50)/1000.0, h.percentile(90)/1000.0,
+            h.percentile(99)/1000.0, h.percentile(99.9)/1000.0,
+            h.max_ns/1000.0);
+}
+
+static void print(const HistMap& cur, const HistMap& prev, const char* hop_prefix) {
+    printf("%-12s %-16s %10s %9s %9s %9s %9s %9s %9s\n",
+            "hop", "symbol", "count", "mean_us", "p50", "p90", "p99", "p99.9", "max");
+    // the hops in the path order, then any other hops found
+    std::vector<std::string> hops (std::begin(Hops), std::end(Hops));
+    for (const auto& kv : cur) {
+        if (std::find(hops.begin(), hops.end(), kv.first.first) == hops.end()) {
+            hops.push_back(kv.first.first);
+        }
+    }
+    for (const auto& hop : hops) {
+        if (hop_prefix && (strncmp(hop.c_str(), hop_prefix, strlen(hop_prefix)) != 0)) {
+            continue;
+        }
+        LatencyHist total;
+        memset(&total, 0, sizeof(total));
+        std::vector<std::pair<std::string, LatencyHist>> sym;
+        for (auto iter = cur.lower_bound(std::make_pair(hop, std::string()));
+             (iter != cur.end()) && (iter->first.first == hop); ++iter) {
+            auto piter = prev.find(iter->first);
+            const auto& h (diff(iter->second, (piter == prev.end())? nullptr : &piter->second));
+            total.add(h);
+            sym.emplace_back(iter->first.second, h);
+        }
+        if (!sym.size()) {
+            continue;
+        }
+        printHist(hop, "", total);
+        for (const auto& s : sym) {
+            printHist(hop, s.first, s.second);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int interval = 0;
+    bool reset = false;
+    const char* hop_prefix = nullptr;
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-i") == 0) && (i+1 < argc)) {
+            interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            reset = true;
+        } else if (argv[i][0] == '-') {
+            printf("Usage: %s [-i seconds] [-r] [hop]\n", argv[0]);
+            printf("prints the latency percentiles in micro seconds per hop and symbol\n");
+            printf("  -i: repeat every given seconds, with the counts of the interval\n");
+            printf("  -r: zero the histograms\n");
+            return 0;
+        } else {
+            hop_prefix = argv[i];
+        }
+    }
+    try {
+        if (reset) {
+            LatencyStats(LatencyStats::ShmName).reset();
+            printf("latency histograms reset\n");
+            return 0;
+        }
+        LatencyStats stats(LatencyStats::ShmName, true);
+        HistMap prev;
+        while (true) {
+            const auto& cur (snapshot(stats));
+            printf("%s\n", utils::TimeUtil::frac_UTC_to_string(0, 0).c_str());
+            print(cur, prev, hop_prefix);
+            if (stats.dropped()) {
+                printf("lookups dropped to a private histogram: %llu\n\n", (unsigned long long)stats.dropped());
+            }
+            if (!interval) {
+                break;
+            }
+            prev = cur;
+            utils::TimeUtil::micro_sleep((uint64_t)interval*1000000ULL);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include "ExecutionReport.h"
+#include "ERJournal.h"
+#include "time_util.h"
 #include <iostream>
 #include <cmath>
 #include "gtest/gtest.h"
@@ -115,6 +117,64 @@ TEST (ExecutionReportTest, TestER) {
     EXPECT_TRUE(er0.compareTo(pm::ExecutionReport::fromCSVLine(erline[0]), &difflog)) << difflog;
 }
 
+TEST (ExecutionReportTest, Journal) {
+    const std::string erfname = "/tmp/test_er_journal.csv";
+    const std::string jfname = pm::ERJournal::fname(erfname);
+    EXPECT_EQ(std::string("/tmp/test_er_journal.bin"), jfname);
+
+    // the 4th is received out of order
+    utils::CSVUtil::FileTokens erlines = {
+        {"sym1", "algo1","cid1", "eid1", "0","-10","2.1218", "20201004-18:33:02","", "1601850782023138"},
+        {"sym1", "algo1","cid1", "eid2", "1","-3" ,"2.1218", "20201004-18:33:02","", "1601850782823033"},
+        {"sym1", "algo1","cid2", "eid3", "0","5"  ,"2.1219", "20201004-18:33:08","", "1601850788504031"},
+        {"sym1", "algo1","cid2", "eid4", "4","0"  ,"0"     , "20201004-18:33:08","", "1601850785591032"},
+        {"sym1", "algo1","cid1", "eid5", "2","-7" ,"2.13"  , "20201004-18:33:09","", "1601850789504031"}
+    };
+    utils::CSVUtil::write_file(erlines, erfname, false);
+    EXPECT_EQ(5, pm::ERJournal::convert(erfname, jfname));
+
+    std::vector<pm::ExecutionReport> er_vec;
+    bool covered = false;
+    EXPECT_TRUE(pm::ERJournal::read(jfname, 1601850785000000ULL, 1601850789000000ULL, er_vec, &covered));
+    EXPECT_TRUE(covered);
+    ASSERT_EQ(2, (int)er_vec.size());
+    EXPECT_STREQ("eid3", er_vec[0].m_execId);
+    EXPECT_STREQ("eid4", er_vec[1].m_execId);
+
+    er_vec.clear();
+    EXPECT_TRUE(pm::ERJournal::read(jfname, 1601850780000000ULL, (uint64_t)-1, er_vec, &covered));
+    EXPECT_FALSE(covered);
+    EXPECT_EQ(5, (int)er_vec.size());
+
+    // the same replay from the journal and from the csv
+    const std::string start_local = utils::TimeUtil::frac_UTC_to_string(1601850785, 0);
+    const std::string end_local = utils::TimeUtil::frac_UTC_to_string(1601850790, 0);
+    const std::string out_journal = "/tmp/test_er_journal_out1.csv";
+    const std::string out_csv = "/tmp/test_er_journal_out2.csv";
+    EXPECT_TRUE(pm::ExecutionReport::loadFromPersistence(start_local, end_local, out_journal, erfname));
+    std::remove(jfname.c_str());
+    EXPECT_TRUE(pm::ExecutionReport::loadFromPersistence(start_local, end_local, out_csv, erfname));
+    const auto& lines_journal = utils::CSVUtil::read_file(out_journal);
+    EXPECT_EQ(3, (int)lines_journal.size());
+    EXPECT_EQ(utils::CSVUtil::read_file(out_csv), lines_journal);
+
+    // appended with the csv by persist()
+    for (const auto& line : erlines) {
+        EXPECT_TRUE(pm::ERJournal::append(pm::ExecutionReport::fromCSVLine(line), jfname));
+    }
+    EXPECT_TRUE(pm::ERJournal::flush(jfname));
+    er_vec.clear();
+    EXPECT_TRUE(pm::ERJournal::read(jfname, 0, (uint64_t)-1, er_vec, &covered));
+    ASSERT_EQ(5, (int)er_vec.size());
+    std::string difflog;
+    EXPECT_TRUE(er_vec[4].compareTo(pm::ExecutionReport::fromCSVLine(erlines[4]), &difflog)) << difflog;
+
+    std::remove(erfname.c_str());
+    std::remove(jfname.c_str());
+    std::remove(out_journal.c_str());
+    std::remove(out_csv.c_str());
+}
+
 int main(int argc, char** argv) {
     utils::PLCC::setConfigPath("/tmp/main.cfg");
     setupConfig();
@@ -0,0 +1,119 @@
+#include "ExecutionTrader.h"
+#include <stdio.h>
+#include <map>
+#include <algorithm>
+#include <time.h>
+
+/*
+ * The FloorTrader's loop over concurrent TWAP instructions, each run
+ * every IntervalMicro, staggered, a part done after each run, i.e. the
+ * instructions accumulated in a day.  The loop wakes every StepMicro of
+ * the simulated time, for DayMicro, with
+ *   scan:   m_eiMap scanned for the due ones, then for the sleep, as
+ *           the FloorTrader before the ETSchedule
+ *   sched:  the due ones taken from the ETSchedule, the sleep from
+ *           its top
+ * onRun() only reschedules, so the time is that of the loop itself.
+ *     bin/et_sched_bench [instructions...]
+ */
+
+static const uint64_t IntervalMicro = 60*1000000ULL;
+static const uint64_t StepMicro = 10000;
+static const uint64_t DayMicro = 300*1000000ULL;
+static const int DonePerMil = 20;   // of the runs, the instruction done
+
+static volatile uint64_t Sink;  // the sleeps, kept
+
+static uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static std::map<std::string, std::shared_ptr<pm::ETInfo>> genMap(int n) {
+    std::map<std::string, std::shared_ptr<pm::ETInfo>> m;
+    for (int i=0; i<n; ++i) {
+        auto ei = std::make_shared<pm::ETInfo>();
+        ei->_done = false;
+        ei->_next_micro = (IntervalMicro/n)*i;
+        m["algo" + std::to_string(i%50) + "::SYM" + std::to_string(i)] = ei;
+    }
+    return m;
+}
+
+// as onRun()
+static void run(pm::ETInfo& ei, uint64_t cur_micro, uint64_t& runs) {
+    ei._next_micro = cur_micro + IntervalMicro;
+    if ((++runs*7919)%1000 < DonePerMil) {
+        ei._done = true;
+    }
+}
+
+static void print(const char* name, int n, uint64_t ns, uint64_t loops, uint64_t runs, uint64_t chk) {
+    Sink = chk;
+    printf("%-6s %6d instructions: %9.2f us/loop, %8.1f ns/run (%llu runs)\n",
+            name, n, ns/1000.0/loops, (double)ns/runs, (unsigned long long)runs);
+}
+
+static void runScan(int n) {
+    auto m (genMap(n));
+    uint64_t runs = 0, loops = 0, chk = 0;
+    const uint64_t t0 = mono_ns();
+    for (uint64_t cur_micro=0; cur_micro<DayMicro; cur_micro+=StepMicro, ++loops) {
+        for (auto& kv : m) {
+            auto& ei (*kv.second);
+            if (ei._done) {
+                continue;
+            }
+            if (ei._next_micro <= cur_micro) {
+                run(ei, cur_micro, runs);
+            }
+        }
+        uint64_t min_next_micro = cur_micro + 100000;
+        for (auto& kv : m) {
+            const auto& ei (*kv.second);
+            if (ei._done) {
+                continue;
+            }
+            min_next_micro = std::min(ei._next_micro, min_next_micro);
+        }
+        chk += min_next_micro;
+    }
+    print("scan", n, mono_ns() - t0, loops, runs, chk);
+}
+
+static void runSched(int n) {
+    auto m (genMap(n));
+    pm::ETSchedule sched;
+    for (auto& kv : m) {
+        sched.update(kv.second);
+    }
+    std::vector<std::shared_ptr<pm::ETInfo>> due;
+    uint64_t runs = 0, loops = 0, chk = 0;
+    const uint64_t t0 = mono_ns();
+    for (uint64_t cur_micro=0; cur_micro<DayMicro; cur_micro+=StepMicro, ++loops) {
+        due.clear();
+        sched.popDue(cur_micro, due);
+        for (auto& ei : due) {
+            run(*ei, cur_micro, runs);
+            sched.update(ei);
+        }
+        chk += std::min(sched.nextMicro(), cur_micro + 100000);
+    }
+    print("sched", n, mono_ns() - t0, loops, runs, chk);
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> cnt;
+    for (int i=1; i<argc; ++i) {
+        cnt.push_back(atoi(argv[i]));
+    }
+    if (!cnt.size()) {
+        cnt = {1000, 5000, 20000};
+    }
+    for (int n : cnt) {
+        runScan(n);
+        runSched(n);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "PositionManager.h"
+#include "md_snap.h"
+#include <stdio.h>
+#include <fstream>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * A pnl sweep, PositionManager::getPosition_Market() with the MTM pnl, of
+ * Positions positions in as many symbols, the prices from
+ *   attach:    the L1 BookQ attached and detached per position, as
+ *              LatestBook() before the BookQRegistry, the registry
+ *              cleared before each sweep
+ *   registry:  the BookQ readers kept by the BookQRegistry
+ *   lvc:       the last value cache
+ * The first two run with the time mocked, so that getBBO() doesn't use
+ * the last value cache, as in simulations.
+ * Writes its config and empty EoD positions to /tmp/mtm_bench, and the
+ * L1 BookQ of each symbol, removed at the end, i.e.
+ *     bin/mtm_bench [sweeps]
+ */
+
+static const char* Dir = "/tmp/mtm_bench";
+static const int Positions = 50;
+
+static std::string tradable(int i) {
+    return "T" + std::to_string(i) + "Q1";
+}
+
+static void setupCfg() {
+    mkdir(Dir, 0755);
+    const std::string dir (Dir);
+    {
+        std::ofstream ofs (dir + "/main.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "Logger = " << dir << "/log" << std::endl;
+        ofs << "RecoveryPath = " << dir << std::endl;
+        ofs << "SymbolMap = " << dir << "/symbol_map.cfg" << std::endl;
+    }
+    {
+        std::ofstream ofs (dir + "/symbol_map.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "tradable = {\n";
+        for (int m=0; m<Positions; ++m) {
+            ofs << "    " << tradable(m) << " = {\n";
+            ofs << "        symbol = MKT" << m << "\n";
+            ofs << "        exch_symbol = M" << m << "\n";
+            ofs << "        venue = NYM\n";
+            ofs << "        currency = USD\n";
+            ofs << "        tick_size = 0.010000000000\n";
+            ofs << "        point_value = 1000.0\n";
+            ofs << "        px_multiplier = 0.010000000000\n";
+            ofs << "        type = FUT\n";
+            ofs << "        mts_contract = MKT" << m << "_202106\n";
+            ofs << "        contract_month = 202106\n";
+            ofs << "        mts_symbol = MKT" << m << "_N1\n";
+            ofs << "        N = 1\n";
+            ofs << "        expiration_days = 5\n";
+            ofs << "        tt_security_id = " << 1000+m << "\n";
+            ofs << "        tt_venue = NYM\n";
+            ofs << "        expiration_date = 2021-05-20\n";
+            ofs << "        bbg_id = " << tradable(m) << " COMDTY\n";
+            ofs << "        bbg_px_multiplier = 1.0\n";
+            ofs << "        tickdata_id = T" << m << "Q21\n";
+            ofs << "        tickdata_px_multiplier = 1.000000000000\n";
+            ofs << "        tickdata_timezone = America/New_York\n";
+            ofs << "        lotspermin = 40\n";
+            ofs << "    }\n";
+        }
+        ofs << "}\n";
+    }
+    std::ofstream ofs (dir + "/eod_pos.csv", std::ofstream::out | std::ofstream::trunc);
+    // the path is kept by PLCC
+    static const std::string cfg (dir + "/main.cfg");
+    utils::PLCC::setConfigPath(cfg.c_str());
+}
+
+static uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static void run(const char* name, pm::PositionManager& pmgr, int sweeps, bool clear) {
+    auto& reg (md::BookQRegistry::get());
+    double mtm = 0, chk = 0;
+    uint64_t ns = 0;
+    for (int r=0; r<sweeps; ++r) {
+        if (clear) {
+            reg.clear();
+        }
+        const uint64_t t0 = mono_ns();
+        pmgr.getPosition_Market(nullptr, nullptr, &mtm);
+        ns += mono_ns() - t0;
+        chk += mtm;
+    }
+    printf("%-9s sweep of %d positions: %9.1f us, %7.1f ns/position (mtm %.0f)\n",
+            name, Positions, ns/1000.0/sweeps, (double)ns/sweeps/Positions, chk/sweeps);
+}
+
+int main(int argc, char** argv) {
+    const int sweeps = (argc>1)? atoi(argv[1]) : 1000;
+    setupCfg();
+
+    // the tp's writers, one L1 BookQ per symbol
+    std::vector<std::shared_ptr<md::BookQType>> bqs;
+    for (int m=0; m<Positions; ++m) {
+        md::BookConfig bcfg(tradable(m), "L1");
+        bqs.emplace_back(new md::BookQType(bcfg, false, true));
+        bqs.back()->theWriter().updBBO(40.0+m-0.01, 10, 40.0+m+0.01, 20, utils::TimeUtil::cur_micro());
+    }
+
+    // a long position of 1+m lots in each symbol
+    pm::PositionManager pmgr("bench", Dir);
+    uint64_t recv_micro = 1601850782000000ULL;
+    for (int m=0; m<Positions; ++m) {
+        const std::string clOrdId ("c" + std::to_string(m));
+        const std::string utc (utils::TimeUtil::frac_UTC_to_string(recv_micro/1000000ULL, 0, "%Y%m%d-%H:%M:%S", true));
+        pmgr.update(pm::ExecutionReport(tradable(m), "algo", clOrdId, clOrdId + "n", "0", 1+m, 40.0+m, utc, "", ++recv_micro, 0));
+        pmgr.update(pm::ExecutionReport(tradable(m), "algo", clOrdId, clOrdId + "f", "2", 1+m, 40.0+m, utc, "", ++recv_micro, 0));
+    }
+
+    utils::TimeUtil::set_cur_time_micro(recv_micro);
+    run("attach", pmgr, sweeps, true);
+    run("registry", pmgr, sweeps, false);
+    utils::TimeUtil::unset_cur_time_micro();
+    run("lvc", pmgr, sweeps, false);
+
+    md::BookQRegistry::get().clear();
+    for (const auto& bq : bqs) {
+        shm_unlink(bq->_q_name.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include "PegScanner.h"
+#include "latency_stats.h"
+#include "md_snap.h"
+#include <stdio.h>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <sys/stat.h>
+
+/*
+ * The FloorManager's peg of Orders open orders, OrdersPerSymbol in each
+ * symbol joining the touch, while a symbol's touch moves every
+ * MoveEveryMicro, with
+ *   timer:  every ScanIntervalMicro all open orders listed and pegged,
+ *           at most one replace per scan, as the FloorManager before the
+ *           PegScanner, waking every IdleSleepMicro
+ *   event:  the PegScanner, the symbols of the moved touch pegged
+ * The BBO is written to the last value cache, the replace is acked as a
+ * new order at once, aged, so that the next move is pegged.  Reports the
+ * reaction, from the move of a touch to the replace of its first order,
+ * and the cpu of the scans.
+ * Writes its config and empty EoD positions to /tmp/peg_bench, i.e.
+ *     bin/peg_bench [run_sec]
+ */
+
+static const char* Dir = "/tmp/peg_bench";
+static const int Symbols = 50;
+static const int OrdersPerSymbol = 10;
+static const int MoveEveryMicro = 5000;
+static const uint64_t IdleSleepMicro = 50000;
+static const uint64_t ScanIntervalMicro = 100000;
+
+static std::string tradable(int i) {
+    return "T" + std::to_string(i) + "Q1";
+}
+
+static void setupCfg() {
+    mkdir(Dir, 0755);
+    const std::string dir (Dir);
+    {
+        std::ofstream ofs (dir + "/main.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "Logger = " << dir << "/log" << std::endl;
+        ofs << "RecoveryPath = " << dir << std::endl;
+        ofs << "SymbolMap = " << dir << "/symbol_map.cfg" << std::endl;
+    }
+    {
+        std::ofstream ofs (dir + "/symbol_map.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "tradable = {\n";
+        for (int m=0; m<Symbols; ++m) {
+            ofs << "    " << tradable(m) << " = {\n";
+            ofs << "        symbol = MKT" << m << "\n";
+            ofs << "        exch_symbol = M" << m << "\n";
+            ofs << "        venue = NYM\n";
+            ofs << "        currency = USD\n";
+            ofs << "        tick_size = 0.010000000000\n";
+            ofs << "        point_value = 1000.0\n";
+            ofs << "        px_multiplier = 0.010000000000\n";
+            ofs << "        type = FUT\n";
+            ofs << "        mts_contract = MKT" << m << "_202106\n";
+            ofs << "        contract_month = 202106\n";
+            ofs << "        mts_symbol = MKT" << m << "_N1\n";
+            ofs << "        N = 1\n";
+            ofs << "        expiration_days = 5\n";
+            ofs << "        tt_security_id = " << 1000+m << "\n";
+            ofs << "        tt_venue = NYM\n";
+            ofs << "        expiration_date = 2021-05-20\n";
+            ofs << "        bbg_id = " << tradable(m) << " COMDTY\n";
+            ofs << "        bbg_px_multiplier = 1.0\n";
+            ofs << "        tickdata_id = T" << m << "Q21\n";
+            ofs << "        tickdata_px_multiplier = 1.000000000000\n";
+            ofs << "        tickdata_timezone = America/New_York\n";
+            ofs << "        lotspermin = 40\n";
+            ofs << "    }\n";
+        }
+        ofs << "}\n";
+    }
+    std::ofstream ofs (dir + "/eod_pos.csv", std::ofstream::out | std::ofstream::trunc);
+    // the path is kept by PLCC
+    static const std::string cfg (dir + "/main.cfg");
+    utils::PLCC::setConfigPath(cfg.c_str());
+}
+
+// the tp side, moves the touch of a symbol and stamps it
+struct Market {
+    std::vector<int> lvc_id;
+    std::vector<int> tick;
+    std::atomic<uint64_t> moved_ns[Symbols];
+
+    Market() : tick(Symbols, 0) {
+        auto& lvc (md::LVC::get());
+        for (int m=0; m<Symbols; ++m) {
+            lvc_id.push_back(lvc.id(md::LVC::key(md::BookConfig(tradable(m), "L1"))));
+            moved_ns[m] = 0;
+            write(m);
+        }
+    }
+
+    void write(int m) {
+        md::BookDepot book;
+        book.avail_level[0] = book.avail_level[1] = 1;
+        const double bid = 40.0 + m + tick[m]*0.01;
+        book.pe[0] = md::PriceEntry(bid, 10, 1, 1);
+        book.pe[BookLevel] = md::PriceEntry(bid + 0.02, 10, 1, 1);
+        md::LVC::get().update(lvc_id[m], book);
+    }
+
+    void move(int m) {
+        tick[m] += (tick[m] > 0)? -1 : 1;
+        write(m);
+        moved_ns[m] = utils::LatencyStats::now_ns();
+    }
+};
+
+struct Floor {
+    pm::PositionManager pmgr;
+    Market& mkt;
+    std::unordered_map<std::string, int> sym_idx;
+    utils::LatencyHist reaction;
+    int ord;
+
+    explicit Floor(Market& mkt_) : pmgr("bench", Dir), mkt(mkt_), ord(0) {
+        memset(&reaction, 0, sizeof(reaction));
+        const uint64_t recv_micro = utils::TimeUtil::cur_micro() - 1000000;
+        for (int m=0; m<Symbols; ++m) {
+            sym_idx[tradable(m)] = m;
+            for (int k=0; k<OrdersPerSymbol; ++k) {
+                newOrder(tradable(m), (k%2)? 1:-1, 40.0 + m, recv_micro);
+            }
+        }
+    }
+
+    pm::ExecutionReport newOrder(const std::string& symbol, int qty, double px, uint64_t recv_micro) {
+        const std::string clOrdId ("p" + std::to_string(++ord));
+        pm::ExecutionReport er(symbol, "algo", clOrdId, clOrdId + "n", "0", qty, px, "20201004-18:33:02", "", recv_micro, 0);
+        pmgr.update(er);
+        return er;
+    }
+
+    // joins the touch
+    bool peg(const std::shared_ptr<const pm::OpenOrder>& oo, double& px, bool& aggressive) {
+        double bp, ap;
+        int bs, as;
+        if (!md::getBBO(oo->m_idp->get_symbol(), bp, bs, ap, as)) {
+            return false;
+        }
+        px = (oo->m_open_qty > 0)? bp : ap;
+        aggressive = false;
+        return true;
+    }
+
+    // acked at once, aged to be pegged on the next move
+    pm::ExecutionReport replace(const std::shared_ptr<const pm::OpenOrder>& oo, double px) {
+        const std::string symbol (oo->m_idp->get_symbol());
+        auto& moved (mkt.moved_ns[sym_idx[symbol]]);
+        const uint64_t moved_ns = moved.exchange(0);
+        if (moved_ns) {
+            reaction.record(utils::LatencyStats::now_ns() - moved_ns);
+        }
+        const int64_t qty = oo->m_open_qty;
+        pmgr.deleteOO(oo->m_clOrdId);
+        return newOrder(symbol, (int)qty, px, utils::TimeUtil::cur_micro() - pm::PegScanner::MinAgeMicro - 1);
+    }
+};
+
+struct ScanStats {
+    uint64_t scans, scan_ns, idle_scans, idle_ns, replaces;
+};
+
+static void print(const char* name, const Floor& flr, const ScanStats& st, uint64_t run_ns) {
+    const auto& h (flr.reaction);
+    printf("%-6s reaction_us p50 %8.1f p99 %8.1f max %8.1f (%llu moves)  scan_us %7.2f x %5llu, without replace %7.2f x %5llu, cpu %5.2f%%, %llu replaces\n",
+            name, h.percentile(50)/1000.0, h.percentile(99)/1000.0, h.max_ns/1000.0, (unsigned long long)h.count(),
+            st.scan_ns/1000.0/st.scans, (unsigned long long)st.scans,
+            st.idle_scans? st.idle_ns/1000.0/st.idle_scans : 0.0, (unsigned long long)st.idle_scans,
+            100.0*st.scan_ns/run_ns, (unsigned long long)st.replaces);
+}
+
+template<typename ScanFunc>
+static void run(const char* name, Floor& flr, int run_sec, ScanFunc&& scan_func) {
+    std::atomic<bool> done(false);
+    std::thread mover([&]() {
+            uint64_t i = 0;
+            while (!done) {
+                utils::TimeUtil::micro_sleep(MoveEveryMicro);
+                flr.mkt.move((int)((i++*7919)%Symbols));
+            }
+        });
+    ScanStats st;
+    memset(&st, 0, sizeof(st));
+    const uint64_t t0 = utils::LatencyStats::now_ns();
+    const uint64_t t1 = t0 + run_sec*1000000000ULL;
+    while (true) {
+        const uint64_t t = utils::LatencyStats::now_ns();
+        if (t >= t1) {
+            break;
+        }
+        uint64_t wait_micro = IdleSleepMicro;
+        const int r = scan_func(wait_micro);
+        if (r >= 0) {
+            const uint64_t ns = utils::LatencyStats::now_ns() - t;
+            ++st.scans;
+            st.scan_ns += ns;
+            st.replaces += r;
+            if (!r) {
+                ++st.idle_scans;
+                st.idle_ns += ns;
+            }
+        }
+        utils::TimeUtil::micro_sleep(wait_micro);
+    }
+    done = true;
+    mover.join();
+    print(name, flr, st, utils::LatencyStats::now_ns() - t0);
+}
+
+int main(int argc, char** argv) {
+    const int run_sec = (argc > 1)? atoi(argv[1]) : 3;
+    setupCfg();
+    Market mkt;
+    printf("%d open orders in %d symbols, a touch moves every %d us, %u cpus\n",
+            Symbols*OrdersPerSymbol, Symbols, MoveEveryMicro, std::thread::hardware_concurrency());
+    {
+        Floor flr(mkt);
+        uint64_t last_scan_micro = 0;
+        run("timer", flr, run_sec, [&](uint64_t& wait_micro) {
+                const uint64_t cur_micro = utils::TimeUtil::cur_micro();
+                if (cur_micro - last_scan_micro < ScanIntervalMicro) {
+                    return -1;
+                }
+                last_scan_micro = cur_micro;
+                for (const auto& oo : flr.pmgr.listOO()) {
+                    double px;
+                    bool aggressive;
+                    if (flr.peg(oo, px, aggressive) && (std::abs(px - oo->m_open_px) > 1e-10)) {
+                        flr.replace(oo, px);
+                        return 1;
+                    }
+                }
+                return 0;
+            });
+    }
+    {
+        Floor flr(mkt);
+        for (auto& m : mkt.moved_ns) {
+            m = 0;
+        }
+        pm::PegScanner* scanner = nullptr;
+        pm::PegScanner peg(flr.pmgr,
+                [&flr](const std::shared_ptr<const pm::OpenOrder>& oo, double& px, bool& aggressive) {
+                    return flr.peg(oo, px, aggressive);
+                },
+                [&flr, &scanner](const std::shared_ptr<const pm::OpenOrder>& oo, double px) {
+                    scanner->onER(flr.replace(oo, px));
+                    return true;
+                });
+        scanner = &peg;
+        run("event", flr, run_sec, [&](uint64_t& wait_micro) {
+                const int r = peg.scan(utils::TimeUtil::cur_micro());
+                wait_micro = peg.waitMicro(IdleSleepMicro);
+                return r;
+            });
+    }
+    return 0;
+}
@@ -1,4 +1,8 @@
 #include "PositionManager.h"
+#include "PositionShards.h"
+#include "ExecutionTrader.h"
+#include "PegScanner.h"
+#include "md_snap.h"
 #include "csv_util.h"
 #include "time_util.h"
 #include <iostream>
@@ -6,6 +10,10 @@
 #include "gtest/gtest.h"
 #include "plcc/PLCC.hpp"
 #include <fstream>
+#include <sys/stat.h>
+#include <utime.h>
+#include <atomic>
+#include <algorithm>
 
 void setupConfig() {
     const std::string cfgstr ("SymbolMap = /tmp/symbol_map.cfg\n");
@@ -224,6 +232,350 @@ TEST_F(PMTest,  LoadSave) {
     }
 };
 
+TEST_F(PMTest,  MarketIds) {
+    utils::CSVUtil::FileTokens erlines0;
+    utils::CSVUtil::write_file(erlines0, RecoverPath+"/"+EODCSV, false);
+
+    pm::PositionManager pmgr("testpm_ids", RecoverPath);
+    utils::CSVUtil::write_file(erlines, RecoverPath+"/"+RecoveryCSV, false);
+    pmgr.loadRecovery(RecoveryCSV);
+    pmgr.persist();
+
+    utils::CSVUtil::FileTokens erlines_update = {
+    {"sym1", "algo1","cid5", "eid11", "0","10","3.0", "20201004-18:33:02","", "1601850782023138"},
+    {"sym1", "algo1","cid5", "eid12", "1","5" ,"3.0", "20201004-18:33:02","", "1601850782823033"}
+    };
+    for (const auto& line : erlines_update) {
+        pmgr.update(pm::ExecutionReport::fromCSVLine(line));
+    }
+
+    // aggregated position including open qty by algo and market
+    // algo1: sym1 -5 oo(5), sym2 -1 oo(-4)
+    // algo2: sym1 1 oo(4)
+    const std::string algo1 ("algo1"), algo2 ("algo2"), wti ("WTI"), brent ("Brent");
+    EXPECT_EQ(pmgr.getPosition_Market(&algo1, &wti), -5);
+    EXPECT_EQ(pmgr.getPosition_Market(&algo2, &wti), 5);
+    EXPECT_EQ(pmgr.getPosition_Market(nullptr, &wti), 0);
+    EXPECT_EQ(pmgr.getPosition_Market(&algo1, nullptr), -5);
+    EXPECT_EQ(pmgr.getPosition_Market(&algo1, &brent), 0);
+
+    // the id index is rebuilt after reconcile
+    // algo1: sym1 -5 oo(5), sym2 -5 oo()
+    utils::CSVUtil::FileTokens erlines_update2 = {
+    {"sym2", "algo1","cid4", "eid13", "2","-4","10.1", "20201004-18:33:02","", "1601850782023138"}
+    };
+    utils::CSVUtil::write_file(erlines_update, RecoverPath+"/"+RecoveryCSV, false);
+    utils::CSVUtil::write_file(erlines_update2, RecoverPath+"/"+RecoveryCSV, true);
+    std::string difflog;
+    pmgr.reconcile(RecoveryCSV, difflog, true);
+
+    int64_t eng_qty = 0;
+    for (const auto& idp : pmgr.listPosition()) {
+        eng_qty += (idp->getPosition() + idp->getOpenQty());
+    }
+    EXPECT_EQ(pmgr.getPosition_Market(&algo1, &wti), -5);
+    EXPECT_EQ(pmgr.getPosition_Market(nullptr, &wti), eng_qty);
+};
+
+TEST_F(PMTest,  Checkpoint) {
+    const std::string path = "/tmp/pm_ckpt_test";
+    mkdir(path.c_str(), 0755);
+    // eod position reconciled before the execution reports
+    utils::CSVUtil::FileTokens eodlines = {
+        {utils::TimeUtil::frac_UTC_to_string(1601848800, 0), "algo3", "sym2", "2", "10.0", "0", "1601848800000000", "USD"}
+    };
+    utils::CSVUtil::write_file(eodlines, path+"/"+EODCSV, false);
+    utils::CSVUtil::write_file(erlines, path+"/"+RecoveryCSV, false);
+    const std::string ckpt_file = path + "/ckpt_pm.ckpt";
+    std::remove(ckpt_file.c_str());
+
+    pm::PositionManager pmgr("ckpt", path);
+    EXPECT_EQ(pmgr.getLoadUtc(), eodlines[0][0]);
+    pmgr.loadRecovery(RecoveryCSV);
+    EXPECT_EQ(pmgr.getMaxRecvMicro(), 1601850789504031ULL);
+    EXPECT_TRUE(pmgr.checkpoint());
+    EXPECT_EQ(pmgr.checkpoint_file(), ckpt_file);
+
+    // loaded from the checkpoint, with pnl and open orders
+    pm::PositionManager pmgr2("ckpt", path);
+    EXPECT_EQ(pmgr2.getLoadUtc(), utils::TimeUtil::frac_UTC_to_string(1601850789-60, 0));
+    EXPECT_EQ(pmgr2.getMaxRecvMicro(), pmgr.getMaxRecvMicro());
+    std::string difflog = pmgr.diff(pmgr2) + pmgr2.diff(pmgr);
+    EXPECT_EQ(difflog.size(), 0) << "checkpoint mismatch!" << std::endl << difflog;
+    EXPECT_NEAR(pmgr.getPnl(), pmgr2.getPnl(), 1e-10);
+    const auto& oovec (pmgr.listOO());
+    const auto& oovec2 (pmgr2.listOO());
+    ASSERT_EQ(oovec.size(), oovec2.size());
+    for (size_t i=0; i<oovec.size(); ++i) {
+        EXPECT_EQ(oovec[i]->toString(), oovec2[i]->toString());
+        EXPECT_TRUE(pmgr2.getOO(oovec[i]->m_clOrdId));
+    }
+
+    // replaying the tail doesn't double count the fills
+    pmgr2.loadRecovery(RecoveryCSV);
+    EXPECT_EQ(pmgr.getPosition("algo1", "sym1"), pmgr2.getPosition("algo1", "sym1"));
+    EXPECT_EQ(pmgr.getPosition("algo2", "sym1"), pmgr2.getPosition("algo2", "sym1"));
+    EXPECT_EQ(pmgr.getPosition("algo1", "sym2"), pmgr2.getPosition("algo1", "sym2"));
+    EXPECT_NEAR(pmgr.getPnl(), pmgr2.getPnl(), 1e-10);
+    // nor re-opens the orders acked in the tail, i.e. cid1 filled after its ack
+    const auto& oovec3 (pmgr2.listOO());
+    ASSERT_EQ(oovec.size(), oovec3.size());
+    for (size_t i=0; i<oovec.size(); ++i) {
+        EXPECT_EQ(oovec[i]->toString(), oovec3[i]->toString());
+    }
+    EXPECT_FALSE(pmgr2.getOO("cid1"));
+    for (const auto& line : erlines) {
+        const auto& er (pm::ExecutionReport::fromCSVLine(line));
+        EXPECT_EQ(pmgr.haveThisFill(er), pmgr2.haveThisFill(er));
+    }
+
+    // checkpoint older than the eod position is not loaded
+    struct utimbuf tb;
+    tb.actime = tb.modtime = time(nullptr) - 3600;
+    utime(ckpt_file.c_str(), &tb);
+    pm::PositionManager pmgr3("ckpt", path);
+    EXPECT_EQ(pmgr3.getLoadUtc(), eodlines[0][0]);
+    EXPECT_EQ(pmgr3.getMaxRecvMicro(), 0ULL);
+    EXPECT_EQ(pmgr3.getPosition("algo1", "sym1"), 0);
+    EXPECT_EQ(pmgr3.getPosition("algo3", "sym2"), 2);
+
+    std::remove(ckpt_file.c_str());
+    std::remove((path+"/"+EODCSV).c_str());
+    std::remove((path+"/"+RecoveryCSV).c_str());
+}
+
+TEST_F(PMTest,  Shards) {
+    const std::string path = "/tmp/pm_shard_test";
+    mkdir(path.c_str(), 0755);
+    utils::CSVUtil::FileTokens eodlines = {
+        {utils::TimeUtil::frac_UTC_to_string(1601848800, 0), "algo3", "sym2", "2", "10.0", "0", "1601848800000000", "USD"}
+    };
+    utils::CSVUtil::write_file(eodlines, path+"/"+EODCSV, false);
+    std::remove((path+"/shard_pm.ckpt").c_str());
+
+    // same reports to a position manager and the shards
+    pm::PositionManager pmgr("shard", path);
+    pm::PositionShards shards("shard", 3, path);
+    std::atomic<int> acks(0);
+    shards.setAck([&acks](const pm::ExecutionReport& er, uint64_t recv_ns) {
+            ++acks;
+        });
+    shards.start();
+    for (const auto& line : erlines) {
+        const auto& er (pm::ExecutionReport::fromCSVLine(line));
+        pmgr.update(er);
+        shards.post(er);
+    }
+    shards.drain();
+    EXPECT_EQ(acks, (int)erlines.size());
+    EXPECT_EQ(shards.applied(), shards.posted());
+
+    // the market is in one shard, the others are empty
+    const int s = shards.shardOf("sym1");
+    EXPECT_EQ(s, shards.shardOf("sym2"));
+    for (int i=0; i<shards.shards(); ++i) {
+        EXPECT_EQ(shards.snapshot(i)->pos.size(), (i==s)? pmgr.listPosition().size() : 0);
+    }
+
+    const std::string algo1 ("algo1"), algo3 ("algo3"), wti ("WTI"), sym1 ("sym1");
+    EXPECT_EQ(shards.getPosition_Market(&algo1, &wti), pmgr.getPosition_Market(&algo1, &wti));
+    EXPECT_EQ(shards.getPosition_Market(&algo3, nullptr), 2);
+    EXPECT_EQ(shards.getPosition_Market(nullptr, &wti), pmgr.getPosition_Market(nullptr, &wti));
+    EXPECT_NEAR(shards.getPnl(&algo1), pmgr.getPnl(&algo1), 1e-10);
+    EXPECT_EQ(shards.toString(), pmgr.toString());
+    EXPECT_EQ(shards.toString(nullptr, &sym1, true), pmgr.toString(nullptr, &sym1, true));
+
+    // a duplicated fill is not applied twice
+    const auto& er4 (pm::ExecutionReport::fromCSVLine(erlines[4]));
+    EXPECT_TRUE(er4.isFill());
+    EXPECT_TRUE(shards.haveThisFill(er4));
+    auto er_new (er4);
+    strcpy(er_new.m_execId, "new_exec_id");
+    EXPECT_FALSE(shards.haveThisFill(er_new));
+    shards.post(er4);
+    shards.drain();
+    EXPECT_EQ(shards.getPosition_Market(&algo1, &wti), pmgr.getPosition_Market(&algo1, &wti));
+    shards.stop();
+
+    std::remove((path+"/"+EODCSV).c_str());
+}
+
+TEST_F(PMTest,  ETSchedule) {
+    // entries due in order of _next_micro, done ones taken out
+    pm::ETSchedule sched;
+    std::vector<std::shared_ptr<pm::ETInfo>> eis;
+    for (int i=0; i<200; ++i) {
+        auto ei = std::make_shared<pm::ETInfo>();
+        ei->_done = false;
+        ei->_next_micro = 1000 + (i*7919)%200;
+        eis.push_back(ei);
+        sched.update(ei);
+    }
+    EXPECT_EQ(sched.size(), 200u);
+    EXPECT_EQ(sched.nextMicro(), 1000ULL);
+
+    // reschedule some, finish some
+    for (int i=0; i<200; i+=3) {
+        eis[i]->_next_micro += 500;
+        sched.update(eis[i]);
+    }
+    for (int i=1; i<200; i+=5) {
+        eis[i]->_done = true;
+        sched.update(eis[i]);
+        EXPECT_EQ(eis[i]->_sched_idx, -1);
+    }
+    size_t scheduled = 0;
+    for (const auto& ei : eis) {
+        scheduled += (ei->_done? 0:1);
+    }
+    EXPECT_EQ(sched.size(), scheduled);
+
+    std::vector<std::shared_ptr<pm::ETInfo>> due;
+    sched.popDue(1100, due);
+    for (const auto& ei : eis) {
+        const bool is_due = (!ei->_done) && (ei->_next_micro <= 1100);
+        EXPECT_EQ(std::count(due.begin(), due.end(), ei), is_due? 1:0);
+    }
+    for (size_t i=1; i<due.size(); ++i) {
+        EXPECT_LE(due[i-1]->_next_micro, due[i]->_next_micro);
+    }
+    EXPECT_EQ(sched.size(), scheduled - due.size());
+    EXPECT_GT(sched.nextMicro(), 1100ULL);
+
+    // run and rescheduled, due again later
+    for (auto& ei : due) {
+        ei->_next_micro = 2000;
+        sched.update(ei);
+    }
+    due.clear();
+    sched.popDue(1999, due);
+    for (const auto& ei : due) {
+        EXPECT_LT(ei->_next_micro, 2000ULL);
+    }
+    sched.clear();
+    EXPECT_EQ(sched.size(), 0u);
+    EXPECT_EQ(sched.nextMicro(), (uint64_t)-1);
+    for (const auto& ei : eis) {
+        EXPECT_EQ(ei->_sched_idx, -1);
+    }
+}
+
+TEST_F(PMTest,  PegScanner) {
+    const std::string path = "/tmp/pm_peg_test";
+    mkdir(path.c_str(), 0755);
+    utils::CSVUtil::write_file(utils::CSVUtil::FileTokens(), path+"/"+EODCSV, false);
+    std::remove((path+"/peg_pm.ckpt").c_str());
+    pm::PositionManager pmgr("peg", path);
+
+    // the touch of sym1 in the last value cache
+    auto& lvc (md::LVC::get());
+    const int id = lvc.id(md::LVC::key(md::BookConfig("sym1", "L1")));
+    ASSERT_GE(id, 0);
+    auto setBBO = [&lvc, id](double bidpx, double askpx) {
+        md::BookDepot book;
+        book.avail_level[0] = book.avail_level[1] = 1;
+        book.pe[0] = md::PriceEntry(bidpx, 10, 1, 1);
+        book.pe[BookLevel] = md::PriceEntry(askpx, 10, 1, 1);
+        lvc.update(id, book);
+    };
+    setBBO(39.99, 40.01);
+
+    // buy orders join the bid, the replace acked as a new order
+    uint64_t cur_micro = 1601850782000000ULL;
+    bool aggressive = false;
+    int ord = 0, pegs = 0;
+    std::vector<double> replaced;
+    pm::PegScanner* scanner = nullptr;
+    auto newOrder = [&](double px, uint64_t recv_micro) {
+        const std::string clOrdId ("p" + std::to_string(++ord));
+        pm::ExecutionReport er("sym1", "algo1", clOrdId, clOrdId + "n", "0", 1, px, "20201004-18:33:02", "", recv_micro, 0);
+        pmgr.update(er);
+        if (scanner) {
+            scanner->onER(er);
+        }
+    };
+    pm::PegScanner peg(pmgr,
+            [&](const std::shared_ptr<const pm::OpenOrder>& oo, double& px, bool& agg) {
+                ++pegs;
+                double bp, ap;
+                int bs, as;
+                EXPECT_TRUE(md::getBBO("sym1", bp, bs, ap, as));
+                px = aggressive? ap : bp;
+                agg = aggressive;
+                return true;
+            },
+            [&](const std::shared_ptr<const pm::OpenOrder>& oo, double px) {
+                replaced.push_back(px);
+                pmgr.deleteOO(oo->m_clOrdId);
+                newOrder(px, cur_micro);
+                return true;
+            });
+    scanner = &peg;
+    newOrder(39.98, cur_micro - 1000000);
+
+    // picked up by the sweep and replaced to the bid
+    EXPECT_EQ(peg.scan(cur_micro), 1);
+    EXPECT_EQ(replaced, std::vector<double>({39.99}));
+    EXPECT_EQ(peg.symbols(), 1u);
+    EXPECT_EQ(peg.waitMicro(50000), (uint64_t)pm::PegScanner::PollMicro);
+
+    // nothing moved, the replacement not aged yet
+    const int pegs0 = pegs;
+    const uint64_t evals0 = peg.stats().symbols;
+    EXPECT_EQ(peg.scan(cur_micro + 1000), 0);
+    EXPECT_EQ(peg.scan(cur_micro + 2000), 0);
+    EXPECT_EQ(pegs, pegs0);
+    EXPECT_EQ(peg.stats().symbols, evals0 + 1);  // the er of the replacement
+
+    // the touch moves, the order is pegged once aged
+    setBBO(40.00, 40.02);
+    EXPECT_EQ(peg.scan(cur_micro + 3000), 0);
+    EXPECT_EQ(pegs, pegs0);
+    EXPECT_EQ(peg.scan(cur_micro + pm::PegScanner::MinAgeMicro + 1), 1);
+    EXPECT_EQ(replaced.back(), 40.00);
+
+    // an aggressive replace holds the others
+    cur_micro += 2*pm::PegScanner::MinAgeMicro;
+    aggressive = true;
+    setBBO(40.01, 40.03);
+    EXPECT_EQ(peg.scan(cur_micro), 1);
+    EXPECT_EQ(replaced.back(), 40.03);
+    setBBO(40.02, 40.04);
+    const int pegs1 = pegs;
+    EXPECT_EQ(peg.scan(cur_micro + 2*pm::PegScanner::MinAgeMicro), 0);
+    EXPECT_EQ(pegs, pegs1);
+    EXPECT_EQ(peg.scan(cur_micro + pm::PegScanner::AggHoldMicro), 1);
+    EXPECT_EQ(replaced.back(), 40.04);
+
+    // the replaces of a scan are capped, the rest sent on the next
+    aggressive = false;
+    cur_micro += 2*pm::PegScanner::AggHoldMicro;
+    for (const auto& oo : pmgr.listOO()) {
+        pmgr.deleteOO(oo->m_clOrdId);
+    }
+    const int n = pm::PegScanner::MaxReplacesPerScan + 2;
+    for (int i=0; i<n; ++i) {
+        newOrder(40.00, cur_micro - 1000000);
+    }
+    setBBO(40.03, 40.05);
+    replaced.clear();
+    EXPECT_EQ(peg.scan(cur_micro), (int)pm::PegScanner::MaxReplacesPerScan);
+    EXPECT_EQ(peg.scan(cur_micro + 1000), 2);
+    EXPECT_EQ(replaced, std::vector<double>(n, 40.03));
+    EXPECT_EQ(peg.scan(cur_micro + 2000), 0);
+
+    // no open orders, the symbol is dropped
+    for (const auto& oo : pmgr.listOO()) {
+        pmgr.deleteOO(oo->m_clOrdId);
+    }
+    setBBO(40.03, 40.05);
+    peg.scan(cur_micro + 2*pm::PegScanner::AggHoldMicro);
+    EXPECT_EQ(peg.symbols(), 0u);
+    EXPECT_EQ(peg.waitMicro(50000), 50000u);
+
+    std::remove((path+"/"+EODCSV).c_str());
+}
+
 int main(int argc, char** argv) {
     utils::PLCC::setConfigPath("/tmp/main.cfg");
     setupConfig();
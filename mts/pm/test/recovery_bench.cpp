@@ -0,0 +1,155 @@
+#include "PositionManager.h"
+#include "ERJournal.h"
+#include <stdio.h>
+#include <algorithm>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * Cold start time of the position manager after a month of execution
+ * reports, i.e. the FloorCPR startup of loadEoD(), loadFromPersistence()
+ * and loadRecovery(), for:
+ *   csv:  EoD position csv, scan of the whole ERPersistFile csv and
+ *         replay of the execution reports since the last EoD
+ *   ckpt: binary checkpoint, time indexed ER journal and replay
+ *         of the execution reports since the checkpoint's load time
+ * Files are written to the given directory, default /tmp/recovery_bench.
+ * Run in the build directory after pm_test, which writes the main config
+ * and the symbol map used here, i.e.
+ *     bin/recovery_bench /tmp/main.cfg
+ */
+
+static long long now_micro() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000LL + ts.tv_nsec/1000;
+}
+
+static pm::ExecutionReport genER(int day, int ord, bool fill, uint64_t recv_micro) {
+    static const char* Symbol[] = {"sym1", "sym2"};
+    const std::string algo ("algo" + std::to_string(ord%8));
+    const std::string clOrdId ("c" + std::to_string(day) + "_" + std::to_string(ord));
+    const int qty = ((ord%3)?1:-1) * (1 + ord%5);
+    const double px = 40.0 + (ord%50)*0.01;
+    return pm::ExecutionReport(Symbol[ord%2], algo, clOrdId, clOrdId + (fill?"f":"n"), fill?"2":"0",
+            qty, px, utils::TimeUtil::frac_UTC_to_string(recv_micro/1000000ULL, 0, "%Y%m%d-%H:%M:%S", true),
+            "", recv_micro, 0);
+}
+
+// returns the micro taken to load the pm with name, which is then compared to ref_pm
+static long long coldStart(const std::string& name, const std::string& dir, const std::string& er_file,
+                           const std::string& end_local, const pm::PositionManager* ref_pm, size_t* replay_cnt) {
+    long long t0 = now_micro();
+    pm::PositionManager pmgr(name, dir);
+    const std::string replay_file (name + "_replay.csv");
+    pm::ExecutionReport::loadFromPersistence(pmgr.getLoadUtc(), end_local, dir + "/" + replay_file, er_file);
+    pmgr.loadRecovery(replay_file);
+    long long t1 = now_micro();
+
+    *replay_cnt = utils::CSVUtil::read_file(dir + "/" + replay_file).size();
+    if (ref_pm) {
+        const std::string difflog (ref_pm->diff(pmgr) + pmgr.diff(*ref_pm));
+        if (difflog.size()) {
+            printf("%s position mismatch:\n%s\n", name.c_str(), difflog.c_str());
+        }
+    }
+    return t1-t0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s main_config [days] [orders_per_day] [dir]\n", argv[0]);
+        printf("  days default 22, orders_per_day default 10000 with a new and a fill each, dir default /tmp/recovery_bench\n");
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    const int days = (argc>2)? atoi(argv[2]) : 22;
+    const int orders = (argc>3)? atoi(argv[3]) : 10000;
+    const std::string dir = (argc>4)? std::string(argv[4]) : std::string("/tmp/recovery_bench");
+    mkdir(dir.c_str(), 0755);
+    const std::string er_file (dir + "/er_persist.csv");
+    const std::string journal_file (pm::ERJournal::fname(er_file));
+    std::remove(er_file.c_str());
+    std::remove(journal_file.c_str());
+    std::remove((dir + "/eod_pos.csv").c_str());
+    std::remove((dir + "/eod_pos_mtm.csv").c_str());
+    std::remove((dir + "/bench_ckpt_pm.ckpt").c_str());
+
+    // a month of execution reports, 8 hours a day, the last day ending an hour ago
+    const uint64_t day_micro = 86400ULL*1000000ULL;
+    const uint64_t end_micro = (utils::TimeUtil::cur_utc() - 3600)*1000000ULL;
+    const uint64_t start_micro = end_micro - days*day_micro;
+    const uint64_t eod_micro = end_micro - day_micro;  // the last EoD
+    std::vector<pm::ExecutionReport> er_vec;
+    for (int d=0; d<days; ++d) {
+        for (int i=0; i<orders; ++i) {
+            const uint64_t recv_micro = start_micro + d*day_micro + (i*(8*3600ULL*1000000ULL))/orders;
+            er_vec.push_back(genER(d, i, false, recv_micro));
+            er_vec.push_back(genER(d, i, true, recv_micro + 1000));
+        }
+    }
+    utils::CSVUtil::FileTokens lines;
+    for (const auto& er : er_vec) {
+        lines.push_back(er.toCSVLine());
+    }
+    utils::CSVUtil::write_file(lines, er_file, false);
+    lines.clear();
+
+    // positions until the last EoD, persisted at that time
+    utils::CSVUtil::write_file(utils::CSVUtil::FileTokens(), dir + "/eod_pos.csv", false);
+    {
+        pm::PositionManager pm_eod("bench_eod", dir);
+        for (const auto& er : er_vec) {
+            if (er.m_recv_micro < eod_micro) {
+                pm_eod.update(er);
+            }
+        }
+        utils::TimeUtil::set_cur_time_micro(eod_micro);
+        pm_eod.persist();
+        utils::TimeUtil::unset_cur_time_micro();
+    }
+    const std::string end_local (utils::TimeUtil::frac_UTC_to_string(end_micro/1000000ULL + 1, 0));
+    printf("%d days x %d orders, %d execution reports, %d since the last EoD\n",
+            days, orders, (int)er_vec.size(), (int)std::count_if(er_vec.begin(), er_vec.end(),
+                [eod_micro](const pm::ExecutionReport& er) { return er.m_recv_micro >= eod_micro; }));
+
+    // csv: the current startup, without journal and checkpoint
+    pm::PositionManager pm_ref("bench_ref", dir);
+    for (const auto& er : er_vec) {
+        if (er.m_recv_micro >= eod_micro) {
+            pm_ref.update(er);
+        }
+    }
+    size_t replay_cnt = 0;
+    long long csv_micro = coldStart("bench_csv", dir, er_file, end_local, &pm_ref, &replay_cnt);
+    printf("    csv  cold start: %.1f ms, replayed %d\n", csv_micro/1000.0, (int)replay_cnt);
+
+    // the journal is appended with each report persisted, queued to its writer
+    long long t0 = now_micro();
+    for (const auto& er : er_vec) {
+        pm::ERJournal::append(er, journal_file);
+    }
+    long long append_micro = now_micro() - t0;
+    pm::ERJournal::flush(journal_file);
+    long long flush_micro = now_micro() - t0;
+    printf("    journal append: %.2f us per report, %.2f us per report written\n",
+            (double)append_micro/er_vec.size(), (double)flush_micro/er_vec.size());
+
+    // ckpt: the checkpoint taken after the last report, the floor checkpoints
+    // every CheckpointIntervalSec if updated
+    {
+        pm::PositionManager pm_ckpt("bench_ckpt", dir);
+        for (const auto& er : er_vec) {
+            if (er.m_recv_micro >= eod_micro) {
+                pm_ckpt.update(er);
+            }
+        }
+        t0 = now_micro();
+        pm_ckpt.checkpoint();
+        printf("    checkpoint write: %.1f ms\n", (now_micro()-t0)/1000.0);
+    }
+    long long ckpt_micro = coldStart("bench_ckpt", dir, er_file, end_local, &pm_ref, &replay_cnt);
+    printf("    ckpt cold start: %.1f ms, replayed %d\n", ckpt_micro/1000.0, (int)replay_cnt);
+    printf("    speedup: %.1fx\n", (double)csv_micro/_MAX_(ckpt_micro,1LL));
+    return 0;
+}
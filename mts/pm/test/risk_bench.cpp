@@ -0,0 +1,73 @@
+#include "RiskMonitor.h"
+#include "ExecutionReport.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Throughput of RiskMonitor's checkNewOrder() and updateER()
+ * for a new order with its NEW and FILL reports.
+ * The position manager is a mock that returns fixed positions,
+ * so only the risk checks are timed.
+ * Run in the build directory after risk_test, which writes
+ * the main config and the risk config files used here, i.e.
+ *     bin/risk_bench /tmp/main.cfg tests/risk.json
+ */
+
+class MockPM {
+public:
+    long long getPosition_Market(const std::string* algo,
+                                 const std::string* mkt,
+                                 double* pnl=nullptr) const {
+        if (pnl) *pnl = 0;
+        return 0;
+    }
+
+    template<typename ER>
+    bool haveThisFill(const ER& er) const {
+        return false;
+    }
+};
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: %s main_config risk_json [count]\n", argv[0]);
+        return 0;
+    }
+    utils::PLCC::setConfigPath(argv[1]);
+    const int count = (argc>3)? atoi(argv[3]) : 100000;
+    const std::string strat ("TSC-7000-387");
+    const std::string sym("CLH0");
+
+    auto& mon (*pm::risk::Monitor::get(argv[2]));
+    mon.status().setPause("", "", false);
+    MockPM pm;
+
+    // one order every 11 seconds, within the order count limits
+    time_t cur_utc = utils::TimeUtil::cur_utc();
+    long long check_ns = 0, er_ns = 0;
+    int passed = 0;
+    for (int i=0; i<count; ++i) {
+        cur_utc += 11;
+        const pm::ExecutionReport er_new(sym, strat, "", "", "0", 1, 1.0, "", "", cur_utc*1000000ULL, 0);
+        const pm::ExecutionReport er_fill(sym, strat, "", "", "2", 1, 1.0, "", "", cur_utc*1000000ULL, 0);
+
+        long long t0 = now_ns();
+        passed += mon.checkNewOrder(strat, sym, 1, pm, cur_utc)? 1:0;
+        long long t1 = now_ns();
+        mon.updateER(er_new, pm);
+        mon.updateER(er_fill, pm);
+        long long t2 = now_ns();
+        check_ns += (t1-t0);
+        er_ns += (t2-t1);
+    }
+    printf("orders: %d, passed: %d, checkNewOrder: %.1f ns, updateER: %.1f ns, orders/sec: %.0f\n",
+            count, passed, (double)check_ns/count, (double)er_ns/(2*count),
+            count*1e+9/(double)(check_ns+er_ns));
+    return 0;
+}
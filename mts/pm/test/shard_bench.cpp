@@ -0,0 +1,266 @@
+#include "PositionShards.h"
+#include "latency_stats.h"
+#include "md_snap.h"
+#include <stdio.h>
+#include <fstream>
+#include <thread>
+#include <sys/stat.h>
+
+/*
+ * ER-to-ack latency of a day's execution reports replayed in bursts, with
+ * a GUI dumping all positions (toString) and open orders (listOO) at a
+ * fixed interval, for:
+ *   single:   one PositionManager, the dumps run inline as in FloorCPR
+ *   shards N: PositionShards of N workers, the dumps from the snapshots
+ *             on a separate thread
+ * The ack of a report is when the position updated with it is visible,
+ * the latency from the arrival of its burst, for all reports and for those
+ * not of the large orders filled lot by lot in one market every
+ * FillBurstEvery burst, i.e. the other markets behind a fill burst.
+ * The reports are generated for Markets markets, or read from an execution
+ * report csv, i.e. a day's recovery file, given as the first argument.
+ * The quotes of the MTM pnl in the dumps are written to the last value
+ * cache for the generated symbols.
+ * Writes its config and empty EoD positions to /tmp/shard_bench, i.e.
+ *     bin/shard_bench [er_csv|-] [gap_micro] [shards...]
+ */
+
+static const char* Dir = "/tmp/shard_bench";
+static const int Markets = 16;
+static const int Algos = 8;
+static const int Orders = 40000;
+static const int OrdersPerBurst = 4;
+static const int FillBurstEvery = 50;
+static const int FillBurstLots = 1000;
+static const int GuiEveryMicro = 20000;
+
+static void setupCfg() {
+    mkdir(Dir, 0755);
+    const std::string dir (Dir);
+    {
+        std::ofstream ofs (dir + "/main.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "Logger = " << dir << "/log" << std::endl;
+        ofs << "RecoveryPath = " << dir << std::endl;
+        ofs << "SymbolMap = " << dir << "/symbol_map.cfg" << std::endl;
+    }
+    {
+        std::ofstream ofs (dir + "/symbol_map.cfg", std::ofstream::out | std::ofstream::trunc);
+        ofs << "tradable = {\n";
+        for (int m=0; m<Markets; ++m) {
+            ofs << "    T" << m << "Q1 = {\n";
+            ofs << "        symbol = MKT" << m << "\n";
+            ofs << "        exch_symbol = M" << m << "\n";
+            ofs << "        venue = NYM\n";
+            ofs << "        currency = USD\n";
+            ofs << "        tick_size = 0.010000000000\n";
+            ofs << "        point_value = 1.0\n";
+            ofs << "        px_multiplier = 0.010000000000\n";
+            ofs << "        type = FUT\n";
+            ofs << "        mts_contract = MKT" << m << "_202106\n";
+            ofs << "        contract_month = 202106\n";
+            ofs << "        mts_symbol = MKT" << m << "_N1\n";
+            ofs << "        N = 1\n";
+            ofs << "        expiration_days = 5\n";
+            ofs << "        tt_security_id = " << 1000+m << "\n";
+            ofs << "        tt_venue = NYM\n";
+            ofs << "        expiration_date = 2021-05-20\n";
+            ofs << "        bbg_id = T" << m << "Q1 COMDTY\n";
+            ofs << "        bbg_px_multiplier = 1.0\n";
+            ofs << "        tickdata_id = T" << m << "Q21\n";
+            ofs << "        tickdata_px_multiplier = 1.000000000000\n";
+            ofs << "        tickdata_timezone = America/New_York\n";
+            ofs << "    }\n";
+        }
+        ofs << "}\n";
+    }
+    std::ofstream ofs (dir + "/eod_pos.csv", std::ofstream::out | std::ofstream::trunc);
+    // the path is kept by PLCC
+    static const std::string cfg (dir + "/main.cfg");
+    utils::PLCC::setConfigPath(cfg.c_str());
+}
+
+// quotes of the generated symbols for the MTM pnl
+static void setupQuotes() {
+    md::BookDepot book;
+    book.avail_level[0] = book.avail_level[1] = 1;
+    book.pe[0] = md::PriceEntry(40.0, 10, 1, utils::TimeUtil::cur_micro());
+    book.pe[BookLevel] = md::PriceEntry(40.01, 10, 1, utils::TimeUtil::cur_micro());
+    for (int m=0; m<Markets; ++m) {
+        const std::string symbol ("T" + std::to_string(m) + "Q1");
+        auto& lvc (md::LVC::get());
+        lvc.update(lvc.id(md::LVC::key(md::BookConfig(symbol, "L1"))), book);
+    }
+}
+
+using Burst = std::vector<pm::ExecutionReport>;
+
+// each burst has an order of 1 to 5 lots in each of OrdersPerBurst markets,
+// a NEW and a fill per lot.  Every FillBurstEvery burst the first one is a
+// FillBurstLots lots order filled lot by lot, with clOrdId starting 'b'.
+static std::vector<Burst> genDay() {
+    std::vector<Burst> day;
+    uint64_t recv_micro = 1601850782000000ULL;
+    for (int ord=0; ord<Orders; ) {
+        Burst b;
+        const bool big = (day.size() % FillBurstEvery == 0);
+        for (int k=0; k<OrdersPerBurst; ++k, ++ord) {
+            const std::string symbol ("T" + std::to_string(ord%Markets) + "Q1");
+            const std::string algo ("algo" + std::to_string(ord%Algos));
+            const std::string clOrdId (((big && !k)? "b":"c") + std::to_string(ord));
+            const int lots = (big && !k)? FillBurstLots : 1 + ord%5;
+            const int side = (ord%3)? 1 : -1;
+            const double px = 40.0 + (ord%50)*0.01;
+            const std::string utc (utils::TimeUtil::frac_UTC_to_string(recv_micro/1000000ULL, 0, "%Y%m%d-%H:%M:%S", true));
+            b.emplace_back(symbol, algo, clOrdId, clOrdId + "n", "0", side*lots, px, utc, "", ++recv_micro, 0);
+            for (int f=0; f<lots; ++f) {
+                b.emplace_back(symbol, algo, clOrdId, clOrdId + "f" + std::to_string(f), (f==lots-1)? "2":"1",
+                        side, px, utc, "", ++recv_micro, 0);
+            }
+        }
+        day.push_back(b);
+    }
+    return day;
+}
+
+// the reports of the csv in bursts of the same second
+static std::vector<Burst> readDay(const char* fn) {
+    std::vector<Burst> day;
+    uint64_t sec = 0;
+    for (const auto& line : utils::CSVUtil::read_file(fn)) {
+        const auto& er (pm::ExecutionReport::fromCSVLine(line));
+        if ((!day.size()) || (er.m_recv_micro/1000000ULL != sec)) {
+            day.emplace_back();
+            sec = er.m_recv_micro/1000000ULL;
+        }
+        day.back().push_back(er);
+    }
+    return day;
+}
+
+// waits until the arrival of the next burst
+static void waitUntil(uint64_t ns) {
+    while (true) {
+        const uint64_t now = utils::LatencyStats::now_ns();
+        if (now >= ns) {
+            return;
+        }
+        if (ns - now > 200000) {
+            utils::TimeUtil::micro_sleep((ns-now)/1000 - 100);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct AckHist {
+    utils::LatencyHist all, others;
+    AckHist() {
+        memset(&all, 0, sizeof(all));
+        memset(&others, 0, sizeof(others));
+    }
+    void record(const pm::ExecutionReport& er, uint64_t ns) {
+        all.record(ns);
+        if (er.m_clOrdId[0] != 'b') {
+            others.record(ns);
+        }
+    }
+};
+
+static void print(const char* name, const utils::LatencyHist& h, uint64_t total_ns, size_t dumps) {
+    printf("%-16s ers %7llu  ack_us mean %7.1f p50 %7.1f p99 %8.1f p99.9 %8.1f max %8.1f  dumps %zu  run %.2f s\n",
+            name, (unsigned long long)h.count(), h.mean()/1000.0,
+            h.percentile(50)/1000.0, h.percentile(99)/1000.0, h.percentile(99.9)/1000.0,
+            h.max_ns/1000.0, dumps, total_ns/1e9);
+}
+
+static void print(const std::string& name, const AckHist& h, uint64_t total_ns, size_t dumps) {
+    print(name.c_str(), h.all, total_ns, dumps);
+    print((name + " others").c_str(), h.others, total_ns, dumps);
+}
+
+static void runSingle(const std::vector<Burst>& day, uint64_t gap_ns) {
+    pm::PositionManager pmgr("bench", Dir);
+    AckHist h;
+    size_t dumps = 0, chk = 0;
+    const uint64_t t0 = utils::LatencyStats::now_ns();
+    uint64_t next_gui = t0;
+    for (size_t i=0; i<day.size(); ++i) {
+        waitUntil(t0 + i*gap_ns);
+        // the burst is read by the router
+        const uint64_t arrival = utils::LatencyStats::now_ns();
+        for (const auto& er : day[i]) {
+            pmgr.update(er);
+            h.record(er, utils::LatencyStats::now_ns() - arrival);
+        }
+        if (utils::LatencyStats::now_ns() >= next_gui) {
+            // the GUI's dump is handled in the floor's loop
+            chk += pmgr.toString().size() + pmgr.listOO().size();
+            ++dumps;
+            next_gui += GuiEveryMicro*1000ULL;
+        }
+    }
+    print("single", h, utils::LatencyStats::now_ns() - t0, dumps);
+}
+
+static void runShards(const std::vector<Burst>& day, uint64_t gap_ns, int n) {
+    pm::PositionShards shards("bench", n, Dir);
+    AckHist h;
+    shards.setAck([&h](const pm::ExecutionReport& er, uint64_t recv_ns) {
+            h.record(er, utils::LatencyStats::now_ns() - recv_ns);
+        });
+    shards.start();
+
+    std::atomic<bool> done(false);
+    size_t dumps = 0;
+    std::thread gui([&]() {
+            size_t chk = 0;
+            while (!done) {
+                chk += shards.toString().size() + shards.listPosition().size();
+                ++dumps;
+                utils::TimeUtil::micro_sleep(GuiEveryMicro);
+            }
+        });
+
+    const uint64_t t0 = utils::LatencyStats::now_ns();
+    for (size_t i=0; i<day.size(); ++i) {
+        waitUntil(t0 + i*gap_ns);
+        // the burst is read by the router
+        const uint64_t arrival = utils::LatencyStats::now_ns();
+        for (const auto& er : day[i]) {
+            shards.post(er, arrival);
+        }
+    }
+    shards.drain();
+    const uint64_t t1 = utils::LatencyStats::now_ns();
+    done = true;
+    gui.join();
+    shards.stop();
+    print("shards " + std::to_string(n), h, t1 - t0, dumps);
+}
+
+int main(int argc, char** argv) {
+    setupCfg();
+    setupQuotes();
+    const bool from_file = (argc > 1) && strcmp(argv[1], "-");
+    const auto& day (from_file? readDay(argv[1]) : genDay());
+    const uint64_t gap_ns = ((argc > 2)? atoll(argv[2]) : 200) * 1000ULL;
+    size_t ers = 0;
+    for (const auto& b : day) {
+        ers += b.size();
+    }
+    printf("%zu execution reports in %zu bursts, %llu us apart, %u cpus\n",
+            ers, day.size(), (unsigned long long)gap_ns/1000, std::thread::hardware_concurrency());
+
+    runSingle(day, gap_ns);
+    std::vector<int> shard_cnt;
+    for (int i=3; i<argc; ++i) {
+        shard_cnt.push_back(atoi(argv[i]));
+    }
+    if (!shard_cnt.size()) {
+        shard_cnt = {1, 2, 4};
+    }
+    for (int n : shard_cnt) {
+        runShards(day, gap_ns, n);
+    }
+    return 0;
+}
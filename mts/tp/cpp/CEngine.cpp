@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 #include "ExecutionReport.h"
+#include "ERJournal.h"
 #include "RiskMonitor.h"
 
 using namespace Mts::Engine;
@@ -61,7 +62,8 @@ CEngine::CEngine(unsigned int                   iEngineID,
     m_bar_writer(),
     m_bar_writer_thread(m_bar_writer),
     m_floor("tp", *this),
-    m_er_fp(fopen(pm::ExecutionReport::ERPersistFile().c_str(), "a"))
+    m_er_fp(fopen(pm::ExecutionReport::ERPersistFile().c_str(), "a")),
+    m_er_journal(pm::ERJournal::fname(pm::ExecutionReport::ERPersistFile()))
 
 {
     if (!m_er_fp) {
@@ -448,7 +450,8 @@ void CEngine::publishMktUpdate(const Mts::OrderBook::CBidAsk & objBidAsk) {
 */
 
 bool CEngine::persistExecutionReport(const pm::ExecutionReport& er) const{
-    return utils::CSVUtil::write_file(er.toCSVLine(), m_er_fp);
+    bool ret = utils::CSVUtil::write_file(er.toCSVLine(), m_er_fp);
+    return pm::ERJournal::append(er, m_er_journal) && ret;
 }
 
 void CEngine::sendExecutionReport(const pm::ExecutionReport& er) {
@@ -303,6 +303,7 @@ namespace Mts
             pm::FloorClientOrder<CEngine> m_floor;
             friend class pm::FloorClientOrder<CEngine> ;
             FILE* m_er_fp;
+            const std::string m_er_journal;
         };
 
     }
@@ -0,0 +1,53 @@
+#include "circular_buffer.h"
+#include "plcc/PLCC.hpp"
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace utils {
+namespace shm {
+    void createHuge(const std::string& shm_name, const std::string& shm_file, const std::string& dir) {
+        struct statfs sfs;
+        if ((statfs(dir.c_str(), &sfs) != 0) || (sfs.f_type != HUGETLBFS_MAGIC)) {
+            logError("%s: ShmCircularBuffer: %s not hugetlbfs, using /dev/shm", shm_name.c_str(), dir.c_str());
+            return;
+        }
+        struct stat st;
+        if (lstat(shm_file.c_str(), &st) == 0) {
+            // used as it is
+            return;
+        }
+        const std::string huge_file (dir + shm_file.substr(shm_file.rfind('/')));
+        const int fd = ::open(huge_file.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+            logError("%s: ShmCircularBuffer: failed to create %s %s, using /dev/shm",
+                    shm_name.c_str(), huge_file.c_str(), strerror(errno));
+            return;
+        }
+        ::close(fd);
+        if ((symlink(huge_file.c_str(), shm_file.c_str()) != 0) && (errno != EEXIST)) {
+            logError("%s: ShmCircularBuffer: failed to link %s %s, using /dev/shm",
+                    shm_name.c_str(), huge_file.c_str(), strerror(errno));
+            ::unlink(huge_file.c_str());
+        }
+    }
+
+    void bindNode(const std::string& shm_name, void* ptr, size_t len, int node) {
+        unsigned long mask[4] = {0};
+        if ((node < 0) || (node >= (int) (sizeof(mask)*8))) {
+            logError("%s: ShmCircularBuffer: numa node %d out of range", shm_name.c_str(), node);
+            return;
+        }
+        mask[node/(sizeof(unsigned long)*8)] = 1UL << (node%(sizeof(unsigned long)*8));
+        if (syscall(SYS_mbind, ptr, (unsigned long) len, MPOL_BIND, mask,
+                    (unsigned long) (sizeof(mask)*8), MPOL_MF_MOVE) != 0) {
+            logError("%s: ShmCircularBuffer: mbind to node %d failed %s", shm_name.c_str(), node, strerror(errno));
+        }
+    }
+
+    void lock(const std::string& shm_name, void* ptr, size_t len) {
+        if (mlock(ptr, len) != 0) {
+            logError("%s: ShmCircularBuffer: mlock failed %s", shm_name.c_str(), strerror(errno));
+        }
+    }
+}
+}
@@ -8,6 +8,11 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <stdlib.h>
+#include <string>
+#include <stdexcept>
 
 /*
  * This is the multi-process version of lock-free queue
@@ -175,22 +180,89 @@ namespace utils {
         bool m_buffer_given;
     };
 
+    // The shm file of a segment, as shm_open() names it
+    inline std::string shmFile(const std::string& shm_name) {
+        return "/dev/shm/" + ((shm_name.size() && (shm_name[0] == '/'))? shm_name.substr(1) : shm_name);
+    }
+
+    // The backing of the ShmCircularBuffer segments and how they are
+    // attached, process wide.  Read from the environment at the first
+    // attach, or set before it:
+    //   MTS_SHM_HUGE_DIR   a hugetlbfs mount, i.e. /dev/hugepages, for the
+    //                      segments created by the process.  A segment is
+    //                      created as <dir>/<shm_name> with /dev/shm/<shm_name>
+    //                      a symlink to it, so other processes open it by
+    //                      the same name, with or without the option.  Its
+    //                      size is rounded up to the hugepage.  Segments
+    //                      already in /dev/shm are used as they are.
+    //   MTS_SHM_THP        1 to advise transparent hugepages for the
+    //                      /dev/shm segments, with shmem_enabled=advise
+    //   MTS_SHM_PREFAULT   1 to populate the page tables at attach,
+    //                      2 to mlock the segment as well
+    //   MTS_SHM_NUMA_NODE  the node a writer binds the segment's pages to
+    struct ShmOptions {
+        std::string huge_dir;
+        bool thp;
+        int prefault;
+        int numa_node;   // -1 for none
+
+        ShmOptions() : thp(false), prefault(0), numa_node(-1) {
+            const char* env;
+            if ((env = getenv("MTS_SHM_HUGE_DIR"))) {
+                huge_dir = env;
+            }
+            if ((env = getenv("MTS_SHM_THP"))) {
+                thp = (atoi(env) != 0);
+            }
+            if ((env = getenv("MTS_SHM_PREFAULT"))) {
+                prefault = atoi(env);
+            }
+            if ((env = getenv("MTS_SHM_NUMA_NODE"))) {
+                numa_node = atoi(env);
+            }
+        }
+
+        static ShmOptions& get() {
+            static ShmOptions opt;
+            return opt;
+        }
+    };
+
+    // The attach steps of the ShmCircularBuffer segments that log their
+    // errors, in circular_buffer.cpp as the logger uses the queues
+    namespace shm {
+        // creates the segment in the hugetlbfs dir with shm_file a
+        // symlink to it, if shm_file is not there
+        void createHuge(const std::string& shm_name, const std::string& shm_file, const std::string& dir);
+
+        // binds the pages of the segment to the numa node
+        void bindNode(const std::string& shm_name, void* ptr, size_t len, int node);
+
+        // mlocks the segment
+        void lock(const std::string& shm_name, void* ptr, size_t len);
+    }
+
     template<int QLen, int HeaderLen>
     class ShmCircularBuffer : public CircularBuffer<QLen, HeaderLen>  {
     public:
         ShmCircularBuffer(const char* shm_name, bool is_read, bool init_to_zero):
         CircularBuffer<QLen, HeaderLen>(NULL), m_shm_name(shm_name), m_is_read(is_read), m_shm_size(QLen + HeaderLen),
-        m_shm_ptr(NULL), m_shm_fd(-1)
+        m_shm_ptr(NULL), m_shm_fd(-1), m_shm_file(shm_name? utils::shmFile(shm_name) : "")
         {
         	if (!shm_name)
         		// this is the case where an empty buffer is created
         		return;
 
+            const auto& opt (ShmOptions::get());
+            if (opt.huge_dir.size()) {
+                shm::createHuge(m_shm_name, m_shm_file, opt.huge_dir);
+            }
+
             if (is_read) {
-                m_shm_fd = shm_open(m_shm_name.c_str(), O_RDONLY, S_IRUSR);
+                m_shm_fd = openSeg(O_RDONLY, S_IRUSR);
                 if (m_shm_fd == -1) {
                     // could this because the file does not exist?
-                    m_shm_fd = shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT, S_IRUSR| S_IWUSR);
+                    m_shm_fd = openSeg(O_RDWR | O_CREAT, S_IRUSR| S_IWUSR);
                     if (m_shm_fd != -1) {
                         struct stat st;
                         if ((fstat(m_shm_fd, &st)!=0) || ((int) st.st_size != m_shm_size))
@@ -200,15 +272,15 @@ namespace utils {
                             };
                         }
                         ::close(m_shm_fd);
-                        m_shm_fd = shm_open(m_shm_name.c_str(), O_RDONLY, S_IRUSR);
+                        m_shm_fd = openSeg(O_RDONLY, S_IRUSR);
                     }
                 }
             } else {
-                m_shm_fd = shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT, S_IRUSR| S_IWUSR);
+                m_shm_fd = openSeg(O_RDWR | O_CREAT, S_IRUSR| S_IWUSR);
             }
             if (m_shm_fd == -1) {
                 std::string errstr(m_shm_name +
-                        std::string(": ShmCircularBuffer: shm_open failed") +
+                        std::string(": ShmCircularBuffer: open failed ") +
                         std::string(strerror(errno)));
                 throw  std::runtime_error(errstr.c_str());
             };
@@ -222,11 +294,13 @@ namespace utils {
                 };
             }
 
-            // mmap
+            // mmap, the pages are bound to the node before they are populated
+            const bool bind = (!is_read) && (opt.numa_node >= 0);
+            const int flags = MAP_SHARED | ((opt.prefault && !bind)? MAP_POPULATE : 0);
             if (is_read) {
-                m_shm_ptr = mmap(NULL, m_shm_size, PROT_READ, MAP_SHARED, m_shm_fd, 0);
+                m_shm_ptr = mmap(NULL, m_shm_size, PROT_READ, flags, m_shm_fd, 0);
             } else {
-                m_shm_ptr = mmap(NULL, m_shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_shm_fd, 0);
+                m_shm_ptr = mmap(NULL, m_shm_size, PROT_READ | PROT_WRITE, flags, m_shm_fd, 0);
             }
 
             if (m_shm_ptr == MAP_FAILED) {
@@ -236,6 +310,19 @@ namespace utils {
                 throw  std::runtime_error(errstr.c_str());
             }
 
+            if (opt.thp && !m_huge_path.size()) {
+                madvise(m_shm_ptr, m_shm_size, MADV_HUGEPAGE);
+            }
+            if (bind) {
+                shm::bindNode(m_shm_name, m_shm_ptr, m_shm_size, opt.numa_node);
+                if (opt.prefault) {
+                    populate();
+                }
+            }
+            if (opt.prefault > 1) {
+                shm::lock(m_shm_name, m_shm_ptr, m_shm_size);
+            }
+
             if ((!is_read) && init_to_zero) {
                 memset((uint8_t*)m_shm_ptr, 0, m_shm_size);
             }
@@ -254,11 +341,60 @@ namespace utils {
             }
         }
 
+        // the file of the segment in /dev/shm, a symlink to hugePath()
+        // if on hugetlbfs
+        const std::string& shmFile() const { return m_shm_file; };
+        // the hugetlbfs file of the segment, empty if in /dev/shm
+        const std::string& hugePath() const { return m_huge_path; };
+        int shmSize() const { return m_shm_size; };
+
+        // the file mapped, to tell if the segment was re-created since
+        bool fileId(dev_t& dev, ino_t& ino) const {
+            struct stat st;
+            if ((m_shm_fd == -1) || (fstat(m_shm_fd, &st) != 0)) {
+                return false;
+            }
+            dev = st.st_dev;
+            ino = st.st_ino;
+            return true;
+        }
+
     private:
         const std::string m_shm_name;
         const bool m_is_read;
-        const int m_shm_size;
+        int m_shm_size;       // mapped, QLen + HeaderLen rounded up to the hugepage
         void* m_shm_ptr;
         int m_shm_fd;
+        const std::string m_shm_file;
+        std::string m_huge_path;
+
+        // opens the file of the segment, following the symlink to
+        // hugetlbfs that shm_open() doesn't, and sizes it for hugepages
+        int openSeg(int oflag, mode_t mode) {
+            const int fd = ::open(m_shm_file.c_str(), oflag | O_CLOEXEC, mode);
+            struct statfs sfs;
+            if ((fd != -1) && (fstatfs(fd, &sfs) == 0) && (sfs.f_type == HUGETLBFS_MAGIC)) {
+                char* path = realpath(m_shm_file.c_str(), NULL);
+                m_huge_path = path? path : m_shm_file;
+                free(path);
+                const long page = (long) sfs.f_bsize;
+                m_shm_size = (int) (((QLen + HeaderLen) + page - 1) / page * page);
+            }
+            return fd;
+        }
+
+        void populate() {
+#ifdef MADV_POPULATE_WRITE
+            if (madvise(m_shm_ptr, m_shm_size, m_is_read? MADV_POPULATE_READ : MADV_POPULATE_WRITE) == 0) {
+                return;
+            }
+#endif
+            // before 5.14, touch a byte of each page
+            const long page = sysconf(_SC_PAGESIZE);
+            volatile const char* p = (volatile const char*) m_shm_ptr;
+            for (long off=0; off<m_shm_size; off+=page) {
+                (void) p[off];
+            }
+        }
     };
 }
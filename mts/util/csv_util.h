@@ -12,32 +12,35 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <string_view>
+#include <charconv>
 
 namespace utils {
     class CSVUtil {
     public:
         using LineTokens = std::vector<std::string>;
         using FileTokens = std::vector<LineTokens>;
+        using LineView = std::vector<std::string_view>;
         static const char Delimiter = ',';
 
         static LineTokens read_line(const std::string& line, char delimiter = Delimiter) {
             LineTokens vec;
-            if (line.size()==0) 
-                return vec;
-
-            std::string line0 = line;
-            if (line0.back()==delimiter) {
-                //in case last column skipped
-                line0.append(1, ' ');
-            }
-            std::istringstream iss(line0);
-            std::string token;
-            while (getline(iss, token, delimiter)) {
-                vec.push_back(trim(token));
-            }
+            forEachToken(line, delimiter, [&vec](std::string_view tk) {
+                    vec.emplace_back(tk);
+                });
             return vec;
         }
 
+        // same tokens as read_line(), as views into the line, reusing the
+        // vector of tokens across the lines. Returns the number of tokens.
+        static size_t read_line(std::string_view line, LineView& tokens, char delimiter = Delimiter) {
+            tokens.clear();
+            forEachToken(line, delimiter, [&tokens](std::string_view tk) {
+                    tokens.push_back(tk);
+                });
+            return tokens.size();
+        }
+
         static FileTokens read_file(const std::string& csv_file, char delimiter = Delimiter, int skip_head_lines = 0) {
             std::string line;
             FileTokens vec;
@@ -112,73 +115,182 @@ namespace utils {
             return false;
         }
 
-        // string utilities
-        static std::string ltrim(const std::string& s) {
-            static const std::string WhiteSpace = " \n\r\t\f\v";
-            size_t start = s.find_first_not_of(WhiteSpace);
-            return (start == std::string::npos) ? "" : s.substr(start);
+        // parses the number at the start of s after white spaces, as
+        // std::stod/stoi/stoll, throws std::invalid_argument if no number
+        // is found and std::out_of_range if it does not fit in T
+        template<typename T>
+        static T parse(std::string_view s) {
+            const char* p = s.data();
+            const char* const end = p + s.size();
+            while ((p < end) && isWhiteSpace(*p)) {
+                ++p;
+            }
+            if ((p+1 < end) && (*p == '+') && (p[1] != '-')) {
+                ++p;
+            }
+            T v;
+            const auto ret = std::from_chars(p, end, v);
+            if (__builtin_expect(ret.ec != std::errc(), 0)) {
+                if (ret.ec == std::errc::result_out_of_range) {
+                    throw std::out_of_range(std::string("parse out of range: ") + std::string(s));
+                }
+                throw std::invalid_argument(std::string("parse no number: ") + std::string(s));
+            }
+            return v;
         }
 
-        static std::string rtrim(const std::string& s) {
-            static const std::string WhiteSpace = " \n\r\t\f\v";
-            size_t end = s.find_last_not_of(WhiteSpace);
-            return (end == std::string::npos) ? "" : s.substr(0, end+1);
+        // formatting kernels writing to p without the terminating 0,
+        // returning the end of the chars written
+
+        static char* writeUInt(char* p, unsigned long long v) {
+            char digits[24];
+            int n = 0;
+            do {
+                digits[n++] = (char)('0' + v%10);
+                v /= 10;
+            } while (v);
+            while (n) {
+                *p++ = digits[--n];
+            }
+            return p;
         }
 
-        static std::string trim(const std::string& s) {
-            return rtrim(ltrim(s));
+        static char* writeInt(char* p, long long v) {
+            if (v < 0) {
+                *p++ = '-';
+                return writeUInt(p, 0ULL - (unsigned long long)v);
+            }
+            return writeUInt(p, (unsigned long long)v);
         }
 
-        static std::string printDouble(double d, int max_decimal) {
-            // convert a double to string, with maximum number of decimals in fraction precision
-            // note it rounds the last decimal if needed, similar as %g in printf
-            // i.e. 
-            // printDouble(-2.5678, 2) --> -2.57
-            // printDouble(-2.5678, 6) --> -2.5678
-            // printDouble(-2.5678, 0) --> -3.0
-            // printDouble(0, 0)       --> 0
+        // |v|*10**n rounded to an integer as "%.nf" does, on the exact
+        // binary value of v, i.e. 0.15 (0.1499..) to 1 and 0.25 to 2 with n 1.
+        // The product's rounding error is recovered with fma() to find
+        // the side of .5 and the exact ties are rounded to even.
+        static unsigned long long roundScaled(double v, int decimals) {
+            const double av = std::abs(v), mul10 = pow10(decimals);
+            const double x = av*mul10;
+            const double err = std::fma(av, mul10, -x);  // av*mul10 is x+err exactly
+            const double k = std::floor(x);
+            const double frac = x - k;
+            const bool up = (frac > 0.5) ||
+                            ((frac == 0.5) && ((err > 0) || ((err == 0) && (std::fmod(k, 2.0) != 0))));
+            return (unsigned long long)k + (up? 1:0);
+        }
+
+        // same as "%.nf", with n the decimals
+        static char* writeFixed(char* p, double v, int decimals) {
+            const unsigned long long mul10 = (unsigned long long) pow10(decimals);
+            if (std::signbit(v)) {
+                *p++ = '-';
+            }
+            unsigned long long k = roundScaled(v, decimals);
+            p = writeUInt(p, k/mul10);
+            if (!decimals) {
+                return p;
+            }
+            *p++ = '.';
+            k %= mul10;
+            for (int i=decimals-1; i>=0; --i) {
+                p[i] = (char)('0' + k%10);
+                k /= 10;
+            }
+            return p + decimals;
+        }
 
+        // same as printDouble(), p should have at least 48 chars
+        static char* writeDouble(char* p, double d, int max_decimal) {
             if (__builtin_expect((max_decimal>20) || (max_decimal < 0),0)) {
                 // 10**20 is almost 2**60, upto a long long to hold the fraction part 
                 throw std::runtime_error(std::string("printDouble got max_decimal too high ") + std::to_string(max_decimal));
             }
-
-            char strbuf[128];
-            size_t cnt = 0;
             if (d < (double)0.0) {
-                strbuf[cnt++] = '-';
+                *p++ = '-';
                 d = -d;
             }
-            double mul10 = pow(10,max_decimal), intpart, fracpart;
+            const double mul10 = pow10(max_decimal);
+            double intpart, fracpart;
             d = (double)((unsigned long long)(d*mul10 + 0.5))/mul10; // normalize d w.r.t. max_decimal
             fracpart = modf(d, &intpart);
-
-            // write the sign and integer part
-            cnt += snprintf(strbuf+cnt, sizeof(strbuf)-cnt, "%llu",  (unsigned long long) (intpart+0.5));
+            p = writeUInt(p, (unsigned long long) (intpart+0.5));
             if (max_decimal > 0) {
-                // write the fraction upto max_decimal
-                strbuf[cnt++]='.';
+                // write the fraction upto max_decimal, without trailing zeros
+                *p++ = '.';
                 unsigned long long fpart = (unsigned long long) (fracpart*mul10 + 0.5);
                 if (fpart == 0) {
-                    // no fraction, put "0" and done
-                    strbuf[cnt++]='0';
-                    strbuf[cnt++]=0;
+                    *p++ = '0';
                 } else {
-                    char* ptr = strbuf + (cnt+max_decimal);
-                    *ptr--=0;
-                    const char* ptr0 = strbuf+cnt;
-                    // skipping trailing zeros
+                    int n = max_decimal;
                     while (fpart%10==0) {
                         fpart/=10;
-                        *ptr--=0;
+                        --n;
                     };
-                    while (ptr>=ptr0) {
-                        *ptr--= (char)((fpart%10) + '0');
+                    for (int i=n-1; i>=0; --i) {
+                        p[i] = (char)((fpart%10) + '0');
                         fpart/=10;
                     }
+                    p += n;
                 }
             }
-            return std::string(strbuf);
+            return p;
+        }
+
+        // the decimals of prices in the tick size, i.e. 2 for 0.25 and
+        // 6 for 1/64, at most 9
+        static int tickDecimals(double tick_size) {
+            double m = std::abs(tick_size);
+            for (int n=0; n<9; ++n) {
+                if (std::abs(m - std::nearbyint(m)) < 1e-7*std::max(m, 1.0)) {
+                    return n;
+                }
+                m *= 10;
+            }
+            return 9;
+        }
+
+        // the price rounded to the tick size, with the decimals of the
+        // tick, i.e. 75.1 of tick 0.01 as 75.10, decimals could be given
+        // from tickDecimals() of the symbol to save the search
+        static char* writePrice(char* p, double px, double tick_size, int decimals = -1) {
+            if (tick_size > 0) {
+                // adding 0 to clear the sign of -0
+                px = std::nearbyint(px/tick_size)*tick_size + 0.0;
+            }
+            return writeFixed(p, px, (decimals<0)? tickDecimals(tick_size) : decimals);
+        }
+
+        static std::string printPrice(double px, double tick_size) {
+            char buf[48];
+            return std::string(buf, writePrice(buf, px, tick_size));
+        }
+
+        // string utilities
+        static std::string ltrim(const std::string& s) {
+            static const std::string WhiteSpace = " \n\r\t\f\v";
+            size_t start = s.find_first_not_of(WhiteSpace);
+            return (start == std::string::npos) ? "" : s.substr(start);
+        }
+
+        static std::string rtrim(const std::string& s) {
+            static const std::string WhiteSpace = " \n\r\t\f\v";
+            size_t end = s.find_last_not_of(WhiteSpace);
+            return (end == std::string::npos) ? "" : s.substr(0, end+1);
+        }
+
+        static std::string trim(const std::string& s) {
+            return rtrim(ltrim(s));
+        }
+
+        static std::string printDouble(double d, int max_decimal) {
+            // convert a double to string, with maximum number of decimals in fraction precision
+            // note it rounds the last decimal if needed, similar as %g in printf
+            // i.e. 
+            // printDouble(-2.5678, 2) --> -2.57
+            // printDouble(-2.5678, 6) --> -2.5678
+            // printDouble(-2.5678, 0) --> -3.0
+            // printDouble(0, 0)       --> 0
+            char strbuf[48];
+            return std::string(strbuf, writeDouble(strbuf, d, max_decimal));
         }
 
         static std::string printPnl(double d) {
@@ -198,5 +310,47 @@ namespace utils {
             }
             return RED+ret;
         }
+
+    private:
+        static bool isWhiteSpace(char c) {
+            return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f') || (c == '\v');
+        }
+
+        // 10**n exactly for n upto 22
+        static double pow10(int n) {
+            static const double p10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            return p10[n];
+        }
+
+        // calls f with each token of the line trimmed of white spaces.
+        // A line ending with the delimiter has an empty last token, and
+        // an empty line has no tokens.
+        template<typename Func>
+        static void forEachToken(std::string_view line, char delimiter, Func&& f) {
+            if (line.size() == 0) {
+                return;
+            }
+            size_t start = 0;
+            while (true) {
+                size_t end = line.find(delimiter, start);
+                const bool last = (end == std::string_view::npos);
+                if (last) {
+                    end = line.size();
+                }
+                size_t b = start, e = end;
+                while ((b < e) && isWhiteSpace(line[b])) {
+                    ++b;
+                }
+                while ((e > b) && isWhiteSpace(line[e-1])) {
+                    --e;
+                }
+                f(line.substr(b, e-b));
+                if (last) {
+                    break;
+                }
+                start = end + 1;
+            }
+        }
     };
 }
@@ -1,9 +1,12 @@
 #include <memory>
 #include <map>
 #include <set>
+#include <bitset>
 #include <iostream>
 #include <stdio.h>
 #include <mutex>
+#include <atomic>
+#include <unordered_map>
 #include "time_util.h"
 #include "queue.h"
 #include "plcc/PLCC.hpp"
@@ -18,8 +21,16 @@ namespace utils {
     public:
         // TODO - maybe protect the buf/buf_capacity
         // as private if needed in the future usage cases
+        //
+        // Payloads up to InlineSize bytes, i.e. ExecutionReport, PositionInstruction
+        // and the order strings, are kept in the message itself, so that creating,
+        // copying and reading messages on the order path doesn't touch the heap.
+        // Larger payloads go to a malloc'ed buf, which is moved rather than copied
+        // where possible.
         class Message {
         public:
+            static const size_t InlineSize = 512;
+
             // a stateless message that doesn't demand response
             int type;
             mutable uint64_t ref;
@@ -27,32 +38,45 @@ namespace utils {
             size_t data_size;
         private: 
             size_t buf_capacity;
+            alignas(8) char _inline_buf[InlineSize];
+
+            bool onHeap() const {
+                return buf != _inline_buf;
+            }
 
         public:
             //uint64_t id;
-            Message() : type(0), ref(NOREF), buf(nullptr), data_size(0), buf_capacity(0) {}
+            Message() : type(0), ref(NOREF), buf(_inline_buf), data_size(0), buf_capacity(InlineSize) {}
 
             Message(int type_, const char* data_, size_t size_, uint64_t ref_=NOREF)
-            : type(type_), ref(ref_), buf((char*)malloc(size_)), data_size(size_), buf_capacity(size_) 
+            : type(type_), ref(ref_), buf(_inline_buf), data_size(0), buf_capacity(InlineSize) 
             {
-                if (!data_) 
-                    data_size = 0;
-                else {
-                    if (data_size)
-                        memcpy(buf, data_, size_);
+                if (data_ && size_) {
+                    copyData(data_, size_);
+                } else {
+                    reserve(size_);
                 }
             }
 
             Message(const Message& msg)
-            : type(msg.type), ref(msg.ref), buf(nullptr), data_size(0), buf_capacity(0)
+            : type(msg.type), ref(msg.ref), buf(_inline_buf), data_size(0), buf_capacity(InlineSize)
             {
                 if (msg.data_size) {
                     copyData(msg.buf, msg.data_size);
                 }
             }
 
-            void operator = (const Message& msg)
+            Message(Message&& msg)
+            : type(msg.type), ref(msg.ref), buf(_inline_buf), data_size(0), buf_capacity(InlineSize)
+            {
+                moveFrom(msg);
+            }
+
+            Message& operator = (const Message& msg)
             {
+                if (this == &msg) {
+                    return *this;
+                }
                 type = msg.type;
                 ref = msg.ref;
                 if (msg.data_size) {
@@ -60,14 +84,26 @@ namespace utils {
                 } else {
                     data_size = 0;
                 }
+                return *this;
+            }
+
+            Message& operator = (Message&& msg)
+            {
+                if (this == &msg) {
+                    return *this;
+                }
+                type = msg.type;
+                ref = msg.ref;
+                moveFrom(msg);
+                return *this;
             }
 
             ~Message() {
-                if (buf && buf_capacity) {
-                    buf_capacity=0;
+                if (onHeap()) {
                     free (buf);
-                    buf=nullptr;
                 }
+                buf_capacity=0;
+                buf=nullptr;
             }
 
             void copyData(const char* data, const size_t data_size_) {
@@ -98,7 +134,7 @@ namespace utils {
 
             void reserve(size_t data_size_) {
                 if (buf_capacity<data_size_) {
-                    if (buf) {
+                    if (onHeap()) {
                         free (buf);
                     }
                     buf = (char*)malloc(data_size_*2);
@@ -106,9 +142,43 @@ namespace utils {
                 }
             };
 
+        private:
+            void moveFrom(Message& msg) {
+                // take the heap buffer if msg has one, otherwise copy the
+                // inline bytes. msg is left as an empty inline message.
+                if (msg.onHeap()) {
+                    if (onHeap()) {
+                        free (buf);
+                    }
+                    buf = msg.buf;
+                    buf_capacity = msg.buf_capacity;
+                    data_size = msg.data_size;
+                    msg.buf = msg._inline_buf;
+                    msg.buf_capacity = InlineSize;
+                } else if (msg.data_size) {
+                    copyData(msg.buf, msg.data_size);
+                } else {
+                    data_size = 0;
+                }
+                msg.data_size = 0;
+            }
+
+        public:
             static const uint64_t NOREF = static_cast<uint64_t>(-1);
         };
 
+        // A read-only view of a message in the queue, given by Channel::nextMessageView().
+        // buf points into the queue slot, or into the reader's local buffer in case
+        // the record wraps around the circular buffer. It is valid until the next read
+        // from the same reader, as long as the writers don't overrun the reader.
+        struct MessageView {
+            int type;
+            uint64_t ref;
+            const char* buf;
+            size_t data_size;
+            MessageView() : type(0), ref(Message::NOREF), buf(nullptr), data_size(0) {}
+        };
+
         static Floor& get() {
             static Floor flr(nullptr);
             return flr;
@@ -168,6 +238,9 @@ namespace utils {
           _qout(std::make_shared<QType>( (name? (std::string(name)+"_fq2").c_str() : "fq2"), false, false))
         {
             // createt the two queues read+write, without init to zero
+            // the channels wait on them, see Channel::waitNext()
+            _qin->enableDoorbell();
+            _qout->enableDoorbell();
         };
 
         Floor(const Floor&) = delete ;
@@ -179,7 +252,8 @@ namespace utils {
             Channel(std::shared_ptr<QType> qread, std::shared_ptr<QType> qwrite)
             : _qin(qread), _qout(qwrite),
               _reader(std::make_shared<QType::Reader>(*_qin)),
-              _writer(std::make_shared<QType::Writer>(*_qout))
+              _writer(std::make_shared<QType::Writer>(*_qout)),
+              _id(std::make_shared<const uint64_t>(nextId()))
             {}
 
             Channel() {}; // dummy channel
@@ -191,8 +265,22 @@ namespace utils {
                 // Memory allocation wise, caller is responsible to allocate enough memory in the
                 // resp message and set the size as available. Upon return, the resp byte-wise
                 // copied and size updated. It returns false if size is not enough.
-                auto reader (std::make_shared<QType::Reader>(*_qin));
-                return sendSync(req, &resp, timeout_sec, reader);
+                // the sync reader of the calling thread is reused across requests
+                // of the channel, sync'ed to the latest position before sending,
+                // as a newly created reader would be.  Threads don't share it.
+                thread_local std::unordered_map<uint64_t, SyncReader> sync_readers;
+                auto iter = sync_readers.find(*_id);
+                if (__builtin_expect(iter == sync_readers.end(), 0)) {
+                    // first request of the channel on this thread, drop
+                    // the readers of the channels gone
+                    for (auto it = sync_readers.begin(); it != sync_readers.end(); ) {
+                        it = it->second.channel.expired()? sync_readers.erase(it) : std::next(it);
+                    }
+                    iter = sync_readers.emplace(*_id, SyncReader{_id, _qin, std::make_shared<QType::Reader>(*_qin)}).first;
+                }
+                auto& sync_reader (iter->second.reader);
+                sync_reader->syncPos();
+                return sendSync(req, &resp, timeout_sec, sync_reader);
             }
 
             bool requestWithReader(const Message& req, Message& resp, std::shared_ptr<QType::Reader>& reader, int timeout_sec=5) {
@@ -214,18 +302,44 @@ namespace utils {
                 return nextMessage(&msg, _reader, true);
             }
 
+            // same as nextMessage() but without copying the payload, see MessageView
+            bool nextMessageView(MessageView& view) {
+                return nextMessageView(view, _reader, true);
+            }
+
+            // blocks until the channel's _reader has a message to read,
+            // or timeout_micro (negative for no timeout). Returns true 
+            // if a message is ready, which may not pass the subscription
+            bool waitNext(long long timeout_micro) {
+                return _reader->waitNext(timeout_micro);
+            }
+
+            // types not subscribed are skipped by nextMessage() from the
+            // message header, without taking the payload
             void addSubscription(const std::set<int>& type_set) {
                 for (auto tp : type_set) {
-                    _subscribed_types.insert(tp);
+                    if ((tp < 0) || (tp >= MaxMsgType)) {
+                        logError("subscription type %d out of range [0, %d), ignored", tp, MaxMsgType);
+                        continue;
+                    }
+                    _subscribed_types.set(tp);
                 }
             }
 
             void removeSubscription(const std::set<int>& type_set) {
                 for (auto tp : type_set) {
-                    _subscribed_types.erase(tp);
+                    if ((tp >= 0) && (tp < MaxMsgType)) {
+                        _subscribed_types.reset(tp);
+                    }
                 }
             }
 
+            bool isSubscribed(int type) const {
+                return ((unsigned) type < (unsigned) MaxMsgType) && _subscribed_types.test(type);
+            }
+
+            static const int MaxMsgType = 256;
+
             void outputBuf(char*buf, int size) {
                 fprintf(stderr, "\n");
                 for (int i=0;i<size;++i) {
@@ -306,7 +420,23 @@ namespace utils {
             std::shared_ptr<QType> _qin, _qout;
             std::shared_ptr<QType::Reader> _reader;
             std::shared_ptr<QType::Writer> _writer;
-            std::set<int> _subscribed_types;
+            // id of the channel and its copies, never reused, expires
+            // with the last of them
+            std::shared_ptr<const uint64_t> _id;
+
+            // the reader of a thread's requests on a channel, holding the
+            // queue it reads, as it could outlive the channel
+            struct SyncReader {
+                std::weak_ptr<const uint64_t> channel;
+                std::shared_ptr<QType> q;
+                std::shared_ptr<QType::Reader> reader;
+            };
+
+            static uint64_t nextId() {
+                static std::atomic<uint64_t> id(0);
+                return ++id;
+            }
+            std::bitset<MaxMsgType> _subscribed_types;
             static const int _hdrsize = sizeof(int) + sizeof(uint64_t);
 
             bool sendSync(const Message& req,  Message* resp, int timeout_sec, std::shared_ptr<QType::Reader>& reader) {
@@ -324,7 +454,7 @@ namespace utils {
                         }
                         continue;
                     }
-                    utils::TimeUtil::micro_sleep(10 * 1000);
+                    reader->waitNext(10 * 1000);
                 }
                 logError("sendSync timeout while waiting for response. event_type: %d", (int) req.type);
                 return false;
@@ -351,7 +481,18 @@ namespace utils {
                 return type;
             }
 
-            bool nextMessage(Message* msg, std::shared_ptr<QType::Reader> reader, bool filter_on) {
+            bool nextMessage(Message* msg, std::shared_ptr<QType::Reader>& reader, bool filter_on) {
+                MessageView view;
+                if (nextMessageView(view, reader, filter_on)) {
+                    msg->type = view.type;
+                    msg->ref = view.ref;
+                    msg->copyData(view.buf, view.data_size);
+                    return true;
+                }
+                return false;
+            }
+
+            bool nextMessageView(MessageView& view, std::shared_ptr<QType::Reader>& reader, bool filter_on) {
                 // this reads next message from reader with filter.  
                 // If the msg is a request, i.e. a msg with ref to be NOREF
                 //     the msg ref assigned to be the reader position before reading the msg,
@@ -366,27 +507,35 @@ namespace utils {
                 volatile char* buf;
                 int bytes;
                 while (true) {
-                    QStatus status = reader->takeNextPtr(buf, bytes);
+                    QStatus status = utils::QStat_OK;
+                    if (filter_on) {
+                        // skip the unsubscribed types by the header
+                        int type;
+                        status = reader->peekNextHeader((char*)&type, sizeof(int), bytes);
+                        if ((status == utils::QStat_OK) && (!isSubscribed(type))) {
+                            reader->advance(bytes);
+                            continue;
+                        }
+                    }
                     if (status == utils::QStat_OK) {
-                        msg->type = readMessage(buf, &(msg->ref));
-                        if (! msg->refSet()) {
-                            msg->ref = reader->getReadPos();
+                        status = reader->takeNextPtr(buf, bytes);
+                    }
+                    if (status == utils::QStat_OK) {
+                        view.type = readMessage(buf, &(view.ref));
+                        if (view.ref == Message::NOREF) {
+                            view.ref = reader->getReadPos();
                         }
 
                         // debug
-                        //logInfo("nextMessage received %d bytes, msg: %s, queue dump: %s", 
-                        //        bytes, msg->toString().c_str(),
+                        //logInfo("nextMessage received %d bytes, type: %d, queue dump: %s", 
+                        //        bytes, view.type,
                         //        reader->dump_state().c_str());
 
                         asm volatile("" ::: "memory");
                         reader->advance(bytes);
-                        if ( (!filter_on) ||
-                             (_subscribed_types.find(msg->type) != _subscribed_types.end()) ) {
-                            msg->copyData((char*)buf, bytes-_hdrsize);
-                            return true;
-                        }
-                        // try next one
-                        continue;
+                        view.buf = (const char*)buf;
+                        view.data_size = bytes-_hdrsize;
+                        return true;
                     } else {
                         if (status != utils::QStat_EAGAIN) {
                             // overflow or error, sync
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+/*
+ * Always-on latency histograms of the hops of the trading path, per hop
+ * and symbol, kept in a shm segment to be read by lattap from outside:
+ *
+ *   md_algo:     tp writes the book (update_ts_micro) -> algo event callback
+ *   algo_pi:     algo event callback -> setPosition() sent to the floor
+ *   pi_floor:    setPosition() sent -> SetPositionReq received by the floor
+ *   floor_order: SetPositionReq received -> first order of it sent to the tp
+ *   order_er:    order sent -> first execution report back from the tp
+ *
+ * The stamps are CLOCK_REALTIME nano seconds, carried in the
+ * PositionInstruction, since the hops cross processes and the first one
+ * starts from the tp's update_ts_micro.  Recording is two relaxed atomic
+ * adds to a histogram found once by hop and symbol, see latency_bench for
+ * the overhead.
+ */
+
+namespace utils {
+    // log-linear histogram in nano seconds: exact below 2^SubBits, then
+    // SubCount buckets per power of two, i.e. within 1/16 of the value.
+    // Values of 2^MaxExp (about 18 minutes) or more go to the last bucket.
+    struct LatencyHist {
+        enum {
+            SubBits = 4,
+            SubCount = 1<<SubBits,
+            MaxExp = 40,
+            Buckets = (MaxExp-SubBits+1)*SubCount
+        };
+
+        uint64_t sum_ns;
+        uint64_t max_ns;
+        uint64_t cnt[Buckets];
+
+        static int bucket(uint64_t ns) {
+            if (ns < SubCount) {
+                return (int)ns;
+            }
+            const int e = 63 - __builtin_clzll(ns);
+            if (__builtin_expect(e >= MaxExp, 0)) {
+                return Buckets-1;
+            }
+            return (e-SubBits+1)*SubCount + (int)((ns >> (e-SubBits)) & (SubCount-1));
+        }
+
+        // the smallest value of bucket b
+        static uint64_t bucketLow(int b) {
+            if (b < SubCount) {
+                return b;
+            }
+            const int e = b/SubCount + SubBits - 1;
+            return ((uint64_t)(SubCount + b%SubCount)) << (e-SubBits);
+        }
+
+        // the largest value of bucket b
+        static uint64_t bucketHigh(int b) {
+            return (b+1 < Buckets)? bucketLow(b+1)-1 : bucketLow(b);
+        }
+
+        // lock-free, could be called from multiple threads or processes
+        void record(uint64_t ns) {
+            if (__builtin_expect((int64_t)ns < 0, 0)) {
+                // the clock stepped back between the stamps
+                ns = 0;
+            }
+            __atomic_fetch_add(&cnt[bucket(ns)], 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&sum_ns, ns, __ATOMIC_RELAXED);
+            uint64_t m = __atomic_load_n(&max_ns, __ATOMIC_RELAXED);
+            while ((ns > m) && !__atomic_compare_exchange_n(&max_ns, &m, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {};
+        }
+
+        // the values recorded, summed from the buckets to keep record()
+        // to two atomic adds
+        uint64_t count() const {
+            uint64_t total = 0;
+            for (int b=0; b<Buckets; ++b) {
+                total += cnt[b];
+            }
+            return total;
+        }
+
+        // the value at percentile p (0 to 100), as the high of the bucket
+        // capped by the max, 0 if empty
+        uint64_t percentile(double p) const {
+            const uint64_t total = count();
+            if (!total) {
+                return 0;
+            }
+            uint64_t target = (uint64_t)(p/100.0*total + 0.5);
+            target = (target < 1)? 1 : ((target > total)? total : target);
+            uint64_t cum = 0;
+            for (int b=0; b<Buckets; ++b) {
+                cum += cnt[b];
+                if (cum >= target) {
+                    const uint64_t hi = bucketHigh(b);
+                    return (hi < max_ns)? hi : max_ns;
+                }
+            }
+            return max_ns;
+        }
+
+        double mean() const {
+            const uint64_t total = count();
+            return total? (double)sum_ns/total : 0;
+        }
+
+        void add(const LatencyHist& h) {
+            sum_ns += h.sum_ns;
+            max_ns = (h.max_ns > max_ns)? h.max_ns : max_ns;
+            for (int b=0; b<Buckets; ++b) {
+                cnt[b] += h.cnt[b];
+            }
+        }
+    };
+
+    // the shm segment of a fixed table of histograms keyed by hop and
+    // symbol, claimed on first use by any process and never released.
+    // A slot still being claimed after MaxWaitSpin polls, as when the
+    // claiming process died, isn't waited for: the lookup falls back to
+    // a histogram private to the process and counts a drop.
+    class LatencyStats {
+    public:
+        enum {
+            MaxSlots = 512,
+            HopLen = 16,
+            SymbolLen = 32,
+            MaxWaitSpin = 1<<16     // polls of a claim in progress, yielding
+        };
+
+        struct Slot {
+            char hop[HopLen];
+            char symbol[SymbolLen];
+            int state;  // SlotFree, SlotClaimed or SlotReady
+            int reserved;
+            LatencyHist hist;
+        };
+
+        struct Header {
+            char magic[8];
+            int slot_size;
+            int max_slots;
+            uint64_t dropped;   // lookups given a private histogram
+            char reserved[40];
+        };
+
+        static constexpr const char* ShmName = "/mts_latency";
+        static constexpr const char* Magic = "MTSLAT1";
+
+        // the hops, see above
+        static constexpr const char* HopMdAlgo = "md_algo";
+        static constexpr const char* HopAlgoPI = "algo_pi";
+        static constexpr const char* HopPIFloor = "pi_floor";
+        static constexpr const char* HopFloorOrder = "floor_order";
+        static constexpr const char* HopOrderER = "order_er";
+
+        // the segment used by the process, created if not exists
+        static LatencyStats& get();
+
+        // current time in nano seconds of CLOCK_REALTIME
+        static uint64_t now_ns() {
+            timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+        }
+
+        // maps the segment, read_only to tap an existing segment,
+        // throws if it cannot be opened
+        explicit LatencyStats(const std::string& shm_name = ShmName, bool read_only = false);
+        ~LatencyStats();
+
+        // the histogram of the hop and symbol, claimed if not found.
+        // Symbol could be empty.  Lookups hash into the table, callers
+        // on the hot path should keep the pointer.  With the table full
+        // or the slot stuck in a claim, a histogram private to the
+        // process is returned and counted in dropped().
+        LatencyHist* hist(const char* hop, const char* symbol);
+
+        // the lookups of all processes given a private histogram
+        uint64_t dropped() const {
+            return __atomic_load_n(&m_hdr->dropped, __ATOMIC_RELAXED);
+        }
+
+        // calls f(const Slot&) on the ready slots
+        template<typename Func>
+        void forEach(Func&& f) const {
+            for (int i=0; i<MaxSlots; ++i) {
+                const Slot& s (m_slot[i]);
+                if (__atomic_load_n(&s.state, __ATOMIC_ACQUIRE) == SlotReady) {
+                    f(s);
+                }
+            }
+        }
+
+        // zeros the histograms of all slots and the drops, keeping the
+        // slots claimed
+        void reset();
+
+        size_t size() const { return sizeof(Header) + sizeof(Slot)*MaxSlots; };
+
+    private:
+        enum { SlotFree = 0, SlotClaimed = 1, SlotReady = 2 };
+        const std::string m_shm_name;
+        const bool m_read_only;
+        int m_fd;
+        void* m_ptr;
+        Header* m_hdr;
+        Slot* m_slot;
+
+        static uint32_t hash(const char* hop, const char* symbol);
+        LatencyHist* dropHist();
+    };
+
+    inline LatencyStats& LatencyStats::get() {
+        static LatencyStats stats;
+        return stats;
+    }
+
+    // the histograms of a hop by symbol, found once per symbol in the
+    // LatencyStats of the process.  Not thread safe, to be kept by the
+    // recording thread.
+    class LatencyHopCache {
+    public:
+        explicit LatencyHopCache(const char* hop) : m_hop(hop) {};
+
+        LatencyHist* hist(const char* symbol) {
+            auto iter = m_hist.find(symbol);
+            if (__builtin_expect(iter == m_hist.end(), 0)) {
+                iter = m_hist.emplace(symbol, LatencyStats::get().hist(m_hop, symbol)).first;
+            }
+            return iter->second;
+        }
+
+    private:
+        const char* const m_hop;
+        std::map<std::string, LatencyHist*, std::less<>> m_hist;
+    };
+
+    inline LatencyStats::LatencyStats(const std::string& shm_name, bool read_only)
+    : m_shm_name(shm_name), m_read_only(read_only), m_fd(-1), m_ptr(nullptr), m_hdr(nullptr), m_slot(nullptr) {
+        m_fd = read_only? shm_open(m_shm_name.c_str(), O_RDONLY, S_IRUSR) :
+                          shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (m_fd == -1) {
+            throw std::runtime_error(m_shm_name + ": LatencyStats: shm_open failed " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if ((fstat(m_fd, &st) != 0) || ((size_t) st.st_size != size())) {
+            if (read_only || (ftruncate(m_fd, size()) == -1)) {
+                ::close(m_fd);
+                throw std::runtime_error(m_shm_name + ": LatencyStats: size mismatch or failed to truncate");
+            }
+        }
+        m_ptr = mmap(NULL, size(), read_only? PROT_READ : (PROT_READ|PROT_WRITE), MAP_SHARED, m_fd, 0);
+        if (m_ptr == MAP_FAILED) {
+            ::close(m_fd);
+            throw std::runtime_error(m_shm_name + ": LatencyStats: mmap failed " + std::string(strerror(errno)));
+        }
+        m_hdr = (Header*) m_ptr;
+        m_slot = (Slot*) ((char*)m_ptr + sizeof(Header));
+        if (!read_only && (m_hdr->magic[0] == 0)) {
+            // a new segment, zero filled by ftruncate
+            m_hdr->slot_size = sizeof(Slot);
+            m_hdr->max_slots = MaxSlots;
+            memcpy(m_hdr->magic, Magic, sizeof(m_hdr->magic));
+        }
+        if ((memcmp(m_hdr->magic, Magic, sizeof(m_hdr->magic)) != 0) ||
+            (m_hdr->slot_size != (int)sizeof(Slot)) ||
+            (m_hdr->max_slots != MaxSlots)) {
+            munmap(m_ptr, size());
+            ::close(m_fd);
+            throw std::runtime_error(m_shm_name + ": LatencyStats: not a latency stats segment of this version");
+        }
+    }
+
+    inline LatencyStats::~LatencyStats() {
+        munmap(m_ptr, size());
+        ::close(m_fd);
+    }
+
+    inline uint32_t LatencyStats::hash(const char* hop, const char* symbol) {
+        // FNV-1a
+        uint32_t h = 2166136261u;
+        for (const char* p = hop; *p; ++p) {
+            h = (h ^ (uint8_t)*p) * 16777619u;
+        }
+        h = (h ^ '/') * 16777619u;
+        for (const char* p = symbol; *p; ++p) {
+            h = (h ^ (uint8_t)*p) * 16777619u;
+        }
+        return h;
+    }
+
+    inline LatencyHist* LatencyStats::hist(const char* hop, const char* symbol) {
+        const uint32_t h = hash(hop, symbol);
+        for (int k=0; k<MaxSlots; ++k) {
+            Slot& s (m_slot[(h+k)%MaxSlots]);
+            int state = __atomic_load_n(&s.state, __ATOMIC_ACQUIRE);
+            if ((state == SlotFree) && !m_read_only) {
+                if (__atomic_compare_exchange_n(&s.state, &state, (int)SlotClaimed, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    strncpy(s.hop, hop, HopLen-1);
+                    strncpy(s.symbol, symbol, SymbolLen-1);
+                    __atomic_store_n(&s.state, (int)SlotReady, __ATOMIC_RELEASE);
+                    return &s.hist;
+                }
+            }
+            // claimed by others, wait for the names
+            for (int spin=0; state == SlotClaimed; ++spin) {
+                if (__builtin_expect(spin == MaxWaitSpin, 0)) {
+                    // the claimer is gone, the slot couldn't be told
+                    // from the one wanted
+                    return dropHist();
+                }
+                std::this_thread::yield();
+                state = __atomic_load_n(&s.state, __ATOMIC_ACQUIRE);
+            }
+            if ((state == SlotReady) &&
+                (strncmp(s.hop, hop, HopLen-1) == 0) &&
+                (strncmp(s.symbol, symbol, SymbolLen-1) == 0)) {
+                return &s.hist;
+            }
+            if (state == SlotFree) {
+                // read only and not found
+                break;
+            }
+        }
+        return dropHist();
+    }
+
+    inline LatencyHist* LatencyStats::dropHist() {
+        if (!m_read_only) {
+            __atomic_fetch_add(&m_hdr->dropped, 1, __ATOMIC_RELAXED);
+        }
+        static LatencyHist s_overflow;
+        return &s_overflow;
+    }
+
+    inline void LatencyStats::reset() {
+        if (m_read_only) {
+            return;
+        }
+        for (int i=0; i<MaxSlots; ++i) {
+            memset(&m_slot[i].hist, 0, sizeof(LatencyHist));
+        }
+        __atomic_store_n(&m_hdr->dropped, 0, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,712 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdexcept>
+#include <functional>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "time_util.h"
+
+/*
+ * Asynchronous backend of the Logger.
+ *
+ * The logging thread doesn't format. It parses the printf format string,
+ * copies the raw arguments, strings included, into a record and
+ * enqueues the record with the format string pointer to its own
+ * SPSC ring. A background thread drains the rings, formats the records
+ * into the same text lines as the synchronous Logger and writes them in
+ * batches. In binary mode, records are written as is to a binary segment
+ * together with the strings they refer to, to be decoded by logdecode.
+ *
+ * Format strings and file names have to be static, i.e. literals and
+ * __FILE__, as only the pointers are queued. A format that can't be
+ * encoded (i.e. %n, positional or wide strings) is formatted on the
+ * logging thread and queued as a string.
+ * Records of different threads are written in the order of draining, not
+ * strictly in the order of their timestamps.
+ */
+namespace utils {
+
+    struct AsyncLogRec {
+        uint16_t size;     // total bytes including the header
+        uint8_t level;
+        uint8_t flag;      // padding at the end of a ring
+        int line;
+        uint64_t ts_milli;
+        uint64_t file;     // const char* of the file
+        uint64_t fmt;      // const char* of the format
+        enum { Pad = 1 };
+    } __attribute__((packed));
+
+    class AsyncLog {
+    public:
+        enum Mode {
+            Text = 1,
+            Binary = 2
+        };
+
+        // writes the "time,level,file:line," prefix of a log line
+        typedef int (*PrefixFunc)(int level, const char* file, int line, char* buf, int size, uint64_t ts_milli);
+        typedef std::function<void(const char* buf, int size)> SinkFunc;
+
+        static const int MaxEntry = 1024*4;
+        static const int RingSize = 1024*1024;
+        static const int IdleSleepMicro = 1000;
+        static const char* BinMagic() { return "PLCCBIN1"; };
+
+        AsyncLog(Mode mode, PrefixFunc prefix, SinkFunc sink, std::function<void()> sink_flush)
+        : m_mode(mode), m_prefix(prefix), m_id(nextId()), m_sink(sink), m_sink_flush(sink_flush),
+          m_should_run(true), m_out_len(0)
+        {
+            if (m_mode == Binary) {
+                m_sink(BinMagic(), strlen(BinMagic()));
+            }
+            m_thread = std::thread([this]() { run(); });
+            registerExit(this, true);
+        }
+
+        ~AsyncLog() {
+            registerExit(this, false);
+            stop();
+            for (auto ring: m_rings) {
+                delete ring;
+            }
+        }
+
+        // on the logging thread, the record is dropped if the ring is full
+        void push(int level, const char* file, int line, const char* fmt, va_list ap, uint64_t ts_milli) {
+            LogRing* ring = getRing();
+            char* buf = ring->reserve(sizeof(AsyncLogRec) + MaxEntry);
+            if (__builtin_expect(!buf, 0)) {
+                ++ring->m_dropped;
+                return;
+            }
+            int size = makeRecord(buf, sizeof(AsyncLogRec) + MaxEntry, level, file, line, fmt, ap, ts_milli);
+            ring->commit(size);
+        }
+
+        // waits for all queued records to be written and flushed
+        void sync() {
+            while (true) {
+                bool empty = true;
+                {
+                    std::lock_guard<std::mutex> lock(m_ring_mtx);
+                    for (auto ring: m_rings) {
+                        empty &= ring->empty();
+                    }
+                }
+                if (empty) {
+                    break;
+                }
+                TimeUtil::micro_sleep(IdleSleepMicro);
+            }
+            // wait for the sweep in progress
+            std::lock_guard<std::mutex> lock(m_sweep_mtx);
+        }
+
+        void stop() {
+            if (m_should_run) {
+                m_should_run = false;
+                if (m_thread.joinable()) {
+                    m_thread.join();
+                }
+            }
+        }
+
+        // make a record of the log, returns size of the record
+        static int makeRecord(char* buf, int cap, int level, const char* file, int line, const char* fmt, va_list ap, uint64_t ts_milli) {
+            AsyncLogRec* rec = (AsyncLogRec*) buf;
+            rec->level = level;
+            rec->flag = 0;
+            rec->line = line;
+            rec->ts_milli = ts_milli;
+            rec->file = (uint64_t) file;
+            rec->fmt = (uint64_t) fmt;
+            char* args = buf + sizeof(AsyncLogRec);
+            const int args_cap = cap - sizeof(AsyncLogRec);
+            va_list ap2;
+            va_copy(ap2, ap);
+            int len = encodeArgs(fmt, ap2, args, args_cap);
+            va_end(ap2);
+            if (__builtin_expect(len < 0, 0)) {
+                // not able to encode, format here and queue as a string
+                static const char* StrFmt = "%s";
+                rec->fmt = (uint64_t) StrFmt;
+                char str[MaxEntry];
+                int slen = vsnprintf(str, sizeof(str), fmt, ap);
+                slen = _clamp(slen, 0, (int)sizeof(str)-1);
+                len = putStr(args, args + args_cap, str, slen);
+            }
+            rec->size = sizeof(AsyncLogRec) + len;
+            return rec->size;
+        }
+
+        // formats the record to a text line with a new line, returns the length
+        // the line is cropped to cap the same way as the synchronous Logger
+        static int formatRecord(const AsyncLogRec* rec, const char* file, const char* fmt, char* out, int cap, PrefixFunc prefix) {
+            int len = prefix(rec->level, file, rec->line, out, cap-1, rec->ts_milli);
+            len += formatArgs(fmt, (const char*)rec + sizeof(AsyncLogRec), rec->size - sizeof(AsyncLogRec), out+len, cap-len);
+            if (__builtin_expect(len >= cap-1, 0)) {
+                strcpy(out+cap-11, "<CROPPED!>");
+                len = cap-1;
+            }
+            out[len++] = '\n';
+            return len;
+        }
+
+        // decodes a binary segment file to text lines
+        // returns number of lines decoded, throws on format error
+        static long long decode(FILE* in, FILE* out, PrefixFunc prefix) {
+            std::map<uint64_t, std::string> strs;
+            const int mlen = strlen(BinMagic());
+            long long cnt = 0;
+            char buf[sizeof(AsyncLogRec) + MaxEntry];
+            char line[MaxEntry];
+            int tag;
+            while ((tag = fgetc(in)) != EOF) {
+                switch (tag) {
+                case 'P': {
+                    // a new segment, strings are from a new process
+                    if ((int)fread(buf, 1, mlen-1, in) != mlen-1 || memcmp(buf, BinMagic()+1, mlen-1) != 0) {
+                        throw std::runtime_error("AsyncLog decode: bad segment magic");
+                    }
+                    strs.clear();
+                    break;
+                }
+                case 'D': {
+                    uint64_t id;
+                    uint16_t len;
+                    if (fread(&id, sizeof(id), 1, in) != 1 || fread(&len, sizeof(len), 1, in) != 1 ||
+                        fread(buf, 1, len, in) != len) {
+                        throw std::runtime_error("AsyncLog decode: truncated string");
+                    }
+                    strs[id] = std::string(buf, len);
+                    break;
+                }
+                case 'R': {
+                    AsyncLogRec* rec = (AsyncLogRec*) buf;
+                    if (fread(buf, sizeof(AsyncLogRec), 1, in) != 1 || rec->size < sizeof(AsyncLogRec) ||
+                        rec->size > sizeof(buf) ||
+                        fread(buf + sizeof(AsyncLogRec), 1, rec->size - sizeof(AsyncLogRec), in) != rec->size - sizeof(AsyncLogRec)) {
+                        throw std::runtime_error("AsyncLog decode: truncated record");
+                    }
+                    const auto fiter = strs.find(rec->file);
+                    const auto miter = strs.find(rec->fmt);
+                    if (fiter == strs.end() || miter == strs.end()) {
+                        throw std::runtime_error("AsyncLog decode: string not defined for record");
+                    }
+                    int len = formatRecord(rec, fiter->second.c_str(), miter->second.c_str(), line, sizeof(line), prefix);
+                    fwrite(line, 1, len, out);
+                    ++cnt;
+                    break;
+                }
+                default:
+                    throw std::runtime_error("AsyncLog decode: unknown tag " + std::to_string(tag));
+                }
+            }
+            return cnt;
+        }
+
+    private:
+        // a single producer single consumer ring of records,
+        // records are 8 bytes aligned and don't cross the end
+        class LogRing {
+        public:
+            LogRing() : m_buf(new char[RingSize]), m_head(0), m_tail(0), m_dropped(0), m_pending(0) {
+                // touch the pages off the hot path
+                memset(m_buf, 0, RingSize);
+            };
+            ~LogRing() { delete[] m_buf; };
+
+            // producer
+            char* reserve(int size) {
+                size = align(size);
+                uint64_t h = m_head;
+                const uint64_t t = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+                const int off = (int)(h & (RingSize-1));
+                const int to_end = RingSize - off;
+                if (h + size + (to_end < size? to_end: 0) - t > (uint64_t) RingSize) {
+                    return NULL;
+                }
+                if (to_end < size) {
+                    AsyncLogRec* pad = (AsyncLogRec*) (m_buf + off);
+                    pad->size = to_end;
+                    pad->flag = AsyncLogRec::Pad;
+                    h += to_end;
+                }
+                m_pending = h;
+                return m_buf + (h & (RingSize-1));
+            }
+
+            void commit(int size) {
+                __atomic_store_n(&m_head, m_pending + align(size), __ATOMIC_RELEASE);
+            }
+
+            // consumer
+            const AsyncLogRec* peek() {
+                while (true) {
+                    const uint64_t h = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+                    if (m_tail == h) {
+                        return NULL;
+                    }
+                    const AsyncLogRec* rec = (const AsyncLogRec*) (m_buf + (m_tail & (RingSize-1)));
+                    if (rec->flag == AsyncLogRec::Pad) {
+                        __atomic_store_n(&m_tail, m_tail + rec->size, __ATOMIC_RELEASE);
+                        continue;
+                    }
+                    return rec;
+                }
+            }
+
+            void pop(const AsyncLogRec* rec) {
+                __atomic_store_n(&m_tail, m_tail + align(rec->size), __ATOMIC_RELEASE);
+            }
+
+            bool empty() const {
+                return __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+            }
+
+            static int align(int size) { return (size + 7) & ~7; };
+
+            char* const m_buf;
+            alignas(64) uint64_t m_head;
+            alignas(64) uint64_t m_tail;
+            alignas(64) std::atomic<int> m_dropped;
+            uint64_t m_pending;
+        };
+
+        const Mode m_mode;
+        const PrefixFunc m_prefix;
+        const int m_id;
+        SinkFunc m_sink;
+        std::function<void()> m_sink_flush;
+        volatile bool m_should_run;
+        std::thread m_thread;
+        std::mutex m_ring_mtx, m_sweep_mtx;
+        std::vector<LogRing*> m_rings;
+        std::set<uint64_t> m_strs;   // strings written to the binary segment
+        char m_out[1024*64];
+        int m_out_len;
+
+        static int nextId() {
+            static std::atomic<int> id(0);
+            return ++id;
+        }
+
+        LogRing* getRing() {
+            thread_local int t_owner = 0;
+            thread_local LogRing* t_ring = nullptr;
+            if (__builtin_expect(t_owner == m_id, 1)) {
+                return t_ring;
+            }
+            // first log of this thread, or alternating loggers
+            thread_local std::map<int, LogRing*> t_rings;
+            auto iter = t_rings.find(m_id);
+            if (iter == t_rings.end()) {
+                LogRing* ring = new LogRing();
+                {
+                    std::lock_guard<std::mutex> lock(m_ring_mtx);
+                    m_rings.push_back(ring);
+                }
+                iter = t_rings.emplace(m_id, ring).first;
+            }
+            t_owner = m_id;
+            t_ring = iter->second;
+            return t_ring;
+        }
+
+        void run() {
+            while (true) {
+                bool should_run = m_should_run;
+                if (!sweep() && should_run) {
+                    TimeUtil::micro_sleep(IdleSleepMicro);
+                }
+                if (!should_run) {
+                    // drained once more after stop
+                    break;
+                }
+            }
+        }
+
+        // drains all rings, returns true if anything written
+        bool sweep() {
+            std::lock_guard<std::mutex> sweep_lock(m_sweep_mtx);
+            std::vector<LogRing*> rings;
+            {
+                std::lock_guard<std::mutex> lock(m_ring_mtx);
+                rings = m_rings;
+            }
+            bool written = false;
+            for (auto ring: rings) {
+                int dropped = ring->m_dropped.exchange(0);
+                if (__builtin_expect(dropped > 0, 0)) {
+                    char buf[sizeof(AsyncLogRec) + 64];
+                    makeRecordF(buf, sizeof(buf), 0, __FILE__, __LINE__, "AsyncLog ring full, dropped %d log entries", dropped);
+                    write((const AsyncLogRec*) buf);
+                    written = true;
+                }
+                const AsyncLogRec* rec;
+                while ((rec = ring->peek())) {
+                    write(rec);
+                    ring->pop(rec);
+                    written = true;
+                }
+            }
+            if (written) {
+                flushOut();
+                m_sink_flush();
+            }
+            return written;
+        }
+
+        static int makeRecordF(char* buf, int cap, int level, const char* file, int line, const char* fmt, ...) {
+            va_list ap;
+            va_start(ap, fmt);
+            int size = makeRecord(buf, cap, level, file, line, fmt, ap, TimeUtil::cur_micro()/1000ULL);
+            va_end(ap);
+            return size;
+        }
+
+        void write(const AsyncLogRec* rec) {
+            if (m_mode == Text) {
+                if (m_out_len + MaxEntry > (int)sizeof(m_out)) {
+                    flushOut();
+                }
+                m_out_len += formatRecord(rec, (const char*)rec->file, (const char*)rec->fmt,
+                                          m_out + m_out_len, MaxEntry, m_prefix);
+                return;
+            }
+            writeStr(rec->file);
+            writeStr(rec->fmt);
+            writeOut("R", 1);
+            writeOut((const char*)rec, rec->size);
+        }
+
+        void writeStr(uint64_t id) {
+            if (m_strs.insert(id).second) {
+                uint16_t len = (uint16_t) _clamp((int)strlen((const char*)id), 0, MaxEntry-1);
+                writeOut("D", 1);
+                writeOut((const char*)&id, sizeof(id));
+                writeOut((const char*)&len, sizeof(len));
+                writeOut((const char*)id, len);
+            }
+        }
+
+        void writeOut(const char* buf, int len) {
+            if (m_out_len + len > (int)sizeof(m_out)) {
+                flushOut();
+            }
+            memcpy(m_out + m_out_len, buf, len);
+            m_out_len += len;
+        }
+
+        void flushOut() {
+            if (m_out_len > 0) {
+                m_sink(m_out, m_out_len);
+                m_out_len = 0;
+            }
+        }
+
+        // the queued records are written at exit, as the loggers
+        // are usually not destroyed
+        static void registerExit(AsyncLog* alog, bool add) {
+            static std::mutex mtx;
+            static std::set<AsyncLog*> logs;
+            static bool registered = false;
+            std::lock_guard<std::mutex> lock(mtx);
+            if (add) {
+                logs.insert(alog);
+                if (!registered) {
+                    registered = true;
+                    atexit([]() {
+                        std::vector<AsyncLog*> to_stop;
+                        {
+                            std::lock_guard<std::mutex> lock(mtx);
+                            to_stop.assign(logs.begin(), logs.end());
+                        }
+                        for (auto al: to_stop) {
+                            al->stop();
+                        }
+                    });
+                }
+            } else {
+                logs.erase(alog);
+            }
+        }
+
+        static int _clamp(int v, int lo, int hi) {
+            return v<lo? lo: (v>hi? hi: v);
+        }
+
+        /*
+         * argument encoding
+         */
+        struct Spec {
+            char conv;
+            char lenmod;    // 'H' for hh, 'q' for ll
+            int nstar;      // number of '*' for width and precision
+            int prec;       // -1 if not given, -2 if '*'
+            int len;        // bytes after '%' upto and including conv
+        };
+
+        // parses the conversion spec after a '%'
+        // returns false if not supported
+        static bool parseSpec(const char* p, Spec& s) {
+            const char* q = p;
+            s.nstar = 0;
+            s.lenmod = 0;
+            s.prec = -1;
+            while (*q && strchr("-+ #0'", *q)) ++q;
+            if (*q == '*') {
+                ++s.nstar; ++q;
+            } else {
+                while (isdigit(*q)) ++q;
+            }
+            if (*q == '.') {
+                ++q;
+                if (*q == '*') {
+                    ++s.nstar; ++q;
+                    s.prec = -2;
+                } else {
+                    s.prec = 0;
+                    while (isdigit(*q)) {
+                        s.prec = _clamp(s.prec*10 + (*q - '0'), 0, 0xffff);
+                        ++q;
+                    }
+                }
+            }
+            if (q[0]=='h' && q[1]=='h') {
+                s.lenmod = 'H'; q+=2;
+            } else if (q[0]=='l' && q[1]=='l') {
+                s.lenmod = 'q'; q+=2;
+            } else if (*q && strchr("hlLqjzt", *q)) {
+                s.lenmod = *q; ++q;
+            }
+            s.conv = *q;
+            s.len = (int)(q - p) + 1;
+            if (!s.conv || !strchr("diouxXcfFeEgGaAsp%", s.conv)) {
+                return false;
+            }
+            // wide chars and strings
+            if ((s.conv=='s' || s.conv=='c') && s.lenmod=='l') {
+                return false;
+            }
+            return true;
+        }
+
+        template<typename T>
+        static bool put(char*& p, const char* end, T v) {
+            if (__builtin_expect(p + sizeof(T) > end, 0)) {
+                return false;
+            }
+            memcpy(p, &v, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+
+        template<typename T>
+        static T get(const char*& p) {
+            T v;
+            memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+            return v;
+        }
+
+        static int putStr(char* p, const char* end, const char* str, int len) {
+            char* p0 = p;
+            len = _clamp(len, 0, (int)(end - p - sizeof(uint16_t)));
+            put<uint16_t>(p, end, (uint16_t)len);
+            memcpy(p, str, len);
+            return (int)(p - p0) + len;
+        }
+
+        // returns bytes of the encoded args, -1 if not supported
+        static int encodeArgs(const char* fmt, va_list ap, char* buf, int cap) {
+            char* p = buf;
+            const char* end = buf + cap;
+            for (const char* f = fmt; *f; ++f) {
+                if (*f != '%') {
+                    continue;
+                }
+                Spec s;
+                if (!parseSpec(f+1, s)) {
+                    return -1;
+                }
+                f += s.len;
+                if (s.conv == '%') {
+                    continue;
+                }
+                bool ok = true;
+                int prec = s.prec;
+                for (int i=0; i<s.nstar; ++i) {
+                    const int v = va_arg(ap, int);
+                    ok &= put<long long>(p, end, v);
+                    if (s.prec == -2 && i == s.nstar-1) {
+                        // a negative precision is taken as if omitted
+                        prec = v < 0? -1: v;
+                    }
+                }
+                switch (s.conv) {
+                case 'd': case 'i':
+                    switch (s.lenmod) {
+                    case 'l': ok &= put<long long>(p, end, va_arg(ap, long)); break;
+                    case 'q': case 'L': ok &= put<long long>(p, end, va_arg(ap, long long)); break;
+                    case 'j': ok &= put<long long>(p, end, va_arg(ap, intmax_t)); break;
+                    case 'z': ok &= put<long long>(p, end, va_arg(ap, ssize_t)); break;
+                    case 't': ok &= put<long long>(p, end, va_arg(ap, ptrdiff_t)); break;
+                    default : ok &= put<long long>(p, end, va_arg(ap, int)); break;
+                    }
+                    break;
+                case 'o': case 'u': case 'x': case 'X':
+                    switch (s.lenmod) {
+                    case 'l': ok &= put<unsigned long long>(p, end, va_arg(ap, unsigned long)); break;
+                    case 'q': case 'L': ok &= put<unsigned long long>(p, end, va_arg(ap, unsigned long long)); break;
+                    case 'j': ok &= put<unsigned long long>(p, end, va_arg(ap, uintmax_t)); break;
+                    case 'z': ok &= put<unsigned long long>(p, end, va_arg(ap, size_t)); break;
+                    case 't': ok &= put<unsigned long long>(p, end, va_arg(ap, ptrdiff_t)); break;
+                    default : ok &= put<unsigned long long>(p, end, va_arg(ap, unsigned int)); break;
+                    }
+                    break;
+                case 'c':
+                    ok &= put<long long>(p, end, va_arg(ap, int));
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    if (s.lenmod == 'L') {
+                        ok &= put<long double>(p, end, va_arg(ap, long double));
+                    } else {
+                        ok &= put<double>(p, end, va_arg(ap, double));
+                    }
+                    break;
+                case 'p':
+                    ok &= put<uint64_t>(p, end, (uint64_t) va_arg(ap, void*));
+                    break;
+                case 's': {
+                    const char* str = va_arg(ap, const char*);
+                    if (!str) {
+                        str = "(null)";
+                    }
+                    if (p + sizeof(uint16_t) > end) {
+                        return -1;
+                    }
+                    // with a precision, str needn't be terminated
+                    p += putStr(p, end, str, prec < 0? strlen(str): strnlen(str, prec));
+                    break;
+                }
+                }
+                if (__builtin_expect(!ok, 0)) {
+                    return -1;
+                }
+            }
+            return (int)(p - buf);
+        }
+
+        // formats the args as printf would do with fmt
+        // returns the length written, upto cap-1
+        static int formatArgs(const char* fmt, const char* args, int args_len, char* out, int cap) {
+            const char* p = args;
+            const char* const pend = args + args_len;
+            int n = 0;
+            char spec[64];
+            char str[MaxEntry];
+            for (const char* f = fmt; *f && n < cap-1; ++f) {
+                if (*f != '%') {
+                    out[n++] = *f;
+                    continue;
+                }
+                Spec s;
+                if (!parseSpec(f+1, s) || s.len + 16*s.nstar >= (int)sizeof(spec)) {
+                    // shouldn't happen, as encoded
+                    break;
+                }
+                if (s.conv == '%') {
+                    out[n++] = '%';
+                    f += s.len;
+                    continue;
+                }
+                // the spec with '*' substituted
+                int sl = 0;
+                spec[sl++] = '%';
+                for (int i=1; i<=s.len; ++i) {
+                    if (f[i] == '*') {
+                        if (p + sizeof(long long) > pend) break;
+                        const int v = (int)get<long long>(p);
+                        if (v < 0 && spec[sl-1] == '.') {
+                            // negative precision, as if omitted
+                            --sl;
+                            continue;
+                        }
+                        sl += sprintf(spec+sl, "%d", v);
+                    } else {
+                        spec[sl++] = f[i];
+                    }
+                }
+                spec[sl] = 0;
+                f += s.len;
+
+                int ret = 0;
+                const int room = cap - n;
+                switch (s.conv) {
+                case 'd': case 'i': case 'c': {
+                    if (p + sizeof(long long) > pend) break;
+                    long long v = get<long long>(p);
+                    switch (s.lenmod) {
+                    case 'l': ret = snprintf(out+n, room, spec, (long) v); break;
+                    case 'q': case 'L': ret = snprintf(out+n, room, spec, v); break;
+                    case 'j': ret = snprintf(out+n, room, spec, (intmax_t) v); break;
+                    case 'z': ret = snprintf(out+n, room, spec, (ssize_t) v); break;
+                    case 't': ret = snprintf(out+n, room, spec, (ptrdiff_t) v); break;
+                    default : ret = snprintf(out+n, room, spec, (int) v); break;
+                    }
+                    break;
+                }
+                case 'o': case 'u': case 'x': case 'X': {
+                    if (p + sizeof(unsigned long long) > pend) break;
+                    unsigned long long v = get<unsigned long long>(p);
+                    switch (s.lenmod) {
+                    case 'l': ret = snprintf(out+n, room, spec, (unsigned long) v); break;
+                    case 'q': case 'L': ret = snprintf(out+n, room, spec, v); break;
+                    case 'j': ret = snprintf(out+n, room, spec, (uintmax_t) v); break;
+                    case 'z': ret = snprintf(out+n, room, spec, (size_t) v); break;
+                    case 't': ret = snprintf(out+n, room, spec, (ptrdiff_t) v); break;
+                    default : ret = snprintf(out+n, room, spec, (unsigned int) v); break;
+                    }
+                    break;
+                }
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    if (s.lenmod == 'L') {
+                        if (p + sizeof(long double) > pend) break;
+                        ret = snprintf(out+n, room, spec, get<long double>(p));
+                    } else {
+                        if (p + sizeof(double) > pend) break;
+                        ret = snprintf(out+n, room, spec, get<double>(p));
+                    }
+                    break;
+                case 'p':
+                    if (p + sizeof(uint64_t) > pend) break;
+                    ret = snprintf(out+n, room, spec, (void*) get<uint64_t>(p));
+                    break;
+                case 's': {
+                    if (p + sizeof(uint16_t) > pend) break;
+                    int len = _clamp(get<uint16_t>(p), 0, _clamp((int)(pend-p), 0, (int)sizeof(str)-1));
+                    memcpy(str, p, len);
+                    str[len] = 0;
+                    p += len;
+                    ret = snprintf(out+n, room, spec, str);
+                    break;
+                }
+                }
+                n += _clamp(ret, 0, room-1);
+            }
+            n = _clamp(n, 0, cap-1);
+            out[n] = 0;
+            return n;
+        }
+    };
+};
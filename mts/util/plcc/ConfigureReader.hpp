@@ -11,6 +11,7 @@
 #include <iostream>
 #include <sstream>
 #include <type_traits>
+#include "csv_util.h"
 
 /* ----------------------------------
  * A configuration File Parser/Writer
@@ -308,9 +309,9 @@ T ConfigureReader::Value::get() const {
                    (std::is_same<T, std::string>::value));
 };
 
-template<> inline int  ConfigureReader::Value::get<int>() const                { return std::stoi(_reader.stripQuotedString(_value)); };
-template<> inline long long ConfigureReader::Value::get<long long>() const     { return std::stoll(_reader.stripQuotedString(_value)); };
-template<> inline double ConfigureReader::Value::get<double>() const           { return std::stod(_reader.stripQuotedString(_value)); };
+template<> inline int  ConfigureReader::Value::get<int>() const                { return CSVUtil::parse<int>(_reader.stripQuotedString(_value)); };
+template<> inline long long ConfigureReader::Value::get<long long>() const     { return CSVUtil::parse<long long>(_reader.stripQuotedString(_value)); };
+template<> inline double ConfigureReader::Value::get<double>() const           { return CSVUtil::parse<double>(_reader.stripQuotedString(_value)); };
 template<> inline bool ConfigureReader::Value::get<bool>() const             { return _reader.stripQuotedString(_value) == "true"; };
 template<> inline std::string ConfigureReader::Value::get<std::string>() const { return _reader.stripQuotedString(_value); };
 
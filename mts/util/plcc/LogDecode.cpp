@@ -0,0 +1,46 @@
+#include "plcc/Logger.hpp"
+#include <string.h>
+
+// This decodes the binary log segments written by the async logger
+// in binary mode, i.e. LoggerAsync = binary, to the text log lines
+
+void print_usage(const char* cmd) {
+    printf("Usage: %s bin_file [out_file]\n"
+           "    bin_file: the binary log, i.e. log_20230101.txt.bin\n"
+           "    out_file: optional, the text log lines are written to stdout if not given\n"
+           , cmd);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 0;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    FILE* out = stdout;
+    if (argc > 2) {
+        out = fopen(argv[2], "w");
+        if (!out) {
+            fprintf(stderr, "cannot open %s: %s\n", argv[2], strerror(errno));
+            fclose(in);
+            return 1;
+        }
+    }
+    int ret = 0;
+    try {
+        long long cnt = utils::AsyncLog::decode(in, out, &utils::Logger::log_prefix);
+        fprintf(stderr, "decoded %lld lines\n", cnt);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "failed to decode %s: %s\n", argv[1], e.what());
+        ret = 1;
+    }
+    fclose(in);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ret;
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <string.h>
 #include "rate_limiter.h"
+#include "plcc/AsyncLog.hpp"
 
 #define MAX_LOG_ENTRY 1024*4
 #define MAX_LOG_PER_SECOND 100
@@ -63,13 +64,19 @@ namespace utils {
     }
 
     virtual void flush() = 0;
-    Logger():rl(MAX_LOG_PER_SECOND,1){}
+    explicit Logger(int max_log_per_second = MAX_LOG_PER_SECOND):rl(max_log_per_second,1){}
     virtual ~Logger() {
     };
 
   protected:
     void log(LogLevel level, const char* file, int line, const char* fmt, va_list ap) {
-      if (__builtin_expect(rl.check() != 0,0)) {
+      const uint64_t cur_micro = TimeUtil::cur_micro();
+      if (__builtin_expect(rl.check(cur_micro) != 0,0)) {
+          return;
+      }
+      if (m_async) {
+          // formatted and written by the async logger thread
+          m_async->push(level, file, line, fmt, ap, cur_micro/1000ULL);
           return;
       }
       char char_buffer[MAX_LOG_ENTRY];
@@ -89,19 +96,38 @@ namespace utils {
        writeLog(level, str, str_len);
     };
 
-    static int prepare_log_string(LogLevel level, const char* file, int line, char* char_buffer, int buf_size) {
-      int len = TimeUtil::frac_UTC_to_string(0, char_buffer, buf_size, 3);
-      len += sprintf(char_buffer+len, ",%s,%s:%d,", getLevelStr(level),file,line);
-      return len;
+    // ts_milli is utc in milliseconds, 0 for the current time
+    static int prepare_log_string(LogLevel level, const char* file, int line, char* char_buffer, int buf_size, uint64_t ts_milli=0) {
+      if (ts_milli == 0) {
+          ts_milli = TimeUtil::cur_micro()/1000ULL;
+      }
+      // the date time string is only formatted once a second
+      thread_local time_t t_sec = -1;
+      thread_local char t_str[32];
+      const time_t sec = (time_t) (ts_milli/1000ULL);
+      if (__builtin_expect(sec != t_sec, 0)) {
+          TimeUtil::frac_UTC_to_string(sec, t_str, sizeof(t_str), 0);
+          t_sec = sec;
+      }
+      return snprintf(char_buffer, buf_size, "%s.%03d,%s,%s:%d,", t_str, (int)(ts_milli%1000ULL), getLevelStr(level),file,line);
+    }
+
+  public:
+    // the async logger uses the same prefix
+    static int log_prefix(int level, const char* file, int line, char* char_buffer, int buf_size, uint64_t ts_milli) {
+      return prepare_log_string((LogLevel)level, file, line, char_buffer, buf_size, ts_milli);
     }
 
+  protected:
     virtual void writeLog(int level, const char* str, int size) = 0;
     RateLimiter rl;
+    std::unique_ptr<AsyncLog> m_async;
   };
 
   class FileLogger : public Logger {
   public:
-    FileLogger(const char* filepath): fp(NULL), fp_save(NULL) {
+    explicit FileLogger(const char* filepath, int max_log_per_second = MAX_LOG_PER_SECOND):
+    Logger(max_log_per_second), fp(NULL), fp_save(NULL), bin_fp(NULL), m_filepath(filepath) {
         if (strncmp(filepath, "stdout", 6)==0) {
             fp = stdout;
         } else {
@@ -113,6 +139,12 @@ namespace utils {
         fp_save = fp;
     }
     ~FileLogger() {
+        // write out the queued logs before closing
+        m_async.reset();
+        if (bin_fp) {
+            fclose(bin_fp);
+            bin_fp = NULL;
+        }
         // don't close stdout yet
         if (fp_save && (fp_save != stdout)) {
             fclose(fp_save);
@@ -120,9 +152,38 @@ namespace utils {
         fp_save = NULL;
     }
     void flush() {
+       if (m_async) {
+           m_async->sync();
+       }
        fflush(fp);
     }
 
+    // mode is "text" or "binary", empty to stay synchronous.
+    // "text" writes the same log lines by a background thread,
+    // "binary" writes records to the log file name with ".bin",
+    // decoded by logdecode.  Only set once, before logging.
+    void setAsync(const std::string& mode) {
+        if (m_async || mode.size() == 0) {
+            return;
+        }
+        if (mode == "text" || fp_save == stdout) {
+            m_async.reset(new AsyncLog(AsyncLog::Text, &Logger::log_prefix,
+                    [this](const char* str, int size) { fwrite(str, 1, size, fp); },
+                    [this]() { fflush(fp); }));
+            return;
+        }
+        if (mode != "binary") {
+            throw std::runtime_error("unknown async logger mode: " + mode);
+        }
+        bin_fp = fopen((m_filepath + ".bin").c_str(), "ab");
+        if (!bin_fp) {
+            throw std::runtime_error("cannot open binary log file to write!");
+        }
+        m_async.reset(new AsyncLog(AsyncLog::Binary, &Logger::log_prefix,
+                [this](const char* str, int size) { fwrite(str, 1, size, bin_fp); },
+                [this]() { fflush(bin_fp); }));
+    }
+
     void loggerStdoutON() {
         fp = stdout;
     }
@@ -134,6 +195,8 @@ namespace utils {
   private:
     FILE* fp;
     FILE* fp_save;
+    FILE* bin_fp;
+    const std::string m_filepath;
     void writeLog(int level, const char* str, int size) {
         fwrite(str, 1, size, fp);
         flush();
@@ -3,8 +3,10 @@
 namespace utils {
 
 const char* PLCC::LoggerConfigKey = DefaultLoggerConfigKey;
+const char* PLCC::AsyncLoggerConfigKey = DefaultAsyncLoggerConfigKey;
 const char* PLCC::ConfigFilePath =  DefaultConfigFilePath;
 PLCC* PLCC::default_plcc=nullptr;
+thread_local PLCC* PLCC::thread_plcc=nullptr;
 
 const char* PLCC::getConfigPath() {
     return ConfigFilePath;
@@ -40,10 +42,24 @@ void PLCC::ToggleTest(bool is_on) {
 }
 
 
+void PLCC::setThreadConfig(const char* cfg_path) {
+    if (thread_plcc) {
+        delete thread_plcc;
+        thread_plcc = nullptr;
+    }
+    if (cfg_path) {
+        thread_plcc = new PLCC(cfg_path, "");
+    }
+}
+
 PLCC& PLCC::instance(const char* instname) {
     // note this is NOT thread safe
     static std::map<std::string, PLCC*>plcc_map;
 
+    if (__builtin_expect(thread_plcc && !instname, 0)) {
+        return *thread_plcc;
+    }
+
     if (__builtin_expect(!default_plcc, 0)) {
         default_plcc=new PLCC(getConfigPath(), "");
         plcc_map[""] = default_plcc;
@@ -68,7 +84,12 @@ PLCC::PLCC(const char* configFileName, const std::string& instname) :
        getLogFileName(get<std::string>(LoggerConfigKey, nullptr, "stdout"),instname).c_str() : 
        "stdout"),
     m_configFileName(configFileName?configFileName:"")
-{}
+{
+    // optional async logger, "text" or "binary"
+    if (configFileName) {
+        setAsync(get<std::string>(AsyncLoggerConfigKey, nullptr, ""));
+    }
+}
 
 PLCC::~PLCC() {}
 }
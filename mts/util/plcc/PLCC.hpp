@@ -37,6 +37,7 @@
 #define _ABS_(x)    ((x)>=0 ?(x):(-x))
 
 #define DefaultLoggerConfigKey "Logger"
+#define DefaultAsyncLoggerConfigKey "LoggerAsync"
 #define DefaultConfigFilePath  "config/main.cfg"
 
 namespace utils {
@@ -44,6 +45,7 @@ namespace utils {
 class PLCC : public ConfigureReader, public FileLogger {
 public:
     static const char* LoggerConfigKey;
+    static const char* AsyncLoggerConfigKey;
     static const char* ConfigFilePath;
 
     static const char* getConfigPath();
@@ -54,10 +56,16 @@ public:
     static const std::string getLogFileName(std::string logfile, std::string instname);
     static PLCC& instance(const char* instname=NULL);
 
+    // use cfg_path as the default instance of the calling thread, i.e.
+    // for simulations running on multiple threads each with its own
+    // main config and logger.  nullptr to go back to the process default.
+    static void setThreadConfig(const char* cfg_path);
+
 private:
     explicit PLCC(const char* configFileName, const std::string& instname);
     ~PLCC();
     static PLCC* default_plcc;
+    static thread_local PLCC* thread_plcc;
     std::string m_configFileName;
 };
 }
@@ -4,6 +4,11 @@
 #include <stdlib.h>
 #include <stdexcept>
 #include <vector>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // compound assignment with 'volatile' -qualified left operand is deprecated [-Werror=volatile]
 //#pragma GCC diagnostic push
@@ -21,6 +26,122 @@
 
 namespace utils {
 
+    // Optional wakeup for readers, instead of spinning or sleep polling.
+    // It is four 32-bit words in the queue header, shared by processes,
+    // and is off unless the queue enables it, see enableDoorbell(), so
+    // writers of other queues don't pay the fence in ring().
+    // A reader takes a bit of slots on its first wait and releases it
+    // when detached.  It parks on a futex of seq with its bit set in
+    // parked, and clears the bit when it stops waiting, i.e. on data
+    // or timeout.  A writer rings after making the data ready, and only
+    // enters the kernel if a bit is parked.  The wake clears all of
+    // them, woken readers set theirs again to park, so a reader that
+    // died parked costs one wake and not every put after it.
+    struct Doorbell {
+        volatile int enabled;
+        volatile int seq;
+        volatile unsigned int parked;
+        volatile unsigned int slots;
+
+        static const long long PollMicro = 1000; // without a doorbell or a slot
+
+        void enable() {
+            __atomic_store_n(&enabled, 1, __ATOMIC_SEQ_CST);
+        }
+
+        void ring() {
+            if (!enabled) {
+                return;
+            }
+            // order the ready bytes store before the parked load,
+            // pairs with the parked set in wait()
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (__builtin_expect(parked != 0, 0)) {
+                __atomic_store_n(&parked, 0, __ATOMIC_SEQ_CST);
+                __atomic_add_fetch(&seq, 1, __ATOMIC_SEQ_CST);
+                syscall(SYS_futex, &seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+            }
+        }
+
+        // wait until has_data() or timeout_micro, negative to wait forever.
+        // slot is the reader's, -1 until it gets one here, and given to
+        // detach() when done.  Returns true if has_data()
+        template<typename HasData>
+        bool wait(HasData has_data, long long timeout_micro, int& slot) {
+            if (has_data()) {
+                return true;
+            }
+            if (slot < 0 && enabled) {
+                slot = attach();
+            }
+            timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            end.tv_sec += timeout_micro/1000000LL;
+            end.tv_nsec += (timeout_micro%1000000LL)*1000LL;
+            if (end.tv_nsec >= 1000000000L) {
+                end.tv_sec += 1;
+                end.tv_nsec -= 1000000000L;
+            }
+            while (true) {
+                long long ns = -1;
+                if (timeout_micro >= 0) {
+                    timespec now;
+                    clock_gettime(CLOCK_MONOTONIC, &now);
+                    ns = (end.tv_sec-now.tv_sec)*1000000000LL + (end.tv_nsec-now.tv_nsec);
+                    if (ns <= 0) {
+                        return has_data();
+                    }
+                }
+                if (__builtin_expect(slot < 0, 0)) {
+                    // not rung, poll
+                    const long long poll_ns = PollMicro*1000LL;
+                    usleep((useconds_t)(((ns < 0) || (ns > poll_ns))? PollMicro : ns/1000LL + 1));
+                } else {
+                    timespec rel, *prel = NULL;
+                    if (ns >= 0) {
+                        rel.tv_sec = ns/1000000000LL;
+                        rel.tv_nsec = ns%1000000000LL;
+                        prel = &rel;
+                    }
+                    const unsigned int bit = 1u << slot;
+                    __atomic_or_fetch(&parked, bit, __ATOMIC_SEQ_CST);
+                    const int s = __atomic_load_n(&seq, __ATOMIC_SEQ_CST);
+                    if (!has_data()) {
+                        syscall(SYS_futex, &seq, FUTEX_WAIT, s, prel, NULL, 0);
+                    }
+                    __atomic_and_fetch(&parked, ~bit, __ATOMIC_SEQ_CST);
+                }
+                if (has_data()) {
+                    return true;
+                }
+            }
+        }
+
+        // releases the slot of a reader
+        void detach(int& slot) {
+            if (slot >= 0) {
+                const unsigned int bit = 1u << slot;
+                __atomic_and_fetch(&parked, ~bit, __ATOMIC_SEQ_CST);
+                __atomic_and_fetch(&slots, ~bit, __ATOMIC_SEQ_CST);
+                slot = -1;
+            }
+        }
+
+    private:
+        // a free slot, -1 if all are taken, in which case the reader polls
+        int attach() {
+            unsigned int s = __atomic_load_n(&slots, __ATOMIC_SEQ_CST);
+            while (s != ~0u) {
+                const int i = __builtin_ctz(~s);
+                if (__atomic_compare_exchange_n(&slots, &s, s | (1u << i), false,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+    };
+
     // This is a fixed size, lossy single writer multiple reader queue.
     // The writer does not check the overflow on readers, and it always
     // writes to queue without blocking. Overflow can be detected at
@@ -69,8 +190,16 @@ namespace utils {
         friend class Reader;
         friend class Writer;
         volatile QPos *getPtrReadyBytes() const { return (volatile QPos*) m_buffer.getHeaderStart(); } ;
+        Doorbell *getPtrDoorbell() const { return (Doorbell*) (m_buffer.getHeaderStart() + 3*sizeof(QPos)); };
 
     public:
+        // the buffer, i.e. the shm segment of the queue
+        const BufferType<QLen, HeaderLen>& buffer() const { return m_buffer; };
+
+        // opts in the Doorbell for the readers' waitNext(), by the
+        // writer's side before readers wait on it
+        void enableDoorbell() { getPtrDoorbell()->enable(); };
+
         // only one writer will have shared access to the queue
         class Writer {
         public:
@@ -83,6 +212,7 @@ namespace utils {
                 m_buffer->template copyBytesNoCross<true>(ready_bytes, content, DataLen);
                 asm volatile("" ::: "memory");
                 *m_ready_bytes += DataLen;
+                m_doorbell->ring();
                 return ready_bytes;
             }
 
@@ -114,13 +244,14 @@ namespace utils {
         private:
             explicit Writer(SwQueue<QLen, DataLen, BufferType>& queue, bool init_to_zero=true)
             : m_buffer(&queue.m_buffer),
-              m_ready_bytes(queue.getPtrReadyBytes())
+              m_ready_bytes(queue.getPtrReadyBytes()),
+              m_doorbell(queue.getPtrDoorbell())
             {
                 if (init_to_zero)
                     *m_ready_bytes = 0;
 
                 // the head format is 
-                // ready_bytes(8), item_size(8), total_items(8)
+                // ready_bytes(8), item_size(8), total_items(8), doorbell(16)
                 m_ready_bytes[1] = DataLen;
                 m_ready_bytes[2] = QLen / DataLen; //total items
             };
@@ -128,6 +259,7 @@ namespace utils {
             explicit Writer(const Writer& writer);
             volatile BufferType<QLen, SwQueue<QLen, DataLen, BufferType>::HeaderLen>* const m_buffer;
             volatile QPos* const m_ready_bytes;
+            Doorbell* const m_doorbell;
             // for private constructor access
             friend class SwQueue<QLen, DataLen, BufferType>;
         };
@@ -167,6 +299,48 @@ namespace utils {
                 return QStat_OK;
             }
 
+            // copies up to max_items after the read position into buffer,
+            // stopping at the wrap point of the circular buffer so it is
+            // one memcpy.  The writer position is read once and the
+            // overflow checked once after the copy.  items is the count
+            // copied on QStat_OK, the caller advance(items) after using them.
+            QStatus copyNextBatchIn(char* buffer, int max_items, int& items) {
+                items = 0;
+                QPos pos = *m_ready_bytes;
+                long long bytes = (long long) (pos - m_pos);
+
+                if (__builtin_expect((bytes == 0),0)) {
+                    return QStat_EAGAIN;
+                }
+                while (__builtin_expect((bytes < 0),0)) {
+                    // queue was restarted with a lower position
+                    seekToBottom();
+                    pos = *m_ready_bytes;
+                    bytes = (long long) (pos - m_pos);
+                }
+                if (__builtin_expect((bytes > QLen - DataLen), 0)) {
+                    return QStat_OVERFLOW;
+                }
+                const long long to_wrap = (long long) (QLen - (m_pos % QLen));
+                if (bytes > to_wrap) {
+                    bytes = to_wrap;
+                }
+                int cnt = (int) (bytes/DataLen);
+                if (cnt > max_items) {
+                    cnt = max_items;
+                }
+                if (__builtin_expect(cnt <= 0, 0)) {
+                    return QStat_EAGAIN;
+                }
+                m_buffer->template copyBytesNoCross<false>(m_pos, buffer, cnt*DataLen);
+                // check overflow after read, of the first item
+                if (__builtin_expect(((*m_ready_bytes - m_pos) > QLen - DataLen), 0)) {
+                    return QStat_OVERFLOW;
+                }
+                items = cnt;
+                return QStat_OK;
+            }
+
             QStatus copyTopIn(char* buffer) {
                 QPos pos = *m_ready_bytes;
                 if (__builtin_expect( (pos==0),0)) {
@@ -308,17 +482,35 @@ namespace utils {
                 m_pos = (pos > (QLen - DataLen))? (pos - QLen - DataLen) : 0;
             }
 
-            void advance() { m_pos += DataLen; };
+            void advance(int items = 1) { m_pos += items*DataLen; };
             void syncPos() { m_pos = *m_ready_bytes;};
             QPos getPos() const { return m_pos; };
             QPos getWritePos() const { return *m_ready_bytes;}
-            //void setPos(QPos pos) { m_pos = pos; };
+            // caller is responsible for pos being a valid item position,
+            // i.e. a return value of put() or from getWritePos()
+            void setPos(QPos pos) { m_pos = pos; };
+
+            // blocks until an item after the read position is
+            // written, or timeout_micro (negative for no timeout).
+            // Returns true if there is something to read.
+            // It polls unless the queue enabled the Doorbell.
+            bool waitNext(long long timeout_micro) {
+                return m_doorbell->wait([this]() { return *m_ready_bytes != m_pos; }, timeout_micro, m_slot);
+            }
+
+            ~Reader() {
+                if (m_slot >= 0) {
+                    m_doorbell->detach(m_slot);
+                }
+            }
 
         private:
             explicit Reader(SwQueue<QLen, DataLen, BufferType>& queue)
             : m_buffer(&queue.m_buffer),
               m_ready_bytes(queue.getPtrReadyBytes()),
-              m_pos(*m_ready_bytes)
+              m_doorbell(queue.getPtrDoorbell()),
+              m_pos(*m_ready_bytes),
+              m_slot(-1)
             {
                 //seekToBottom();
                 //seekToTop();
@@ -329,7 +521,9 @@ namespace utils {
             Reader(const Reader&);
             volatile BufferType<QLen, SwQueue<QLen, DataLen, BufferType>::HeaderLen>* const m_buffer;
             const volatile QPos* const m_ready_bytes;
+            Doorbell* const m_doorbell;
             QPos m_pos;
+            int m_slot;  // in the Doorbell
             // for private constructor access
             friend class SwQueue<QLen, DataLen, BufferType>;
         };
@@ -551,6 +745,11 @@ namespace utils {
         volatile QPos *getPtrPosDirty() const { return (volatile QPos*) (m_buffer.getHeaderStart() + sizeof(QPos)) ; };
         volatile QPos *getPtrPosReady() const { return (volatile QPos*) (m_buffer.getHeaderStart() + 64); } ;
         volatile QPos *getPtrPosReadyPrev() const { return (volatile QPos*) (m_buffer.getHeaderStart() + 64 + sizeof(QPos)) ; } ;
+        Doorbell *getPtrDoorbell() const { return (Doorbell*) (m_buffer.getHeaderStart() + 64 + 2*sizeof(QPos)) ; } ;
+
+        // opts in the Doorbell for the readers' waitNext(), before
+        // readers wait on it
+        void enableDoorbell() { getPtrDoorbell()->enable(); };
 
     private:
         const std::string m_name;
@@ -568,6 +767,8 @@ namespace utils {
               m_pos_write(queue.getPtrPosWrite()),
               m_ready_bytes(queue.getPtrPosReady()),
               m_ready_bytes_prev(queue.getPtrPosReadyPrev()),
+              m_doorbell(queue.getPtrDoorbell()),
+              m_slot(-1),
               m_pos(0),
               m_localBuffer(NULL),
               m_localBufferSize(0) {
@@ -580,6 +781,11 @@ namespace utils {
             // go across the circular buffer boundary
             QStatus takeNextPtr(volatile char*& buffer, int& bytes);
 
+            // copies only the first hdr_bytes of the next message into buffer,
+            // with bytes set to the message size, for readers to decide whether
+            // to skip it, i.e. advance(bytes), without taking the whole content
+            QStatus peekNextHeader(char* buffer, int hdr_bytes, int& bytes) const;
+
             // following 2 reads the latest update in the queue,
             // if the queue is not empty, using m_ready_bytes_prev
    	    QStatus copyLatestIn(char*buffer, int& bytes);
@@ -595,7 +801,18 @@ namespace utils {
             QPos getReadPos() const { return m_pos; };
             QPos getReadyPos() const { return *m_ready_bytes; };
 
+            // blocks until a message after the read position is
+            // ready, or timeout_micro (negative for no timeout).
+            // Returns true if there is something to read.
+            // It polls unless the queue enabled the Doorbell.
+            bool waitNext(long long timeout_micro) {
+                return m_doorbell->wait([this]() { return *m_ready_bytes != m_pos; }, timeout_micro, m_slot);
+            }
+
             ~Reader() {
+                if (m_slot >= 0) {
+                    m_doorbell->detach(m_slot);
+                }
                 if (m_localBuffer) {
                     free(m_localBuffer); 
                     m_localBuffer = NULL ;
@@ -606,6 +823,8 @@ namespace utils {
             const volatile QPos* const m_pos_write; // readonly volatile pointer to a ever changing memory location
             const volatile QPos* const m_ready_bytes;
             const volatile QPos* const m_ready_bytes_prev;
+            Doorbell* const m_doorbell;
+            int m_slot;  // in the Doorbell
             QPos m_pos;
             mutable char* m_localBuffer;
             mutable int  m_localBufferSize;
@@ -619,7 +838,8 @@ namespace utils {
               m_pos_write(queue.getPtrPosWrite()),
               m_pos_dirty(queue.getPtrPosDirty()),
               m_ready_bytes(queue.getPtrPosReady()),
-              m_ready_bytes_prev(queue.getPtrPosReadyPrev()) {
+              m_ready_bytes_prev(queue.getPtrPosReadyPrev()),
+              m_doorbell(queue.getPtrDoorbell()) {
                 //reset();
             };
 
@@ -642,6 +862,7 @@ namespace utils {
             volatile QPos* const m_pos_dirty;
             volatile QPos* const m_ready_bytes;
             volatile QPos* const m_ready_bytes_prev;
+            Doorbell* const m_doorbell;
             QPos getWritePos(int bytes);
             void finalizeWrite(int bytes);
             static const QPos SpinThreshold = QLen/2;
@@ -748,6 +969,7 @@ namespace utils {
             if (__builtin_expect(prev_ready_bytes_save < prev_ready_bytes,1)) {
                 *m_ready_bytes_prev = prev_ready_bytes_save;
             }
+            m_doorbell->ring();
         }
     }
 
@@ -793,6 +1015,28 @@ namespace utils {
         return QStat_OK;
     };
 
+    template<int QLen, template<int, int> class BufferType>
+    inline
+    QStatus MwQueue<QLen, BufferType>::Reader::peekNextHeader(char* buffer, int hdr_bytes, int& bytes) const {
+        bytes = 0;
+        if (__builtin_expect((m_pos > *m_pos_write),0)) {
+            // queue restarted, return failure
+            return QStat_ERROR;
+        }
+        if (__builtin_expect((*m_pos_write - m_pos >= QLen), 0)) {
+            return QStat_OVERFLOW;
+        }
+        if (*m_ready_bytes == m_pos)
+            return QStat_EAGAIN;
+
+        m_buffer.template copyBytes<false>(m_pos, (char*)&bytes, sizeof(int));
+        if (__builtin_expect(bytes < hdr_bytes, 0)) {
+            return QStat_ERROR;
+        }
+        m_buffer.template copyBytes<false>(m_pos + sizeof(int), buffer, hdr_bytes);
+        return QStat_OK;
+    }
+
     template<int QLen, template<int, int> class BufferType>
     inline
     QStatus MwQueue<QLen, BufferType>::Reader::copyNextIn(char* buffer, int& bytes) {
@@ -9,7 +9,7 @@ namespace utils {
     // implementation of RateEstimator
     ////////////////////////////////////
 
-    RateEstimator::RateEstimator(const std::vector<std::pair<double, int>>& rate_seconds, int bucket_seconds): _bucket_seconds(bucket_seconds), _lock(false){
+    RateEstimator::RateEstimator(const std::vector<std::pair<double, int>>& rate_seconds, int bucket_seconds): _bucket_seconds(bucket_seconds) {
         if (rate_seconds.size() == 0) {
             logError("RateEstimator: creation with zero length vector");
             throw std::runtime_error("RateEstimator: create with zero length vector");
@@ -21,6 +21,7 @@ namespace utils {
         _event_len = 0;
         const int MIN_BUCKETS = 2; // enforce a minimum numbero of buckets
         int prev_sec = 0;
+        std::vector<int> limits;
         for (const auto& rate_sec: rate_seconds) {
             auto [rate, sec] = rate_sec;
             // check on the bucket
@@ -37,54 +38,62 @@ namespace utils {
             }
             prev_sec = (int)sec;
             _event_len = _MAX_(_event_len, sec);
-            _twnd_count_limit.push_back(std::make_tuple((int)sec, 0, (int) (rate*sec*_bucket_seconds+0.5)));
+            _twnd.push_back((int)sec);
+            limits.push_back((int) (rate*sec*_bucket_seconds+0.5));
+        }
+        _limit = std::vector<std::atomic<int>>(limits.size());
+        _wnd_count = std::vector<std::atomic<uint64_t>>(limits.size());
+        for (size_t i=0; i<limits.size(); ++i) {
+            _limit[i].store(limits[i]);
         }
 
         if (_event_len <= 0) {
             logError("RateEstimator: non-positive event length");
             throw std::runtime_error("RateEstimator: non-positive event length");
         }
-        _event = (volatile unsigned int*) malloc (sizeof(unsigned int)*_event_len);
-        if (!_event) {
-            logError("RateEstimator: malloc of %d", (int) sizeof(unsigned int)*_event_len);
-            throw std::runtime_error(std::string("RateEstimator: malloc of ") + std::to_string((int) sizeof(unsigned int)*_event_len));
+        _event = new std::atomic<uint64_t>[_event_len];
+        for (int i=0; i<_event_len; ++i) {
+            _event[i].store(0, std::memory_order_relaxed);
+        }
+        _latest_second.store(TimeUtil::cur_utc()/_bucket_seconds);
+        for (auto& wc: _wnd_count) {
+            wc.store(packCount(_latest_second, 0));
         }
-        memset((void*)_event, 0, sizeof(unsigned int)*_event_len);
-        _latest_second = TimeUtil::cur_utc()/_bucket_seconds;
 
         //logInfo("Created as %s", toString().c_str());
     }
 
     RateEstimator::RateEstimator(const RateEstimator& re)
     : _bucket_seconds(re._bucket_seconds), 
-      _twnd_count_limit(re._twnd_count_limit),
-      _event_len(re._event_len),
-      _event(nullptr),
-      _latest_second(re._latest_second),
-      _lock(false)
+      _event_len(0),
+      _event(nullptr)
     {
-        _event = (volatile unsigned int*)malloc( _event_len * sizeof(unsigned int));
-        if (!_event) {
-            logError("RateEstimator: malloc of %d", (int) sizeof(unsigned int)*_event_len);
-            throw std::runtime_error(std::string("RateEstimator copy constructor: malloc of ") + std::to_string((int) sizeof(unsigned int)*_event_len));
-        }
-        memcpy((void*)_event, (const void*) re._event, sizeof(unsigned int)*_event_len);
+        copyFrom(re);
     }
 
     void RateEstimator::operator=(const RateEstimator& re) {
         // just copy everything, not thread safe
-        _bucket_seconds = re._bucket_seconds;
-        _twnd_count_limit = re._twnd_count_limit;
-        _event_len = re._event_len;
-        _latest_second = re._latest_second;
+        copyFrom(re);
+    }
 
-        if (_event) free ((void*)_event);
-        _event = (volatile unsigned int*)malloc( _event_len * sizeof(unsigned int));
-        if (!_event) {
-            logError("RateEstimator: malloc of %d", (int) sizeof(unsigned int)*_event_len);
-            throw std::runtime_error(std::string("RateEstimator copy constructor: malloc of ") + std::to_string((int) sizeof(unsigned int)*_event_len));
-        }
-        memcpy((void*)_event, (const void*) re._event, sizeof(unsigned int)*_event_len);
+    void RateEstimator::copyFrom(const RateEstimator& re) {
+        _bucket_seconds = re._bucket_seconds;
+        _twnd = re._twnd;
+        _limit = std::vector<std::atomic<int>>(re._limit.size());
+        _wnd_count = std::vector<std::atomic<uint64_t>>(re._wnd_count.size());
+        for (size_t i=0; i<_limit.size(); ++i) {
+            _limit[i].store(re._limit[i].load());
+            _wnd_count[i].store(re._wnd_count[i].load());
+        }
+        if (_event_len != re._event_len) {
+            delete[] _event;
+            _event_len = re._event_len;
+            _event = new std::atomic<uint64_t>[_event_len];
+        }
+        for (int i=0; i<_event_len; ++i) {
+            _event[i].store(re._event[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        _latest_second.store(re._latest_second.load());
     }
 
     uint64_t RateEstimator::checkOnly(uint64_t cur_micro, int update_cnt) const {
@@ -95,39 +104,32 @@ namespace utils {
         if (__builtin_expect(cur_micro == 0, 0)) {
             cur_micro = TimeUtil::cur_micro();
         }
+        const int latest = _latest_second.load(std::memory_order_acquire);
         int cur_utc = (int) (cur_micro/1000000ULL/_bucket_seconds);
-        if (__builtin_expect( cur_utc < _latest_second, 0)) {
-            if (cur_utc < _latest_second - 1) {
+        if (__builtin_expect( cur_utc < latest, 0)) {
+            if (cur_utc < latest - 1) {
                 logError("RateEstimator: checkOnly time goes back - latest(%d):check(%d)",
-                       (int) _latest_second*_bucket_seconds, (int) cur_utc*_bucket_seconds);
+                       (int) latest*_bucket_seconds, (int) cur_utc*_bucket_seconds);
             }
-            cur_utc = _latest_second;
+            cur_utc = latest;
         }
-        // now check all the tuple
+        // now check all the windows
         int wait_sec = 0;
-        {
-            auto lock = SpinLock(_lock);
-            for (const auto& tp: _twnd_count_limit) {
-                auto [wnd_sec, count, limit] = tp;
-                int update_cnt0 = update_cnt;
+        for (size_t i=0; i<_twnd.size(); ++i) {
+            const int wnd_sec = _twnd[i];
+            const int limit = _limit[i].load(std::memory_order_relaxed);
+            int update_cnt0 = update_cnt;
 
-                // if update_cnt violates limit, log a warning and 
-                // adjust it to the limit
-                if (__builtin_expect(update_cnt > limit,0)) {
-                    logError("RateEstimator: checkOnly update_cnt (%d) more than limit(%d), set it to limit", update_cnt, limit);
-                    update_cnt0 = limit;
-                }
-                count = getCount_Unsafe(cur_utc, count, wnd_sec) + update_cnt0;
-                if (__builtin_expect(count > limit, 0)) {
-                    // look for the seconds to wait
-                    auto utc0 = cur_utc - wnd_sec + 1;
-                    int wait_sec0 = 0;
-                    for (; (utc0 <= _latest_second) && (count > limit) ; ++utc0) {
-                        ++wait_sec0;
-                        count -= _event[utc0%_event_len];
-                    }
-                    wait_sec = _MAX_(wait_sec, wait_sec0);
-                }
+            // if update_cnt violates limit, log a warning and 
+            // adjust it to the limit
+            if (__builtin_expect(update_cnt > limit,0)) {
+                logError("RateEstimator: checkOnly update_cnt (%d) more than limit(%d), set it to limit", update_cnt, limit);
+                update_cnt0 = limit;
+            }
+            int count = getCount(i, cur_utc) + update_cnt0;
+            if (__builtin_expect(count > limit, 0)) {
+                // look for the seconds to wait
+                wait_sec = _MAX_(wait_sec, waitBuckets(cur_utc, wnd_sec, count, limit, latest));
             }
         }
         if (__builtin_expect(wait_sec == 0, 1)) {
@@ -157,42 +159,47 @@ namespace utils {
             cur_micro = TimeUtil::cur_micro();
         }
         int cur_utc = (int)(cur_micro/1000000ULL/_bucket_seconds);
-        if (__builtin_expect( cur_utc < _latest_second, 0)) {
-            if (cur_utc < _latest_second - 1) {
+        int latest = _latest_second.load(std::memory_order_acquire);
+        if (__builtin_expect( cur_utc < latest, 0)) {
+            if (cur_utc < latest - 1) {
                 logError("RateEstimator: updateOnly time goes back - latest(%d):check(%d)",
-                       (int) _latest_second*_bucket_seconds, (int) cur_utc*_bucket_seconds);
+                       (int) latest*_bucket_seconds, (int) cur_utc*_bucket_seconds);
             }
-            cur_utc = _latest_second;
+            cur_utc = latest;
         }
-        // update all the tuple
+        // move the head of each window to cur_utc and add update_cnt,
+        // if another thread moved it further, add to its head
         int wait_sec = 0;
-        {
-            auto lock = SpinLock(_lock);
-            for (auto& tp: _twnd_count_limit) {
-                auto [wnd_sec, count, limit] = tp;
-                int new_count = getCount_Unsafe(cur_utc, count, wnd_sec) + update_cnt;
-                std::get<1>(tp) = new_count;
-                if (__builtin_expect(ret_wait && (new_count > limit),0)) {
-                    // figure out the wait
-                    auto utc0 = cur_utc - wnd_sec + 1;
-                    if (utc0 > _latest_second) {
+        for (size_t i=0; i<_twnd.size(); ++i) {
+            const int wnd_sec = _twnd[i];
+            auto& wc (_wnd_count[i]);
+            uint64_t v = wc.load(std::memory_order_acquire);
+            int new_count;
+            while (true) {
+                const int head = (int)(v>>32);
+                const int utc = _MAX_(head, cur_utc);
+                new_count = rollCount(v, utc, wnd_sec) + update_cnt;
+                if (wc.compare_exchange_weak(v, packCount(utc, new_count), std::memory_order_acq_rel)) {
+                    break;
+                }
+            }
+            if (__builtin_expect(ret_wait, 0)) {
+                const int limit = _limit[i].load(std::memory_order_relaxed);
+                if (__builtin_expect(new_count > limit,0)) {
+                    if (cur_utc - wnd_sec + 1 > latest) {
                         wait_sec = _MAX_(wait_sec, wnd_sec);
                         continue;
                     }
-                    int wait_sec0 = 0;
-                    for (; (utc0 <= _latest_second) && (new_count > limit) ; ++utc0) {
-                        ++wait_sec0;
-                        new_count -= _event[utc0%_event_len];
-                    }
-                    wait_sec = _MAX_(wait_sec, wait_sec0);
+                    wait_sec = _MAX_(wait_sec, waitBuckets(cur_utc, wnd_sec, new_count, limit, latest));
                 }
             }
-            // fill in 0 for skipped buckets if any
-            for (; _latest_second < cur_utc; ++_latest_second) {
-                _event[(_latest_second+1) % _event_len] = 0;
-            }
-            // add the update_cnt to current bucket
-            _event[_latest_second % _event_len] += update_cnt;
+        }
+        // move the latest forward and add update_cnt to its bucket,
+        // to the latest bucket in case another thread moved it more
+        // than a window ahead
+        advance(cur_utc);
+        if (__builtin_expect(!addCount(cur_utc, update_cnt), 0)) {
+            addCount(_latest_second.load(std::memory_order_acquire), update_cnt);
         }
         if (__builtin_expect(wait_sec == 0, 1)) {
             return 0;
@@ -207,43 +214,88 @@ namespace utils {
             throw std::runtime_error("RateEstimator removeOnly() negative update_cnt");
         }
         int rm_cnt = update_cnt;
-        {
-            auto lock = SpinLock(_lock);
-            for (auto utc = _latest_second; (utc>_latest_second-_event_len) && (update_cnt>0); --utc) {
-                auto& cnt (_event[utc%_event_len]);
-                if ((int) cnt >= update_cnt) {
-                    cnt -= update_cnt;
-                    update_cnt = 0;
+        const int latest = _latest_second.load(std::memory_order_acquire);
+        for (auto utc = latest; (utc>latest-_event_len) && (update_cnt>0); --utc) {
+            auto& slot (_event[utc%_event_len]);
+            uint64_t v = slot.load(std::memory_order_acquire);
+            while (true) {
+                const int cnt = ((int)(v>>32) == utc)? (int)(uint32_t)v : 0;
+                if (cnt == 0) {
+                    break;
+                }
+                const int rm = _MIN_(cnt, update_cnt);
+                const uint64_t v1 = (v & 0xffffffff00000000ULL) | (uint32_t)(cnt - rm);
+                if (slot.compare_exchange_weak(v, v1, std::memory_order_acq_rel)) {
+                    update_cnt -= rm;
                     break;
                 }
-                update_cnt -= cnt;
-                cnt = 0;
-            }
-            rm_cnt -= update_cnt;
-            // update the cur_count
-            for (auto& tp: _twnd_count_limit) {
-                auto [wnd_sec, count, limit] = tp;
-                std::get<1>(tp) = _MAX_(count - rm_cnt, 0);
             }
         }
+        rm_cnt -= update_cnt;
+        // update the window counts
+        for (auto& wc: _wnd_count) {
+            uint64_t v = wc.load(std::memory_order_acquire);
+            while (!wc.compare_exchange_weak(v, (v & 0xffffffff00000000ULL) | (uint32_t)_MAX_((int)(uint32_t)v - rm_cnt, 0),
+                                             std::memory_order_acq_rel));
+        }
     }
 
-    // need to be locked, assuming cur_utc >= _latest_second
-    int RateEstimator::getCount_Unsafe(int cur_utc, int cur_count, int wnd_sec) const {
-        auto utc0 = _latest_second - wnd_sec + 1;
-        if (__builtin_expect(cur_utc >= _latest_second + wnd_sec, 0)) {
+    int RateEstimator::getCount(size_t i, int cur_utc) const {
+        // the window is taken at its head if cur_utc is earlier
+        return rollCount(_wnd_count[i].load(std::memory_order_acquire), cur_utc, _twnd[i]);
+    }
+
+    int RateEstimator::rollCount(uint64_t head_count, int cur_utc, int wnd_sec) const {
+        const int head = (int)(head_count>>32);
+        int count = (int)(uint32_t)head_count;
+        if (__builtin_expect(cur_utc >= head + wnd_sec, 0)) {
             return 0;
         }
-        auto utc1 = cur_utc - wnd_sec + 1;
-        int count = cur_count;
-        for (; utc0 < utc1; ++utc0) {
-            count -= _event[utc0%_event_len];
+        // take off the buckets in [head-wnd_sec+1, cur_utc-wnd_sec]
+        for (int utc = head-wnd_sec+1; utc <= cur_utc-wnd_sec; ++utc) {
+            count -= bucketCount(utc);
         }
         return count;
     }
 
+    bool RateEstimator::addCount(int utc, int cnt) {
+        auto& slot (_event[utc%_event_len]);
+        const uint64_t tag = ((uint64_t)(uint32_t)utc)<<32;
+        uint64_t v = slot.load(std::memory_order_acquire);
+        while (true) {
+            const int t = (int)(v>>32);
+            uint64_t v1;
+            if (__builtin_expect(t == utc, 1)) {
+                v1 = tag | (uint32_t)((uint32_t)v + cnt);
+            } else if (t < utc) {
+                // reuse the bucket
+                v1 = tag | (uint32_t)cnt;
+            } else {
+                return false;
+            }
+            if (slot.compare_exchange_weak(v, v1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+    }
+
+    int RateEstimator::advance(int utc) {
+        int prev = _latest_second.load(std::memory_order_acquire);
+        while ((prev < utc) && !_latest_second.compare_exchange_weak(prev, utc, std::memory_order_acq_rel));
+        return prev;
+    }
+
+    int RateEstimator::waitBuckets(int cur_utc, int wnd_sec, int count, int limit, int latest) const {
+        int wait_sec = 0;
+        for (auto utc0 = cur_utc - wnd_sec + 1; (utc0 <= latest) && (count > limit) ; ++utc0) {
+            ++wait_sec;
+            count -= bucketCount(utc0);
+        }
+        return wait_sec;
+    }
+
     void RateEstimator::updateRateLimit(const std::vector<double> & rates) {
-        if (rates.size() != _twnd_count_limit.size()) {
+        if (rates.size() != _twnd.size()) {
             logError("RateEstimator: updateRateLimit mismatch shape, rate limit not updated!");
             return;
         }
@@ -256,26 +308,21 @@ namespace utils {
         }
 
         logInfo("Resetting rates: before: %s", toString().c_str());
-        {
-            auto lock = SpinLock(_lock);
-            for (size_t i=0; i<rates.size(); ++i) {
-                auto [twnd, count, limit] = _twnd_count_limit[i];
-                double new_rate = rates[i];
-                int new_limit = int(twnd*_bucket_seconds*new_rate+0.5);
-                std::get<2>(_twnd_count_limit[i]) = new_limit;
-            }
+        for (size_t i=0; i<rates.size(); ++i) {
+            double new_rate = rates[i];
+            int new_limit = int(_twnd[i]*_bucket_seconds*new_rate+0.5);
+            _limit[i].store(new_limit);
         }
         logInfo("Resetting rates: after: %s", toString().c_str());
     }
 
     // this resets all the counts
     void RateEstimator::resetAll() {
-        {
-            auto lock = SpinLock(_lock);
-            for (auto& tcl: _twnd_count_limit) {
-                std::get<1>(tcl) = 0;
-            }
-            memset((void*)_event, 0, sizeof(unsigned int)*_event_len);
+        for (auto& wc: _wnd_count) {
+            wc.store(packCount(_latest_second.load(), 0), std::memory_order_release);
+        }
+        for (int i=0; i<_event_len; ++i) {
+            _event[i].store(0, std::memory_order_release);
         }
     }
 
@@ -285,12 +332,10 @@ namespace utils {
         char buf[512];
         size_t bytes=0;
         bytes = snprintf(buf, sizeof(buf), "%d, %d", (int) cur_utc, _bucket_seconds);
-        for (const auto& tcl:_twnd_count_limit) {
-            auto [twnd, count, limit] = tcl;
-            {
-                auto lock = SpinLock(_lock);
-                count = getCount_Unsafe(cur_utc/_bucket_seconds, count, twnd);
-            }
+        for (size_t i=0; i<_twnd.size(); ++i) {
+            const int twnd = _twnd[i];
+            const int limit = _limit[i].load();
+            const int count = getCount(i, cur_utc/_bucket_seconds);
             bytes += snprintf(buf+bytes, sizeof(buf)-bytes, ", %d, %.2f, %.2f, %.2f",
                     twnd*_bucket_seconds,
                     (double)limit/(double)(twnd*_bucket_seconds),
@@ -302,12 +347,9 @@ namespace utils {
 
     std::vector<double> RateEstimator::checkRates(int cur_utc, int upd_cnt) const {
         std::vector<double> ret;
-        for (const auto& tcl:_twnd_count_limit) {
-            auto [twnd, count, limit] = tcl;
-            {
-                auto lock = SpinLock(_lock);
-                count = getCount_Unsafe(cur_utc/_bucket_seconds, count, twnd);
-            }
+        for (size_t i=0; i<_twnd.size(); ++i) {
+            const int twnd = _twnd[i];
+            const int count = getCount(i, cur_utc/_bucket_seconds);
             ret.push_back((double)(count+upd_cnt)/(double)(twnd*_bucket_seconds));
         }
         return ret;
@@ -348,11 +390,12 @@ namespace utils {
 
         // set up the counts
         utc /= buckets;
-        re->_latest_second = utc;
+        re->_latest_second.store(utc);
         int cur_cnt = 0;
         for (size_t i=0; i<counts.size(); ++i) {
-            auto& [twnd, cnt, limit] = re->_twnd_count_limit[i];
-            cnt = counts[i];
+            const int twnd = re->_twnd[i];
+            const int cnt = counts[i];
+            re->_wnd_count[i].store(packCount(utc, cnt));
             // populate _event so sum of [utc-twnd+1, utc] to be approximately 
             // no less than cnt 
             // we assuming the time window is increasing, to give more
@@ -365,7 +408,9 @@ namespace utils {
             int utc0 = utc-twnd+1;
             for (int i=0; i<twnd; ++i) {
                 int cnt0 = int((i+1)*ra+0.5) - cum_cnt;
-                re->_event[(utc0+i)%re->_event_len]+=cnt0;
+                if (cnt0 > 0) {
+                    re->addCount(utc0+i, cnt0);
+                }
                 cum_cnt += cnt0;
             }
             cur_cnt = cnt;
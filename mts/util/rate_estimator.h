@@ -2,6 +2,7 @@
 #include <vector>
 #include <tuple>
 #include <memory>
+#include <atomic>
 #include "time_util.h"
 #include "thread_utils.h"
 namespace utils {
@@ -15,7 +16,12 @@ namespace utils {
         // <5.0 per seconds, 300 seconds>, could be defined.  All estimators
         // are checked and/or updated simultanuously.
         //
-        // Same as RateLimiter, it is thread safe.
+        // Same as RateLimiter, it is thread safe and lock free. Each bucket
+        // is an atomic word of <bucket time, count>, updated by CAS, and a
+        // bucket of an earlier time reads as 0, so that buckets are reused
+        // without clearing. Each window also keeps an atomic word of
+        // <window head, count>, the head moved forward by CAS, taking off
+        // the counts of the buckets that fall out of the window.
         //
         // TODO: 
         // 1 - check/update cannot be for an earlier time (1 sec earlier) than
@@ -65,23 +71,45 @@ namespace utils {
 
     protected:
         int _bucket_seconds;
-        // <_twnd, _cum_count, _count_limit>, window size, cum count and limit
-        std::vector<std::tuple<int, int, int>> _twnd_count_limit;
+        std::vector<int> _twnd; // window size in buckets
+        std::vector<std::atomic<int>> _limit; // count limit of each window
+        std::vector<std::atomic<uint64_t>> _wnd_count; // <head, count> of each window
         int _event_len;  // length of allocated _event, i.e. maximum window
-        volatile unsigned int* _event;
-        volatile int _latest_second;
-        mutable SpinLock::LockType _lock;
-
-        // get the event at current time as cur_utc
-        // number of events in [latest_seconds-twnd+1, latest_seconds] as cur_count
-        // and window_seconds as wnd_sec
-        // NOTE - both cur_utc and window_seconds should be divided by bucket
-        // return event counts from [cur_utc-twnd+1, cur_utc] inclusive
-        int getCount_Unsafe(int cur_utc, int cur_count, int wnd_sec) const;
+        std::atomic<uint64_t>* _event; // <bucket time, count> of each bucket
+        std::atomic<int> _latest_second;
+
+        // NOTE - cur_utc should be divided by bucket
+        // return event counts of window i from [cur_utc-twnd+1, cur_utc] inclusive
+        int getCount(size_t i, int cur_utc) const;
+
+        // count of window i at cur_utc, given its <head, count> word
+        int rollCount(uint64_t head_count, int cur_utc, int wnd_sec) const;
+
+        static uint64_t packCount(int utc, int cnt) {
+            return (((uint64_t)(uint32_t)utc)<<32) | (uint32_t)cnt;
+        }
+
+        // count of the bucket at utc, 0 if the bucket has been reused
+        int bucketCount(int utc) const {
+            const uint64_t v = _event[utc%_event_len].load(std::memory_order_acquire);
+            return ((int)(v>>32) == utc)? (int)(uint32_t)v : 0;
+        }
+
+        // adds cnt to the bucket at utc, return false if the bucket
+        // has been reused by a later time
+        bool addCount(int utc, int cnt);
+
+        // moves _latest_second forward to utc, returns the previous
+        int advance(int utc);
+
+        // buckets to wait from the start of the window for count to be within limit
+        int waitBuckets(int cur_utc, int wnd_sec, int count, int limit, int latest) const;
+
+        void copyFrom(const RateEstimator& re);
     };
 
     inline
-    RateEstimator::~RateEstimator() { free ((void*)_event); _event = NULL; };
+    RateEstimator::~RateEstimator() { delete[] _event; _event = NULL; };
 
     inline
     uint64_t RateEstimator::check() {
@@ -11,8 +11,8 @@ namespace utils {
     RateLimiter::RateLimiter(const int count, time_t TimeWindow_In_Second, int history_count_multiple) 
     :_count(count), _twnd(TimeWindow_In_Second*1000000LL),
      _hist_count(count*(history_count_multiple+1)),
-     _event(_hist_count>0? ((volatile long long*)malloc(sizeof(long long)*_hist_count)) : nullptr),
-     _idx(0), _lock(false)
+     _event(_hist_count>0? new std::atomic<long long>[_hist_count] : nullptr),
+     _idx(0)
     {
         if (_hist_count <= 0) {
             throw std::runtime_error("RateLimit history_count_multiple negative!");
@@ -20,18 +20,19 @@ namespace utils {
         if (!_event) {
             throw std::runtime_error("RateLimit malloc");
         }
-        memset((char*)_event, 0, sizeof(int64_t)*_hist_count);
+        for (int i=0; i<_hist_count; ++i) {
+            _event[i].store(0, std::memory_order_relaxed);
+        }
     };
 
     RateLimiter::RateLimiter(const RateLimiter& rl) 
     : _count(rl._count), _twnd(rl._twnd), _hist_count(rl._hist_count), 
-      _event(nullptr), _idx(rl._idx), _lock(false)
+      _event(nullptr), _idx(rl._idx.load())
     {
-        _event = (volatile long long*) malloc(_hist_count*sizeof(long long));
-        if (!_event) {
-            throw std::runtime_error("RateLimiter: failed construct from copy in malloc " + std::to_string(_hist_count*sizeof(long long)));
+        _event = new std::atomic<long long>[_hist_count];
+        for (int i=0; i<_hist_count; ++i) {
+            _event[i].store(rl._event[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
         }
-        memcpy((void*)_event, (const void*)rl._event, _hist_count*sizeof(long long));
     }
 
     void RateLimiter::operator=(const RateLimiter& rl) {
@@ -40,8 +41,10 @@ namespace utils {
              (_hist_count != rl._hist_count) ) {
             throw std::runtime_error("RateLimiter: failed to copy mismatch: this and given\n" + toString() + "\n" + rl.toString());
         }
-        memcpy((void*)_event, (const void*) rl._event, _hist_count*sizeof(long long));
-        _idx = rl._idx;
+        for (int i=0; i<_hist_count; ++i) {
+            _event[i].store(rl._event[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        _idx.store(rl._idx.load());
     }
 
     uint64_t RateLimiter::checkOnly(uint64_t cur_micro, int update_cnt) const {
@@ -60,11 +63,8 @@ namespace utils {
         if (__builtin_expect(cur_micro == 0, 0)) {
             cur_micro = TimeUtil::cur_micro();
         };
-        long long ts = cur_micro;
-        {
-            auto lock = SpinLock(_lock);
-            ts = _event[prevIdx(_idx,update_cnt)];
-        }
+        const long long idx = _idx.load(std::memory_order_acquire);
+        const long long ts = _event[prevIdx(idx,update_cnt)].load(std::memory_order_acquire);
         long long tdiff = (long long)cur_micro - ts;
         if (tdiff < _twnd) {
             return (uint64_t) _twnd - tdiff;
@@ -97,10 +97,11 @@ namespace utils {
         // Return a micro_seconds that must be waited (0 for good case).
         // Note update_cnt >= 0
         //
-        // The function is thread safe.  It works in the following loop:
-        // It get the current idx and do a CAS on the idx+1, upto a 
-        // max_spin count. If max_spin exceeded, it throws a runtime_error.
-        // 
+        // The function is thread safe without lock.  The slots of
+        // [idx, idx+update_cnt) are claimed by an atomic add on _idx,
+        // so concurrent updates write to different slots.  A check
+        // concurrent to the update may read a claimed slot before
+        // it is written, and sees the time of the overwritten event.
         if (__builtin_expect(update_cnt <= 0, 0)) {
             logError("RateLimit updateOnly(): ERROR non-positive update_cnt %d", update_cnt);
             throw std::runtime_error("RateLimit updateOnly(): negative update_cnt!");
@@ -109,18 +110,15 @@ namespace utils {
             cur_micro = TimeUtil::cur_micro();
         };
         long long ts = cur_micro;
-        {
-            auto lock = SpinLock(_lock);
-            long long idx = _idx;
-            if (__builtin_expect(update_cnt <= _count,1)) {
-                ts = _event[prevIdx(idx,update_cnt)];
-            } // else ts = cur_micro, i.e. wait _twnd
-            const long long idx1 = idx + (update_cnt<_hist_count?update_cnt:_hist_count);
-            for (long long i=idx; i<idx1; ++i) {
-                _event[i%(long long)_hist_count] = (long long)cur_micro;
-            }
-            _idx += update_cnt;
+        const long long idx = _idx.fetch_add(update_cnt, std::memory_order_acq_rel);
+        if (__builtin_expect(update_cnt <= _count,1)) {
+            ts = _event[prevIdx(idx,update_cnt)].load(std::memory_order_acquire);
+        } // else ts = cur_micro, i.e. wait _twnd
+        const long long idx1 = idx + (update_cnt<_hist_count?update_cnt:_hist_count);
+        for (long long i=idx; i<idx1; ++i) {
+            _event[i%(long long)_hist_count].store((long long)cur_micro, std::memory_order_release);
         }
+
         // regulate wait_micro between [0, _twnd]
         long long wait_micro0 = cur_micro - ts;
         if (__builtin_expect(wait_micro0 >= _twnd, 1)) {
@@ -135,21 +133,25 @@ namespace utils {
         // to compensate the order counts.
         // '0' is stored in place of the removed event time, that is, if 
         // removing more than hist_count, no history is kept and all is reset.
+        //
+        // The _idx is moved back with a CAS, and the removed slots are then
+        // cleared.  It is approximate if an update concurrently claims the
+        // removed slots, in which case the update's time could be cleared.
         if (__builtin_expect(update_cnt <= 0, 0)) {
             logError("RateLimit removeOnly_Approximate(): ERROR non-positive update_cnt %d", update_cnt);
             throw std::runtime_error("RateLimit removeOnly_Approximate(): negative update_cnt!");
         }
-        {
-            auto lock = SpinLock(_lock);
-            if (__builtin_expect( (update_cnt>=_hist_count)||(update_cnt>=_idx), 0)) {
-                memset((char*)_event, 0, sizeof(int64_t)*_hist_count);
+        long long idx = _idx.load(std::memory_order_acquire);
+        do {
+            if (__builtin_expect( (update_cnt>=_hist_count)||(update_cnt>=idx), 0)) {
+                for (int i=0; i<_hist_count; ++i) {
+                    _event[i].store(0, std::memory_order_release);
+                }
                 return;
             }
-            long long idx = _idx;
-            for (long long i=idx-1; i>=idx-update_cnt; --i) {
-                _event[i%(long long)_hist_count] = 0;
-            }
-            _idx-=update_cnt;
+        } while (!_idx.compare_exchange_weak(idx, idx-update_cnt, std::memory_order_acq_rel));
+        for (long long i=idx-1; i>=idx-update_cnt; --i) {
+            _event[i%(long long)_hist_count].store(0, std::memory_order_release);
         }
     }
 
@@ -167,12 +169,19 @@ namespace utils {
         // format _count, _twnd, _hist_count, _idx, _event[0], _event[1]-_event[0], ...
         // (_event[i] in utc, NOT microseconds)
         // use delta to save space
-        long long idx;
-        long long* evt = (long long*) malloc(_hist_count* sizeof(long long));
-        {
-            auto lock = SpinLock(_lock);
-            idx = _idx;
-            memcpy(evt, (const void*)_event, _hist_count*sizeof(long long));
+        // take a copy with the index unchanged, not
+        // to spin forever on a busy limiter
+        long long idx = _idx.load(std::memory_order_acquire);
+        std::vector<long long> evt(_hist_count);
+        for (int retry=0; retry<16; ++retry) {
+            for (int i=0; i<_hist_count; ++i) {
+                evt[i] = _event[i].load(std::memory_order_acquire);
+            }
+            const long long idx1 = _idx.load(std::memory_order_acquire);
+            if (idx1 == idx) {
+                break;
+            }
+            idx = idx1;
         }
         std::string ret = toString();
         ret+=',';
@@ -214,12 +223,12 @@ namespace utils {
            throw std::runtime_error("RateLimiter load object mismatch!");
         }
 
-        rl->_idx = idx;
-        rl->_event[0] = evt0;
+        rl->_idx.store(idx);
+        rl->_event[0].store(evt0);
         evt0/=1000000;
         for (int i=1; i<hist_count; ++i) {
             evt0 += std::stoi(line[4+i]);
-            rl->_event[i] = (long long)evt0*1000000LL;
+            rl->_event[i].store((long long)evt0*1000000LL);
         }
         return rl;
     }
@@ -5,6 +5,7 @@
 #include "thread_utils.h"
 #include <vector>
 #include <tuple>
+#include <atomic>
 
 namespace utils {
 
@@ -26,7 +27,9 @@ namespace utils {
      * arrival of new events, a longer circular buffer, longer than "count",
      * is created according to the specified multiple.
      *
-     * Note2: It is thread safe.  See the non-blocking implementation notes below.
+     * Note2: It is thread safe and lock free.  The event slots are claimed
+     * by an atomic add on the index, and the removal is a CAS on the index.
+     * See the implementation notes in rate_limiter.cpp.
      */
     class RateLimiter {
     public:
@@ -79,9 +82,8 @@ namespace utils {
         const int _count;
         const long long _twnd;
         const int _hist_count;
-        volatile long long* _event;
-        volatile long long _idx;
-        mutable SpinLock::LockType _lock;
+        std::atomic<long long>* _event;
+        std::atomic<long long> _idx;
 
         int prevIdx(long long idx, int update_cnt) const {
             return (int)((idx+update_cnt-1+_hist_count-_count)%(long long)_hist_count);
@@ -89,7 +91,7 @@ namespace utils {
     };
 
     inline
-    RateLimiter::~RateLimiter() { free ((void*)_event); _event = NULL; };
+    RateLimiter::~RateLimiter() { delete[] _event; _event = NULL; };
 
     inline
     uint64_t RateLimiter::check(uint64_t cur_micro) {
@@ -0,0 +1,84 @@
+#include "plcc/PLCC.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <stdio.h>
+
+using namespace utils;
+
+// the async record formatted to a log line should be the same
+// as the synchronous logger, given the same timestamp
+std::string syncLine(uint64_t ts_milli, const char* fmt, ...) {
+    char buf[MAX_LOG_ENTRY];
+    int len = Logger::log_prefix(Info, "file.cpp", 10, buf, sizeof(buf)-1, ts_milli);
+    va_list ap;
+    va_start(ap, fmt);
+    int len2 = vsnprintf(buf+len, sizeof(buf)-len, fmt, ap);
+    va_end(ap);
+    if (len2 >= (int)sizeof(buf)-len) {
+        strcpy(buf+sizeof(buf)-11, "<CROPPED!>");
+        len = sizeof(buf)-1;
+    } else {
+        len += len2;
+    }
+    buf[len++] = '\n';
+    return std::string(buf, len);
+}
+
+std::string asyncLine(uint64_t ts_milli, const char* fmt, ...) {
+    char rec[sizeof(AsyncLogRec) + AsyncLog::MaxEntry];
+    va_list ap;
+    va_start(ap, fmt);
+    AsyncLog::makeRecord(rec, sizeof(rec), Info, "file.cpp", 10, fmt, ap, ts_milli);
+    va_end(ap);
+    const AsyncLogRec* r = (const AsyncLogRec*) rec;
+    char buf[AsyncLog::MaxEntry];
+    int len = AsyncLog::formatRecord(r, (const char*)r->file, (const char*)r->fmt, buf, sizeof(buf), &Logger::log_prefix);
+    return std::string(buf, len);
+}
+
+#define EXPECT_SAME_LINE(a...) EXPECT_EQ(syncLine(ts, a), asyncLine(ts, a))
+
+TEST (AsyncLog, Format) {
+    const uint64_t ts = 1675198786123ULL;
+    EXPECT_SAME_LINE("plain");
+    EXPECT_SAME_LINE("%d %i %u %x %X %o %c %%", -1, 2, 3u, 255, 255, 8, 'a');
+    EXPECT_SAME_LINE("%ld %lld %lu %llu %zu %hd %hhu", -1L, -2LL, 3UL, 4ULL, (size_t)5, (short)-6, (unsigned char)7);
+    EXPECT_SAME_LINE("%f %.8f %e %g %10.3lf %-8.2f| %Lf", 1.5, 70.12, 1e-9, 0.1, 2.25, 3.5, (long double)1.25);
+    EXPECT_SAME_LINE("%s %-10s| %5s %.2s %s", "abc", "left", "r", "trunc", "");
+    EXPECT_SAME_LINE("%*d %-*d| %.*f %*.*s", 6, 1, 4, 2, 3, 1.23456, 8, 2, "abcd");
+    EXPECT_SAME_LINE("%p %s", (void*)0x1234, (const char*)NULL);
+    EXPECT_SAME_LINE("%s", std::string(MAX_LOG_ENTRY*2, 'x').c_str());
+
+    // precision bounds the read, the string needn't be terminated
+    const char sym[6] = {'W','T','I','_','N','1'};
+    EXPECT_SAME_LINE("%.6s %.*s %.0s| %.*s", sym, 3, sym, sym, -1, "neg");
+
+    // not encoded, formatted by the caller
+    EXPECT_SAME_LINE("%2$s %1$s", "a", "b");
+}
+
+TEST (AsyncLog, BinaryDecode) {
+    const char* fname = "/tmp/async_log_test.txt";
+    std::remove(fname);
+    std::remove((std::string(fname)+".bin").c_str());
+    {
+        FileLogger logger(fname);
+        logger.setAsync("binary");
+        (logger.logInfo)("file.cpp", 10, "order %d %s px %.8f", 1, "WTI_N1", 70.12);
+        (logger.logError)("file.cpp", 11, std::string("error string"));
+    }
+    FILE* in = fopen((std::string(fname)+".bin").c_str(), "rb");
+    ASSERT_TRUE(in != NULL);
+    char* out_buf = NULL;
+    size_t out_size = 0;
+    FILE* out = open_memstream(&out_buf, &out_size);
+    EXPECT_EQ(AsyncLog::decode(in, out, &Logger::log_prefix), 2);
+    fclose(in);
+    fclose(out);
+    const std::string lines(out_buf, out_size);
+    free(out_buf);
+    EXPECT_NE(lines.find(",INF,file.cpp:10,order 1 WTI_N1 px 70.12000000\n"), std::string::npos);
+    EXPECT_NE(lines.find(",ERR,file.cpp:11,error string\n"), std::string::npos);
+    std::remove(fname);
+    std::remove((std::string(fname)+".bin").c_str());
+}
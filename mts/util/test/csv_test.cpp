@@ -1,4 +1,5 @@
 #include "csv_util.h"
+#include "plcc/PLCC.hpp"
 #include <iostream>
 #include "gtest/gtest.h"
 #include <cstdio>
@@ -81,6 +82,241 @@ TEST_F (CSVFixture, Double) {
     }
 }
 
+TEST_F (CSVFixture, ReadView) {
+    utils::CSVUtil::LineView tk;
+    std::vector<std::string> lines (_lines);
+    for (const auto& l : {"", " ", ",", "a,", " a , b ,\r", "a,,b", "single"}) {
+        lines.push_back(l);
+    }
+    for (const auto& l : lines) {
+        const auto& ref (utils::CSVUtil::read_line(l));
+        EXPECT_EQ(utils::CSVUtil::read_line(l, tk), ref.size());
+        EXPECT_EQ(std::vector<std::string>(tk.begin(), tk.end()), ref);
+    }
+    EXPECT_EQ(utils::CSVUtil::read_line("a,", tk), 2);
+    EXPECT_EQ(tk[1], "");
+    EXPECT_EQ(utils::CSVUtil::read_line("", tk), 0);
+    EXPECT_EQ(utils::CSVUtil::read_line("1|2", tk, '|'), 2);
+}
+
+TEST_F (CSVFixture, Parse) {
+    using utils::CSVUtil;
+    for (const auto& s : {"0", "1.5", " -2.25", "+3", "1e-3", "101.2 ", "39.500000", "-0.000001", "1605199509225505"}) {
+        EXPECT_EQ(CSVUtil::parse<double>(s), std::stod(s));
+        EXPECT_EQ(CSVUtil::parse<long long>(s), std::stoll(s));
+    }
+    EXPECT_EQ(CSVUtil::parse<int>(" 12abc"), 12);
+    EXPECT_EQ(CSVUtil::parse<unsigned long long>("1605199509225505"), 1605199509225505ULL);
+    EXPECT_THROW(CSVUtil::parse<int>(""), std::invalid_argument);
+    EXPECT_THROW(CSVUtil::parse<double>("abc"), std::invalid_argument);
+    EXPECT_THROW(CSVUtil::parse<int>("+-1"), std::invalid_argument);
+    EXPECT_THROW(CSVUtil::parse<int>("12345678901"), std::out_of_range);
+}
+
+// printDouble() formatting the integer part with snprintf
+static std::string printDoubleRef(double d, int max_decimal) {
+    char strbuf[128];
+    size_t cnt = 0;
+    if (d < (double)0.0) {
+        strbuf[cnt++] = '-';
+        d = -d;
+    }
+    double mul10 = pow(10,max_decimal), intpart, fracpart;
+    d = (double)((unsigned long long)(d*mul10 + 0.5))/mul10;
+    fracpart = modf(d, &intpart);
+    cnt += snprintf(strbuf+cnt, sizeof(strbuf)-cnt, "%llu",  (unsigned long long) (intpart+0.5));
+    if (max_decimal > 0) {
+        strbuf[cnt++]='.';
+        unsigned long long fpart = (unsigned long long) (fracpart*mul10 + 0.5);
+        if (fpart == 0) {
+            strbuf[cnt++]='0';
+            strbuf[cnt++]=0;
+        } else {
+            char* ptr = strbuf + (cnt+max_decimal);
+            *ptr--=0;
+            const char* ptr0 = strbuf+cnt;
+            while (fpart%10==0) {
+                fpart/=10;
+                *ptr--=0;
+            };
+            while (ptr>=ptr0) {
+                *ptr--= (char)((fpart%10) + '0');
+                fpart/=10;
+            }
+        }
+    } else {
+        strbuf[cnt] = 0;
+    }
+    return std::string(strbuf);
+}
+
+TEST_F (CSVFixture, Write) {
+    unsigned int seed = 11;
+    for (int i=0; i<100000; ++i) {
+        const double v = ((double)rand_r(&seed) - RAND_MAX/2) / (1 + rand_r(&seed)%10000);
+        const int d = i%10;
+        EXPECT_EQ(utils::CSVUtil::printDouble(v, d), printDoubleRef(v, d));
+    }
+    char buf[64];
+    // including the ties, exact (0.25, 2.5) or not (0.15, 1.005)
+    for (double v : {0.0, 1.26, -1.26, 99.951, 1234.5678, -0.04, 0.15, 0.25, 2.5, 3.5, -0.25, 1.005, 2.675, 0.0000005}) {
+        for (int d : {0, 1, 2, 6}) {
+            char ref[64];
+            snprintf(ref, sizeof(ref), "%.*f", d, v);
+            EXPECT_EQ(std::string(buf, utils::CSVUtil::writeFixed(buf, v, d)), std::string(ref));
+        }
+    }
+    for (int i=0; i<100000; ++i) {
+        // the values of 3 decimals are mostly near a tie of 2 decimals
+        const double v = (double)(rand_r(&seed)%2000000 - 1000000)/1000.0;
+        const int d = 1 + i%3;
+        char ref[64];
+        snprintf(ref, sizeof(ref), "%.*f", d, v);
+        EXPECT_EQ(std::string(buf, utils::CSVUtil::writeFixed(buf, v, d)), std::string(ref));
+    }
+    EXPECT_EQ(std::string(buf, utils::CSVUtil::writeInt(buf, -1605199509225505LL)), "-1605199509225505");
+}
+
+TEST_F (CSVFixture, Price) {
+    EXPECT_EQ(utils::CSVUtil::tickDecimals(0.01), 2);
+    EXPECT_EQ(utils::CSVUtil::tickDecimals(0.25), 2);
+    EXPECT_EQ(utils::CSVUtil::tickDecimals(1.0/64), 6);
+    EXPECT_EQ(utils::CSVUtil::tickDecimals(0.0001), 4);
+    EXPECT_EQ(utils::CSVUtil::tickDecimals(5), 0);
+    EXPECT_EQ(utils::CSVUtil::printPrice(75.1, 0.01), "75.10");
+    EXPECT_EQ(utils::CSVUtil::printPrice(4512.3, 0.25), "4512.25");
+    EXPECT_EQ(utils::CSVUtil::printPrice(4512.38, 0.25), "4512.50");
+    EXPECT_EQ(utils::CSVUtil::printPrice(-0.004, 0.01), "0.00");
+    EXPECT_EQ(utils::CSVUtil::printPrice(-1.3, 0.01), "-1.30");
+    EXPECT_EQ(utils::CSVUtil::printPrice(110.0+5.0/64, 1.0/64), "110.078125");
+    EXPECT_EQ(utils::CSVUtil::printPrice(4103, 5), "4105");
+}
+
+/*
+ * Parsing and formatting of the bar and fill lines, the istringstream
+ * tokens and std::stod vs the view tokens and parse(), and snprintf vs
+ * the write kernels.  The lines are generated, or read from the files
+ * given by the env MTS_CSV_BENCH_BARS and MTS_CSV_BENCH_FILLS, such as
+ * a day of bar files and fills.csv.
+ */
+static std::vector<std::string> benchLines(const char* env, bool is_bar, int cnt) {
+    std::vector<std::string> lines;
+    const char* fn = getenv(env);
+    if (fn) {
+        std::ifstream f(fn);
+        std::string l;
+        while (std::getline(f, l)) {
+            lines.push_back(l);
+        }
+        return lines;
+    }
+    unsigned int seed = 3;
+    char buf[256];
+    for (int i=0; i<cnt; ++i) {
+        const double px = 4100 + (rand_r(&seed)%400)*0.25;
+        if (is_bar) {
+            snprintf(buf, sizeof(buf), "%d, %s, %s, %s, %s, %d, %s, %lld, %d, %.1f, %.1f, %f, %d, %d",
+                    1675285202+i, PriceCString(px), PriceCString(px+0.5), PriceCString(px-0.25), PriceCString(px+0.25),
+                    rand_r(&seed)%1000, PriceCString(px), 1675285201072262LL + i*1000000LL, rand_r(&seed)%200-100,
+                    67.4, 163.3, 0.250193, rand_r(&seed)%300, rand_r(&seed)%300);
+        } else {
+            snprintf(buf, sizeof(buf), "CLM1,CL1,cid%d,exid%d,2,%d,%f,20201112-11:48:49.176,,%lld",
+                    i, i, rand_r(&seed)%200-100, px/100, 1605199729176522LL + i*1000LL);
+        }
+        lines.push_back(buf);
+    }
+    return lines;
+}
+
+static long long bench_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+// the numeric fields of the bar and the fill lines
+static const std::vector<int> BarNum {1, 2, 3, 4, 6, 9, 10, 11};
+static const std::vector<int> FillNum {5, 6, 9};
+
+static void benchParse(const char* name, const std::vector<std::string>& lines, const std::vector<int>& num) {
+    long long t0 = bench_ns();
+    double chk0 = 0;
+    for (const auto& l : lines) {
+        const auto& tk (utils::CSVUtil::read_line(l));
+        for (int k : num) {
+            if (k < (int)tk.size()) chk0 += std::stod(tk[k]);
+        }
+    }
+    const long long ns0 = bench_ns() - t0;
+
+    t0 = bench_ns();
+    double chk1 = 0;
+    utils::CSVUtil::LineView tk;
+    for (const auto& l : lines) {
+        utils::CSVUtil::read_line(l, tk);
+        for (int k : num) {
+            if (k < (int)tk.size()) chk1 += utils::CSVUtil::parse<double>(tk[k]);
+        }
+    }
+    const long long ns1 = bench_ns() - t0;
+    EXPECT_DOUBLE_EQ(chk0, chk1);
+    printf("%s parse %d lines: read_line and stod %.0f ns, view and parse %.0f ns per line\n",
+            name, (int)lines.size(), (double)ns0/lines.size(), (double)ns1/lines.size());
+}
+
+TEST_F (CSVFixture, Bench) {
+    const int cnt = 100000;
+    const auto& bars (benchLines("MTS_CSV_BENCH_BARS", true, cnt));
+    const auto& fills (benchLines("MTS_CSV_BENCH_FILLS", false, cnt));
+    benchParse("bar", bars, BarNum);
+    benchParse("fill", fills, FillNum);
+
+    // formatting the prices of the bars
+    std::vector<double> px;
+    utils::CSVUtil::LineView tk;
+    for (const auto& l : bars) {
+        utils::CSVUtil::read_line(l, tk);
+        for (int k : {1, 2, 3, 4}) {
+            if (k < (int)tk.size()) px.push_back(utils::CSVUtil::parse<double>(tk[k]));
+        }
+    }
+    long long t0 = bench_ns();
+    size_t len0 = 0;
+    for (double v : px) {
+        len0 += printDoubleRef(v, PRICE_PRECISION).size();
+    }
+    const long long ns0 = bench_ns() - t0;
+
+    t0 = bench_ns();
+    size_t len1 = 0;
+    char buf[64];
+    for (double v : px) {
+        len1 += utils::CSVUtil::writeDouble(buf, v, PRICE_PRECISION) - buf;
+    }
+    const long long ns1 = bench_ns() - t0;
+
+    t0 = bench_ns();
+    size_t len2 = 0;
+    for (double v : px) {
+        len2 += snprintf(buf, sizeof(buf), "%.2f", v);
+    }
+    const long long ns2 = bench_ns() - t0;
+
+    t0 = bench_ns();
+    size_t len3 = 0;
+    const int decimals = utils::CSVUtil::tickDecimals(0.25);
+    for (double v : px) {
+        len3 += utils::CSVUtil::writePrice(buf, v, 0.25, decimals) - buf;
+    }
+    const long long ns3 = bench_ns() - t0;
+    EXPECT_EQ(len0, len1);
+    EXPECT_EQ(len2, len3);
+    printf("format %d prices: printDouble with snprintf %.0f ns, writeDouble %.0f ns, "
+           "snprintf %%.2f %.0f ns, writePrice of tick %.0f ns per price\n",
+            (int)px.size(), (double)ns0/px.size(), (double)ns1/px.size(),
+            (double)ns2/px.size(), (double)ns3/px.size());
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,133 @@
+#include "floor.h"
+#include "csv_util.h"
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sys/resource.h>
+
+/*
+ * Per-reader cpu of Floor channel subscribers versus the message rate.
+ * One server publishes messages of NumTypes types round robin, each of
+ * the subscribers reads one type, either by the channel subscription,
+ * where other types are skipped by the header, or by subscribing to all
+ * types and discarding in the client, i.e. copying every message.
+ */
+
+using Message = utils::Floor::Message;
+
+static const int NumTypes = 32;
+static const int PayloadSize = 360; // about the size of an ExecutionReport
+
+static double thread_cpu_ms() {
+    rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000.0 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)/1000.0;
+}
+
+static void run(char mode, int subscribers, int rate, int seconds) {
+    auto flr = utils::Floor::getByName("floor_bench");
+    auto server = flr->getServer();
+    std::vector<std::unique_ptr<utils::Floor::Channel>> clients;
+    for (int i=0; i<subscribers; ++i) {
+        clients.emplace_back(flr->getClient());
+        std::set<int> types;
+        if (mode == 'f') {
+            types.insert(i%NumTypes);
+        } else {
+            for (int tp=0; tp<NumTypes; ++tp) {
+                types.insert(tp);
+            }
+        }
+        clients[i]->addSubscription(types);
+    }
+
+    std::atomic<bool> done(false);
+    std::vector<double> cpu_ms(subscribers, 0);
+    std::vector<long long> recv_cnt(subscribers, 0);
+    std::vector<std::thread> threads;
+    for (int i=0; i<subscribers; ++i) {
+        threads.emplace_back([&, i]() {
+            auto& ch (clients[i]);
+            const int my_type = i%NumTypes;
+            Message msg;
+            utils::Floor::MessageView view;
+            double cpu0 = thread_cpu_ms();
+            while (!done) {
+                bool got = false;
+                if (mode == 'f') {
+                    got = ch->nextMessageView(view);
+                } else {
+                    got = ch->nextMessage(msg) && (msg.type == my_type);
+                }
+                if (got) {
+                    ++recv_cnt[i];
+                    continue;
+                }
+                ch->waitNext(10*1000);
+            }
+            cpu_ms[i] = thread_cpu_ms() - cpu0;
+        });
+    }
+
+    char payload[PayloadSize] = {0};
+    Message msg(0, payload, sizeof(payload));
+    const long long total = (long long)rate*seconds;
+    const uint64_t start_micro = utils::TimeUtil::cur_micro();
+    for (long long k=0; k<total; ++k) {
+        // pace by the target rate
+        const uint64_t due_micro = start_micro + (uint64_t)(k*1000000LL/rate);
+        while (utils::TimeUtil::cur_micro() < due_micro) {
+            if (due_micro - utils::TimeUtil::cur_micro() > 100) {
+                utils::TimeUtil::micro_sleep(50);
+            }
+        }
+        msg.type = (int)(k%NumTypes);
+        msg.ref = Message::NOREF;
+        server->update(msg);
+    }
+    const double elapsed = (utils::TimeUtil::cur_micro() - start_micro)/1e+6;
+    utils::TimeUtil::micro_sleep(100*1000);
+    done = true;
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    double cpu_sum = 0;
+    long long recv_sum = 0;
+    for (int i=0; i<subscribers; ++i) {
+        cpu_sum += cpu_ms[i];
+        recv_sum += recv_cnt[i];
+    }
+    printf("%-6s subscribers: %d, rate: %d msg/s (%.0f actual), received: %lld, reader cpu: %.2f ms/s (%.2f%%)\n",
+            mode=='f'?"filter":"copy", subscribers, rate, total/elapsed, recv_sum,
+            cpu_sum/subscribers/elapsed, cpu_sum/subscribers/elapsed/10.0);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s mode[f/c/a] [subscribers] [seconds] [rate1,rate2,...]\n", argv[0]);
+        printf("  f: channel subscription filter, c: copy all and discard, a: all\n");
+        return 0;
+    }
+    utils::PLCC::ToggleTest(true);
+    char mode = argv[1][0];
+    int subscribers = (argc>2)? atoi(argv[2]) : 8;
+    int seconds = (argc>3)? atoi(argv[3]) : 2;
+    std::vector<int> rates {1000, 10000, 100000};
+    if (argc>4) {
+        rates.clear();
+        for (const auto& r : utils::CSVUtil::read_line(argv[4])) {
+            rates.push_back(std::stoi(r));
+        }
+    }
+    for (int rate : rates) {
+        if (mode == 'a') {
+            run('f', subscribers, rate, seconds);
+            run('c', subscribers, rate, seconds);
+        } else {
+            run(mode, subscribers, rate, seconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,305 @@
+#include "stdio.h"
+#include <string>
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include "floor.h"
+#include "plcc/PLCC.hpp"
+#include <thread>
+#include <atomic>
+#include <vector>
+
+/*
+ * Floor message and channel tests, including the heap allocation count
+ * of an order round trip: request, ack and an execution report sized
+ * message read back with a view.
+ */
+
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+
+static std::atomic<bool> _count_malloc(false);
+static std::atomic<long long> _malloc_cnt(0);
+
+extern "C" void* malloc(size_t size) {
+    if (_count_malloc.load(std::memory_order_relaxed)) {
+        _malloc_cnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    if (_count_malloc.load(std::memory_order_relaxed)) {
+        _malloc_cnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (_count_malloc.load(std::memory_order_relaxed)) {
+        _malloc_cnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(ptr, size);
+}
+
+using Message = utils::Floor::Message;
+
+// same as the pm::FloorBase event types
+static const int ER_TYPE = 1;
+static const int ORDER_REQ_TYPE = 6;
+static const int ORDER_ACK_TYPE = 7;
+
+// about the size of pm::ExecutionReport
+struct ERBlob {
+    char data[360];
+};
+
+TEST (FloorTest, MessageInline) {
+    ERBlob er;
+    for (int i=0; i<(int)sizeof(er.data); ++i) {
+        er.data[i] = (char)i;
+    }
+
+    _malloc_cnt = 0;
+    _count_malloc = true;
+    {
+        Message msg(ER_TYPE, er.data, sizeof(er));
+        Message msg2(msg);
+        Message msg3(std::move(msg2));
+        Message msg4;
+        msg4 = msg3;
+        msg4 = std::move(msg3);
+        msg4.copyString("Ack");
+        EXPECT_EQ(msg4.data_size, 4);
+        EXPECT_STREQ(msg4.buf, "Ack");
+        EXPECT_EQ(memcmp(msg.buf, er.data, sizeof(er)), 0);
+    }
+    _count_malloc = false;
+    EXPECT_EQ(_malloc_cnt.load(), 0);
+
+    // larger than the inline buffer, moves take the heap buffer
+    std::string large(Message::InlineSize*2, 'x');
+    Message big(ER_TYPE, large.c_str(), large.size()+1);
+    const char* big_buf = big.buf;
+    Message big2(std::move(big));
+    EXPECT_EQ(big2.buf, big_buf);
+    EXPECT_EQ(big.data_size, 0);
+    EXPECT_STREQ(big2.buf, large.c_str());
+    Message big3;
+    big3 = std::move(big2);
+    EXPECT_EQ(big3.buf, big_buf);
+    big = big3;
+    EXPECT_STREQ(big.buf, large.c_str());
+    EXPECT_NE(big.buf, big3.buf);
+}
+
+TEST (FloorTest, OrderRoundTripNoMalloc) {
+    utils::PLCC::ToggleTest(true);
+    auto flr = utils::Floor::getByName("floor_test");
+    auto client = flr->getClient();
+    auto server = flr->getServer();
+    server->addSubscription(std::set<int>{ORDER_REQ_TYPE});
+    client->addSubscription(std::set<int>{ER_TYPE});
+
+    ERBlob er;
+    memset(er.data, 0, sizeof(er));
+    std::atomic<bool> done(false);
+
+    std::thread st([&]() {
+        Message msg_in, msg_out, msg_er;
+        while (!done) {
+            if (server->nextMessage(msg_in)) {
+                server->updateAck(msg_in, msg_out, ORDER_ACK_TYPE);
+                // an ER on the order, same as the TPClient
+                msg_er.type = ER_TYPE;
+                msg_er.ref = Message::NOREF;
+                msg_er.copyData(er.data, sizeof(er));
+                server->update(msg_er);
+                continue;
+            }
+            server->waitNext(1000);
+        }
+    });
+
+    const int warmup = 10, count = 1000;
+    int er_cnt = 0;
+    Message req, resp;
+    utils::Floor::MessageView view;
+    char ordstr[256];
+    for (int i=0; i<warmup+count; ++i) {
+        if (i == warmup) {
+            _malloc_cnt = 0;
+            _count_malloc = true;
+        }
+        size_t bytes = snprintf(ordstr, sizeof(ordstr), "B algo_test, sym_test, %d, 100.25, ord_%d", i+1, i);
+        req.type = ORDER_REQ_TYPE;
+        req.copyData(ordstr, bytes+1);
+        EXPECT_TRUE(client->requestAndCheckAck(req, resp, 1, ORDER_ACK_TYPE));
+
+        // read the ER without copying
+        while (!client->nextMessageView(view)) {
+            client->waitNext(1000);
+        }
+        EXPECT_EQ(view.type, ER_TYPE);
+        EXPECT_EQ(view.data_size, sizeof(er));
+        ++er_cnt;
+    }
+    _count_malloc = false;
+    done = true;
+    st.join();
+
+    EXPECT_EQ(er_cnt, warmup+count);
+    EXPECT_EQ(_malloc_cnt.load(), 0);
+    printf("heap allocations in %d order round trips: %lld\n", count, _malloc_cnt.load());
+}
+
+TEST (FloorTest, ConcurrentRequests) {
+    // threads requesting on the same channel each get their own acks
+    utils::PLCC::ToggleTest(true);
+    auto flr = utils::Floor::getByName("floor_test_mt");
+    auto client = flr->getClient();
+    auto server = flr->getServer();
+    server->addSubscription(std::set<int>{ORDER_REQ_TYPE});
+
+    std::atomic<bool> done(false);
+    std::thread st([&]() {
+        Message msg_in, msg_out;
+        while (!done) {
+            if (server->nextMessage(msg_in)) {
+                // ack with the request, to be checked by the requester
+                server->updateAck(msg_in, msg_out, ORDER_ACK_TYPE, std::string("Ack ") + msg_in.buf);
+                continue;
+            }
+            server->waitNext(1000);
+        }
+    });
+
+    const int threads = 3, count = 200;
+    std::atomic<int> ok(0);
+    std::vector<std::thread> ct;
+    for (int t=0; t<threads; ++t) {
+        ct.emplace_back([&, t]() {
+            Message req, resp;
+            for (int i=0; i<count; ++i) {
+                const std::string ordstr ("ord_" + std::to_string(t) + "_" + std::to_string(i));
+                req.type = ORDER_REQ_TYPE;
+                req.copyString(ordstr);
+                if (client->requestAndCheckAck(req, resp, 1, ORDER_ACK_TYPE) &&
+                    (std::string(resp.buf) == "Ack " + ordstr)) {
+                    ++ok;
+                }
+            }
+        });
+    }
+    for (auto& th : ct) {
+        th.join();
+    }
+    done = true;
+    st.join();
+    EXPECT_EQ(ok.load(), threads*count);
+}
+
+TEST (FloorTest, SyncReaderLifetime) {
+    // the sync reader of a thread holds the queue of its channel, and
+    // is dropped at the thread's first request on a later channel once
+    // its channel and copies are gone
+    utils::PLCC::ToggleTest(true);
+    using QType = utils::Floor::QType;
+    auto qi = std::make_shared<QType>("floor_test_sr_fq1", false, false);
+    auto qo = std::make_shared<QType>("floor_test_sr_fq2", false, false);
+    utils::Floor::Channel server(qi, qo);
+    server.addSubscription(std::set<int>{ORDER_REQ_TYPE});
+
+    std::atomic<bool> done(false);
+    std::thread st([&]() {
+        Message msg_in, msg_out;
+        while (!done) {
+            if (server.nextMessage(msg_in)) {
+                server.updateAck(msg_in, msg_out, ORDER_ACK_TYPE, "Ack");
+                continue;
+            }
+            server.waitNext(1000);
+        }
+    });
+
+    Message req, resp;
+    req.type = ORDER_REQ_TYPE;
+    req.copyString("ord");
+    {
+        auto client = std::make_unique<utils::Floor::Channel>(qo, qi);
+        const long cnt = qo.use_count();
+        EXPECT_TRUE(client->requestAndCheckAck(req, resp, 1, ORDER_ACK_TYPE));
+        EXPECT_EQ(qo.use_count(), cnt+1);
+        {
+            // a copy shares the reader
+            utils::Floor::Channel copy (*client);
+            EXPECT_TRUE(copy.requestAndCheckAck(req, resp, 1, ORDER_ACK_TYPE));
+            EXPECT_EQ(qo.use_count(), cnt+2);
+        }
+        client.reset();
+        // the reader still holds the queue
+        EXPECT_EQ(qo.use_count(), cnt);
+    }
+    {
+        utils::Floor::Channel client(qo, qi);
+        const long cnt = qo.use_count();
+        EXPECT_TRUE(client.requestAndCheckAck(req, resp, 1, ORDER_ACK_TYPE));
+        // the previous channel's reader dropped, this one's added
+        EXPECT_EQ(qo.use_count(), cnt);
+    }
+    done = true;
+    st.join();
+}
+
+TEST (FloorTest, Doorbell) {
+    // the doorbell is off unless enabled, a woken reader's parked bit
+    // is cleared, its slot released when detached, and a reader dead
+    // while parked costs one wake
+    using QType = utils::MwQueue<1024*64>;
+    QType q;
+    QType::Writer writer(q);
+    utils::Doorbell* db = q.getPtrDoorbell();
+    const char data[] = "doorbell";
+
+    {
+        QType::Reader reader(q);
+        EXPECT_FALSE(reader.waitNext(2000));
+        EXPECT_EQ(db->slots, 0u);
+        writer.put(data, sizeof(data));
+        EXPECT_EQ(db->seq, 0);
+        EXPECT_TRUE(reader.waitNext(2000));
+    }
+
+    q.enableDoorbell();
+    {
+        QType::Reader reader(q);
+        std::atomic<bool> woken(false);
+        std::thread rt([&]() {
+            woken = reader.waitNext(5*1000*1000);
+        });
+        while (db->parked == 0) {
+            usleep(100);
+        }
+        writer.put(data, sizeof(data));
+        rt.join();
+        EXPECT_TRUE(woken.load());
+        EXPECT_EQ(db->seq, 1);
+        EXPECT_EQ(db->parked, 0u);
+        EXPECT_EQ(db->slots, 1u);
+
+        // times out with its bit cleared
+        reader.syncPos();
+        EXPECT_FALSE(reader.waitNext(2000));
+        EXPECT_EQ(db->parked, 0u);
+    }
+    EXPECT_EQ(db->slots, 0u);
+
+    // a reader of slot 5 died parked
+    db->slots = 1u << 5;
+    db->parked = 1u << 5;
+    writer.put(data, sizeof(data));
+    EXPECT_EQ(db->seq, 2);
+    EXPECT_EQ(db->parked, 0u);
+    writer.put(data, sizeof(data));
+    EXPECT_EQ(db->seq, 2);
+}
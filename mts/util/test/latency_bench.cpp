@@ -0,0 +1,81 @@
+#include "latency_stats.h"
+#include "time_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/*
+ * Overhead of the latency stats on the trading path, per hop:
+ *   stamp:   LatencyStats::now_ns(), vs the TimeUtil::cur_micro() the
+ *            path already reads, the cost of the platform clock
+ *   record:  LatencyHist::record() into a kept histogram, the algo event
+ *   lookup:  hist() by hop and symbol and a record, the floor hops
+ * The budget is 30 ns per record and 100 ns per lookup and record on top
+ * of the stamp, exits 1 if over.  Threads record into the same histogram
+ * to show the contention of the atomic adds.
+ */
+
+static const double RecordBudgetNs = 30;
+static const double LookupBudgetNs = 100;
+
+static uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    const int n = (argc>1)? atoi(argv[1]) : 10000000;
+    const int threads = (argc>2)? atoi(argv[2]) : 2;
+    const char* shm_name = "/mts_latency_bench";
+    utils::LatencyStats stats(shm_name);
+    stats.reset();
+    auto* h = stats.hist(utils::LatencyStats::HopMdAlgo, "CLN3");
+
+    uint64_t t0 = mono_ns(), chk = 0;
+    for (int i=0; i<n; ++i) {
+        chk += utils::LatencyStats::now_ns();
+    }
+    const double stamp_ns = (double)(mono_ns()-t0)/n;
+
+    t0 = mono_ns();
+    for (int i=0; i<n; ++i) {
+        chk += utils::TimeUtil::cur_micro();
+    }
+    const double cur_micro_ns = (double)(mono_ns()-t0)/n;
+
+    t0 = mono_ns();
+    for (int i=0; i<n; ++i) {
+        h->record(i&0xffff);
+    }
+    const double record_ns = (double)(mono_ns()-t0)/n;
+
+    const char* symbols[] = {"CLN3", "ESU3", "NQU3", "GCQ3"};
+    t0 = mono_ns();
+    for (int i=0; i<n; ++i) {
+        stats.hist(utils::LatencyStats::HopOrderER, symbols[i&3])->record(i&0xffff);
+    }
+    const double lookup_ns = (double)(mono_ns()-t0)/n;
+
+    printf("stamp %.1f ns (cur_micro %.1f ns), record %.1f ns (budget %.0f), lookup and record %.1f ns (budget %.0f) (%llu)\n",
+            stamp_ns, cur_micro_ns, record_ns, RecordBudgetNs, lookup_ns, LookupBudgetNs, (unsigned long long)(chk&0xff));
+
+    std::vector<std::thread> th;
+    t0 = mono_ns();
+    for (int t=0; t<threads; ++t) {
+        th.emplace_back([h, n]() {
+                for (int i=0; i<n; ++i) {
+                    h->record(i&0xffff);
+                }
+            });
+    }
+    for (auto& t : th) {
+        t.join();
+    }
+    printf("%d threads on one histogram: record %.1f ns\n", threads, (double)(mono_ns()-t0)/n);
+    shm_unlink(shm_name);
+    const bool ok = (record_ns <= RecordBudgetNs) && (lookup_ns <= LookupBudgetNs);
+    printf("%s\n", ok? "within budget" : "OVER BUDGET");
+    return ok? 0 : 1;
+}
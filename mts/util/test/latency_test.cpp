@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+#include "latency_stats.h"
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using utils::LatencyHist;
+using utils::LatencyStats;
+
+static const char* TestShm = "/mts_latency_test";
+
+TEST (LatencyTest, Buckets) {
+    // exact below SubCount, then each value falls within its bucket
+    for (uint64_t v=0; v<LatencyHist::SubCount; ++v) {
+        EXPECT_EQ(LatencyHist::bucket(v), (int)v);
+    }
+    int prev_b = -1;
+    for (uint64_t v : {16ULL, 17ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 12345ULL, 999999ULL, 123456789ULL, (1ULL<<39)+7}) {
+        const int b = LatencyHist::bucket(v);
+        EXPECT_GE(b, prev_b);
+        EXPECT_LE(LatencyHist::bucketLow(b), v);
+        EXPECT_GE(LatencyHist::bucketHigh(b), v);
+        // within 1/16 of the value
+        EXPECT_LE(LatencyHist::bucketHigh(b) - LatencyHist::bucketLow(b), v/LatencyHist::SubCount);
+        prev_b = b;
+    }
+    // consecutive buckets are contiguous
+    for (int b=0; b<LatencyHist::Buckets-1; ++b) {
+        EXPECT_EQ(LatencyHist::bucketHigh(b)+1, LatencyHist::bucketLow(b+1));
+    }
+    EXPECT_EQ(LatencyHist::bucket(1ULL<<50), LatencyHist::Buckets-1);
+}
+
+TEST (LatencyTest, Percentile) {
+    LatencyHist h;
+    memset(&h, 0, sizeof(h));
+    EXPECT_EQ(h.percentile(50), 0ULL);
+    for (uint64_t v=1; v<=10000; ++v) {
+        h.record(v*1000);
+    }
+    EXPECT_EQ(h.count(), 10000ULL);
+    EXPECT_EQ(h.max_ns, 10000000ULL);
+    EXPECT_NEAR(h.mean(), 5000500.0, 1e-6);
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        const double expected = p/100.0*10000000.0;
+        EXPECT_NEAR((double)h.percentile(p), expected, expected/LatencyHist::SubCount);
+    }
+    EXPECT_EQ(h.percentile(100), h.max_ns);
+
+    // stamps out of order count as 0
+    h.record(-5);
+    EXPECT_EQ(h.cnt[0], 1ULL);
+}
+
+TEST (LatencyTest, Shm) {
+    shm_unlink(TestShm);
+    {
+        LatencyStats stats(TestShm);
+        auto* h1 = stats.hist(LatencyStats::HopOrderER, "CLN3");
+        auto* h2 = stats.hist(LatencyStats::HopOrderER, "ESU3");
+        auto* h3 = stats.hist(LatencyStats::HopMdAlgo, "CLN3");
+        EXPECT_NE(h1, h2);
+        EXPECT_NE(h1, h3);
+        EXPECT_EQ(h1, stats.hist(LatencyStats::HopOrderER, "CLN3"));
+        h1->record(1000);
+        h1->record(3000);
+        h3->record(20);
+
+        // another process, i.e. a tap, sees the same slots
+        LatencyStats tap(TestShm, true);
+        int slots = 0;
+        tap.forEach([&slots](const LatencyStats::Slot& s) {
+                ++slots;
+                if ((strcmp(s.hop, LatencyStats::HopOrderER)==0) && (strcmp(s.symbol, "CLN3")==0)) {
+                    EXPECT_EQ(s.hist.count(), 2ULL);
+                    EXPECT_EQ(s.hist.max_ns, 3000ULL);
+                }
+            });
+        EXPECT_EQ(slots, 3);
+
+        stats.reset();
+        EXPECT_EQ(h1->count(), 0ULL);
+        EXPECT_EQ(h1, stats.hist(LatencyStats::HopOrderER, "CLN3"));
+    }
+    {
+        // a process died claiming the slots, the lookup isn't stuck
+        // and is counted as dropped
+        LatencyStats stats(TestShm);
+        int fd = shm_open(TestShm, O_RDWR, 0);
+        ASSERT_NE(fd, -1);
+        char* seg = (char*)mmap(NULL, stats.size(), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        ASSERT_NE(seg, MAP_FAILED);
+        LatencyStats::Slot* slot = (LatencyStats::Slot*)(seg + sizeof(LatencyStats::Header));
+        std::vector<int> claimed;
+        for (int i=0; i<LatencyStats::MaxSlots; ++i) {
+            if (slot[i].state == 0) {
+                slot[i].state = 1;
+                claimed.push_back(i);
+            }
+        }
+        EXPECT_EQ(stats.dropped(), 0ULL);
+        auto* h = stats.hist("stuck_hop", "CLN3");
+        ASSERT_TRUE(h != NULL);
+        h->record(10);
+        EXPECT_EQ(stats.dropped(), 1ULL);
+        LatencyStats tap(TestShm, true);
+        EXPECT_EQ(tap.dropped(), 1ULL);
+        tap.forEach([](const LatencyStats::Slot& s) {
+                EXPECT_STRNE(s.hop, "stuck_hop");
+            });
+        for (int i : claimed) {
+            slot[i].state = 0;
+        }
+        stats.reset();
+        EXPECT_EQ(tap.dropped(), 0ULL);
+        munmap(seg, stats.size());
+        ::close(fd);
+    }
+    {
+        // recorded from multiple threads
+        LatencyStats stats(TestShm);
+        const int threads = 4, per_thread = 100000;
+        std::vector<std::thread> th;
+        for (int t=0; t<threads; ++t) {
+            th.emplace_back([&stats, t]() {
+                    auto* h = stats.hist("mt_hop", "");
+                    for (int i=0; i<per_thread; ++i) {
+                        h->record(100 + t);
+                    }
+                });
+        }
+        for (auto& t : th) {
+            t.join();
+        }
+        auto* h = stats.hist("mt_hop", "");
+        EXPECT_EQ(h->count(), (uint64_t)threads*per_thread);
+        EXPECT_EQ(h->max_ns, 100ULL + threads - 1);
+    }
+    shm_unlink(TestShm);
+}
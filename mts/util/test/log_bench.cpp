@@ -0,0 +1,44 @@
+#include "plcc/PLCC.hpp"
+#include <time.h>
+
+/*
+ * Hot path cost of a logInfo() with the synchronous and the
+ * async (text and binary) loggers, writing to files in /tmp.
+ * The rate limit is raised to let all the logs through.
+ */
+
+using namespace utils;
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static void run(const char* name, const std::string& mode, int count) {
+    const std::string fname = std::string("/tmp/log_bench_") + name + ".txt";
+    std::remove(fname.c_str());
+    std::remove((fname+".bin").c_str());
+    FileLogger logger(fname.c_str(), count*2);
+    logger.setAsync(mode);
+    const char* sym = "WTI_N1";
+
+    long long t0 = now_ns();
+    for (int i=0; i<count; ++i) {
+        // not to expand the logInfo macro
+        (logger.logInfo)(__FILE__, __LINE__, "order %d %s qty %lld px %.8f sent to %s", i, sym, (long long)(i%10)+1, 70.12+i*0.01, "TT");
+    }
+    long long t1 = now_ns();
+    logger.flush();
+    long long t2 = now_ns();
+    printf("%-6s count: %d, logInfo: %.1f ns, including write out: %.1f ns\n",
+            name, count, (double)(t1-t0)/count, (double)(t2-t0)/count);
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1)? atoi(argv[1]) : 100000;
+    run("sync", "", count);
+    run("text", "text", count);
+    run("binary", "binary", count);
+    return 0;
+}
@@ -4,7 +4,10 @@
 #include <cstdlib>
 #include "rate_limiter.h"
 #include "rate_estimator.h"
+#include "csv_util.h"
 #include "plcc/PLCC.hpp"
+#include <thread>
+#include <atomic>
 
 /*
 TEST (RateTest, Check) {
@@ -469,6 +472,74 @@ TEST (RateTest, RateEstimator2) {
     }
 }
 
+// Runs op(thread_id, i) for count times on each of the threads,
+// returns nano seconds per op
+template<typename OpType>
+static double run_threads(int threads, int count, OpType op) {
+    std::atomic<int> ready(0);
+    std::vector<std::thread> tv;
+    auto t0 = utils::TimeUtil::cur_micro();
+    for (int t=0; t<threads; ++t) {
+        tv.emplace_back([&, t]() {
+            ++ready;
+            while (ready.load() < threads);
+            for (int i=0; i<count; ++i) {
+                op(t, i);
+            }
+        });
+    }
+    for (auto& th: tv) {
+        th.join();
+    }
+    return (double)(utils::TimeUtil::cur_micro()-t0)*1000.0/((double)threads*count);
+}
+
+TEST (RateTest, Contention) {
+    // all threads check/update/remove the same limiter and estimator
+    // as in risk::State::checkOrder, with the same ops serialized by a
+    // SpinLock as the reference.  Counts should be exact after the run.
+    const int count = 10000;
+    const uint64_t micro0 = utils::TimeUtil::cur_utc()*1000000ULL;
+    for (int threads : {1, 2, 4}) {
+        std::vector<std::tuple<int, time_t, int>> rlv = {
+            std::make_tuple(1000000, 1, 1),
+            std::make_tuple(2000000, 60, 1)};
+        utils::RateLimiterEns rle(rlv);
+        utils::RateEstimator re({{1e+5, 300}, {1e+5, 900}, {1e+5, 3600}}, 15);
+        auto op = [&](int t, int i) {
+            uint64_t cur_micro = micro0 + i*10;
+            rle.check(cur_micro, 1);
+            re.check(cur_micro, 1);
+            if (i%4 == 3) {
+                // cancels
+                rle.removeOnly(1);
+                re.removeOnly(1);
+            }
+        };
+        double ns = run_threads(threads, count, op);
+        const int net = threads*(count - count/4);
+        const auto& rates (re.checkRates(micro0/1000000ULL));
+        EXPECT_EQ((int)(rates[0]*300+0.5), net);
+        const auto& dump (utils::CSVUtil::read_line(rle.toStringDump()));
+        EXPECT_EQ(std::stoll(dump[3]), (long long)net);
+
+        utils::RateLimiterEns rle0(rlv);
+        utils::RateEstimator re0({{1e+5, 300}, {1e+5, 900}, {1e+5, 3600}}, 15);
+        utils::SpinLock::LockType lock(false);
+        double ns0 = run_threads(threads, count, [&](int t, int i) {
+            uint64_t cur_micro = micro0 + i*10;
+            auto sl = utils::SpinLock(lock);
+            rle0.check(cur_micro, 1);
+            re0.check(cur_micro, 1);
+            if (i%4 == 3) {
+                rle0.removeOnly(1);
+                re0.removeOnly(1);
+            }
+        });
+        printf("threads: %d, lock-free ns/op: %.1f, spin-locked ns/op: %.1f\n", threads, ns, ns0);
+    }
+}
+
 int main(int argc, char** argv) {
     utils::PLCC::ToggleTest(true);
     ::testing::InitGoogleTest(&argc, argv);
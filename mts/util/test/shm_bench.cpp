@@ -0,0 +1,151 @@
+#include "queue.h"
+#include "latency_stats.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+/*
+ * Reader throughput and latency of the ShmCircularBuffer rings with the
+ * backing options of ShmOptions, i.e.
+ *     4k        shm_open()'ed /dev/shm, as before
+ *     prefault  MAP_POPULATE at attach
+ *     mlock     MAP_POPULATE and mlock at attach
+ *     thp       transparent hugepages advised, with shmem_enabled=advise
+ *     numa0     the writer binds the pages to node 0, prefaulted
+ *     huge      hugetlbfs at the dir given, prefaulted
+ * A writer fills Rings rings of BookQ size, 8192 entries of DataLen bytes,
+ * then a reader attaches to them and reads one entry of each ring in turn,
+ * as a strategy subscribed to many BookQs.  The first pass after the
+ * attach takes the page faults, the second, after the rings are written
+ * again, the TLB misses.  The latency is of each read.
+ *     bin/shm_bench [passes] [hugetlbfs_dir]
+ */
+
+using namespace utils;
+
+static const int Rings = 32;
+static const int DataLen = 512;
+static const int Entries = 8192;
+typedef SwQueue<Entries*DataLen, DataLen, ShmCircularBuffer> QType;
+
+struct Pass {
+    LatencyHist h;
+    uint64_t total_ns;
+    Pass() : total_ns(0) { memset(&h, 0, sizeof(h)); }
+};
+
+static void fill(std::vector<std::unique_ptr<QType>>& wq) {
+    char buf[DataLen] = {0};
+    for (auto& q : wq) {
+        for (int i=0; i<Entries-1; ++i) {
+            *(int*)buf = i;
+            q->theWriter().put(buf);
+        }
+    }
+}
+
+// reads the Entries-1 last entries of each ring, one ring after another
+static void read(std::vector<std::unique_ptr<QType::Reader>>& rd, Pass& p) {
+    char buf[DataLen];
+    long long chk = 0;
+    for (auto& r : rd) {
+        r->setPos(r->getWritePos() - (Entries-1)*DataLen);
+    }
+    const uint64_t t0 = LatencyStats::now_ns();
+    for (int i=0; i<Entries-1; ++i) {
+        for (auto& r : rd) {
+            const uint64_t t1 = LatencyStats::now_ns();
+            if (r->copyNextIn(buf) == QStat_OK) {
+                chk += *(int*)buf;
+            }
+            r->advance();
+            p.h.record(LatencyStats::now_ns() - t1);
+        }
+    }
+    p.total_ns += LatencyStats::now_ns() - t0;
+    if (chk < 0) {
+        printf("bad checksum\n");
+    }
+}
+
+static void print(const char* mode, const char* pass, const Pass& p, double attach_ms) {
+    const double reads = (double)p.h.count();
+    printf("%-9s %-5s attach %7.2f ms  reads/s %6.1fM  read_ns mean %6.1f p50 %5.1f p99 %6.1f p99.9 %7.1f max %8.1f\n",
+            mode, pass, attach_ms, reads/p.total_ns*1000.0, p.h.mean(),
+            (double)p.h.percentile(50), (double)p.h.percentile(99), (double)p.h.percentile(99.9), (double)p.h.max_ns);
+}
+
+static void run(const char* mode, int passes) {
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<QType>> wq, rq;
+    for (int i=0; i<Rings; ++i) {
+        names.push_back(std::string("/shm_bench_") + mode + "_" + std::to_string(i));
+        wq.emplace_back(new QType(names.back().c_str(), false, true));
+    }
+    fill(wq);
+
+    const uint64_t t0 = LatencyStats::now_ns();
+    std::vector<std::unique_ptr<QType::Reader>> rd;
+    for (int i=0; i<Rings; ++i) {
+        rq.emplace_back(new QType(names[i].c_str(), true, false));
+        rd.emplace_back(rq.back()->newReader());
+    }
+    const double attach_ms = (LatencyStats::now_ns() - t0)/1e6;
+
+    Pass first;
+    read(rd, first);
+    print(mode, "first", first, attach_ms);
+    Pass warm;
+    for (int k=0; k<passes; ++k) {
+        fill(wq);
+        read(rd, warm);
+    }
+    print(mode, "warm", warm, attach_ms);
+
+    const std::string& dir (ShmOptions::get().huge_dir);
+    rd.clear();
+    rq.clear();
+    wq.clear();
+    for (const auto& n : names) {
+        if (dir.size()) {
+            ::unlink((dir + n).c_str());
+        }
+        shm_unlink(n.c_str());
+    }
+}
+
+int main(int argc, char** argv) {
+    const int passes = (argc > 1)? atoi(argv[1]) : 4;
+    const char* huge_dir = (argc > 2)? argv[2] : nullptr;
+    printf("%d rings of %d x %d bytes, %d warm passes\n", Rings, Entries, DataLen, passes);
+
+    auto& opt (ShmOptions::get());
+    opt.huge_dir.clear();
+    opt.thp = false;
+    opt.prefault = 0;
+    opt.numa_node = -1;
+    run("4k", passes);
+
+    opt.prefault = 1;
+    run("prefault", passes);
+
+    opt.prefault = 2;
+    run("mlock", passes);
+
+    opt.prefault = 0;
+    opt.thp = true;
+    run("thp", passes);
+
+    opt.thp = false;
+    opt.prefault = 1;
+    opt.numa_node = 0;
+    run("numa0", passes);
+
+    if (huge_dir) {
+        opt.numa_node = -1;
+        opt.huge_dir = huge_dir;
+        run("huge", passes);
+    }
+    return 0;
+}
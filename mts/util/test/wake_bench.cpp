@@ -0,0 +1,97 @@
+#include "queue.h"
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+
+/*
+ * Latency and cpu of a SwQueue reader waiting for the writer,
+ * comparing spin, sleep-poll and futex (waitNext) modes.
+ * The writer puts a timestamp every interval micro, the reader
+ * measures the delay from put to read and its own cpu time.
+ */
+
+using namespace utils;
+
+typedef SwQueue<1024*64, 64, CircularBuffer> QType;
+
+static long long now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static double thread_cpu_ms() {
+    rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)*1000.0 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)/1000.0;
+}
+
+static void run(char mode, int count, int interval_micro, int sleep_micro) {
+    QType q;
+    if (mode == 'f') {
+        q.enableDoorbell();
+    }
+    QType::Reader* reader = q.newReader();
+    std::vector<long long> lat;
+    lat.reserve(count);
+    double cpu_ms = 0;
+
+    std::thread rt([&]() {
+        char buf[64];
+        double cpu0 = thread_cpu_ms();
+        while ((int)lat.size() < count) {
+            QStatus stat = reader->copyNextIn(buf);
+            if (stat == QStat_OK) {
+                lat.push_back(now_ns() - *(long long*)buf);
+                reader->advance();
+                continue;
+            }
+            if (stat != QStat_EAGAIN) {
+                reader->catchUp();
+                continue;
+            }
+            switch (mode) {
+            case 's': break;
+            case 'p': usleep(sleep_micro); break;
+            case 'f': reader->waitNext(100*1000); break;
+            }
+        }
+        cpu_ms = thread_cpu_ms() - cpu0;
+    });
+
+    char buf[64] = {0};
+    for (int i=0; i<count; ++i) {
+        usleep(interval_micro);
+        *(long long*)buf = now_ns();
+        q.theWriter().put(buf);
+    }
+    rt.join();
+    delete reader;
+
+    std::sort(lat.begin(), lat.end());
+    const char* name = (mode=='s'?"spin":(mode=='p'?"sleep":"futex"));
+    printf("%-5s count: %d, latency(us) p50: %.1f, p99: %.1f, max: %.1f, reader cpu: %.1f ms\n",
+            name, count, lat[count/2]/1000.0, lat[count*99/100]/1000.0, lat[count-1]/1000.0, cpu_ms);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s mode[s/p/f/a] [count] [writer_interval_micro] [poll_sleep_micro]\n", argv[0]);
+        printf("  s: spin, p: sleep-poll, f: futex, a: all\n");
+        return 0;
+    }
+    char mode = argv[1][0];
+    int count = (argc>2)? atoi(argv[2]) : 10000;
+    int interval_micro = (argc>3)? atoi(argv[3]) : 100;
+    int sleep_micro = (argc>4)? atoi(argv[4]) : 1000;
+    if (mode == 'a') {
+        run('s', count, interval_micro, sleep_micro);
+        run('p', count, interval_micro, sleep_micro);
+        run('f', count, interval_micro, sleep_micro);
+    } else {
+        run(mode, count, interval_micro, sleep_micro);
+    }
+    return 0;
+}
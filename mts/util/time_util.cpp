@@ -218,6 +218,6 @@ namespace utils {
        return 0;
     }
 
-    uint64_t TimeUtil::CurTimeMicro  = 0;  // init to use 
+    thread_local uint64_t TimeUtil::CurTimeMicro  = 0;  // init to use 
 
 }
@@ -100,9 +100,10 @@ public:
     //
     static void set_cur_time_micro(uint64_t cur_micro);
     static void unset_cur_time_micro();
+    static bool is_mocked();  // cur_micro() is mocked in this thread
 
 private:
-    static uint64_t CurTimeMicro;  // static instance for time mocking
+    static thread_local uint64_t CurTimeMicro;  // per thread instance for time mocking, i.e. simulations on multiple threads
 };
 
 //
@@ -156,6 +157,10 @@ inline void TimeUtil::unset_cur_time_micro() {
     TimeUtil::CurTimeMicro = 0;
 }
 
+inline bool TimeUtil::is_mocked() {
+    return TimeUtil::CurTimeMicro != 0;
+}
+
 inline uint64_t TimeUtil::cur_micro() {
     if (__builtin_expect(TimeUtil::CurTimeMicro != 0, 0)) {
         return TimeUtil::CurTimeMicro;
@@ -0,0 +1,31 @@
+#include <bookL2.hpp>
+
+#include <string>
+#include <stdlib.h>
+
+using namespace tp;
+using namespace utils;
+using namespace std;
+
+// builds or catches up the L2DeltaIndex of the L2 delta files written by
+// tickrecL2, i.e. the files recorded before the writer kept the index
+int main(int argc, char**argv) {
+    if (argc < 2) {
+        printf("Usage: %s l2_delta_file [l2_delta_file ...]\n", argv[0]);
+        return 0;
+    }
+    utils::PLCC::instance("L2Indexer");
+    int ret = 0;
+    for (int i = 1; i < argc; ++i) {
+        long long cnt = L2DeltaIndex::update(argv[i]);
+        if (cnt < 0) {
+            printf("%s: failed to index\n", argv[i]);
+            ret = -1;
+            continue;
+        }
+        const L2DeltaIndex idx(argv[i]);
+        printf("%s: %lld snapshots indexed, %d total in %s\n",
+                argv[i], cnt, (int) idx.size(), L2DeltaIndex::fname(argv[i]).c_str());
+    }
+    return ret;
+}
@@ -66,6 +66,9 @@ int main(int argc, char**argv) {
     if (argc>5) {
         start_utc = (int64_t)atoi(argv[5]);
     }
+    if (start_utc > 0) {
+        start_utc*=1000000LL;
+    }
 
     int64_t end_utc = 0x7fffffff;
     if (argc>6) {
@@ -81,6 +84,10 @@ int main(int argc, char**argv) {
     utils::PLCC::instance("L2Reader");
     BookConfig bcfg(argv[1],bt,next_contract);
     L2DeltaReader reader(bcfg, tail);
+    if (!tail && start_utc > 0) {
+        // from the snapshot before start_utc through the index
+        reader.seek((uint64_t)start_utc);
+    }
     user_stopped = false;
     const BookDepot* book;
     int64_t last_micro = 0;
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "bookL2.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace tp {
+
+/*
+ * Replay of the L2 delta files recorded by tickrecL2, one segment per
+ * symbol/day file, each from the snapshot found by L2DeltaReader::seek()
+ * through the L2DeltaIndex.
+ */
+class L2Replay {
+public:
+	struct Segment {
+		BookConfig cfg;
+		std::string fname;     // empty for cfg.L2fname()
+		uint64_t start_micro;  // updates in [start_micro, end_micro)
+		uint64_t end_micro;    // 0 for the end of the file
+	};
+	typedef std::function<void(int, const BookDepot&)> Callback;
+	static const int BatchSize = 256;  // updates per batch of merge()
+	static const int MaxBatches = 4;   // batches ahead of merge() per segment
+
+	// the segments are taken by the workers in order, the callback is
+	// called from the workers, so it has to be thread safe.
+	// Returns the number of updates replayed
+	static long long run(const std::vector<Segment>& segs, int threads, const Callback& cb) {
+		std::atomic<size_t> next(0);
+		std::atomic<long long> cnt(0);
+		auto worker = [&]() {
+			size_t i;
+			while ((i = next.fetch_add(1)) < segs.size()) {
+				std::unique_ptr<L2DeltaReader> reader(open(segs[i]));
+				if (!reader) {
+					continue;
+				}
+				long long n = 0;
+				const BookDepot* book;
+				while ((book = reader->readNext()) &&
+					   (!segs[i].end_micro || (book->update_ts_micro < segs[i].end_micro))) {
+					cb((int)i, *book);
+					++n;
+				}
+				cnt += n;
+			}
+		};
+		std::vector<std::thread> pool;
+		for (int i=0; i<std::max(std::min(threads, (int)segs.size()), 1); ++i) {
+			pool.emplace_back(worker);
+		}
+		for (auto& t : pool) {
+			t.join();
+		}
+		return cnt;
+	}
+
+	// the updates of all segments merged in the order of update_ts_micro,
+	// ties in the order of the segments.  The workers rebuild the books in
+	// batches ahead of the merge, the callback is called from the caller's
+	// thread.  Returns the number of updates replayed
+	static long long merge(const std::vector<Segment>& segs, int threads, const Callback& cb) {
+		const int n = (int)segs.size();
+		std::vector<SegState> st(n);
+		for (int i=0; i<n; ++i) {
+			st[i].reader.reset(open(segs[i]));
+			st[i].done = !st[i].reader;
+		}
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool stop = false;
+
+		// a worker takes a segment that is not busy, done or full
+		auto worker = [&]() {
+			std::unique_lock<std::mutex> lock(mtx);
+			while (!stop) {
+				int i = 0;
+				for (; i<n; ++i) {
+					if (!st[i].busy && !st[i].done && ((int)st[i].batches.size() < MaxBatches)) {
+						break;
+					}
+				}
+				if (i == n) {
+					cv.wait(lock);
+					continue;
+				}
+				st[i].busy = true;
+				lock.unlock();
+				std::vector<BookDepot> batch;
+				batch.reserve(BatchSize);
+				bool done = false;
+				while ((int)batch.size() < BatchSize) {
+					const BookDepot* book = st[i].reader->readNext();
+					if (!book || (segs[i].end_micro && (book->update_ts_micro >= segs[i].end_micro))) {
+						done = true;
+						break;
+					}
+					batch.push_back(*book);
+				}
+				lock.lock();
+				if (batch.size()) {
+					st[i].batches.emplace_back(std::move(batch));
+				}
+				st[i].done = done;
+				st[i].busy = false;
+				cv.notify_all();
+			}
+		};
+		std::vector<std::thread> pool;
+		for (int i=0; i<std::max(std::min(threads, n), 1); ++i) {
+			pool.emplace_back(worker);
+		}
+
+		// the next update of segment i, NULL if the segment is done
+		auto head = [&](int i) -> const BookDepot* {
+			SegState& s (st[i]);
+			if (s.pos < s.cur.size()) {
+				return &s.cur[s.pos];
+			}
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&s]() { return s.batches.size() || (s.done && !s.busy); });
+			if (s.batches.empty()) {
+				return NULL;
+			}
+			s.cur = std::move(s.batches.front());
+			s.batches.pop_front();
+			s.pos = 0;
+			cv.notify_all();
+			return &s.cur[0];
+		};
+
+		typedef std::pair<uint64_t, int> HeapEntry;
+		std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > heap;
+		for (int i=0; i<n; ++i) {
+			const BookDepot* book = head(i);
+			if (book) {
+				heap.emplace(book->update_ts_micro, i);
+			}
+		}
+		long long cnt = 0;
+		while (heap.size()) {
+			const int i = heap.top().second;
+			heap.pop();
+			cb(i, st[i].cur[st[i].pos++]);
+			++cnt;
+			const BookDepot* book = head(i);
+			if (book) {
+				heap.emplace(book->update_ts_micro, i);
+			}
+		}
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			stop = true;
+			cv.notify_all();
+		}
+		for (auto& t : pool) {
+			t.join();
+		}
+		return cnt;
+	}
+
+private:
+	struct SegState {
+		std::unique_ptr<L2DeltaReader> reader;
+		std::deque<std::vector<BookDepot> > batches;  // rebuilt ahead of the merge
+		std::vector<BookDepot> cur;  // the batch being merged
+		size_t pos;                  // next update in cur
+		bool busy;                   // a worker is reading the segment
+		bool done;                   // no more batches from the reader
+		SegState() : pos(0), busy(false), done(false) {};
+	};
+
+	// a reader at the segment's start_micro, NULL if failed to open
+	static L2DeltaReader* open(const Segment& seg) {
+		try {
+			L2DeltaReader* reader = new L2DeltaReader(seg.cfg, false, seg.fname);
+			reader->seek(seg.start_micro);
+			return reader;
+		} catch (const std::exception& e) {
+			logError("failed to open L2 delta file of %s: %s", seg.cfg.toString().c_str(), e.what());
+		}
+		return NULL;
+	}
+};
+
+}  // namespace tp
@@ -15,7 +15,11 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <algorithm>
 
 //#define MaxPriceLevels 8
 //there is really no need to
@@ -1010,6 +1014,36 @@ public:
             throw std::runtime_error("BookQ Reader got unknown qstat.");
         }
 
+        // reads up to max_books next updates into book, as getNextUpdate()
+        // in a loop, with one position read, memcpy and overflow check per
+        // contiguous run of the queue.  Returns the updates read, 0 if none.
+        int readBatch(BookDepot* book, int max_books) {
+            int cnt = 0;
+            while (cnt < max_books) {
+                int items = 0;
+                utils::QStatus stat = _rq->copyNextBatchIn((char*)(book + cnt), max_books - cnt, items);
+                switch (stat) {
+                case utils::QStat_OK :
+                    _rq->advance(items);
+                    cnt += items;
+                    continue;
+                case utils::QStat_EAGAIN :
+                    return cnt;
+                case utils::QStat_OVERFLOW :
+                {
+                    int lost_updates = _rq->catchUp();
+                    logError("venue read queue %s overflow, lost %d updates. Trying to catch up."
+                            ,_bq._q_name.c_str(), lost_updates);
+                    continue;
+                }
+                }
+                logError("readBatch read queue %s unknown qstat %d, exiting..."
+                        ,_bq._q_name.c_str(), (int) stat);
+                throw std::runtime_error("BookQ Reader got unknown qstat.");
+            }
+            return cnt;
+        }
+
         bool getLatestUpdate(BookDepot& book) {
             _rq->seekToTop();
             utils::QStatus stat = _rq->copyNextIn((char*)&book);
@@ -1216,6 +1250,8 @@ private:
 template <template<int, int> class BufferType >
 class BarLine {
 public:
+	static const int BatchSize = 16;  // updates per BookQ read
+
 	BarLine(const BookConfig& cfg, int bar_sec) :
 		bcfg(cfg), barsec(bar_sec),
 		bq(cfg,true), br(bq.newReader()),
@@ -1229,13 +1265,12 @@ public:
 	}
 
 	bool update_continous(int64_t cur_micro) {
-		BookDepot book;
 		//if (br->getLatestUpdateAndAdvance(book)) {
-		if (br->getNextUpdate(book)) {
-			bw.update(book, cur_micro);
-			return true;
+		const int cnt = br->readBatch(books, BatchSize);
+		for (int i = 0; i < cnt; ++i) {
+			bw.update(books[i], cur_micro);
 		}
-		return false;
+		return cnt > 0;
 	}
 
     void onBar(int64_t cur_micro) {
@@ -1253,6 +1288,7 @@ private:
 	BookQ<BufferType> bq;
 	typename BookQ<BufferType>::Reader* br;
 	BarLineWriter bw;
+	BookDepot books[BatchSize];
 };
 
 /*
@@ -1267,18 +1303,151 @@ private:
 static const uint64_t SnapshotPreamble = 0xf0f0f0f0f0f0f0f0ULL;
 static const int SnapCount  = 1024;
 
+/*
+ * Time index of the snapshots of an L2 delta file, in a sidecar file
+ * with the .bin replaced by .idx.  Each entry is the offset of a
+ * PREAMBLE and the running max of the snapshot's update_ts_micro, so
+ * the entries stay sorted for a binary search by time.
+ * L2DeltaWriter appends an entry for each snapshot it writes; update()
+ * indexes the snapshots not yet indexed, i.e. the files written before
+ * the index, and is used by the offline indexer (l2fileidx).
+ */
+class L2DeltaIndex {
+public:
+	struct Entry {
+		uint64_t ts_micro;
+		uint64_t offset;
+	};
+
+	static std::string fname(const std::string& l2_fname) {
+		const std::string ext(".bin");
+		if (l2_fname.size() > ext.size() &&
+			l2_fname.compare(l2_fname.size()-ext.size(), ext.size(), ext) == 0) {
+			return l2_fname.substr(0, l2_fname.size()-ext.size()) + ".idx";
+		}
+		return l2_fname + ".idx";
+	}
+
+	// maps the index of l2_fname read only, empty if it doesn't exist
+	explicit L2DeltaIndex(const std::string& l2_fname) : _ptr(NULL), _len(0) {
+		int fd = open(fname(l2_fname).c_str(), O_RDONLY);
+		if (fd < 0) {
+			return;
+		}
+		struct stat fs;
+		if (fstat(fd, &fs) == 0 && fs.st_size >= (off_t)sizeof(Entry)) {
+			// a partially written entry at the end is not mapped
+			size_t len = fs.st_size - fs.st_size % sizeof(Entry);
+			void* ptr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+			if (ptr != MAP_FAILED) {
+				_ptr = ptr;
+				_len = len;
+			}
+		}
+		close(fd);
+	}
+	~L2DeltaIndex() {
+		if (_ptr)
+			munmap(_ptr, _len);
+	}
+
+	size_t size() const { return _len/sizeof(Entry); }
+	const Entry* begin() const { return (const Entry*) _ptr; }
+	const Entry* end() const { return begin() + size(); }
+
+	// offset of the latest snapshot at or before ts_micro, -1 if none
+	long long snapBefore(uint64_t ts_micro) const {
+		const Entry* e = std::upper_bound(begin(), end(), ts_micro,
+				[](uint64_t ts, const Entry& en) { return ts < en.ts_micro; });
+		return (e == begin())? -1 : (long long) (e-1)->offset;
+	}
+
+	// indexes the snapshots of l2_fname after the last one in the index,
+	// returns the number of entries added, -1 on error
+	static long long update(const std::string& l2_fname) {
+		const std::string idx_fname(fname(l2_fname));
+		uint64_t pos = 0, max_ts = 0;
+		size_t cnt = 0;
+		{
+			const L2DeltaIndex idx(l2_fname);
+			cnt = idx.size();
+			if (cnt) {
+				// restart from the last indexed snapshot, skipped below
+				pos = (idx.end()-1)->offset;
+				max_ts = (idx.end()-1)->ts_micro;
+			}
+		}
+		FILE* fp = fopen(l2_fname.c_str(), "rb");
+		if (!fp) {
+			logError("cannot open L2 delta file %s for indexing", l2_fname.c_str());
+			return -1;
+		}
+		std::vector<Entry> entries;
+		fseek(fp, pos, SEEK_SET);
+		uint64_t header;
+		BookDepot book;
+		L2Delta delta;
+		for (bool skip = (cnt > 0); fread(&header, sizeof(uint64_t), 1, fp) == 1; skip = false) {
+			if (header == SnapshotPreamble) {
+				if (fread(&book, sizeof(BookDepot), 1, fp) != 1) {
+					break;
+				}
+				if (!skip) {
+					max_ts = std::max(max_ts, book.update_ts_micro);
+					entries.push_back(Entry{max_ts, pos});
+				}
+				pos += sizeof(uint64_t) + sizeof(BookDepot);
+			} else {
+				if (fread(&delta, sizeof(L2Delta), 1, fp) != 1) {
+					break;
+				}
+				pos += sizeof(uint64_t) + sizeof(L2Delta);
+			}
+		}
+		fclose(fp);
+
+		// drop a partially written entry before appending
+		if (truncate(idx_fname.c_str(), cnt*sizeof(Entry)) != 0 && errno != ENOENT) {
+			logError("cannot truncate L2 delta index %s", idx_fname.c_str());
+			return -1;
+		}
+		if (entries.size() == 0) {
+			return 0;
+		}
+		FILE* ifp = fopen(idx_fname.c_str(), "ab");
+		if (!ifp) {
+			logError("cannot open L2 delta index %s", idx_fname.c_str());
+			return -1;
+		}
+		bool ok = (fwrite(&entries[0], sizeof(Entry), entries.size(), ifp) == entries.size());
+		ok = (fclose(ifp) == 0) && ok;
+		return ok? (long long) entries.size() : -1;
+	}
+
+private:
+	void* _ptr;
+	size_t _len;
+	L2DeltaIndex(const L2DeltaIndex&) = delete;
+	void operator=(const L2DeltaIndex&) = delete;
+};
+
 template <template<int, int> class BufferType >
 class L2DeltaWriter {
 public:
 	static const int FlushCount = 1;
 	static const uint64_t MaxSnapMicro = 300ULL * 1000000ULL;
+	static const int BatchSize = 16;  // updates per BookQ read
 
 	L2DeltaWriter(const BookConfig& bcfg) :
 		_bcfg(bcfg),
-		_fp(fopen(bcfg.L2fname().c_str(), "ab+")), // barsec=0 -> L2Delta
+		_fname(bcfg.L2fname()),
+		_fp(fopen(_fname.c_str(), "ab+")), // barsec=0 -> L2Delta
 		_flushCount(0),
 		_snapCount(0),
 		_nextSnapSec(0),
+		_pos(0),
+		_maxSnapMicro(0),
+		_ifp(NULL),
 		_bq(_bcfg,true), _br(_bq.newReader())
 	{
 		if (!_fp) {
@@ -1291,41 +1460,74 @@ public:
 					std::string("cannot open shm queue for L2 delta writer ")
 			        + bcfg.toString());
 		}
+		// catch up the index with a file written before it, then
+		// append an entry for each snapshot written from here
+		if (L2DeltaIndex::update(_fname) < 0) {
+			throw std::runtime_error(
+					std::string("cannot update the index for L2 delta writer ")
+			        + bcfg.toString());
+		}
+		{
+			const L2DeltaIndex idx(_fname);
+			if (idx.size()) {
+				_maxSnapMicro = (idx.end()-1)->ts_micro;
+			}
+		}
+		fseek(_fp, 0, SEEK_END);
+		_pos = ftell(_fp);
+		_ifp = fopen(L2DeltaIndex::fname(_fname).c_str(), "ab");
+		if (!_ifp) {
+			throw std::runtime_error(
+					std::string("cannot open index file for L2 delta writer ")
+			        + bcfg.toString());
+		}
 	};
 	~L2DeltaWriter() {
 		if (_fp)
 			fclose(_fp);
 		_fp=NULL;
+		if (_ifp)
+			fclose(_ifp);
+		_ifp=NULL;
 		delete _br;
 		_br = NULL;
 	}
 
 	bool update() {
-		BookDepot book;
-		if (_br->getNextUpdate(book)) {
-			write(book);
-			return true;
+		const int cnt = _br->readBatch(_books, BatchSize);
+		for (int i = 0; i < cnt; ++i) {
+			write(_books[i]);
 		}
-		return false;
+		return cnt > 0;
 	}
 private:
 	const BookConfig& _bcfg;
+	const std::string _fname;
 	FILE* _fp;
 	int _flushCount;
 	int _snapCount;
 	uint64_t _nextSnapSec;
+	uint64_t _pos;  // file size, the offset of the next record
+	uint64_t _maxSnapMicro;
+	FILE* _ifp;  // L2DeltaIndex
 	BookQ<BufferType> _bq;
 	typename BookQ<BufferType>::Reader* _br;
+	BookDepot _books[BatchSize];
 
 	void writeSnap(const BookDepot& book) {
 		logDebug("write snap\n");
+		_maxSnapMicro = std::max(_maxSnapMicro, book.update_ts_micro);
+		const L2DeltaIndex::Entry entry {_maxSnapMicro, _pos};
 		fwrite(&SnapshotPreamble, sizeof(uint64_t), 1, _fp);
 		fwrite(&book, sizeof(BookDepot), 1, _fp);
+		fwrite(&entry, sizeof(entry), 1, _ifp);
+		_pos += sizeof(uint64_t) + sizeof(BookDepot);
 	}
 	void writeDelta(const BookDepot& book) {
 		logDebug("write delta: %s\n", book.l2_delta.toString().c_str());
 		fwrite(&book.update_ts_micro, sizeof(uint64_t), 1, _fp);
 		fwrite(&book.l2_delta, sizeof(book.l2_delta), 1, _fp);
+		_pos += sizeof(uint64_t) + sizeof(book.l2_delta);
 	}
 
 	void write(const BookDepot& book) {
@@ -1342,7 +1544,9 @@ private:
 			writeDelta(book);
 		}
 		if (_flushCount == 0) {
+			// the data before its index entry
 			fflush(_fp);
+			fflush(_ifp);
 			_flushCount = FlushCount;
 		} else {
 			--_flushCount;
@@ -1352,16 +1556,18 @@ private:
 
 class L2DeltaReader {
 public:
-	explicit L2DeltaReader(const BookConfig& bcfg, bool tail = true) :
+	// fname defaults to bcfg.L2fname(), given to read the file of another day
+	explicit L2DeltaReader(const BookConfig& bcfg, bool tail = true, const std::string& fname = "") :
 		_bcfg(bcfg),
-		_fname(bcfg.L2fname()),
+		_fname(fname.size()? fname : bcfg.L2fname()),
 		_book(bcfg),
 		_fp(fopen(_fname.c_str(), "rb")),
 		_latest_micro(0),
 		_last_pos(0),
 		_file_size(0),
 		_has_header(false),
-		_header(0)
+		_header(0),
+		_pending(false)
 	{
 		if (!_fp) {
 			throw std::runtime_error(
@@ -1379,6 +1585,11 @@ public:
 		_fp = NULL;
 	}
 	const BookDepot* readNext() {
+		if (_pending) {
+			// the snapshot read by seek()
+			_pending = false;
+			return &(_book._book);
+		}
 		if (!readHeader()) {
 			return NULL;
 		}
@@ -1397,6 +1608,41 @@ public:
 		return &(_book._book);
 	}
 
+	// Positions at the first update at or after ts_micro, with the book
+	// built from the latest snapshot before it found in the L2DeltaIndex,
+	// or from the start of the file if not indexed.  The next readNext()
+	// returns that update.  Returns false if no snapshot was read, i.e.
+	// the file has nothing at or before ts_micro
+	bool seek(uint64_t ts_micro) {
+		long long offset = -1;
+		{
+			const L2DeltaIndex idx(_fname);
+			offset = idx.snapBefore(ts_micro);
+		}
+		_file_size = updFileSize();
+		_last_pos = (offset > 0 && (uint64_t) offset < _file_size)? offset : 0;
+		fseek(_fp, _last_pos, SEEK_SET);
+		_has_header = false;
+		_pending = false;
+
+		bool has_snap = false;
+		while (readHeader()) {
+			if (_header != SnapshotPreamble && _header >= ts_micro && has_snap) {
+				break;
+			}
+			const BookDepot* book = readNext();
+			if (_header == SnapshotPreamble) {
+				has_snap = true;
+			}
+			if (book->update_ts_micro >= ts_micro && has_snap) {
+				// a snapshot at or after ts_micro
+				_pending = true;
+				break;
+			}
+		}
+		return has_snap;
+	}
+
 private:
 	const BookConfig& _bcfg;
 	const std::string _fname;
@@ -1408,9 +1654,19 @@ private:
 
 	bool _has_header;
 	uint64_t _header;
+	bool _pending;
 
 	void sync() {
 		_file_size = updFileSize();
+		{
+			// the latest snapshot from the index, if any
+			const L2DeltaIndex idx(_fname);
+			if (idx.size() && (idx.end()-1)->offset < _file_size) {
+				_last_pos = (idx.end()-1)->offset;
+				fseek(_fp, _last_pos, SEEK_SET);
+				return;
+			}
+		}
 		uint64_t seek_point = SnapCount*(sizeof(L2Delta)+sizeof(uint64_t)) + sizeof(uint64_t);
 		if (seek_point < _file_size) {
 			_last_pos = _file_size - seek_point;
@@ -163,6 +163,48 @@ namespace utils {
                 return QStat_OK;
             }
 
+            // copies up to max_items after the read position into buffer,
+            // stopping at the wrap point of the circular buffer so it is
+            // one memcpy.  The writer position is read once and the
+            // overflow checked once after the copy.  items is the count
+            // copied on QStat_OK, the caller advance(items) after using them.
+            QStatus copyNextBatchIn(char* buffer, int max_items, int& items) {
+                items = 0;
+                QPos pos = *m_ready_bytes;
+                long long bytes = (long long) (pos - m_pos);
+
+                if (__builtin_expect((bytes == 0),0)) {
+                    return QStat_EAGAIN;
+                }
+                while (__builtin_expect((bytes < 0),0)) {
+                    // queue was restarted with a lower position
+                    seekToBottom();
+                    pos = *m_ready_bytes;
+                    bytes = (long long) (pos - m_pos);
+                }
+                if (__builtin_expect((bytes > QLen - DataLen), 0)) {
+                    return QStat_OVERFLOW;
+                }
+                const long long to_wrap = (long long) (QLen - (m_pos % QLen));
+                if (bytes > to_wrap) {
+                    bytes = to_wrap;
+                }
+                int cnt = (int) (bytes/DataLen);
+                if (cnt > max_items) {
+                    cnt = max_items;
+                }
+                if (__builtin_expect(cnt <= 0, 0)) {
+                    return QStat_EAGAIN;
+                }
+                m_buffer->template copyBytesNoCross<false>(m_pos, buffer, cnt*DataLen);
+                // check overflow after read, of the first item
+                if (__builtin_expect(((*m_ready_bytes - m_pos) > QLen - DataLen), 0)) {
+                    return QStat_OVERFLOW;
+                }
+                items = cnt;
+                return QStat_OK;
+            }
+
             QStatus copyTopIn(char* buffer) {
                 QPos pos = *m_ready_bytes;
                 if (__builtin_expect( (pos==0),0)) {
@@ -303,7 +345,7 @@ namespace utils {
                 m_pos = (pos > (QLen - DataLen))? (pos - QLen - DataLen) : 0;
             }
 
-            void advance() { m_pos += DataLen; };
+            void advance(int items = 1) { m_pos += items*DataLen; };
             void syncPos() { m_pos = *m_ready_bytes;};
             QPos getPos() const { return m_pos; };
             QPos getWritePos() const { return *m_ready_bytes;}